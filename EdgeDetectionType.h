@@ -3,7 +3,8 @@
 enum class EdgeDetectionType {
     None,
     Sobel,
-    Canny
+    Canny,
+    Texture
 };
 
 #endif // EDGEDETECTIONTYPE_H
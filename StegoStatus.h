@@ -12,7 +12,13 @@ enum class StegoStatus {
     VIDEO_OPEN_FAILED,
     DECRYPTION_FAILED,
     INVALID_MEDIA,
-    VIDEO_REENCODING_FAILED
+    VIDEO_REENCODING_FAILED,
+    DECOMPRESSION_FAILED,
+    ARCHIVE_MEMBER_NOT_FOUND,
+    INVALID_RANGE,
+    SHARD_SET_INCOMPLETE,
+    UNEXPECTED_ERROR,
+    PAYLOAD_IS_ARCHIVE
 };
 
 #endif // STEGOSTATUS_H
@@ -0,0 +1,875 @@
+#include <QTest>
+#include <QElapsedTimer>
+#include "../edgecache.h"
+#include "../edgedetection.h"
+#include "../jobscheduler.h"
+#include "../stego.h"
+#include "../stegocapacity.h"
+#include "../stegoplanner.h"
+#include "../framesource.h"
+#include "../videobackend.h"
+#include <fstream>
+#include <functional>
+#include <random>
+
+/**
+ * Per sample cost of the embedding and extraction loops for every algorithm and edge detection mode, with the edge
+ * detection reported apart from the loops. Runs on a single thread so the numbers compare between builds, e.g. before
+ * and after a change to the kernels.
+ * The video backends and frame sources are timed end to end instead, in frames per second.
+ */
+class Benchmarks: public QObject
+{
+    Q_OBJECT
+private:
+    QString smallImage = "TestMedia/Lenna.png";
+    QString testVideo = "TestMedia/sample_640x360.mkv";
+
+    QString LSB = "LSB";
+    QString PVD = "PVD";
+
+    QString noEdgeDetection = "None";
+    QString sobelEdgeDetection = "Sobel";
+    QString cannyEdgeDetection = "Canny";
+    QString textureEdgeDetection = "Texture";
+
+    static constexpr int NUM_SIDE_RUNS = 5;
+
+    /**
+     * @brief payloadForHalfCapacity Random payload that fills half of the image's capacity in the given mode.
+     */
+    std::vector<uint8_t> payloadForHalfCapacity(const cv::Mat& image, const QString& stegoAlgo, const QString& edgeDetection)
+    {
+        StegoAlgo algo = stegoAlgo == LSB ? StegoAlgo::LSB : StegoAlgo::PVD;
+        EdgeDetectionType edgeDetectionType = EdgeDetectionType::None;
+        if (edgeDetection == sobelEdgeDetection)
+        {
+            edgeDetectionType = EdgeDetectionType::Sobel;
+        }
+        else if (edgeDetection == cannyEdgeDetection)
+        {
+            edgeDetectionType = EdgeDetectionType::Canny;
+        }
+        else if (edgeDetection == textureEdgeDetection)
+        {
+            edgeDetectionType = EdgeDetectionType::Texture;
+        }
+
+        StegoCapacity capacity(algo, edgeDetectionType);
+        std::vector<uint8_t> payload(capacity.FrameCapacity(image, NUM_HEADER_PIXELS) / 2);
+
+        std::mt19937 generator(1);
+        for (uint8_t& byte : payload)
+        {
+            byte = static_cast<uint8_t>(generator());
+        }
+
+        return payload;
+    }
+
+    /**
+     * @brief averageTime Average time of one call in nanoseconds, for the costs reported next to a QBENCHMARK loop.
+     */
+    double averageTime(const std::function<void()>& call)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        for (int run = 0; run < NUM_SIDE_RUNS; run++)
+        {
+            call();
+        }
+
+        return double(timer.nsecsElapsed()) / NUM_SIDE_RUNS;
+    }
+
+    /**
+     * @brief detectionTime Time in nanoseconds to detect the edges of the carrier once, 0 without edge detection.
+     */
+    double detectionTime(const cv::Mat& carrier, EdgeDetectionType edgeDetectionType)
+    {
+        if (edgeDetectionType == EdgeDetectionType::None)
+        {
+            return 0;
+        }
+
+        EdgeDetection edgeDetector;
+        return averageTime([&]()
+        {
+            QCOMPARE(edgeDetector.DetectEdges(carrier, edgeDetectionType), StegoStatus::SUCCESS);
+        });
+    }
+
+    void modes()
+    {
+        QTest::addColumn<QString>("stegoAlgo");
+        QTest::addColumn<QString>("edgeDetection");
+
+        QTest::newRow("LSB-NoEdgeDetection") << LSB << noEdgeDetection;
+        QTest::newRow("LSB-SobelEdgeDetection") << LSB << sobelEdgeDetection;
+        QTest::newRow("LSB-CannyEdgeDetection") << LSB << cannyEdgeDetection;
+        QTest::newRow("LSB-TextureEdgeDetection") << LSB << textureEdgeDetection;
+        QTest::newRow("PVD-NoEdgeDetection") << PVD << noEdgeDetection;
+        QTest::newRow("PVD-SobelEdgeDetection") << PVD << sobelEdgeDetection;
+        QTest::newRow("PVD-CannyEdgeDetection") << PVD << cannyEdgeDetection;
+        QTest::newRow("PVD-TextureEdgeDetection") << PVD << textureEdgeDetection;
+    }
+
+private slots:
+    void encodeImageBenchmark_data()
+    {
+        modes();
+    }
+
+    /**
+     * @brief encodeImageBenchmark Per sample cost of the embedding loop. The edges are detected once before the
+     * timed loop and reported on their own, the timed encodes read the mask from a warm edge cache, and the fixed cost
+     * of a call, measured with a one byte payload, is left out of the kernel time.
+     */
+    void encodeImageBenchmark()
+    {
+        QFETCH(QString, stegoAlgo);
+        QFETCH(QString, edgeDetection);
+
+        cv::Mat carrier = cv::imread(smallImage.toStdString(), cv::IMREAD_COLOR);
+        QVERIFY(!carrier.empty());
+        std::vector<uint8_t> payload = payloadForHalfCapacity(carrier, stegoAlgo, edgeDetection);
+        std::vector<uint8_t> tinyPayload(1, 0);
+
+        EdgeDetectionType edgeDetectionType;
+        QVERIFY(StegoPlanner::ParseEdgeDetection(edgeDetection.toStdString(), edgeDetectionType));
+        double numSamples = double(carrier.total()) * carrier.channels();
+        double detectionNs = detectionTime(carrier, edgeDetectionType);
+
+        std::filesystem::remove_all("image_benchmark_cache");
+        Stego stego(stegoAlgo.toStdString(), edgeDetection.toStdString(), false, "");
+        stego.SetParallel(false);
+        stego.SetEdgeCache(std::make_shared<EdgeCache>("image_benchmark_cache"));
+        cv::Mat stegoImage;
+        QCOMPARE(stego.EncodeImage(carrier, tinyPayload.data(), tinyPayload.size(), "payload.bin", stegoImage),
+                 StegoStatus::SUCCESS);
+
+        double fixedNs = averageTime([&]()
+        {
+            QCOMPARE(stego.EncodeImage(carrier, tinyPayload.data(), tinyPayload.size(), "payload.bin", stegoImage),
+                     StegoStatus::SUCCESS);
+        });
+
+        QElapsedTimer timer;
+        qint64 numRuns = 0;
+        timer.start();
+        QBENCHMARK
+        {
+            QCOMPARE(stego.EncodeImage(carrier, payload.data(), payload.size(), "payload.bin", stegoImage),
+                     StegoStatus::SUCCESS);
+            numRuns++;
+        }
+
+        double kernelNs = double(timer.nsecsElapsed()) / numRuns - fixedNs;
+        qInfo() << stegoAlgo << edgeDetection << "encode:" << kernelNs / numSamples << "ns per sample, edge detection:"
+                << detectionNs / numSamples << "ns per sample";
+
+        std::filesystem::remove_all("image_benchmark_cache");
+    }
+
+    void decodeImageBenchmark_data()
+    {
+        modes();
+    }
+
+    /**
+     * @brief decodeImageBenchmark Per sample cost of the extraction loop, timed like encodeImageBenchmark. A stego
+     * image made with edge detection hashes like its carrier, so the timed LSB decodes read the carrier's cached mask,
+     * and PVD decodes need no edges at all.
+     */
+    void decodeImageBenchmark()
+    {
+        QFETCH(QString, stegoAlgo);
+        QFETCH(QString, edgeDetection);
+
+        cv::Mat carrier = cv::imread(smallImage.toStdString(), cv::IMREAD_COLOR);
+        QVERIFY(!carrier.empty());
+        std::vector<uint8_t> payload = payloadForHalfCapacity(carrier, stegoAlgo, edgeDetection);
+        std::vector<uint8_t> tinyPayload(1, 0);
+
+        EdgeDetectionType edgeDetectionType;
+        QVERIFY(StegoPlanner::ParseEdgeDetection(edgeDetection.toStdString(), edgeDetectionType));
+        double numSamples = double(carrier.total()) * carrier.channels();
+        double detectionNs = stegoAlgo == LSB ? detectionTime(carrier, edgeDetectionType) : 0;
+
+        std::filesystem::remove_all("image_benchmark_cache");
+        Stego stego(stegoAlgo.toStdString(), edgeDetection.toStdString(), false, "");
+        stego.SetParallel(false);
+        stego.SetEdgeCache(std::make_shared<EdgeCache>("image_benchmark_cache"));
+        cv::Mat stegoImage;
+        cv::Mat tinyStegoImage;
+        QCOMPARE(stego.EncodeImage(carrier, payload.data(), payload.size(), "payload.bin", stegoImage),
+                 StegoStatus::SUCCESS);
+        QCOMPARE(stego.EncodeImage(carrier, tinyPayload.data(), tinyPayload.size(), "payload.bin", tinyStegoImage),
+                 StegoStatus::SUCCESS);
+
+        std::vector<uint8_t> decodedPayload;
+        std::string decodedFileName;
+        double fixedNs = averageTime([&]()
+        {
+            QCOMPARE(stego.DecodeImage(tinyStegoImage, decodedPayload, decodedFileName), StegoStatus::SUCCESS);
+        });
+
+        QElapsedTimer timer;
+        qint64 numRuns = 0;
+        timer.start();
+        QBENCHMARK
+        {
+            QCOMPARE(stego.DecodeImage(stegoImage, decodedPayload, decodedFileName), StegoStatus::SUCCESS);
+            numRuns++;
+        }
+
+        QVERIFY(decodedPayload == payload);
+
+        double kernelNs = double(timer.nsecsElapsed()) / numRuns - fixedNs;
+        qInfo() << stegoAlgo << edgeDetection << "decode:" << kernelNs / numSamples << "ns per sample, edge detection:"
+                << detectionNs / numSamples << "ns per sample";
+
+        std::filesystem::remove_all("image_benchmark_cache");
+    }
+
+    void videoBackendBenchmark_data()
+    {
+        QTest::addColumn<QString>("videoCodec");
+
+        QTest::newRow("FFV1") << "FFV1";
+        QTest::newRow("x264rgb") << "x264rgb";
+        QTest::newRow("UTVideo") << "UTVideo";
+        QTest::newRow("Raw") << "Raw";
+    }
+
+    void videoBackendBenchmark()
+    {
+        QFETCH(QString, videoCodec);
+
+        VideoCodec codec;
+        QVERIFY(VideoBackend::ParseCodec(videoCodec.toStdString(), codec));
+        VideoBackend backend(codec);
+        if (!backend.IsEncoderAvailable())
+        {
+            QSKIP("ffmpeg was built without this encoder");
+        }
+
+        const std::string payloadPath = "video_backend_payload.bin";
+        {
+            std::ofstream payloadFile(payloadPath, std::ios_base::binary | std::ios_base::trunc);
+            std::mt19937 generator(1);
+            for (int i = 0; i < 64 * 1024; i++)
+            {
+                payloadFile.put(static_cast<char>(generator()));
+            }
+        }
+
+        // Encoding covers the whole EncodeVideo, embedding and writing the frames included, as a job sees it
+        Stego stego(payloadPath, testVideo.toStdString(), LSB.toStdString(), noEdgeDetection.toStdString(), false, "");
+        stego.SetWorkingDirectory("video_backend_benchmark");
+        stego.SetVideoBackend(backend);
+        QElapsedTimer timer;
+        qint64 encodeNanoseconds = 0;
+        QBENCHMARK_ONCE
+        {
+            timer.start();
+            QCOMPARE(stego.EncodeVideo(), StegoStatus::SUCCESS);
+            encodeNanoseconds = timer.nsecsElapsed();
+        }
+
+        // Decoding reads every frame of the stego video, payload extraction stops after the frames it needs
+        cv::VideoCapture video(stego.GetOutputPath());
+        QVERIFY(video.isOpened());
+        double videoFPS = video.get(cv::CAP_PROP_FPS);
+        cv::Mat frame;
+        double numFrames = 0;
+        timer.start();
+        while (video.read(frame))
+        {
+            numFrames++;
+        }
+
+        qint64 decodeNanoseconds = timer.nsecsElapsed();
+        video.release();
+        QVERIFY(numFrames > 0);
+
+        double fileBits = double(std::filesystem::file_size(stego.GetOutputPath())) * 8;
+        qInfo() << videoCodec << "encode:" << numFrames * 1e9 / encodeNanoseconds << "fps,"
+                << "decode:" << numFrames * 1e9 / decodeNanoseconds << "fps,"
+                << "bitrate:" << fileBits * videoFPS / (numFrames * 1e6) << "Mbit/s";
+
+        std::filesystem::remove_all("video_backend_benchmark");
+        std::filesystem::remove(payloadPath);
+    }
+
+    void archiveMemberBenchmark_data()
+    {
+        QTest::addColumn<QString>("stegoAlgo");
+        QTest::addColumn<QString>("edgeDetection");
+        QTest::addColumn<double>("fillerFraction");
+
+        QTest::newRow("LSB-NoEdgeDetection-10%") << LSB << noEdgeDetection << 0.1;
+        QTest::newRow("LSB-NoEdgeDetection-80%") << LSB << noEdgeDetection << 0.8;
+        QTest::newRow("LSB-SobelEdgeDetection-10%") << LSB << sobelEdgeDetection << 0.1;
+        QTest::newRow("LSB-SobelEdgeDetection-80%") << LSB << sobelEdgeDetection << 0.8;
+    }
+
+    /**
+     * @brief archiveMemberBenchmark Extract a small member stored after a filler taking a fraction of the capacity,
+     * against decoding the whole archive.
+     */
+    void archiveMemberBenchmark()
+    {
+        QFETCH(QString, stegoAlgo);
+        QFETCH(QString, edgeDetection);
+        QFETCH(double, fillerFraction);
+
+        cv::Mat carrier = cv::imread(smallImage.toStdString(), cv::IMREAD_COLOR);
+        QVERIFY(!carrier.empty());
+        std::vector<uint8_t> filler = payloadForHalfCapacity(carrier, stegoAlgo, edgeDetection);
+        filler.resize(size_t(filler.size() * 2 * fillerFraction));
+
+        std::filesystem::remove_all("archive_benchmark");
+        std::filesystem::create_directories("archive_benchmark/payload");
+        std::ofstream("archive_benchmark/payload/filler.bin", std::ios_base::binary)
+            .write(reinterpret_cast<const char*>(filler.data()), filler.size());
+        std::ofstream("archive_benchmark/payload/member.txt") << "the member extracted on its own\n";
+
+        Stego encodeStego("archive_benchmark/payload", smallImage.toStdString(), stegoAlgo.toStdString(),
+                          edgeDetection.toStdString(), false, "");
+        encodeStego.SetWorkingDirectory("archive_benchmark");
+        QCOMPARE(encodeStego.EncodeImage(), StegoStatus::SUCCESS);
+
+        Stego stego(encodeStego.GetOutputPath(), false, "");
+        stego.SetWorkingDirectory("archive_benchmark");
+        stego.SetParallel(false);
+
+        QElapsedTimer timer;
+        qint64 numRuns = 0;
+        timer.start();
+        QBENCHMARK
+        {
+            QCOMPARE(stego.ExtractMember("member.txt"), StegoStatus::SUCCESS);
+            numRuns++;
+        }
+
+        double memberMs = timer.nsecsElapsed() / (numRuns * 1e6);
+
+        timer.restart();
+        for (int i = 0; i < numRuns; i++)
+        {
+            QCOMPARE(stego.DecodeImage(), StegoStatus::SUCCESS);
+        }
+
+        double archiveMs = timer.nsecsElapsed() / (numRuns * 1e6);
+        qInfo() << stegoAlgo << edgeDetection << fillerFraction << "member:" << memberMs << "ms, whole archive:"
+                << archiveMs << "ms";
+
+        std::filesystem::remove_all("archive_benchmark");
+    }
+
+    void videoRangeBenchmark_data()
+    {
+        QTest::addColumn<QString>("stegoAlgo");
+        QTest::addColumn<QString>("edgeDetection");
+
+        QTest::newRow("LSB-NoEdgeDetection") << LSB << noEdgeDetection;
+        QTest::newRow("LSB-SobelEdgeDetection") << LSB << sobelEdgeDetection;
+        QTest::newRow("PVD-NoEdgeDetection") << PVD << noEdgeDetection;
+    }
+
+    /**
+     * @brief videoRangeBenchmark Extract the last 64 KiB of a payload filling most of the video, against decoding all
+     * of it.
+     */
+    void videoRangeBenchmark()
+    {
+        QFETCH(QString, stegoAlgo);
+        QFETCH(QString, edgeDetection);
+
+        cv::VideoCapture video(testVideo.toStdString());
+        cv::Mat frame;
+        QVERIFY(video.read(frame));
+        // Random bytes filling about 80% of the frames
+        std::vector<uint8_t> payload = payloadForHalfCapacity(frame, stegoAlgo, edgeDetection);
+        payload.resize(payload.size() * 2 * std::max<size_t>(1, size_t(video.get(cv::CAP_PROP_FRAME_COUNT) * 0.8)));
+        video.release();
+
+        std::mt19937 generator(2);
+        for (uint8_t& byte : payload)
+        {
+            byte = static_cast<uint8_t>(generator());
+        }
+
+        std::filesystem::create_directories("range_benchmark");
+        std::string payloadPath = "range_benchmark/payload.bin";
+        std::ofstream(payloadPath, std::ios_base::binary)
+            .write(reinterpret_cast<const char*>(payload.data()), payload.size());
+
+        Stego encodeStego(payloadPath, testVideo.toStdString(), stegoAlgo.toStdString(), edgeDetection.toStdString(),
+                          false, "");
+        encodeStego.SetWorkingDirectory("range_benchmark");
+        QCOMPARE(encodeStego.EncodeVideo(), StegoStatus::SUCCESS);
+
+        Stego stego(encodeStego.GetOutputPath(), false, "");
+        stego.SetWorkingDirectory("range_benchmark");
+        uint64_t rangeLength = 64 * 1024;
+
+        QElapsedTimer timer;
+        qint64 numRuns = 0;
+        timer.start();
+        QBENCHMARK
+        {
+            QCOMPARE(stego.ExtractRange(payload.size() - rangeLength, rangeLength), StegoStatus::SUCCESS);
+            numRuns++;
+        }
+
+        double rangeMs = timer.nsecsElapsed() / (numRuns * 1e6);
+
+        timer.restart();
+        QCOMPARE(stego.DecodeVideo(), StegoStatus::SUCCESS);
+        double payloadMs = timer.nsecsElapsed() / 1e6;
+        qInfo() << stegoAlgo << edgeDetection << "last 64 KiB:" << rangeMs << "ms, whole payload:" << payloadMs << "ms";
+
+        std::filesystem::remove_all("range_benchmark");
+    }
+
+    void shardBenchmark_data()
+    {
+        QTest::addColumn<QString>("stegoAlgo");
+        QTest::addColumn<QString>("edgeDetection");
+        QTest::addColumn<int>("numShards");
+
+        QTest::newRow("LSB-NoEdgeDetection-4") << LSB << noEdgeDetection << 4;
+        QTest::newRow("LSB-SobelEdgeDetection-4") << LSB << sobelEdgeDetection << 4;
+        QTest::newRow("PVD-SobelEdgeDetection-8") << PVD << sobelEdgeDetection << 8;
+    }
+
+    /**
+     * @brief shardBenchmark Encode and decode a payload split across copies of Lenna, against encoding a single
+     * shard's part of it on one copy.
+     */
+    void shardBenchmark()
+    {
+        QFETCH(QString, stegoAlgo);
+        QFETCH(QString, edgeDetection);
+        QFETCH(int, numShards);
+
+        cv::Mat carrier = cv::imread(smallImage.toStdString(), cv::IMREAD_COLOR);
+        QVERIFY(!carrier.empty());
+        std::vector<uint8_t> part = payloadForHalfCapacity(carrier, stegoAlgo, edgeDetection);
+        std::vector<uint8_t> payload;
+        for (int i = 0; i < numShards; i++)
+        {
+            payload.insert(payload.end(), part.begin(), part.end());
+        }
+
+        std::filesystem::remove_all("shard_benchmark");
+        std::filesystem::create_directories("shard_benchmark/carriers");
+        std::ofstream("shard_benchmark/payload.bin", std::ios_base::binary)
+            .write(reinterpret_cast<const char*>(payload.data()), payload.size());
+        std::ofstream("shard_benchmark/part.bin", std::ios_base::binary)
+            .write(reinterpret_cast<const char*>(part.data()), part.size());
+
+        std::vector<std::string> media;
+        for (int i = 0; i < numShards; i++)
+        {
+            media.push_back("shard_benchmark/carriers/carrier_" + std::to_string(i) + ".png");
+            std::filesystem::copy_file(smallImage.toStdString(), media.back());
+        }
+
+        Stego encodeStego("shard_benchmark/payload.bin", "", stegoAlgo.toStdString(), edgeDetection.toStdString(),
+                          false, "");
+        encodeStego.SetWorkingDirectory("shard_benchmark");
+
+        QElapsedTimer timer;
+        qint64 numRuns = 0;
+        timer.start();
+        QBENCHMARK
+        {
+            QCOMPARE(encodeStego.EncodeShards(media), StegoStatus::SUCCESS);
+            numRuns++;
+        }
+
+        double shardsMs = timer.nsecsElapsed() / (numRuns * 1e6);
+
+        std::vector<std::string> stegoMedia;
+        for (const std::string& mediaPath : media)
+        {
+            stegoMedia.push_back((std::filesystem::path(encodeStego.GetOutputPath()) /
+                                  std::filesystem::path(mediaPath).filename()).string());
+        }
+
+        Stego decodeStego("", false, "");
+        decodeStego.SetWorkingDirectory("shard_benchmark");
+        timer.restart();
+        QCOMPARE(decodeStego.DecodeShards(stegoMedia), StegoStatus::SUCCESS);
+        double decodeMs = timer.nsecsElapsed() / 1e6;
+
+        Stego singleStego("shard_benchmark/part.bin", smallImage.toStdString(), stegoAlgo.toStdString(),
+                          edgeDetection.toStdString(), false, "");
+        singleStego.SetWorkingDirectory("shard_benchmark/single");
+        singleStego.SetParallel(false);
+        timer.restart();
+        QCOMPARE(singleStego.EncodeImage(), StegoStatus::SUCCESS);
+        double singleMs = timer.nsecsElapsed() / 1e6;
+        qInfo() << stegoAlgo << edgeDetection << numShards << "shards encode:" << shardsMs << "ms, decode:" << decodeMs
+                << "ms, one shard alone:" << singleMs << "ms";
+
+        std::filesystem::remove_all("shard_benchmark");
+    }
+
+    void edgeCacheBenchmark_data()
+    {
+        QTest::addColumn<QString>("edgeDetection");
+        QTest::addColumn<bool>("bCached");
+
+        QTest::newRow("Sobel-Uncached") << sobelEdgeDetection << false;
+        QTest::newRow("Sobel-Cached") << sobelEdgeDetection << true;
+        QTest::newRow("Canny-Uncached") << cannyEdgeDetection << false;
+        QTest::newRow("Canny-Cached") << cannyEdgeDetection << true;
+    }
+
+    /**
+     * @brief edgeCacheBenchmark Decode a video again and again, with its edge masks detected every time or read
+     * back from a warm cache.
+     */
+    void edgeCacheBenchmark()
+    {
+        QFETCH(QString, edgeDetection);
+        QFETCH(bool, bCached);
+
+        std::filesystem::remove_all("edge_cache_benchmark");
+        std::vector<uint8_t> payload(64 * 1024);
+        std::mt19937 generator(1);
+        for (uint8_t& byte : payload)
+        {
+            byte = static_cast<uint8_t>(generator());
+        }
+
+        std::filesystem::create_directories("edge_cache_benchmark");
+        std::ofstream("edge_cache_benchmark/payload.bin", std::ios_base::binary)
+            .write(reinterpret_cast<const char*>(payload.data()), payload.size());
+
+        auto edgeCache = bCached ? std::make_shared<EdgeCache>("edge_cache_benchmark/cache") : nullptr;
+        Stego encodeStego("edge_cache_benchmark/payload.bin", testVideo.toStdString(), LSB.toStdString(),
+                          edgeDetection.toStdString(), false, "");
+        encodeStego.SetWorkingDirectory("edge_cache_benchmark");
+        encodeStego.SetEdgeCache(edgeCache);
+        QCOMPARE(encodeStego.EncodeVideo(), StegoStatus::SUCCESS);
+
+        QElapsedTimer timer;
+        qint64 numRuns = 0;
+        timer.start();
+        QBENCHMARK
+        {
+            Stego decodeStego(encodeStego.GetOutputPath(), false, "");
+            decodeStego.SetWorkingDirectory("edge_cache_benchmark/decode");
+            decodeStego.SetEdgeCache(edgeCache);
+            QCOMPARE(decodeStego.DecodeVideo(), StegoStatus::SUCCESS);
+            numRuns++;
+        }
+
+        qInfo() << edgeDetection << (bCached ? "cached" : "uncached") << "decode:"
+                << timer.nsecsElapsed() / (numRuns * 1e6) << "ms";
+        if (edgeCache)
+        {
+            qInfo() << "hits:" << edgeCache->Stats().numHits << "misses:" << edgeCache->Stats().numMisses;
+        }
+
+        std::filesystem::remove_all("edge_cache_benchmark");
+    }
+
+    void edgeModeBenchmark_data()
+    {
+        QTest::addColumn<QString>("edgeDetection");
+
+        QTest::newRow("SobelEdgeDetection") << sobelEdgeDetection;
+        QTest::newRow("CannyEdgeDetection") << cannyEdgeDetection;
+        QTest::newRow("TextureEdgeDetection") << textureEdgeDetection;
+    }
+
+    /**
+     * @brief edgeModeBenchmark Edge detection time and LSB capacity of every edge mode on the image and the first
+     * frame of the video, and how visible the same 4 KiB payload is in the image, as the PSNR of the stego image and
+     * the share of its samples that changed.
+     */
+    void edgeModeBenchmark()
+    {
+        QFETCH(QString, edgeDetection);
+
+        EdgeDetectionType edgeDetectionType;
+        QVERIFY(StegoPlanner::ParseEdgeDetection(edgeDetection.toStdString(), edgeDetectionType));
+
+        cv::Mat carrier = cv::imread(smallImage.toStdString(), cv::IMREAD_COLOR);
+        cv::Mat frame;
+        cv::VideoCapture video(testVideo.toStdString());
+        QVERIFY(!carrier.empty() && video.read(frame));
+
+        EdgeDetection edgeDetector;
+        QElapsedTimer timer;
+        qint64 numRuns = 0;
+        timer.start();
+        QBENCHMARK
+        {
+            QCOMPARE(edgeDetector.DetectEdges(carrier, edgeDetectionType), StegoStatus::SUCCESS);
+            numRuns++;
+        }
+
+        double numPixels = double(carrier.total());
+        StegoCapacity capacity(StegoAlgo::LSB, edgeDetectionType);
+        qInfo() << edgeDetection << "detection:" << double(timer.nsecsElapsed()) / (numRuns * numPixels)
+                << "ns per pixel, capacity:" << capacity.FrameCapacity(carrier, NUM_HEADER_PIXELS) << "bytes image,"
+                << capacity.FrameCapacity(frame, NUM_HEADER_PIXELS) << "bytes video frame";
+
+        std::vector<uint8_t> payload(4 * 1024);
+        std::mt19937 generator(1);
+        for (uint8_t& byte : payload)
+        {
+            byte = static_cast<uint8_t>(generator());
+        }
+
+        Stego stego(LSB.toStdString(), edgeDetection.toStdString(), false, "");
+        cv::Mat stegoImage;
+        QCOMPARE(stego.EncodeImage(carrier, payload.data(), payload.size(), "payload.bin", stegoImage),
+                 StegoStatus::SUCCESS);
+
+        cv::Mat changedSamples;
+        cv::absdiff(carrier, stegoImage, changedSamples);
+        qInfo() << edgeDetection << "PSNR:" << cv::PSNR(carrier, stegoImage) << "dB, changed samples:"
+                << cv::countNonZero(changedSamples.reshape(1)) / (numPixels * carrier.channels());
+    }
+
+    void lsbBitsBenchmark_data()
+    {
+        QTest::addColumn<QString>("edgeDetection");
+        QTest::addColumn<int>("lsbBits");
+
+        QTest::newRow("NoEdgeDetection-1") << noEdgeDetection << 1;
+        QTest::newRow("NoEdgeDetection-2") << noEdgeDetection << 2;
+        QTest::newRow("NoEdgeDetection-3") << noEdgeDetection << 3;
+        QTest::newRow("NoEdgeDetection-4") << noEdgeDetection << 4;
+        QTest::newRow("SobelEdgeDetection-1") << sobelEdgeDetection << 1;
+        QTest::newRow("SobelEdgeDetection-2") << sobelEdgeDetection << 2;
+    }
+
+    /**
+     * @brief lsbBitsBenchmark Encode time of the same 16 KiB payload with 1 to 4 LSB bits per sample, how visible it
+     * is as the PSNR and the share of changed samples, and how many frames of the video it takes.
+     */
+    void lsbBitsBenchmark()
+    {
+        QFETCH(QString, edgeDetection);
+        QFETCH(int, lsbBits);
+
+        EdgeDetectionType edgeDetectionType;
+        QVERIFY(StegoPlanner::ParseEdgeDetection(edgeDetection.toStdString(), edgeDetectionType));
+
+        cv::Mat carrier = cv::imread(smallImage.toStdString(), cv::IMREAD_COLOR);
+        cv::Mat frame;
+        cv::VideoCapture video(testVideo.toStdString());
+        QVERIFY(!carrier.empty() && video.read(frame));
+
+        std::vector<uint8_t> payload(16 * 1024);
+        std::mt19937 generator(1);
+        for (uint8_t& byte : payload)
+        {
+            byte = static_cast<uint8_t>(generator());
+        }
+
+        Stego stego(LSB.toStdString(), edgeDetection.toStdString(), false, "");
+        stego.SetParallel(false);
+        stego.SetLsbBits(lsbBits);
+        cv::Mat stegoImage;
+
+        QElapsedTimer timer;
+        qint64 numRuns = 0;
+        timer.start();
+        QBENCHMARK
+        {
+            QCOMPARE(stego.EncodeImage(carrier, payload.data(), payload.size(), "payload.bin", stegoImage),
+                     StegoStatus::SUCCESS);
+            numRuns++;
+        }
+
+        double numSamples = double(carrier.total()) * carrier.channels();
+        cv::Mat changedSamples;
+        cv::absdiff(carrier, stegoImage, changedSamples);
+        StegoCapacity capacity(StegoAlgo::LSB, edgeDetectionType, lsbBits);
+        uint64_t frameCapacity = capacity.FrameCapacity(frame, 0);
+        qInfo() << edgeDetection << lsbBits << "bits encode:" << double(timer.nsecsElapsed()) / (numRuns * payload.size())
+                << "ns per payload byte, PSNR:" << cv::PSNR(carrier, stegoImage) << "dB, changed samples:"
+                << cv::countNonZero(changedSamples.reshape(1)) / numSamples << ", video frames:"
+                << (frameCapacity == 0 ? 0 : (payload.size() + frameCapacity - 1) / frameCapacity);
+    }
+
+    void updateBenchmark_data()
+    {
+        QTest::addColumn<QString>("edgeDetection");
+        QTest::addColumn<int>("numChangedBytes");
+
+        QTest::newRow("NoEdgeDetection-16") << noEdgeDetection << 16;
+        QTest::newRow("NoEdgeDetection-4096") << noEdgeDetection << 4096;
+        QTest::newRow("SobelEdgeDetection-16") << sobelEdgeDetection << 16;
+        QTest::newRow("SobelEdgeDetection-4096") << sobelEdgeDetection << 4096;
+    }
+
+    /**
+     * @brief updateBenchmark Time of an update that changes numChangedBytes bytes at the end of a 16 KiB payload,
+     * against embedding the new payload in the original carrier, and the samples each changes in the stego image.
+     */
+    void updateBenchmark()
+    {
+        QFETCH(QString, edgeDetection);
+        QFETCH(int, numChangedBytes);
+
+        cv::Mat carrier = cv::imread(smallImage.toStdString(), cv::IMREAD_COLOR);
+        QVERIFY(!carrier.empty());
+
+        std::vector<uint8_t> payload(16 * 1024);
+        std::mt19937 generator(1);
+        for (uint8_t& byte : payload)
+        {
+            byte = static_cast<uint8_t>(generator());
+        }
+
+        Stego stego(LSB.toStdString(), edgeDetection.toStdString(), false, "");
+        stego.SetParallel(false);
+        cv::Mat stegoImage;
+        QCOMPARE(stego.EncodeImage(carrier, payload.data(), payload.size(), "payload.bin", stegoImage),
+                 StegoStatus::SUCCESS);
+
+        std::vector<uint8_t> newPayload = payload;
+        for (size_t i = newPayload.size() - numChangedBytes; i < newPayload.size(); i++)
+        {
+            newPayload[i] = static_cast<uint8_t>(generator());
+        }
+
+        cv::Mat updatedImage;
+        QElapsedTimer timer;
+        qint64 numRuns = 0;
+        timer.start();
+        QBENCHMARK
+        {
+            updatedImage = stegoImage.clone();
+            QCOMPARE(stego.UpdateImage(updatedImage, newPayload.data(), newPayload.size(), "payload.bin"),
+                     StegoStatus::SUCCESS);
+            numRuns++;
+        }
+
+        double updateSeconds = double(timer.nsecsElapsed()) / (numRuns * 1e9);
+
+        cv::Mat encodedImage;
+        timer.restart();
+        QCOMPARE(stego.EncodeImage(carrier, newPayload.data(), newPayload.size(), "payload.bin", encodedImage),
+                 StegoStatus::SUCCESS);
+        double encodeSeconds = double(timer.nsecsElapsed()) / 1e9;
+
+        cv::Mat updatedSamples;
+        cv::Mat encodedSamples;
+        cv::absdiff(stegoImage, updatedImage, updatedSamples);
+        cv::absdiff(stegoImage, encodedImage, encodedSamples);
+        qInfo() << edgeDetection << numChangedBytes << "changed bytes, update:" << updateSeconds << "s, encode:"
+                << encodeSeconds << "s, samples changed by the update:" << cv::countNonZero(updatedSamples.reshape(1))
+                << ", by the encode:" << cv::countNonZero(encodedSamples.reshape(1));
+    }
+
+    void plannerBenchmark_data()
+    {
+        QTest::addColumn<QString>("stegoAlgo");
+        QTest::addColumn<QString>("edgeDetection");
+
+        QTest::newRow("Auto-Auto") << "Auto" << "Auto";
+        QTest::newRow("PVD-Auto") << PVD << "Auto";
+        QTest::newRow("PVD-CannyEdgeDetection") << PVD << cannyEdgeDetection;
+        QTest::newRow("LSB-SobelEdgeDetection") << LSB << sobelEdgeDetection;
+    }
+
+    /**
+     * @brief plannerBenchmark Encode a payload filling a quarter of the LSB capacity of the video in a fixed mode, or
+     * in the mode the planner picks, planning included.
+     */
+    void plannerBenchmark()
+    {
+        QFETCH(QString, stegoAlgo);
+        QFETCH(QString, edgeDetection);
+
+        std::filesystem::remove_all("planner_benchmark");
+        std::filesystem::create_directories("planner_benchmark");
+        Stego capacityStego("", testVideo.toStdString(), LSB.toStdString(), noEdgeDetection.toStdString(), false, "");
+        QCOMPARE(capacityStego.CalculateCapacity(), StegoStatus::SUCCESS);
+
+        std::vector<uint8_t> payload(capacityStego.GetEmbedSize() / 4);
+        std::mt19937 generator(1);
+        for (uint8_t& byte : payload)
+        {
+            byte = static_cast<uint8_t>(generator());
+        }
+
+        std::ofstream("planner_benchmark/payload.bin", std::ios_base::binary)
+            .write(reinterpret_cast<const char*>(payload.data()), payload.size());
+
+        StegoJob job;
+        job.filePath = "planner_benchmark/payload.bin";
+        job.mediaPath = testVideo.toStdString();
+        job.algo = stegoAlgo.toStdString();
+        job.edgeDetection = edgeDetection.toStdString();
+        job.costModelPath = "planner_benchmark/cost_model.txt";
+
+        // Calibrated up front, so only the planning is timed
+        StegoCostModel costModel;
+        costModel.Calibrate();
+        QVERIFY(costModel.Save(job.costModelPath));
+
+        StegoJobResult result;
+        QBENCHMARK
+        {
+            result = JobScheduler::RunJob(job, "planner_benchmark");
+            QCOMPARE(result.status, StegoStatus::SUCCESS);
+        }
+
+        qInfo() << stegoAlgo << edgeDetection << "ran as" << QString::fromStdString(result.algo)
+                << QString::fromStdString(result.edgeDetection) << "in" << result.seconds << "s";
+
+        std::filesystem::remove_all("planner_benchmark");
+    }
+
+    void frameSourceBenchmark_data()
+    {
+        QTest::addColumn<QString>("frameSource");
+
+        QTest::newRow("VideoCapture") << "VideoCapture";
+        QTest::newRow("RawPipe") << "RawPipe";
+    }
+
+    void frameSourceBenchmark()
+    {
+        QFETCH(QString, frameSource);
+
+        FrameSourceType type;
+        QVERIFY(FrameSource::ParseType(frameSource.toStdString(), type));
+        BufferPool bufferPool;
+
+        QElapsedTimer timer;
+        double numFrames = 0;
+        double numBytes = 0;
+        timer.start();
+        QBENCHMARK
+        {
+            FrameSource video(type, &bufferPool);
+            QVERIFY(video.Open(testVideo.toStdString()));
+            cv::Mat frame;
+            while (video.Read(frame))
+            {
+                numFrames++;
+                numBytes += double(frame.total()) * frame.elemSize();
+            }
+        }
+
+        double seconds = timer.nsecsElapsed() / 1e9;
+        qInfo() << frameSource << "read:" << numFrames / seconds << "fps," << numBytes / (seconds * 1e6) << "MB/s";
+    }
+};
+
+QTEST_MAIN(Benchmarks)
+#include "Benchmarks.moc"
@@ -1,5 +1,23 @@
 #include <QTest>
+#include <QTimer>
+#include "../edgecache.h"
+#include "../edgedetection.h"
+#include "../framesource.h"
+#include "../jobscheduler.h"
 #include "../stego.h"
+#include "../stegocapacity.h"
+#include "../stegoheader.h"
+#include "../stegojournal.h"
+#include "../stegoplanner.h"
+#include "../stegoscanner.h"
+#include "../threadpool.h"
+#include "../videobackend.h"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <thread>
 
 class UnitTests: public QObject
 {
@@ -38,6 +56,7 @@ private:
     QString noEdgeDetection = "None";
     QString sobelEdgeDetection = "Sobel";
     QString cannyEdgeDetection = "Canny";
+    QString textureEdgeDetection = "Texture";
 
     QString emptyPassword = "";
 
@@ -434,6 +453,22 @@ private slots:
         // 96
         QTest::newRow("zip626KB-testVideoWithAudio-PVD-CannyEdgeDetection-NoEncryption") <<
             testEmbedZip_626KB << testVideoWithAudio << PVD << cannyEdgeDetection << false << emptyPassword;
+
+        // 97
+        QTest::newRow("image16KB-smallImage-LSB-TextureEdgeDetection-NoEncryption") <<
+            testEmbedImage16KB << smallImage << LSB << textureEdgeDetection << false << emptyPassword;
+
+        // 98
+        QTest::newRow("pdf19KB-smallImage-PVD-TextureEdgeDetection-NoEncryption") <<
+            testEmbedPdf19KB << smallImage << PVD << textureEdgeDetection << false << emptyPassword;
+
+        // 99
+        QTest::newRow("image207KB-testVideo-LSB-TextureEdgeDetection-NoEncryption") <<
+            testEmbedImage207KB << testVideo << LSB << textureEdgeDetection << false << emptyPassword;
+
+        // 100
+        QTest::newRow("pdf26KB-testVideo-PVD-TextureEdgeDetection-NoEncryption") <<
+            testEmbedPdf26KB << testVideo << PVD << textureEdgeDetection << false << emptyPassword;
     }
 
     void embedAndExtractFileInMediaTest()
@@ -592,6 +627,1818 @@ private slots:
 
         QCOMPARE(status, StegoStatus::FILE_TOO_LARGE);
     }
+
+    void inMemoryEncodeDecodeTest_data()
+    {
+        QTest::addColumn<QString>("file");
+        QTest::addColumn<QString>("media");
+        QTest::addColumn<QString>("stegoAlgo");
+        QTest::addColumn<QString>("edgeDetection");
+        QTest::addColumn<bool>("encryption");
+        QTest::addColumn<QString>("password");
+
+        QTest::newRow("pdf19KB-smallImage-LSB-NoEdgeDetection-NoEncryption") <<
+            testEmbedPdf19KB << smallImage << LSB << noEdgeDetection << false << emptyPassword;
+
+        QTest::newRow("pdf19KB-smallImage-LSB-CannyEdgeDetection-Encryption") <<
+            testEmbedPdf19KB << smallImage << LSB << cannyEdgeDetection << true << QString("password");
+
+        QTest::newRow("mp3_27KB-smallImage-PVD-NoEdgeDetection-Encryption") <<
+            testEmbedMp3_27KB << smallImage << PVD << noEdgeDetection << true << QString("password");
+
+        QTest::newRow("image16KB-smallImage-PVD-SobelEdgeDetection-NoEncryption") <<
+            testEmbedImage16KB << smallImage << PVD << sobelEdgeDetection << false << emptyPassword;
+    }
+
+    void inMemoryEncodeDecodeTest()
+    {
+        QFETCH(QString, file);
+        QFETCH(QString, media);
+        QFETCH(QString, stegoAlgo);
+        QFETCH(QString, edgeDetection);
+        QFETCH(bool, encryption);
+        QFETCH(QString, password);
+
+        std::ifstream payloadFile(file.toStdString(), std::ios_base::binary);
+        std::vector<uint8_t> payload((std::istreambuf_iterator<char>(payloadFile)), std::istreambuf_iterator<char>());
+        std::ifstream mediaFile(media.toStdString(), std::ios_base::binary);
+        std::vector<uchar> carrier((std::istreambuf_iterator<char>(mediaFile)), std::istreambuf_iterator<char>());
+
+        Stego encodeStego(stegoAlgo.toStdString(), edgeDetection.toStdString(), encryption, password.toStdString());
+        std::vector<uchar> stegoImage;
+        StegoStatus status = encodeStego.EncodeImage(carrier, payload.data(), payload.size(), "payload.bin", stegoImage);
+        QCOMPARE(status, StegoStatus::SUCCESS);
+
+        Stego decodeStego(stegoAlgo.toStdString(), edgeDetection.toStdString(), encryption, password.toStdString());
+        std::vector<uint8_t> decodedPayload;
+        std::string decodedFileName;
+        status = decodeStego.DecodeImage(stegoImage, decodedPayload, decodedFileName);
+        QCOMPARE(status, StegoStatus::SUCCESS);
+        QVERIFY(decodedFileName == "payload.bin");
+        QVERIFY(decodedPayload == payload);
+
+        // A directory is embedded as an archive, which is only decoded to disk
+        std::filesystem::remove_all("in_memory_test");
+        std::filesystem::create_directories("in_memory_test/payload");
+        std::filesystem::copy_file(file.toStdString(), "in_memory_test/payload/payload.bin");
+
+        Stego archiveStego("in_memory_test/payload", media.toStdString(), stegoAlgo.toStdString(),
+                           edgeDetection.toStdString(), encryption, password.toStdString());
+        archiveStego.SetWorkingDirectory("in_memory_test");
+        QCOMPARE(encryption ? archiveStego.EncryptFile() : StegoStatus::SUCCESS, StegoStatus::SUCCESS);
+        QCOMPARE(archiveStego.EncodeImage(), StegoStatus::SUCCESS);
+
+        std::ifstream archiveFile(archiveStego.GetOutputPath(), std::ios_base::binary);
+        std::vector<uchar> archiveImage((std::istreambuf_iterator<char>(archiveFile)), std::istreambuf_iterator<char>());
+        status = decodeStego.DecodeImage(archiveImage, decodedPayload, decodedFileName);
+        QCOMPARE(status, StegoStatus::PAYLOAD_IS_ARCHIVE);
+
+        std::filesystem::remove_all("in_memory_test");
+    }
+
+    void parallelEmbeddingMatchesSequentialTest_data()
+    {
+        QTest::addColumn<QString>("file");
+        QTest::addColumn<QString>("media");
+        QTest::addColumn<QString>("stegoAlgo");
+        QTest::addColumn<QString>("edgeDetection");
+
+        QTest::newRow("pdf26KB-smallImage-LSB-NoEdgeDetection") << testEmbedPdf26KB << smallImage << LSB << noEdgeDetection;
+        QTest::newRow("pdf26KB-smallImage-LSB-SobelEdgeDetection") << testEmbedPdf26KB << smallImage << LSB << sobelEdgeDetection;
+        QTest::newRow("pdf26KB-smallImage-PVD-NoEdgeDetection") << testEmbedPdf26KB << smallImage << PVD << noEdgeDetection;
+        QTest::newRow("image16KB-smallImage-PVD-CannyEdgeDetection") << testEmbedImage16KB << smallImage << PVD << cannyEdgeDetection;
+        QTest::newRow("image773KB-largeImage-LSB-NoEdgeDetection") << testEmbedImage773KB << largeImage << LSB << noEdgeDetection;
+    }
+
+    void parallelEmbeddingMatchesSequentialTest()
+    {
+        QFETCH(QString, file);
+        QFETCH(QString, media);
+        QFETCH(QString, stegoAlgo);
+        QFETCH(QString, edgeDetection);
+
+        std::ifstream payloadFile(file.toStdString(), std::ios_base::binary);
+        std::vector<uint8_t> payload((std::istreambuf_iterator<char>(payloadFile)), std::istreambuf_iterator<char>());
+        cv::Mat carrier = cv::imread(media.toStdString(), cv::IMREAD_COLOR);
+
+        cv::Mat stegoImages[2];
+        for (int parallel = 0; parallel < 2; parallel++)
+        {
+            Stego encodeStego(stegoAlgo.toStdString(), edgeDetection.toStdString(), false, "");
+            encodeStego.SetParallel(parallel == 1);
+            StegoStatus status = encodeStego.EncodeImage(carrier, payload.data(), payload.size(), "payload.bin", stegoImages[parallel]);
+            QCOMPARE(status, StegoStatus::SUCCESS);
+        }
+
+        QCOMPARE(cv::norm(stegoImages[0], stegoImages[1], cv::NORM_INF), 0.0);
+
+        for (int parallel = 0; parallel < 2; parallel++)
+        {
+            Stego decodeStego(stegoAlgo.toStdString(), edgeDetection.toStdString(), false, "");
+            decodeStego.SetParallel(parallel == 1);
+            std::vector<uint8_t> decodedPayload;
+            std::string decodedFileName;
+            StegoStatus status = decodeStego.DecodeImage(stegoImages[0], decodedPayload, decodedFileName);
+            QCOMPARE(status, StegoStatus::SUCCESS);
+            QVERIFY(decodedFileName == "payload.bin");
+            QVERIFY(decodedPayload == payload);
+        }
+    }
+
+    void capacityProbeTest_data()
+    {
+        QTest::addColumn<QString>("media");
+        QTest::addColumn<QString>("stegoAlgo");
+        QTest::addColumn<QString>("edgeDetection");
+
+        QTest::newRow("smallImage-LSB-NoEdgeDetection") << smallImage << LSB << noEdgeDetection;
+        QTest::newRow("smallImage-LSB-SobelEdgeDetection") << smallImage << LSB << sobelEdgeDetection;
+        QTest::newRow("smallImage-PVD-NoEdgeDetection") << smallImage << PVD << noEdgeDetection;
+        QTest::newRow("smallImage-PVD-CannyEdgeDetection") << smallImage << PVD << cannyEdgeDetection;
+        QTest::newRow("smallImage-LSB-TextureEdgeDetection") << smallImage << LSB << textureEdgeDetection;
+    }
+
+    void capacityProbeTest()
+    {
+        QFETCH(QString, media);
+        QFETCH(QString, stegoAlgo);
+        QFETCH(QString, edgeDetection);
+
+        StegoAlgo algo = stegoAlgo == LSB ? StegoAlgo::LSB : StegoAlgo::PVD;
+        EdgeDetectionType edgeDetectionType = EdgeDetectionType::None;
+        if (edgeDetection == sobelEdgeDetection)
+        {
+            edgeDetectionType = EdgeDetectionType::Sobel;
+        }
+        else if (edgeDetection == cannyEdgeDetection)
+        {
+            edgeDetectionType = EdgeDetectionType::Canny;
+        }
+        else if (edgeDetection == textureEdgeDetection)
+        {
+            edgeDetectionType = EdgeDetectionType::Texture;
+        }
+
+        StegoCapacity capacity(algo, edgeDetectionType);
+        uint64_t imageCapacity = 0;
+        QCOMPARE(capacity.ImageCapacity(media.toStdString(), imageCapacity), StegoStatus::SUCCESS);
+
+        cv::Mat image = cv::imread(media.toStdString(), cv::IMREAD_COLOR);
+        QCOMPARE(imageCapacity, capacity.FrameCapacity(image, NUM_HEADER_PIXELS));
+        QVERIFY(imageCapacity > 0);
+
+        if (algo == StegoAlgo::LSB && edgeDetectionType == EdgeDetectionType::None)
+        {
+            QCOMPARE(imageCapacity, uint64_t((image.total() - NUM_HEADER_PIXELS) * 3 / 8));
+        }
+
+        Stego stego("", media.toStdString(), stegoAlgo.toStdString(), edgeDetection.toStdString(), false, "");
+        QCOMPARE(stego.CalculateCapacity(), StegoStatus::SUCCESS);
+        QCOMPARE(stego.GetEmbedSize(), imageCapacity);
+    }
+
+    void videoCapacityTableTest()
+    {
+        StegoCapacity capacity(StegoAlgo::PVD, EdgeDetectionType::None);
+        CapacityTable fullTable;
+        QCOMPARE(capacity.VideoCapacity(testVideo.toStdString(), fullTable), StegoStatus::SUCCESS);
+        QVERIFY(fullTable.numFrames > 0);
+        QCOMPARE(fullTable.frameCapacities.size(), fullTable.numFrames);
+        QVERIFY(!fullTable.bSampled);
+
+        CapacityTable sampledTable;
+        QCOMPARE(capacity.VideoCapacity(testVideo.toStdString(), sampledTable, 10), StegoStatus::SUCCESS);
+        QCOMPARE(sampledTable.numFrames, fullTable.numFrames);
+        QCOMPARE(sampledTable.frameCapacities.size(), (fullTable.numFrames + 9) / 10);
+        QCOMPARE(sampledTable.frameCapacities[0], fullTable.frameCapacities[0]);
+        QVERIFY(sampledTable.bSampled);
+    }
+
+    void headerRoundTripTest_data()
+    {
+        QTest::addColumn<quint64>("fileLength");
+        QTest::addColumn<int>("version");
+
+        QTest::newRow("empty-Version1") << quint64(0) << int(StegoHeader::VERSION_1);
+        QTest::newRow("largest-Version1") << quint64((1ull << 36) - 1) << int(StegoHeader::VERSION_1);
+        QTest::newRow("4GiB-Version2") << quint64(0x100000000ull) << int(StegoHeader::VERSION_2);
+        QTest::newRow("largest-Version2") << quint64(~0ull) << int(StegoHeader::VERSION_2);
+        QTest::newRow("empty-Version3") << quint64(0) << int(StegoHeader::VERSION_3);
+        QTest::newRow("largest-Version3") << quint64(~0ull) << int(StegoHeader::VERSION_3);
+        QTest::newRow("empty-Version4") << quint64(0) << int(StegoHeader::VERSION_4);
+        QTest::newRow("largest-Version4") << quint64(~0ull) << int(StegoHeader::VERSION_4);
+    }
+
+    void headerRoundTripTest()
+    {
+        QFETCH(quint64, fileLength);
+        QFETCH(int, version);
+
+        cv::Mat image(4, 8, CV_8UC3, cv::Scalar(0x55, 0xAA, 0x55));
+        cv::Mat original = image.clone();
+
+        StegoHeader header;
+        header.version = version;
+        header.algo = StegoAlgo::PVD;
+        header.edgeDetectionType = EdgeDetectionType::Sobel;
+        header.bEncrypted = true;
+        header.bShard = true;
+        header.fileNameLength = 255;
+        header.fileLength = fileLength;
+        QCOMPARE(header.Write(image), StegoStatus::SUCCESS);
+
+        StegoHeader decodedHeader;
+        QCOMPARE(decodedHeader.Read(image), StegoStatus::SUCCESS);
+        QCOMPARE(int(decodedHeader.version), version);
+        QVERIFY(decodedHeader.algo == StegoAlgo::PVD);
+        QVERIFY(decodedHeader.edgeDetectionType == EdgeDetectionType::Sobel);
+        QVERIFY(decodedHeader.bEncrypted);
+        QCOMPARE(decodedHeader.bShard, version == StegoHeader::VERSION_4);
+        QCOMPARE(decodedHeader.fileNameLength, uint32_t(255));
+        QCOMPARE(quint64(decodedHeader.fileLength), fileLength);
+
+        // Only the two least significant bits of the header pixels may change
+        cv::Mat changedBits;
+        cv::bitwise_xor(image, original, changedBits);
+        size_t numHeaderSamples = header.NumPixels() * 3;
+        for (size_t sample = 0; sample < image.total() * 3; sample++)
+        {
+            uchar allowedBits = sample < numHeaderSamples ? 0b11 : 0;
+            QCOMPARE(uchar(changedBits.data[sample] & ~allowedBits), uchar(0));
+        }
+    }
+
+    void headerRejectsCleanMediaTest()
+    {
+        cv::Mat image(8, 8, CV_8UC3, cv::Scalar(0x55, 0xAA, 0x55));
+        StegoHeader header;
+        header.fileNameLength = 11;
+        header.fileLength = 1000;
+        QCOMPARE(header.Write(image), StegoStatus::SUCCESS);
+
+        // Any changed header bit fails the checksum
+        cv::Mat damagedImage = image.clone();
+        damagedImage.data[NUM_HEADER_PIXELS * 3 - 1] ^= 1;
+        StegoHeader decodedHeader;
+        QCOMPARE(decodedHeader.Read(damagedImage), StegoStatus::INVALID_HEADER);
+
+        // Read as a version 1 header, the file name length of saturated pixels is longer than any file name
+        cv::Mat whiteImage(64, 64, CV_8UC3, cv::Scalar(0xFF, 0xFF, 0xFF));
+        QCOMPARE(decodedHeader.Read(whiteImage), StegoStatus::INVALID_HEADER);
+
+        // A header describing more data than the image can hold is rejected before extraction
+        header.version = StegoHeader::VERSION_1;
+        header.fileLength = 64 * 64;
+        QCOMPARE(header.Write(whiteImage), StegoStatus::SUCCESS);
+        Stego stego(LSB.toStdString(), noEdgeDetection.toStdString(), false, "");
+        std::vector<uint8_t> decodedPayload;
+        std::string decodedFileName;
+        QCOMPARE(stego.DecodeImage(whiteImage, decodedPayload, decodedFileName), StegoStatus::INVALID_HEADER);
+    }
+
+    void scannerTest()
+    {
+        Stego encodeStego(testEmbedPdf19KB.toStdString(), smallImage.toStdString(), PVD.toStdString(),
+                          sobelEdgeDetection.toStdString(), false, "");
+        encodeStego.SetWorkingDirectory("scan_test/output");
+        QCOMPARE(encodeStego.EncodeImage(), StegoStatus::SUCCESS);
+
+        std::filesystem::create_directories("scan_test/media");
+        std::filesystem::copy_file(encodeStego.GetOutputPath(), "scan_test/media/stego.png",
+                                   std::filesystem::copy_options::overwrite_existing);
+        cv::imwrite("scan_test/media/clean.png", cv::Mat(64, 64, CV_8UC3, cv::Scalar(0xFF, 0xFF, 0xFF)));
+
+        std::vector<ScanResult> results;
+        QCOMPARE(StegoScanner(2).Scan("scan_test/media", results), StegoStatus::SUCCESS);
+        std::filesystem::remove_all("scan_test");
+
+        QCOMPARE(results.size(), size_t(2));
+        QCOMPARE(results[0].status, StegoStatus::INVALID_HEADER);
+        QCOMPARE(results[1].status, StegoStatus::SUCCESS);
+        QVERIFY(results[1].header.algo == StegoAlgo::PVD);
+        QVERIFY(results[1].header.edgeDetectionType == EdgeDetectionType::Sobel);
+        QVERIFY(!results[1].header.bEncrypted);
+        QCOMPARE(results[1].header.fileNameLength, uint32_t(std::string("pdf_19KB.pdf").size()));
+        QCOMPARE(results[1].header.fileLength, uint64_t(std::filesystem::file_size(testEmbedPdf19KB.toStdString())));
+    }
+
+    void stripEncodeMatchesWholeImageTest_data()
+    {
+        QTest::addColumn<QString>("file");
+        QTest::addColumn<QString>("media");
+        QTest::addColumn<QString>("stegoAlgo");
+        QTest::addColumn<QString>("edgeDetection");
+
+        QTest::newRow("pdf26KB-smallImage-LSB-NoEdgeDetection") << testEmbedPdf26KB << smallImage << LSB << noEdgeDetection;
+        QTest::newRow("pdf19KB-smallImage-LSB-SobelEdgeDetection") << testEmbedPdf19KB << smallImage << LSB << sobelEdgeDetection;
+        QTest::newRow("pdf26KB-smallImage-PVD-NoEdgeDetection") << testEmbedPdf26KB << smallImage << PVD << noEdgeDetection;
+        QTest::newRow("image16KB-smallImage-PVD-SobelEdgeDetection") << testEmbedImage16KB << smallImage << PVD << sobelEdgeDetection;
+        QTest::newRow("pdf19KB-smallImage-LSB-TextureEdgeDetection") << testEmbedPdf19KB << smallImage << LSB << textureEdgeDetection;
+        QTest::newRow("image773KB-largeImage-LSB-NoEdgeDetection") << testEmbedImage773KB << largeImage << LSB << noEdgeDetection;
+    }
+
+    void stripEncodeMatchesWholeImageTest()
+    {
+        QFETCH(QString, file);
+        QFETCH(QString, media);
+        QFETCH(QString, stegoAlgo);
+        QFETCH(QString, edgeDetection);
+
+        cv::Mat stegoImages[2];
+        size_t stripBudgets[2] = {0, 64 * 1024};
+        for (int strips = 0; strips < 2; strips++)
+        {
+            Stego encodeStego(file.toStdString(), media.toStdString(), stegoAlgo.toStdString(),
+                              edgeDetection.toStdString(), false, "");
+            encodeStego.SetWorkingDirectory("strip_test");
+            encodeStego.SetStripBudget(stripBudgets[strips]);
+            QCOMPARE(encodeStego.EncodeImage(), StegoStatus::SUCCESS);
+            stegoImages[strips] = cv::imread(encodeStego.GetOutputPath(), cv::IMREAD_COLOR);
+        }
+
+        QCOMPARE(cv::norm(stegoImages[0], stegoImages[1], cv::NORM_INF), 0.0);
+
+        Stego decodeStego(stegoAlgo.toStdString(), edgeDetection.toStdString(), false, "");
+        std::vector<uint8_t> decodedPayload;
+        std::string decodedFileName;
+        QCOMPARE(decodeStego.DecodeImage(stegoImages[1], decodedPayload, decodedFileName), StegoStatus::SUCCESS);
+        std::filesystem::remove_all("strip_test");
+
+        std::ifstream payloadFile(file.toStdString(), std::ios_base::binary);
+        std::vector<uint8_t> payload((std::istreambuf_iterator<char>(payloadFile)), std::istreambuf_iterator<char>());
+        QVERIFY(decodedFileName == std::filesystem::path(file.toStdString()).filename().string());
+        QVERIFY(decodedPayload == payload);
+    }
+
+    void lazyEdgeDetectionMatchesWholeImageTest_data()
+    {
+        QTest::addColumn<QString>("media");
+        QTest::addColumn<QString>("edgeDetection");
+
+        QTest::newRow("largeImage-SobelEdgeDetection") << largeImage << sobelEdgeDetection;
+        QTest::newRow("largeImage-CannyEdgeDetection") << largeImage << cannyEdgeDetection;
+        QTest::newRow("largeImage-TextureEdgeDetection") << largeImage << textureEdgeDetection;
+    }
+
+    void lazyEdgeDetectionMatchesWholeImageTest()
+    {
+        QFETCH(QString, media);
+        QFETCH(QString, edgeDetection);
+
+        EdgeDetectionType edgeDetectionType;
+        QVERIFY(StegoPlanner::ParseEdgeDetection(edgeDetection.toStdString(), edgeDetectionType));
+        cv::Mat image = cv::imread(media.toStdString(), cv::IMREAD_COLOR);
+        EdgeDetection wholeImage;
+        QCOMPARE(wholeImage.DetectEdges(image, edgeDetectionType), StegoStatus::SUCCESS);
+
+        // Rows are detected in uneven steps, every row detected so far must already match the whole image
+        EdgeDetection lazy;
+        QCOMPARE(lazy.BeginDetection(image, edgeDetectionType), StegoStatus::SUCCESS);
+        QCOMPARE(lazy.NumDetectedRows(), 0);
+        int numRows = 0;
+        for (int step = 1; !lazy.IsComplete(); step++)
+        {
+            numRows = lazy.DetectRows(lazy.NumDetectedRows() + step * 37);
+            QCOMPARE(cv::norm(lazy.GetMagnitudes().rowRange(0, numRows), wholeImage.GetMagnitudes().rowRange(0, numRows),
+                              cv::NORM_INF), 0.0);
+        }
+
+        QCOMPARE(numRows, image.rows);
+    }
+
+    void textureEdgeDetectionTest_data()
+    {
+        QTest::addColumn<QString>("media");
+
+        QTest::newRow("smallImage") << smallImage;
+        QTest::newRow("largeImage") << largeImage;
+    }
+
+    /**
+     * Texture blocks are whole, ignore the two least significant bits and, being scored on blocks, keep their
+     * capacity in the range Sobel and Canny give on the same carrier.
+     */
+    void textureEdgeDetectionTest()
+    {
+        QFETCH(QString, media);
+
+        cv::Mat image = cv::imread(media.toStdString(), cv::IMREAD_COLOR);
+        EdgeDetection edgeDetector;
+        QCOMPARE(edgeDetector.DetectEdges(image, EdgeDetectionType::Texture), StegoStatus::SUCCESS);
+        cv::Mat blocks = edgeDetector.GetMagnitudes().clone();
+
+        const int blockSize = EdgeDetection::TEXTURE_BLOCK_SIZE;
+        for (int row = 0; row < blocks.rows; row++)
+        {
+            for (int col = 0; col < blocks.cols; col++)
+            {
+                bool bWholeBlock = row < blocks.rows - blocks.rows % blockSize &&
+                                   col < blocks.cols - blocks.cols % blockSize;
+                uchar blockValue = bWholeBlock ? blocks.at<uchar>(row - row % blockSize, col - col % blockSize) : 0;
+                QCOMPARE(blocks.at<uchar>(row, col), blockValue);
+            }
+        }
+
+        cv::Mat noise(image.size(), image.type());
+        cv::randu(noise, 0, 4);
+        cv::Mat changedImage = (image & cv::Scalar(252, 252, 252)) | noise;
+        QCOMPARE(edgeDetector.DetectEdges(changedImage, EdgeDetectionType::Texture), StegoStatus::SUCCESS);
+        QCOMPARE(cv::norm(edgeDetector.GetMagnitudes(), blocks, cv::NORM_INF), 0.0);
+
+        uint64_t capacities[3];
+        EdgeDetectionType edgeDetectionTypes[3] = {EdgeDetectionType::Sobel, EdgeDetectionType::Canny,
+                                                   EdgeDetectionType::Texture};
+        for (int i = 0; i < 3; i++)
+        {
+            capacities[i] = StegoCapacity(StegoAlgo::LSB, edgeDetectionTypes[i]).FrameCapacity(image, NUM_HEADER_PIXELS);
+        }
+
+        qInfo() << media << "LSB capacity Sobel:" << capacities[0] << "Canny:" << capacities[1]
+                << "Texture:" << capacities[2];
+        QVERIFY(capacities[2] > 0);
+        QVERIFY(capacities[2] < StegoCapacity(StegoAlgo::LSB, EdgeDetectionType::None).FrameCapacity(image, NUM_HEADER_PIXELS));
+    }
+
+    void textureHeaderTest()
+    {
+        cv::Mat image(4, 8, CV_8UC3, cv::Scalar(0x55, 0xAA, 0x55));
+        StegoHeader header;
+        header.edgeDetectionType = EdgeDetectionType::Texture;
+        header.fileNameLength = 11;
+        header.fileLength = 1000;
+        QCOMPARE(header.Write(image), StegoStatus::SUCCESS);
+
+        StegoHeader decodedHeader;
+        QCOMPARE(decodedHeader.Read(image), StegoStatus::SUCCESS);
+        QVERIFY(decodedHeader.edgeDetectionType == EdgeDetectionType::Texture);
+
+        // The code of texture detection marks an extended header in the pixel a version 1 header keeps it in
+        header.version = StegoHeader::VERSION_1;
+        QCOMPARE(header.Write(image), StegoStatus::INVALID_HEADER);
+    }
+
+    void lsbBitsTest_data()
+    {
+        QTest::addColumn<QString>("file");
+        QTest::addColumn<QString>("media");
+        QTest::addColumn<QString>("edgeDetection");
+        QTest::addColumn<int>("lsbBits");
+
+        QTest::newRow("image LSB None 2 bits") << testEmbedPdf26KB << smallImage << noEdgeDetection << 2;
+        QTest::newRow("image LSB None 3 bits") << testEmbedPdf26KB << smallImage << noEdgeDetection << 3;
+        QTest::newRow("image LSB None 4 bits") << testEmbedImage207KB << smallImage << noEdgeDetection << 4;
+        QTest::newRow("image LSB Sobel 2 bits") << testEmbedPdf26KB << smallImage << sobelEdgeDetection << 2;
+        QTest::newRow("image LSB Texture 2 bits") << testEmbedImage16KB << smallImage << textureEdgeDetection << 2;
+        QTest::newRow("largeImage LSB None 3 bits") << testEmbedImage773KB << largeImage << noEdgeDetection << 3;
+        QTest::newRow("video LSB None 4 bits") << testEmbedPdf664KB << testVideo << noEdgeDetection << 4;
+        QTest::newRow("video LSB Sobel 2 bits") << testEmbedPdf664KB << testVideo << sobelEdgeDetection << 2;
+    }
+
+    void lsbBitsTest()
+    {
+        QFETCH(QString, file);
+        QFETCH(QString, media);
+        QFETCH(QString, edgeDetection);
+        QFETCH(int, lsbBits);
+
+        bool bVideo = media == testVideo;
+        Stego encodeStego(file.toStdString(), media.toStdString(), LSB.toStdString(), edgeDetection.toStdString(),
+                          false, "");
+        encodeStego.SetWorkingDirectory("lsb_bits_test");
+        encodeStego.SetLsbBits(lsbBits);
+        QCOMPARE(bVideo ? encodeStego.EncodeVideo() : encodeStego.EncodeImage(), StegoStatus::SUCCESS);
+
+        // The bit count is read from the header
+        Stego decodeStego(encodeStego.GetOutputPath(), false, "");
+        decodeStego.SetWorkingDirectory("lsb_bits_test");
+        QCOMPARE(bVideo ? decodeStego.DecodeVideo() : decodeStego.DecodeImage(), StegoStatus::SUCCESS);
+
+        std::ifstream payloadFile(file.toStdString(), std::ios_base::binary);
+        std::string payload((std::istreambuf_iterator<char>(payloadFile)), std::istreambuf_iterator<char>());
+        std::ifstream decodedFile(decodeStego.GetOutputPath(), std::ios_base::binary);
+        std::string decoded((std::istreambuf_iterator<char>(decodedFile)), std::istreambuf_iterator<char>());
+        QVERIFY(decoded == payload);
+
+        // Ranges start in any bit of a sample
+        for (uint64_t offset : {uint64_t(1), uint64_t(payload.size() / 3), uint64_t(payload.size() - 5)})
+        {
+            Stego rangeStego(encodeStego.GetOutputPath(), false, "");
+            rangeStego.SetWorkingDirectory("lsb_bits_test");
+            QCOMPARE(rangeStego.ExtractRange(offset, 1000), StegoStatus::SUCCESS);
+
+            std::ifstream rangeFile(rangeStego.GetOutputPath(), std::ios_base::binary);
+            std::string extracted((std::istreambuf_iterator<char>(rangeFile)), std::istreambuf_iterator<char>());
+            QVERIFY(extracted == payload.substr(offset, 1000));
+        }
+
+        std::filesystem::remove_all("lsb_bits_test");
+        if (bVideo)
+        {
+            return;
+        }
+
+        // Parallel and sequential kernels embed the same bits and only change the lowest lsbBits bits of a sample
+        cv::Mat carrier = cv::imread(media.toStdString(), cv::IMREAD_COLOR);
+        std::vector<uint8_t> payloadBytes(payload.begin(), payload.end());
+        cv::Mat stegoImages[2];
+        for (int parallel = 0; parallel < 2; parallel++)
+        {
+            Stego memoryStego(LSB.toStdString(), edgeDetection.toStdString(), false, "");
+            memoryStego.SetParallel(parallel == 1);
+            memoryStego.SetLsbBits(lsbBits);
+            QCOMPARE(memoryStego.EncodeImage(carrier, payloadBytes.data(), payloadBytes.size(), "payload.bin",
+                                             stegoImages[parallel]), StegoStatus::SUCCESS);
+        }
+
+        QCOMPARE(cv::norm(stegoImages[0], stegoImages[1], cv::NORM_INF), 0.0);
+
+        cv::Mat changedBits;
+        cv::bitwise_xor(stegoImages[0], carrier, changedBits);
+        uchar allowedBits = static_cast<uchar>((1 << std::max(lsbBits, 2)) - 1);
+        for (size_t sample = 0; sample < changedBits.total() * 3; sample++)
+        {
+            QCOMPARE(uchar(changedBits.data[sample] & ~allowedBits), uchar(0));
+        }
+
+        for (int parallel = 0; parallel < 2; parallel++)
+        {
+            Stego memoryStego(LSB.toStdString(), edgeDetection.toStdString(), false, "");
+            memoryStego.SetParallel(parallel == 1);
+            std::vector<uint8_t> decodedPayload;
+            std::string decodedFileName;
+            QCOMPARE(memoryStego.DecodeImage(stegoImages[0], decodedPayload, decodedFileName), StegoStatus::SUCCESS);
+            QVERIFY(decodedPayload == payloadBytes);
+        }
+
+        // Capacity grows with the bits of a sample
+        Stego oneBitStego("", media.toStdString(), LSB.toStdString(), edgeDetection.toStdString(), false, "");
+        Stego capacityStego("", media.toStdString(), LSB.toStdString(), edgeDetection.toStdString(), false, "");
+        capacityStego.SetLsbBits(lsbBits);
+        QCOMPARE(oneBitStego.CalculateCapacity(), StegoStatus::SUCCESS);
+        QCOMPARE(capacityStego.CalculateCapacity(), StegoStatus::SUCCESS);
+        QVERIFY(capacityStego.GetEmbedSize() >= oneBitStego.GetEmbedSize() * lsbBits);
+        QVERIFY(capacityStego.GetEmbedSize() <= oneBitStego.GetEmbedSize() * lsbBits + lsbBits);
+    }
+
+    void lsbBitsHeaderTest()
+    {
+        cv::Mat image(4, 8, CV_8UC3, cv::Scalar(0x55, 0xAA, 0x55));
+        StegoHeader header;
+        header.lsbBits = 3;
+        header.fileNameLength = 11;
+        header.fileLength = 1000;
+        QCOMPARE(header.Write(image), StegoStatus::SUCCESS);
+
+        StegoHeader decodedHeader;
+        QCOMPARE(decodedHeader.Read(image), StegoStatus::SUCCESS);
+        QCOMPARE(int(decodedHeader.lsbBits), 3);
+
+        // Edge detection is taken on the upper six bits, more than two LSB bits would change the edges
+        header.edgeDetectionType = EdgeDetectionType::Sobel;
+        QCOMPARE(header.Write(image), StegoStatus::SUCCESS);
+        QCOMPARE(decodedHeader.Read(image), StegoStatus::INVALID_HEADER);
+
+        header.algo = StegoAlgo::PVD;
+        header.edgeDetectionType = EdgeDetectionType::None;
+        header.lsbBits = 2;
+        QCOMPARE(header.Write(image), StegoStatus::SUCCESS);
+        QCOMPARE(decodedHeader.Read(image), StegoStatus::INVALID_HEADER);
+
+        // Older headers have no field for it
+        header.algo = StegoAlgo::LSB;
+        header.version = StegoHeader::VERSION_3;
+        QCOMPARE(header.Write(image), StegoStatus::INVALID_HEADER);
+        header.lsbBits = 1;
+        QCOMPARE(header.Write(image), StegoStatus::SUCCESS);
+        QCOMPARE(decodedHeader.Read(image), StegoStatus::SUCCESS);
+        QCOMPARE(int(decodedHeader.lsbBits), 1);
+    }
+
+    void updateImageTest_data()
+    {
+        QTest::addColumn<QString>("edgeDetection");
+        QTest::addColumn<int>("lsbBits");
+        QTest::addColumn<QString>("change");
+
+        for (const QString& change : {QString("bytes"), QString("shorter"), QString("longer"), QString("name")})
+        {
+            QTest::newRow(qPrintable("None 1 bit " + change)) << noEdgeDetection << 1 << change;
+            QTest::newRow(qPrintable("None 3 bits " + change)) << noEdgeDetection << 3 << change;
+            QTest::newRow(qPrintable("Sobel 2 bits " + change)) << sobelEdgeDetection << 2 << change;
+            QTest::newRow(qPrintable("Texture 1 bit " + change)) << textureEdgeDetection << 1 << change;
+        }
+    }
+
+    void updateImageTest()
+    {
+        QFETCH(QString, edgeDetection);
+        QFETCH(int, lsbBits);
+        QFETCH(QString, change);
+
+        std::ifstream payloadFile(testEmbedImage3KB.toStdString(), std::ios_base::binary);
+        std::vector<uint8_t> payload((std::istreambuf_iterator<char>(payloadFile)), std::istreambuf_iterator<char>());
+        cv::Mat carrier = cv::imread(smallImage.toStdString(), cv::IMREAD_COLOR);
+        cv::Mat stegoImage;
+        Stego encodeStego(LSB.toStdString(), edgeDetection.toStdString(), false, "");
+        encodeStego.SetLsbBits(lsbBits);
+        QCOMPARE(encodeStego.EncodeImage(carrier, payload.data(), payload.size(), "image_3KB.png", stegoImage),
+                 StegoStatus::SUCCESS);
+
+        std::vector<uint8_t> newPayload = payload;
+        std::string newFileName = "image_3KB.png";
+        uint64_t numChangedBits = 0;
+        if (change == "bytes")
+        {
+            for (size_t i : {size_t(0), payload.size() / 2, payload.size() - 1})
+            {
+                newPayload[i] ^= 0x21;
+                numChangedBits += 2;
+            }
+        }
+        else if (change == "shorter")
+        {
+            newPayload.resize(payload.size() / 2);
+        }
+        else if (change == "longer")
+        {
+            newPayload.insert(newPayload.end(), payload.begin(), payload.begin() + 1000);
+        }
+        else
+        {
+            newFileName = "image_3KB_2.png";
+        }
+
+        // The mode is read from the header, not from the instance
+        cv::Mat updatedImage = stegoImage.clone();
+        Stego updateStego(LSB.toStdString(), noEdgeDetection.toStdString(), false, "");
+        QCOMPARE(updateStego.UpdateImage(updatedImage, newPayload.data(), newPayload.size(), newFileName),
+                 StegoStatus::SUCCESS);
+
+        Stego decodeStego(LSB.toStdString(), noEdgeDetection.toStdString(), false, "");
+        std::vector<uint8_t> decodedPayload;
+        std::string decodedFileName;
+        QCOMPARE(decodeStego.DecodeImage(updatedImage, decodedPayload, decodedFileName), StegoStatus::SUCCESS);
+        QVERIFY(decodedPayload == newPayload);
+        QCOMPARE(decodedFileName, newFileName);
+
+        // Embedding the whole payload in the stego image again gives the same image
+        cv::Mat encodedImage;
+        Stego fullStego(LSB.toStdString(), edgeDetection.toStdString(), false, "");
+        fullStego.SetLsbBits(lsbBits);
+        QCOMPARE(fullStego.EncodeImage(stegoImage, newPayload.data(), newPayload.size(), newFileName, encodedImage),
+                 StegoStatus::SUCCESS);
+        QCOMPARE(cv::norm(updatedImage, encodedImage, cv::NORM_INF), 0.0);
+
+        // Changed bits outside the header change a sample each
+        if (change == "bytes")
+        {
+            cv::Mat changedSamples;
+            cv::absdiff(stegoImage, updatedImage, changedSamples);
+            QCOMPARE(uint64_t(cv::countNonZero(changedSamples.reshape(1))), numChangedBits);
+        }
+    }
+
+    void updateRejectsTest()
+    {
+        std::ifstream payloadFile(testEmbedPdf1KB.toStdString(), std::ios_base::binary);
+        std::vector<uint8_t> payload((std::istreambuf_iterator<char>(payloadFile)), std::istreambuf_iterator<char>());
+        cv::Mat carrier = cv::imread(smallImage.toStdString(), cv::IMREAD_COLOR);
+
+        // Nothing embedded
+        cv::Mat image = carrier.clone();
+        Stego updateStego(LSB.toStdString(), noEdgeDetection.toStdString(), false, "");
+        QCOMPARE(updateStego.UpdateImage(image, payload.data(), payload.size(), "pdf_1KB.pdf"),
+                 StegoStatus::INVALID_HEADER);
+
+        // PVD carries as many bits as each pixel pair allows, it is encoded again instead
+        Stego pvdStego(PVD.toStdString(), noEdgeDetection.toStdString(), false, "");
+        QCOMPARE(pvdStego.EncodeImage(carrier, payload.data(), payload.size(), "pdf_1KB.pdf", image),
+                 StegoStatus::SUCCESS);
+        QCOMPARE(updateStego.UpdateImage(image, payload.data(), payload.size(), "pdf_1KB.pdf"),
+                 StegoStatus::INVALID_MEDIA);
+
+        // The new payload must fit like an encode
+        Stego lsbStego(LSB.toStdString(), noEdgeDetection.toStdString(), false, "");
+        QCOMPARE(lsbStego.EncodeImage(carrier, payload.data(), payload.size(), "pdf_1KB.pdf", image),
+                 StegoStatus::SUCCESS);
+        std::vector<uint8_t> largePayload(carrier.total() * 3 / 8);
+        cv::Mat updatedImage = image.clone();
+        QCOMPARE(updateStego.UpdateImage(updatedImage, largePayload.data(), largePayload.size(), "large.bin"),
+                 StegoStatus::FILE_TOO_LARGE);
+        QCOMPARE(cv::norm(updatedImage, image, cv::NORM_INF), 0.0);
+    }
+
+    void updateVideoTest_data()
+    {
+        QTest::addColumn<QString>("edgeDetection");
+        QTest::addColumn<int>("lsbBits");
+
+        QTest::newRow("LSB None") << noEdgeDetection << 1;
+        QTest::newRow("LSB None 2 bits") << noEdgeDetection << 2;
+        QTest::newRow("LSB Sobel") << sobelEdgeDetection << 1;
+    }
+
+    void updateVideoTest()
+    {
+        QFETCH(QString, edgeDetection);
+        QFETCH(int, lsbBits);
+
+        std::filesystem::remove_all("update_video_test");
+        std::filesystem::create_directories("update_video_test");
+        std::filesystem::path payloadPath = "update_video_test/payload.pdf";
+        std::filesystem::copy_file(testEmbedPdf664KB.toStdString(), payloadPath);
+
+        Stego encodeStego(payloadPath.string(), testVideo.toStdString(), LSB.toStdString(),
+                          edgeDetection.toStdString(), false, "");
+        encodeStego.SetWorkingDirectory("update_video_test/encode");
+        encodeStego.SetLsbBits(lsbBits);
+        QCOMPARE(encodeStego.EncodeVideo(), StegoStatus::SUCCESS);
+
+        // A change near the end only touches the last frames of the payload
+        std::string payload;
+        {
+            std::ifstream payloadFile(payloadPath, std::ios_base::binary);
+            payload.assign((std::istreambuf_iterator<char>(payloadFile)), std::istreambuf_iterator<char>());
+        }
+
+        payload[payload.size() - 10] ^= 0x55;
+        {
+            std::ofstream payloadFile(payloadPath, std::ios_base::binary);
+            payloadFile.write(payload.data(), payload.size());
+        }
+
+        Stego updateStego(payloadPath.string(), encodeStego.GetOutputPath(), LSB.toStdString(),
+                          noEdgeDetection.toStdString(), false, "");
+        updateStego.SetWorkingDirectory("update_video_test/update");
+        QCOMPARE(updateStego.UpdateVideo(), StegoStatus::SUCCESS);
+
+        Stego decodeStego(updateStego.GetOutputPath(), false, "");
+        decodeStego.SetWorkingDirectory("update_video_test/decode");
+        QCOMPARE(decodeStego.DecodeVideo(), StegoStatus::SUCCESS);
+
+        std::ifstream decodedFile(decodeStego.GetOutputPath(), std::ios_base::binary);
+        std::string decoded((std::istreambuf_iterator<char>(decodedFile)), std::istreambuf_iterator<char>());
+        QVERIFY(decoded == payload);
+
+        std::filesystem::remove_all("update_video_test");
+    }
+
+    void videoBackendRoundTripTest_data()
+    {
+        QTest::addColumn<QString>("videoCodec");
+
+        QTest::newRow("FFV1") << "FFV1";
+        QTest::newRow("x264rgb") << "x264rgb";
+        QTest::newRow("UTVideo") << "UTVideo";
+        QTest::newRow("Raw") << "Raw";
+    }
+
+    void videoBackendRoundTripTest()
+    {
+        QFETCH(QString, videoCodec);
+
+        VideoCodec codec;
+        QVERIFY(VideoBackend::ParseCodec(videoCodec.toStdString(), codec));
+        QCOMPARE(VideoBackend::CodecName(codec), videoCodec.toStdString());
+        VideoBackend backend(codec, 2, 4);
+        if (!backend.IsEncoderAvailable())
+        {
+            QSKIP("ffmpeg was built without this encoder");
+        }
+
+        // The same payload is also written with the default FFV1 backend, every backend must decode to its frames
+        VideoBackend backends[2] = {VideoBackend(), backend};
+        std::string stegoMediaPaths[2];
+        for (int i = 0; i < 2; i++)
+        {
+            Stego encodeStego(testEmbedPdf19KB.toStdString(), testVideo.toStdString(), LSB.toStdString(),
+                              sobelEdgeDetection.toStdString(), false, "");
+            encodeStego.SetWorkingDirectory("video_backend_test/" + std::to_string(i));
+            encodeStego.SetVideoBackend(backends[i]);
+            QCOMPARE(encodeStego.EncodeVideo(), StegoStatus::SUCCESS);
+            stegoMediaPaths[i] = encodeStego.GetOutputPath();
+        }
+
+        cv::VideoCapture reference(stegoMediaPaths[0]);
+        cv::VideoCapture video(stegoMediaPaths[1]);
+        QVERIFY(reference.isOpened() && video.isOpened());
+        cv::Mat referenceFrame;
+        cv::Mat frame;
+        int numFrames = 0;
+        while (reference.read(referenceFrame))
+        {
+            QVERIFY(video.read(frame));
+            QCOMPARE(cv::norm(referenceFrame, frame, cv::NORM_INF), 0.0);
+            numFrames++;
+        }
+
+        QVERIFY(numFrames > 0);
+        QVERIFY(!video.read(frame));
+        reference.release();
+        video.release();
+
+        Stego decodeStego(stegoMediaPaths[1], false, "");
+        decodeStego.SetWorkingDirectory("video_backend_test");
+        QCOMPARE(decodeStego.DecodeVideo(), StegoStatus::SUCCESS);
+
+        std::ifstream payloadFile(testEmbedPdf19KB.toStdString(), std::ios_base::binary);
+        std::vector<char> payload((std::istreambuf_iterator<char>(payloadFile)), std::istreambuf_iterator<char>());
+        std::ifstream decodedFile(decodeStego.GetOutputPath(), std::ios_base::binary);
+        std::vector<char> decoded((std::istreambuf_iterator<char>(decodedFile)), std::istreambuf_iterator<char>());
+        decodedFile.close();
+        std::filesystem::remove_all("video_backend_test");
+
+        QVERIFY(decoded == payload);
+    }
+
+    void rawPipeFrameSourceTest_data()
+    {
+        QTest::addColumn<QString>("media");
+
+        QTest::newRow("testVideo") << testVideo;
+        QTest::newRow("testVideoWithAudio") << testVideoWithAudio;
+    }
+
+    void rawPipeFrameSourceTest()
+    {
+        QFETCH(QString, media);
+
+        // Two frames buffered ahead, so the reader thread waits on the caller for most of the video
+        auto bufferPool = std::make_shared<BufferPool>();
+        FrameSource capture(FrameSourceType::VideoCapture);
+        FrameSource rawPipe(FrameSourceType::RawPipe, bufferPool.get(), 2);
+        QVERIFY(capture.Open(media.toStdString()));
+        QVERIFY(rawPipe.Open(media.toStdString()));
+        QCOMPARE(rawPipe.FPS(), capture.FPS());
+        QCOMPARE(rawPipe.FrameCount(), capture.FrameCount());
+
+        cv::Mat captureFrame;
+        cv::Mat rawPipeFrame;
+        cv::Mat firstFrame;
+        int numFrames = 0;
+        while (capture.Read(captureFrame))
+        {
+            QVERIFY(rawPipe.Read(rawPipeFrame));
+            QCOMPARE(rawPipeFrame.size(), captureFrame.size());
+            QCOMPARE(rawPipeFrame.type(), captureFrame.type());
+            QCOMPARE(cv::norm(captureFrame, rawPipeFrame, cv::NORM_INF), 0.0);
+            if (numFrames == 0)
+            {
+                firstFrame = rawPipeFrame;
+            }
+
+            numFrames++;
+        }
+
+        QVERIFY(!rawPipe.Read(rawPipeFrame));
+        QVERIFY(rawPipeFrame.empty());
+        QVERIFY(numFrames > 0);
+
+        // A frame kept by the caller is never handed out again
+        cv::VideoCapture video(media.toStdString());
+        cv::Mat frame;
+        QVERIFY(video.read(frame));
+        QCOMPARE(cv::norm(frame, firstFrame, cv::NORM_INF), 0.0);
+        firstFrame.release();
+
+        // Stopping early leaves ffmpeg to end on a broken pipe
+        QVERIFY(rawPipe.Open(media.toStdString()));
+        QVERIFY(rawPipe.Read(rawPipeFrame));
+        rawPipe.Release();
+        rawPipeFrame.release();
+
+        Stego encodeStego(testEmbedPdf19KB.toStdString(), media.toStdString(), PVD.toStdString(),
+                          sobelEdgeDetection.toStdString(), false, "");
+        encodeStego.SetWorkingDirectory("raw_pipe_test");
+        encodeStego.SetBufferPool(bufferPool);
+        encodeStego.SetFrameSource(FrameSourceType::RawPipe);
+        QCOMPARE(encodeStego.EncodeVideo(), StegoStatus::SUCCESS);
+
+        Stego decodeStego(encodeStego.GetOutputPath(), false, "");
+        decodeStego.SetWorkingDirectory("raw_pipe_test");
+        decodeStego.SetBufferPool(bufferPool);
+        decodeStego.SetFrameSource(FrameSourceType::RawPipe);
+        QCOMPARE(decodeStego.DecodeVideo(), StegoStatus::SUCCESS);
+
+        std::ostringstream command;
+        command << "cmp " << testEmbedPdf19KB.toStdString() << " " << decodeStego.GetOutputPath();
+        int result = std::system(command.str().c_str());
+        std::filesystem::remove_all("raw_pipe_test");
+
+        QCOMPARE(result, 0);
+    }
+
+    void rawPipeUntrustedPathTest()
+    {
+        // The path is passed to ffmpeg through a shell, which must neither run nor expand any of it
+        std::filesystem::remove_all("raw_pipe_path_test");
+        std::filesystem::create_directories("raw_pipe_path_test");
+        std::string media = "raw_pipe_path_test/it's $(touch raw_pipe_path_test/ran) `touch raw_pipe_path_test/ran`.mkv";
+        std::filesystem::copy_file(testVideo.toStdString(), media);
+
+        FrameSource capture(FrameSourceType::VideoCapture);
+        FrameSource rawPipe(FrameSourceType::RawPipe);
+        QVERIFY(capture.Open(media));
+        QVERIFY(rawPipe.Open(media));
+
+        cv::Mat captureFrame;
+        cv::Mat rawPipeFrame;
+        QVERIFY(capture.Read(captureFrame) && rawPipe.Read(rawPipeFrame));
+        QCOMPARE(cv::norm(captureFrame, rawPipeFrame, cv::NORM_INF), 0.0);
+        rawPipe.Release();
+
+        QVERIFY(!std::filesystem::exists("raw_pipe_path_test/ran"));
+        std::filesystem::remove_all("raw_pipe_path_test");
+    }
+
+    void checkpointResumeTest_data()
+    {
+        QTest::addColumn<QString>("file");
+        QTest::addColumn<QString>("algo");
+        QTest::addColumn<QString>("edgeDetection");
+        QTest::addColumn<QString>("password");
+
+        QTest::newRow("LSB None") << testEmbedPdf664KB << LSB << noEdgeDetection << emptyPassword;
+        QTest::newRow("PVD Sobel encrypted") << testEmbedPdf664KB << PVD << sobelEdgeDetection << "password";
+    }
+
+    void checkpointResumeTest()
+    {
+        QFETCH(QString, file);
+        QFETCH(QString, algo);
+        QFETCH(QString, edgeDetection);
+        QFETCH(QString, password);
+
+        // EncodeVideo runs the event loop every frame, the timer copies the checkpoint once it has two segments as
+        // the state a crash would have left behind
+        std::filesystem::path checkpointDirectory = "checkpoint_test/.stego_checkpoint";
+        std::filesystem::path snapshotDirectory = "checkpoint_snapshot";
+        std::filesystem::remove_all("checkpoint_test");
+        std::filesystem::remove_all(snapshotDirectory);
+        QTimer snapshotTimer;
+        QObject::connect(&snapshotTimer, &QTimer::timeout, [&]()
+        {
+            std::error_code error;
+            for (const auto& entry : std::filesystem::recursive_directory_iterator(checkpointDirectory, error))
+            {
+                StegoJournal journal;
+                if (entry.path().filename() == "journal" && journal.Load(entry.path()) == StegoStatus::SUCCESS &&
+                    journal.segments.size() >= 2)
+                {
+                    std::filesystem::copy(checkpointDirectory, snapshotDirectory,
+                                          std::filesystem::copy_options::recursive);
+                    snapshotTimer.stop();
+                    break;
+                }
+            }
+        });
+
+        std::string stegoMedia[2];
+        for (int i = 0; i < 2; i++)
+        {
+            Stego encodeStego(file.toStdString(), testVideo.toStdString(), algo.toStdString(),
+                              edgeDetection.toStdString(), !password.isEmpty(), password.toStdString());
+            encodeStego.SetWorkingDirectory("checkpoint_test");
+            encodeStego.SetCheckpointInterval(2);
+            if (i == 0)
+            {
+                snapshotTimer.start(0);
+            }
+
+            QCOMPARE(encodeStego.EncodeVideo(), StegoStatus::SUCCESS);
+            snapshotTimer.stop();
+            QVERIFY(!std::filesystem::exists(checkpointDirectory) || std::filesystem::is_empty(checkpointDirectory));
+
+            std::ifstream stegoFile(encodeStego.GetOutputPath(), std::ios_base::binary);
+            stegoMedia[i].assign(std::istreambuf_iterator<char>(stegoFile), std::istreambuf_iterator<char>());
+
+            // The second encode resumes from the snapshot instead of starting over
+            if (i == 0)
+            {
+                QVERIFY(std::filesystem::exists(snapshotDirectory));
+                std::filesystem::remove_all(checkpointDirectory);
+                std::filesystem::rename(snapshotDirectory, checkpointDirectory);
+            }
+        }
+
+        QVERIFY(!stegoMedia[0].empty());
+        QVERIFY(stegoMedia[0] == stegoMedia[1]);
+
+        std::string stegoMediaPath = "checkpoint_test/resumed.mkv";
+        std::ofstream(stegoMediaPath, std::ios_base::binary) << stegoMedia[1];
+        Stego decodeStego(stegoMediaPath, !password.isEmpty(), password.toStdString());
+        decodeStego.SetWorkingDirectory("checkpoint_test");
+        QCOMPARE(decodeStego.DecodeVideo(), StegoStatus::SUCCESS);
+
+        std::ostringstream command;
+        command << "cmp " << file.toStdString() << " " << decodeStego.GetOutputPath();
+        int result = std::system(command.str().c_str());
+        std::filesystem::remove_all("checkpoint_test");
+
+        QCOMPARE(result, 0);
+    }
+
+    void largePayloadVideoTest()
+    {
+        // Writes and decodes more than 4 GiB and needs about as much free disk, so it only runs on request
+        if (!qEnvironmentVariableIsSet("STEGO_LARGE_PAYLOAD_TEST"))
+        {
+            QSKIP("Set STEGO_LARGE_PAYLOAD_TEST to round trip a payload larger than 4 GiB");
+        }
+
+        // Sparse payload just over 4 GiB, only the marker bytes around the 32-bit boundaries take disk space
+        const uint64_t payloadSize = (uint64_t(1) << 32) + 4096;
+        const std::string payloadPath = "large_payload.bin";
+        {
+            std::ofstream payloadFile(payloadPath, std::ios_base::binary | std::ios_base::trunc);
+        }
+        std::filesystem::resize_file(payloadPath, payloadSize);
+        {
+            std::fstream payloadFile(payloadPath, std::ios_base::binary | std::ios_base::in | std::ios_base::out);
+            for (uint64_t offset : {uint64_t(0), (uint64_t(1) << 32) - 1, uint64_t(1) << 32, payloadSize - 1})
+            {
+                payloadFile.seekp(offset);
+                payloadFile.put(static_cast<char>(0xA5 ^ (offset & 0xFF)));
+            }
+        }
+
+        // Flat synthetic frames, so the lossless carrier and the temporary frames stay small on disk
+        const cv::Size frameSize(1920, 1080);
+        uint64_t frameCapacity = StegoCapacity::LsbSequentialCapacity(frameSize.area(), 0);
+        int numFrames = static_cast<int>(payloadSize / frameCapacity) + 2;
+        const std::string carrierPath = "large_payload_carrier.mkv";
+        cv::VideoWriter writer(carrierPath, cv::VideoWriter::fourcc('F', 'F', 'V', '1'), 30, frameSize);
+        QVERIFY(writer.isOpened());
+        cv::Mat frame(frameSize, CV_8UC3);
+        for (int i = 0; i < numFrames; i++)
+        {
+            frame.setTo(cv::Scalar(i % 256, 128, 64));
+            writer.write(frame);
+        }
+        writer.release();
+
+        Stego encodeStego(payloadPath, carrierPath, LSB.toStdString(), noEdgeDetection.toStdString(), false, "");
+        QCOMPARE(encodeStego.EncodeVideo(), StegoStatus::SUCCESS);
+
+        Stego decodeStego(encodeStego.GetOutputPath(), false, "");
+        QCOMPARE(decodeStego.DecodeVideo(), StegoStatus::SUCCESS);
+        QCOMPARE(uint64_t(std::filesystem::file_size(decodeStego.GetOutputPath())), payloadSize);
+
+        // Compare in bounded chunks, neither file is ever held in memory
+        std::ifstream original(payloadPath, std::ios_base::binary);
+        std::ifstream decoded(decodeStego.GetOutputPath(), std::ios_base::binary);
+        std::vector<char> originalChunk(1 << 20);
+        std::vector<char> decodedChunk(1 << 20);
+        bool bEqual = true;
+        while (bEqual && original.read(originalChunk.data(), originalChunk.size()).gcount() > 0)
+        {
+            decoded.read(decodedChunk.data(), decodedChunk.size());
+            bEqual = original.gcount() == decoded.gcount() &&
+                     std::equal(originalChunk.begin(), originalChunk.begin() + original.gcount(), decodedChunk.begin());
+        }
+
+        std::filesystem::remove(payloadPath);
+        std::filesystem::remove(carrierPath);
+        std::filesystem::remove(encodeStego.GetOutputPath());
+        std::filesystem::remove(decodeStego.GetOutputPath());
+
+        QVERIFY(bEqual);
+    }
+
+    void bufferPoolSteadyStateTest()
+    {
+        std::ifstream payloadFile(testEmbedPdf19KB.toStdString(), std::ios_base::binary);
+        std::vector<uint8_t> payload((std::istreambuf_iterator<char>(payloadFile)), std::istreambuf_iterator<char>());
+        cv::Mat carrier = cv::imread(smallImage.toStdString(), cv::IMREAD_COLOR);
+
+        auto bufferPool = std::make_shared<BufferPool>();
+        Stego stego(PVD.toStdString(), cannyEdgeDetection.toStdString(), false, "");
+        stego.SetBufferPool(bufferPool);
+
+        // The first frame fills the pool, every frame of the same size after it only reuses buffers
+        for (int frame = 0; frame < 3; frame++)
+        {
+            bufferPool->ResetStats();
+
+            cv::Mat stegoImage;
+            StegoStatus status = stego.EncodeImage(carrier, payload.data(), payload.size(), "payload.bin", stegoImage);
+            QCOMPARE(status, StegoStatus::SUCCESS);
+
+            std::vector<uint8_t> decodedPayload;
+            std::string decodedFileName;
+            QCOMPARE(stego.DecodeImage(stegoImage, decodedPayload, decodedFileName), StegoStatus::SUCCESS);
+            QVERIFY(decodedPayload == payload);
+
+            BufferPoolStats stats = stego.GetBufferPoolStats();
+            if (frame > 0)
+            {
+                QCOMPARE(stats.numAllocations, uint64_t(0));
+                QVERIFY(stats.numReuses > 0);
+            }
+        }
+    }
+
+    void compressionTest_data()
+    {
+        QTest::addColumn<QString>("stegoAlgo");
+        QTest::addColumn<QString>("edgeDetection");
+        QTest::addColumn<bool>("encryption");
+        QTest::addColumn<QString>("password");
+
+        QTest::newRow("smallImage-LSB-NoEdgeDetection-NoEncryption") << LSB << noEdgeDetection << false << emptyPassword;
+        QTest::newRow("smallImage-LSB-SobelEdgeDetection-Encryption") << LSB << sobelEdgeDetection << true << QString("password");
+        QTest::newRow("smallImage-PVD-NoEdgeDetection-Encryption") << PVD << noEdgeDetection << true << QString("password");
+    }
+
+    void compressionTest()
+    {
+        QFETCH(QString, stegoAlgo);
+        QFETCH(QString, edgeDetection);
+        QFETCH(bool, encryption);
+        QFETCH(QString, password);
+
+        cv::Mat carrier = cv::imread(smallImage.toStdString(), cv::IMREAD_COLOR);
+        Stego capacityStego("", smallImage.toStdString(), stegoAlgo.toStdString(), edgeDetection.toStdString(), false, "");
+        QCOMPARE(capacityStego.CalculateCapacity(), StegoStatus::SUCCESS);
+
+        // Log-like text twice the size of the capacity only fits when it is compressed
+        std::string text;
+        for (int line = 0; text.size() < capacityStego.GetEmbedSize() * 2; line++)
+        {
+            text += "frame " + std::to_string(line) + " embedded in " + std::to_string(line % 97) + " ms\n";
+        }
+
+        std::vector<uint8_t> payload(text.begin(), text.end());
+        cv::Mat stegoImage;
+        Stego uncompressedStego(stegoAlgo.toStdString(), edgeDetection.toStdString(), encryption, password.toStdString());
+        QCOMPARE(uncompressedStego.EncodeImage(carrier, payload.data(), payload.size(), "log.txt", stegoImage),
+                 StegoStatus::FILE_TOO_LARGE);
+
+        Stego encodeStego(stegoAlgo.toStdString(), edgeDetection.toStdString(), encryption, password.toStdString());
+        encodeStego.SetCompression(true);
+        QCOMPARE(encodeStego.EncodeImage(carrier, payload.data(), payload.size(), "log.txt", stegoImage),
+                 StegoStatus::SUCCESS);
+
+        Stego decodeStego(stegoAlgo.toStdString(), edgeDetection.toStdString(), encryption, password.toStdString());
+        std::vector<uint8_t> decodedPayload;
+        std::string decodedFileName;
+        QCOMPARE(decodeStego.DecodeImage(stegoImage, decodedPayload, decodedFileName), StegoStatus::SUCCESS);
+        QVERIFY(decodedFileName == "log.txt");
+        QVERIFY(decodedPayload == payload);
+
+        // Incompressible payloads are stored as they are
+        std::ifstream pdfFile(testEmbedPdf19KB.toStdString(), std::ios_base::binary);
+        std::vector<uint8_t> pdf((std::istreambuf_iterator<char>(pdfFile)), std::istreambuf_iterator<char>());
+        pdf.resize(std::min<size_t>(pdf.size(), capacityStego.GetEmbedSize() / 2));
+        QCOMPARE(encodeStego.EncodeImage(carrier, pdf.data(), pdf.size(), "payload.pdf", stegoImage), StegoStatus::SUCCESS);
+        QCOMPARE(decodeStego.DecodeImage(stegoImage, decodedPayload, decodedFileName), StegoStatus::SUCCESS);
+        QVERIFY(decodedPayload == pdf);
+    }
+
+    void inflateLimitTest()
+    {
+        cv::Mat carrier = cv::imread(smallImage.toStdString(), cv::IMREAD_COLOR);
+        std::vector<uint8_t> payload(1024 * 1024, 0);
+        cv::Mat stegoImage;
+        Stego encodeStego(LSB.toStdString(), noEdgeDetection.toStdString(), false, "");
+        encodeStego.SetCompression(true);
+        QCOMPARE(encodeStego.EncodeImage(carrier, payload.data(), payload.size(), "zeros.bin", stegoImage),
+                 StegoStatus::SUCCESS);
+
+        // A payload that inflates past the limit fails instead of filling memory
+        Stego limitedStego(LSB.toStdString(), noEdgeDetection.toStdString(), false, "");
+        limitedStego.SetInflateLimit(payload.size() / 2);
+        std::vector<uint8_t> decodedPayload;
+        std::string decodedFileName;
+        QCOMPARE(limitedStego.DecodeImage(stegoImage, decodedPayload, decodedFileName),
+                 StegoStatus::DECOMPRESSION_FAILED);
+
+        // The default limit is at least MIN_INFLATE_LIMIT_BYTES, whatever the embedded size
+        Stego decodeStego(LSB.toStdString(), noEdgeDetection.toStdString(), false, "");
+        QCOMPARE(decodeStego.DecodeImage(stegoImage, decodedPayload, decodedFileName), StegoStatus::SUCCESS);
+        QVERIFY(decodedPayload == payload);
+    }
+
+    void extractRangeTest_data()
+    {
+        QTest::addColumn<QString>("file");
+        QTest::addColumn<QString>("media");
+        QTest::addColumn<QString>("stegoAlgo");
+        QTest::addColumn<QString>("edgeDetection");
+        QTest::addColumn<QString>("frameSource");
+
+        QTest::newRow("image LSB None") << testEmbedPdf19KB << smallImage << LSB << noEdgeDetection << "VideoCapture";
+        QTest::newRow("image PVD Sobel") << testEmbedPdf19KB << smallImage << PVD << sobelEdgeDetection << "VideoCapture";
+        QTest::newRow("video LSB None") << testEmbedPdf664KB << testVideo << LSB << noEdgeDetection << "VideoCapture";
+        QTest::newRow("video LSB None RawPipe") << testEmbedPdf664KB << testVideo << LSB << noEdgeDetection << "RawPipe";
+        QTest::newRow("video LSB Sobel") << testEmbedPdf664KB << testVideo << LSB << sobelEdgeDetection << "VideoCapture";
+        QTest::newRow("video PVD None") << testEmbedPdf664KB << testVideo << PVD << noEdgeDetection << "VideoCapture";
+    }
+
+    void extractRangeTest()
+    {
+        QFETCH(QString, file);
+        QFETCH(QString, media);
+        QFETCH(QString, stegoAlgo);
+        QFETCH(QString, edgeDetection);
+        QFETCH(QString, frameSource);
+
+        FrameSourceType frameSourceType;
+        QVERIFY(FrameSource::ParseType(frameSource.toStdString(), frameSourceType));
+        bool bVideo = media == testVideo;
+
+        Stego encodeStego(file.toStdString(), media.toStdString(), stegoAlgo.toStdString(),
+                          edgeDetection.toStdString(), false, "");
+        encodeStego.SetWorkingDirectory("range_test");
+        QCOMPARE(bVideo ? encodeStego.EncodeVideo() : encodeStego.EncodeImage(), StegoStatus::SUCCESS);
+
+        std::ifstream payloadFile(file.toStdString(), std::ios_base::binary);
+        std::string payload((std::istreambuf_iterator<char>(payloadFile)), std::istreambuf_iterator<char>());
+
+        // The tail is cut short at the end of the payload
+        std::vector<std::pair<uint64_t, uint64_t>> ranges = {{0, 100},
+                                                             {payload.size() / 2 + 3, 4096},
+                                                             {payload.size() - 1000, 1000},
+                                                             {payload.size() - 10, 100}};
+        for (const auto& range : ranges)
+        {
+            Stego rangeStego(encodeStego.GetOutputPath(), false, "");
+            rangeStego.SetWorkingDirectory("range_test");
+            rangeStego.SetFrameSource(frameSourceType);
+            QCOMPARE(rangeStego.ExtractRange(range.first, range.second), StegoStatus::SUCCESS);
+
+            std::ifstream rangeFile(rangeStego.GetOutputPath(), std::ios_base::binary);
+            std::string extracted((std::istreambuf_iterator<char>(rangeFile)), std::istreambuf_iterator<char>());
+            QVERIFY(extracted == payload.substr(range.first, range.second));
+        }
+
+        Stego outsideStego(encodeStego.GetOutputPath(), false, "");
+        outsideStego.SetWorkingDirectory("range_test");
+        QCOMPARE(outsideStego.ExtractRange(payload.size() + 1, 1), StegoStatus::INVALID_RANGE);
+
+        std::filesystem::remove_all("range_test");
+    }
+
+    void shardTest_data()
+    {
+        QTest::addColumn<QString>("stegoAlgo");
+        QTest::addColumn<QString>("edgeDetection");
+        QTest::addColumn<bool>("compress");
+        QTest::addColumn<QString>("password");
+
+        QTest::newRow("LSB None") << LSB << noEdgeDetection << false << emptyPassword;
+        QTest::newRow("LSB Sobel encrypted") << LSB << sobelEdgeDetection << false << "password";
+        QTest::newRow("PVD Sobel compressed") << PVD << sobelEdgeDetection << true << emptyPassword;
+    }
+
+    void shardTest()
+    {
+        QFETCH(QString, stegoAlgo);
+        QFETCH(QString, edgeDetection);
+        QFETCH(bool, compress);
+        QFETCH(QString, password);
+
+        // More than one copy of Lenna holds, the video takes the rest
+        bool encryption = !password.isEmpty();
+        std::vector<std::string> media;
+        std::filesystem::create_directories("shard_test/carriers");
+        for (const std::string& name : {"first.png", "second.png", "third.png"})
+        {
+            media.push_back("shard_test/carriers/" + name);
+            std::filesystem::copy_file(smallImage.toStdString(), media.back(),
+                                       std::filesystem::copy_options::overwrite_existing);
+        }
+
+        media.push_back(testVideo.toStdString());
+
+        Stego encodeStego(testEmbedPdf664KB.toStdString(), "", stegoAlgo.toStdString(), edgeDetection.toStdString(),
+                          encryption, password.toStdString());
+        encodeStego.SetWorkingDirectory("shard_test");
+        encodeStego.SetCompression(compress);
+        QCOMPARE(encryption ? encodeStego.EncryptFile() : StegoStatus::SUCCESS, StegoStatus::SUCCESS);
+        QCOMPARE(encodeStego.EncodeShards(media), StegoStatus::SUCCESS);
+
+        // The set decodes in any order
+        std::vector<std::string> stegoMedia;
+        for (const std::string& mediaPath : media)
+        {
+            stegoMedia.push_back((std::filesystem::path(encodeStego.GetOutputPath()) /
+                                  std::filesystem::path(mediaPath).filename()).string());
+        }
+
+        std::reverse(stegoMedia.begin(), stegoMedia.end());
+        Stego decodeStego("", encryption, password.toStdString());
+        decodeStego.SetWorkingDirectory("shard_test");
+        QCOMPARE(decodeStego.DecodeShards(stegoMedia), StegoStatus::SUCCESS);
+        if (encryption)
+        {
+            QCOMPARE(decodeStego.DecryptFile(), StegoStatus::SUCCESS);
+        }
+
+        std::ostringstream command;
+        command << "cmp " << testEmbedPdf664KB.toStdString() << " " << decodeStego.GetOutputPath();
+        QCOMPARE(std::system(command.str().c_str()), 0);
+
+        // Every shard is needed, a shard alone is not decoded as a payload
+        stegoMedia.pop_back();
+        Stego missingStego("", encryption, password.toStdString());
+        missingStego.SetWorkingDirectory("shard_test");
+        QCOMPARE(missingStego.DecodeShards(stegoMedia), StegoStatus::SHARD_SET_INCOMPLETE);
+
+        Stego singleStego(stegoMedia.back(), encryption, password.toStdString());
+        singleStego.SetWorkingDirectory("shard_test");
+        QCOMPARE(singleStego.DecodeImage(), StegoStatus::SHARD_SET_INCOMPLETE);
+
+        std::vector<uint8_t> decodedPayload;
+        std::string decodedFileName;
+        Stego inMemoryStego(stegoAlgo.toStdString(), edgeDetection.toStdString(), encryption, password.toStdString());
+        QCOMPARE(inMemoryStego.DecodeImage(cv::imread(stegoMedia.back(), cv::IMREAD_COLOR), decodedPayload,
+                                           decodedFileName),
+                 StegoStatus::SHARD_SET_INCOMPLETE);
+        QVERIFY(decodedPayload.empty());
+
+        std::filesystem::remove_all("shard_test");
+    }
+
+    void shardSplitTest()
+    {
+        std::vector<uint64_t> lengths = StegoShard::Split(1000, {100, 300, 600});
+        QCOMPARE(lengths, std::vector<uint64_t>({100, 300, 600}));
+
+        lengths = StegoShard::Split(10, {7, 0, 7});
+        QCOMPARE(lengths, std::vector<uint64_t>({5, 0, 5}));
+
+        lengths = StegoShard::Split(999, {1, 1000});
+        QCOMPARE(lengths[0] + lengths[1], uint64_t(999));
+        QVERIFY(lengths[0] <= 1);
+
+        QVERIFY(StegoShard::Split(1001, {100, 300, 600}).empty());
+    }
+
+    void edgeCacheTest_data()
+    {
+        QTest::addColumn<QString>("media");
+        QTest::addColumn<QString>("stegoAlgo");
+        QTest::addColumn<QString>("edgeDetection");
+
+        QTest::newRow("smallImage LSB Sobel") << smallImage << LSB << sobelEdgeDetection;
+        QTest::newRow("smallImage PVD Canny") << smallImage << PVD << cannyEdgeDetection;
+        QTest::newRow("testVideo LSB Canny") << testVideo << LSB << cannyEdgeDetection;
+        QTest::newRow("smallImage LSB Texture") << smallImage << LSB << textureEdgeDetection;
+    }
+
+    void edgeCacheTest()
+    {
+        QFETCH(QString, media);
+        QFETCH(QString, stegoAlgo);
+        QFETCH(QString, edgeDetection);
+
+        bool bVideo = media == testVideo;
+        auto encode = [&](const std::string& directory, std::shared_ptr<EdgeCache> edgeCache)
+        {
+            Stego stego(testEmbedPdf1KB.toStdString(), media.toStdString(), stegoAlgo.toStdString(),
+                        edgeDetection.toStdString(), false, "");
+            stego.SetWorkingDirectory(directory);
+            stego.SetEdgeCache(edgeCache);
+            StegoStatus status = bVideo ? stego.EncodeVideo() : stego.EncodeImage();
+            return std::make_pair(status, stego.GetOutputPath());
+        };
+
+        auto plain = encode("edge_cache_test/plain", nullptr);
+        QCOMPARE(plain.first, StegoStatus::SUCCESS);
+
+        // The first encode fills the cache, the second reads every mask back from it
+        auto edgeCache = std::make_shared<EdgeCache>("edge_cache_test/cache");
+        auto first = encode("edge_cache_test/first", edgeCache);
+        QCOMPARE(first.first, StegoStatus::SUCCESS);
+        QCOMPARE(edgeCache->Stats().numHits, uint64_t(0));
+        QVERIFY(edgeCache->Stats().numMisses > 0);
+
+        uint64_t numMisses = edgeCache->Stats().numMisses;
+        auto second = encode("edge_cache_test/second", edgeCache);
+        QCOMPARE(second.first, StegoStatus::SUCCESS);
+        QCOMPARE(edgeCache->Stats().numMisses, numMisses);
+        QVERIFY(edgeCache->Stats().numHits > 0);
+
+        for (const std::string& outputPath : {first.second, second.second})
+        {
+            std::ostringstream command;
+            command << "cmp " << plain.second << " " << outputPath;
+            QCOMPARE(std::system(command.str().c_str()), 0);
+        }
+
+        // The stego media hashes like its carrier, decoding only hits
+        Stego decodeStego(second.second, false, "");
+        decodeStego.SetWorkingDirectory("edge_cache_test/decode");
+        decodeStego.SetEdgeCache(edgeCache);
+        QCOMPARE(bVideo ? decodeStego.DecodeVideo() : decodeStego.DecodeImage(), StegoStatus::SUCCESS);
+        QCOMPARE(edgeCache->Stats().numMisses, numMisses);
+
+        std::ostringstream command;
+        command << "cmp " << testEmbedPdf1KB.toStdString() << " " << decodeStego.GetOutputPath();
+        QCOMPARE(std::system(command.str().c_str()), 0);
+
+        std::filesystem::remove_all("edge_cache_test");
+    }
+
+    void edgeCacheEvictionTest()
+    {
+        cv::Mat image = cv::imread(smallImage.toStdString(), cv::IMREAD_COLOR);
+        size_t maskBytes = EdgeCache::HEADER_BYTES + (size_t(image.rows) * image.cols + 7) / 8;
+
+        // Room for two masks, storing a third removes the least recently used
+        EdgeCache edgeCache("edge_cache_eviction_test", 2 * maskBytes + maskBytes / 2);
+        cv::Mat mask(image.rows, image.cols, CV_8UC1, cv::Scalar(255));
+        edgeCache.Store(1, mask);
+        edgeCache.Store(2, mask);
+
+        cv::Mat loaded;
+        QVERIFY(edgeCache.Load(1, image.rows, image.cols, loaded));
+        QCOMPARE(cv::countNonZero(loaded != mask), 0);
+
+        edgeCache.Store(3, mask);
+        QCOMPARE(edgeCache.Stats().numEvictions, uint64_t(1));
+        QVERIFY(edgeCache.Load(1, image.rows, image.cols, loaded));
+        QVERIFY(!edgeCache.Load(2, image.rows, image.cols, loaded));
+        QVERIFY(edgeCache.Load(3, image.rows, image.cols, loaded));
+
+        // A mask of another size is a miss
+        QVERIFY(!edgeCache.Load(3, image.rows + 1, image.cols, loaded));
+
+        std::filesystem::remove_all("edge_cache_eviction_test");
+    }
+
+    void edgeCacheSharedDirectoryTest()
+    {
+        // Caches of their own on one directory, like the jobs of a batch, store the same key at once. Half of them
+        // store a mask of edges only, the rest one without edges, every load has to see one of them whole
+        const int numThreads = 8;
+        const int numStores = 50;
+        const int rows = 256;
+        const int cols = 256;
+        std::filesystem::remove_all("edge_cache_shared_test");
+
+        std::vector<bool> loadsWhole(numThreads, true);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < numThreads; i++)
+        {
+            threads.emplace_back([&, i]() {
+                EdgeCache edgeCache("edge_cache_shared_test");
+                cv::Mat mask(rows, cols, CV_8UC1, cv::Scalar(i % 2 == 0 ? 255 : 0));
+                cv::Mat loaded;
+                for (int store = 0; store < numStores; store++)
+                {
+                    edgeCache.Store(1, mask);
+                    if (edgeCache.Load(1, rows, cols, loaded))
+                    {
+                        int numEdges = cv::countNonZero(loaded);
+                        loadsWhole[i] = loadsWhole[i] && (numEdges == 0 || numEdges == rows * cols);
+                    }
+                }
+            });
+        }
+
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+
+        for (int i = 0; i < numThreads; i++)
+        {
+            QVERIFY(loadsWhole[i]);
+        }
+
+        cv::Mat loaded;
+        QVERIFY(EdgeCache("edge_cache_shared_test").Load(1, rows, cols, loaded));
+        for (const auto& entry : std::filesystem::directory_iterator("edge_cache_shared_test"))
+        {
+            QCOMPARE(entry.path().extension().string(), std::string(".edges"));
+        }
+
+        std::filesystem::remove_all("edge_cache_shared_test");
+    }
+
+    void plannerTest_data()
+    {
+        QTest::addColumn<QString>("file");
+        QTest::addColumn<QString>("media");
+        QTest::addColumn<bool>("requireEdgeDetection");
+        QTest::addColumn<double>("maxFill");
+
+        QTest::newRow("pdf19KB-smallImage") << testEmbedPdf19KB << smallImage << false << 1.0;
+        QTest::newRow("pdf19KB-smallImage-requireEdges") << testEmbedPdf19KB << smallImage << true << 1.0;
+        QTest::newRow("mp3_27KB-smallImage-quarterFill") << testEmbedMp3_27KB << smallImage << false << 0.25;
+        QTest::newRow("image207KB-smallImage") << testEmbedImage207KB << smallImage << false << 1.0;
+        QTest::newRow("pdf26KB-testVideo-requireEdges") << testEmbedPdf26KB << testVideo << true << 0.5;
+    }
+
+    void plannerTest()
+    {
+        QFETCH(QString, file);
+        QFETCH(QString, media);
+        QFETCH(bool, requireEdgeDetection);
+        QFETCH(double, maxFill);
+
+        StegoPlanConstraints constraints;
+        constraints.bRequireEdgeDetection = requireEdgeDetection;
+        constraints.maxFill = maxFill;
+        StegoPlanOption chosen;
+        StegoStatus status = StegoPlanner().PlanEncode(file.toStdString(), {media.toStdString()}, false, false,
+                                                      constraints, chosen);
+
+        // The plan is the fastest mode of the default model whose measured capacity holds the file and its name
+        uint64_t requiredBytes = std::filesystem::file_size(file.toStdString()) +
+                                 std::filesystem::path(file.toStdString()).filename().string().size();
+        StegoCostModel costModel;
+        bool bExpected = false;
+        StegoPlanOption expected;
+        for (StegoAlgo algo : constraints.algos)
+        {
+            for (EdgeDetectionType edgeDetectionType : constraints.edgeDetectionTypes)
+            {
+                if (requireEdgeDetection && edgeDetectionType == EdgeDetectionType::None)
+                {
+                    continue;
+                }
+
+                Stego capacityStego("", media.toStdString(), StegoPlanner::AlgoName(algo),
+                                    StegoPlanner::EdgeDetectionName(edgeDetectionType), false, "");
+                QCOMPARE(capacityStego.CalculateCapacity(), StegoStatus::SUCCESS);
+                double seconds = costModel.SecondsPerPixel(algo, edgeDetectionType);
+                if (capacityStego.GetEmbedSize() * maxFill >= requiredBytes &&
+                    (!bExpected || seconds < costModel.SecondsPerPixel(expected.algo, expected.edgeDetectionType)))
+                {
+                    bExpected = true;
+                    expected.algo = algo;
+                    expected.edgeDetectionType = edgeDetectionType;
+                }
+            }
+        }
+
+        if (!bExpected)
+        {
+            QCOMPARE(status, StegoStatus::FILE_TOO_LARGE);
+            return;
+        }
+
+        QCOMPARE(status, StegoStatus::SUCCESS);
+        QCOMPARE(chosen.algo, expected.algo);
+        QCOMPARE(chosen.edgeDetectionType, expected.edgeDetectionType);
+        QVERIFY(chosen.bMeasured && chosen.bFits);
+
+        bool bVideo = media == testVideo;
+        Stego encodeStego(file.toStdString(), media.toStdString(), StegoPlanner::AlgoName(chosen.algo),
+                          StegoPlanner::EdgeDetectionName(chosen.edgeDetectionType), false, "");
+        encodeStego.SetWorkingDirectory("planner_test");
+        QCOMPARE(bVideo ? encodeStego.EncodeVideo() : encodeStego.EncodeImage(), StegoStatus::SUCCESS);
+
+        Stego decodeStego(encodeStego.GetOutputPath(), false, "");
+        decodeStego.SetWorkingDirectory("planner_test");
+        QCOMPARE(bVideo ? decodeStego.DecodeVideo() : decodeStego.DecodeImage(), StegoStatus::SUCCESS);
+
+        std::ostringstream command;
+        command << "cmp " << file.toStdString() << " " << decodeStego.GetOutputPath();
+        QCOMPARE(std::system(command.str().c_str()), 0);
+
+        std::filesystem::remove_all("planner_test");
+    }
+
+    void costModelTest()
+    {
+        StegoCostModel costModel;
+        costModel.Calibrate(128, 128);
+        for (StegoAlgo algo : {StegoAlgo::LSB, StegoAlgo::PVD})
+        {
+            for (EdgeDetectionType edgeDetectionType : {EdgeDetectionType::None, EdgeDetectionType::Sobel,
+                                                        EdgeDetectionType::Canny, EdgeDetectionType::Texture})
+            {
+                QVERIFY(costModel.SecondsPerPixel(algo, edgeDetectionType) > 0);
+            }
+        }
+
+        QVERIFY(costModel.Save("cost_model_test.txt"));
+        StegoCostModel loadedModel;
+        QVERIFY(loadedModel.Load("cost_model_test.txt"));
+        QCOMPARE(loadedModel.SecondsPerPixel(StegoAlgo::PVD, EdgeDetectionType::Canny),
+                 costModel.SecondsPerPixel(StegoAlgo::PVD, EdgeDetectionType::Canny));
+
+        // A model missing a mode is not loaded and leaves the defaults
+        std::ofstream("cost_model_test.txt") << "LSB None 1e-9\n";
+        StegoCostModel partialModel;
+        QVERIFY(!partialModel.Load("cost_model_test.txt"));
+        QCOMPARE(partialModel.SecondsPerPixel(StegoAlgo::LSB, EdgeDetectionType::None),
+                 StegoCostModel().SecondsPerPixel(StegoAlgo::LSB, EdgeDetectionType::None));
+
+        std::filesystem::remove("cost_model_test.txt");
+    }
+
+    void archiveTest_data()
+    {
+        QTest::addColumn<QString>("stegoAlgo");
+        QTest::addColumn<QString>("edgeDetection");
+        QTest::addColumn<bool>("compress");
+
+        QTest::newRow("LSB None") << LSB << noEdgeDetection << false;
+        QTest::newRow("LSB Sobel compressed") << LSB << sobelEdgeDetection << true;
+        QTest::newRow("PVD Sobel compressed") << PVD << sobelEdgeDetection << true;
+    }
+
+    void archiveTest()
+    {
+        QFETCH(QString, stegoAlgo);
+        QFETCH(QString, edgeDetection);
+        QFETCH(bool, compress);
+
+        std::filesystem::remove_all("archive_test");
+        std::filesystem::path payloadDirectory = "archive_test/payload";
+        std::vector<std::pair<QString, std::string>> members = {{testEmbedPdf1KB, "pdf_1KB.pdf"},
+                                                                {testEmbedImage3KB, "images/image_3KB.png"},
+                                                                {testEmbedMp3_5KB, "audio/mp3/mp3_5KB.mp3"},
+                                                                {testEmbedZip_5KB, "zip_5KB.zip"}};
+        for (const auto& member : members)
+        {
+            std::filesystem::create_directories((payloadDirectory / member.second).parent_path());
+            std::filesystem::copy_file(member.first.toStdString(), payloadDirectory / member.second);
+        }
+
+        Stego encodeStego(payloadDirectory.string(), smallImage.toStdString(), stegoAlgo.toStdString(),
+                          edgeDetection.toStdString(), false, "");
+        encodeStego.SetWorkingDirectory("archive_test");
+        encodeStego.SetCompression(compress);
+        QCOMPARE(encodeStego.EncodeImage(), StegoStatus::SUCCESS);
+
+        // Decoding the whole archive unpacks the directory
+        Stego decodeStego(encodeStego.GetOutputPath(), false, "");
+        decodeStego.SetWorkingDirectory("archive_test");
+        QCOMPARE(decodeStego.DecodeImage(), StegoStatus::SUCCESS);
+        std::filesystem::path decodedDirectory = decodeStego.GetOutputPath();
+        QCOMPARE(decodedDirectory.filename().string(), std::string("payload"));
+
+        std::vector<std::string> decodedMembers;
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(decodedDirectory))
+        {
+            if (entry.is_regular_file())
+            {
+                decodedMembers.push_back(entry.path().lexically_relative(decodedDirectory).generic_string());
+            }
+        }
+
+        QCOMPARE(decodedMembers.size(), members.size());
+        for (const auto& member : members)
+        {
+            std::ostringstream command;
+            command << "cmp " << member.first.toStdString() << " " << (decodedDirectory / member.second).string();
+            QCOMPARE(std::system(command.str().c_str()), 0);
+        }
+
+        // A single member is decoded on its own
+        std::filesystem::remove_all(decodedDirectory);
+        for (const auto& member : members)
+        {
+            Stego memberStego(encodeStego.GetOutputPath(), false, "");
+            memberStego.SetWorkingDirectory("archive_test");
+            QCOMPARE(memberStego.ExtractMember(member.second), StegoStatus::SUCCESS);
+            QCOMPARE(memberStego.GetOutputPath(), (decodedDirectory / member.second).string());
+
+            std::ostringstream command;
+            command << "cmp " << member.first.toStdString() << " " << memberStego.GetOutputPath();
+            QCOMPARE(std::system(command.str().c_str()), 0);
+        }
+
+        Stego missingStego(encodeStego.GetOutputPath(), false, "");
+        missingStego.SetWorkingDirectory("archive_test");
+        QCOMPARE(missingStego.ExtractMember("missing.txt"), StegoStatus::ARCHIVE_MEMBER_NOT_FOUND);
+
+        std::filesystem::remove_all("archive_test");
+    }
+
+    void concurrentEncodeDecodeTest()
+    {
+        // Every thread runs its own encode and decode with a different algorithm mix, half of them encrypted.
+        // Run with -DSTEGO_ENABLE_TSAN=ON to check the engine for data races.
+        const std::vector<std::string> algos = {"LSB", "PVD"};
+        const std::vector<std::string> edgeDetections = {"None", "Sobel", "Canny"};
+        const size_t numThreads = 8;
+
+        std::vector<StegoStatus> encodeStatuses(numThreads, StegoStatus::SUCCESS);
+        std::vector<StegoStatus> decodeStatuses(numThreads, StegoStatus::SUCCESS);
+        std::vector<bool> filesMatch(numThreads, false);
+        std::vector<std::thread> threads;
+
+        for (size_t i = 0; i < numThreads; i++)
+        {
+            threads.emplace_back([&, i]() {
+                std::string file = testEmbedPdf19KB.toStdString();
+                std::string workingDirectory = "concurrent_" + std::to_string(i);
+                bool encryption = i % 2 == 1;
+                std::string password = encryption ? "password" + std::to_string(i) : "";
+
+                Stego encodeStego(file, smallImage.toStdString(), algos[i % algos.size()],
+                                  edgeDetections[i % edgeDetections.size()], encryption, password);
+                encodeStego.SetWorkingDirectory(workingDirectory);
+
+                StegoStatus status = encryption ? encodeStego.EncryptFile() : StegoStatus::SUCCESS;
+                if (status == StegoStatus::SUCCESS)
+                {
+                    status = encodeStego.EncodeImage();
+                }
+
+                encodeStatuses[i] = status;
+                if (status != StegoStatus::SUCCESS)
+                {
+                    return;
+                }
+
+                Stego decodeStego(encodeStego.GetOutputPath(), encryption, password);
+                decodeStego.SetWorkingDirectory(workingDirectory);
+                status = decodeStego.DecodeImage();
+                if (status == StegoStatus::SUCCESS && encryption)
+                {
+                    status = decodeStego.DecryptFile();
+                }
+
+                decodeStatuses[i] = status;
+                if (status != StegoStatus::SUCCESS)
+                {
+                    return;
+                }
+
+                std::ifstream original(file, std::ios_base::binary);
+                std::ifstream decoded(decodeStego.GetOutputPath(), std::ios_base::binary);
+                filesMatch[i] = std::equal(std::istreambuf_iterator<char>(original), std::istreambuf_iterator<char>(),
+                                           std::istreambuf_iterator<char>(decoded), std::istreambuf_iterator<char>());
+            });
+        }
+
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+
+        for (size_t i = 0; i < numThreads; i++)
+        {
+            QCOMPARE(encodeStatuses[i], StegoStatus::SUCCESS);
+            QCOMPARE(decodeStatuses[i], StegoStatus::SUCCESS);
+            QVERIFY(filesMatch[i]);
+            QVERIFY(!std::filesystem::exists("concurrent_" + std::to_string(i) + "/.stego_temp") ||
+                    std::filesystem::is_empty("concurrent_" + std::to_string(i) + "/.stego_temp"));
+        }
+    }
+
+    void threadPoolTest()
+    {
+        // Every task is queued on worker 0 so the others have to steal, and some of them throw.
+        // Wait() must return only once all of them ran, and the pool must keep working afterwards
+        const int numTasks = 1000;
+        WorkStealingThreadPool pool(4);
+        std::atomic<int> numRun(0);
+
+        for (int round = 1; round <= 2; round++)
+        {
+            for (int i = 0; i < numTasks; i++)
+            {
+                pool.Submit([&numRun, i]() {
+                    numRun++;
+                    if (i % 10 == 0)
+                    {
+                        throw std::runtime_error("task failed");
+                    }
+                }, 0);
+            }
+
+            pool.Wait();
+            QCOMPARE(numRun.load(), round * numTasks);
+        }
+    }
+
+    void jobSchedulerFailureTest()
+    {
+        // The output root is a regular file, so the jobs cannot create their output directories.
+        // They have to fail on their own instead of ending the batch
+        std::filesystem::remove_all("scheduler_failure_root");
+        std::ofstream("scheduler_failure_root") << "not a directory";
+
+        std::vector<StegoJob> jobs(4);
+        for (StegoJob& job : jobs)
+        {
+            job.type = StegoJobType::Encode;
+            job.filePath = testEmbedPdf19KB.toStdString();
+            job.mediaPath = smallImage.toStdString();
+            job.algo = "LSB";
+            job.edgeDetection = "None";
+        }
+
+        std::vector<StegoJobResult> results;
+        ThroughputReport report = JobScheduler("scheduler_failure_root", 2).Run(jobs, results);
+
+        QCOMPARE(report.numFailed, jobs.size());
+        for (const StegoJobResult& result : results)
+        {
+            QCOMPARE(result.status, StegoStatus::FILE_OPEN_FAILED);
+        }
+
+        std::filesystem::remove("scheduler_failure_root");
+    }
 };
 
 QTEST_MAIN(UnitTests)
@@ -0,0 +1,10 @@
+#ifndef VIDEOCODEC_H
+#define VIDEOCODEC_H
+enum class VideoCodec {
+    FFV1,
+    X264RGB,
+    UTVideo,
+    Raw
+};
+
+#endif // VIDEOCODEC_H
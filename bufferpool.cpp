@@ -0,0 +1,206 @@
+#include "bufferpool.h"
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+inline void* alignedAlloc(size_t alignment, size_t size)
+{
+#ifdef _WIN32
+    return _aligned_malloc(size, alignment);
+#else
+    return std::aligned_alloc(alignment, size);
+#endif
+}
+
+inline void alignedFree(void* buffer)
+{
+#ifdef _WIN32
+    _aligned_free(buffer);
+#else
+    std::free(buffer);
+#endif
+}
+
+BufferPool::BufferPool(bool bHugePages, size_t maxCachedBytes)
+    : bHugePages(bHugePages)
+    , maxCachedBytes(maxCachedBytes)
+{
+}
+
+BufferPool::~BufferPool()
+{
+    Trim();
+}
+
+/**
+ * @brief BufferPool::Bind Make mat allocate its data from this pool the next time it is (re)created.
+ */
+void BufferPool::Bind(cv::Mat& mat)
+{
+    mat.allocator = this;
+}
+
+BufferPoolStats BufferPool::Stats() const
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->stats;
+}
+
+/**
+ * @brief BufferPool::ResetStats Zero the counters, bytesInUse and bytesCached keep describing the pool.
+ */
+void BufferPool::ResetStats()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->stats.numAllocations = 0;
+    this->stats.numReuses = 0;
+    this->stats.numFrees = 0;
+}
+
+/**
+ * @brief BufferPool::Trim Give every cached buffer back to the system.
+ */
+void BufferPool::Trim()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    for (auto& sizeBuffers : this->freeBuffers)
+    {
+        for (void* buffer : sizeBuffers.second)
+        {
+            alignedFree(buffer);
+            this->stats.numFrees++;
+        }
+    }
+
+    this->freeBuffers.clear();
+    this->stats.bytesCached = 0;
+}
+
+/**
+ * @brief BufferPool::bufferSize Size actually reserved for a request of size bytes. Sizes are rounded up so
+ * that planes of the same frame size share a free list.
+ */
+size_t BufferPool::bufferSize(size_t size) const
+{
+    size_t granularity = this->bHugePages && size >= HUGE_PAGE_SIZE ? HUGE_PAGE_SIZE : ALIGNMENT;
+    return ((std::max<size_t>(size, 1) + granularity - 1) / granularity) * granularity;
+}
+
+void* BufferPool::acquire(size_t size) const
+{
+    size_t reservedSize = bufferSize(size);
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stats.bytesInUse += reservedSize;
+
+        auto sizeBuffers = this->freeBuffers.find(reservedSize);
+        if (sizeBuffers != this->freeBuffers.end() && !sizeBuffers->second.empty())
+        {
+            void* buffer = sizeBuffers->second.back();
+            sizeBuffers->second.pop_back();
+            this->stats.bytesCached -= reservedSize;
+            this->stats.numReuses++;
+            return buffer;
+        }
+
+        this->stats.numAllocations++;
+    }
+
+    bool bHugePage = reservedSize % HUGE_PAGE_SIZE == 0 && this->bHugePages;
+    void* buffer = alignedAlloc(bHugePage ? HUGE_PAGE_SIZE : ALIGNMENT, reservedSize);
+    if (buffer == nullptr)
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stats.bytesInUse -= reservedSize;
+        throw std::bad_alloc();
+    }
+
+#ifdef __linux__
+    if (bHugePage)
+    {
+        madvise(buffer, reservedSize, MADV_HUGEPAGE);
+    }
+#endif
+
+    return buffer;
+}
+
+void BufferPool::release(void* buffer, size_t size) const
+{
+    size_t reservedSize = bufferSize(size);
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stats.bytesInUse -= reservedSize;
+        if (this->stats.bytesCached + reservedSize <= this->maxCachedBytes)
+        {
+            this->freeBuffers[reservedSize].push_back(buffer);
+            this->stats.bytesCached += reservedSize;
+            return;
+        }
+
+        this->stats.numFrees++;
+    }
+
+    alignedFree(buffer);
+}
+
+cv::UMatData* BufferPool::allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+                                   cv::AccessFlag /*flags*/, cv::UMatUsageFlags /*usageFlags*/) const
+{
+    size_t total = CV_ELEM_SIZE(type);
+    for (int i = dims - 1; i >= 0; i--)
+    {
+        if (step)
+        {
+            if (data && step[i] != CV_AUTOSTEP)
+            {
+                total = step[i];
+            }
+            else
+            {
+                step[i] = total;
+            }
+        }
+
+        total *= sizes[i];
+    }
+
+    cv::UMatData* matData = new cv::UMatData(this);
+    matData->data = matData->origdata = data ? static_cast<uchar*>(data) : static_cast<uchar*>(acquire(total));
+    matData->size = total;
+    if (data)
+    {
+        matData->flags |= cv::UMatData::USER_ALLOCATED;
+    }
+
+    return matData;
+}
+
+bool BufferPool::allocate(cv::UMatData* data, cv::AccessFlag /*accessFlags*/, cv::UMatUsageFlags /*usageFlags*/) const
+{
+    return data != nullptr;
+}
+
+void BufferPool::deallocate(cv::UMatData* data) const
+{
+    if (data == nullptr)
+    {
+        return;
+    }
+
+    if (!(data->flags & cv::UMatData::USER_ALLOCATED))
+    {
+        release(data->origdata, data->size);
+        data->origdata = nullptr;
+    }
+
+    delete data;
+}
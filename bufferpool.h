@@ -0,0 +1,66 @@
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <opencv2/core/mat.hpp>
+
+/**
+ * Counters of a BufferPool. In steady state, e.g. from the second video frame of the same size on,
+ * numAllocations stays constant and every buffer is a reuse.
+ */
+struct BufferPoolStats
+{
+    uint64_t numAllocations = 0;
+    uint64_t numReuses = 0;
+    uint64_t numFrees = 0;
+    size_t bytesInUse = 0;
+    size_t bytesCached = 0;
+};
+
+/**
+ * Recycles the buffers of the per frame Mats (channel planes, embedding maps, edge detection planes) across
+ * frames and jobs. Buffers are 64-byte aligned and, when enabled, large buffers are backed by huge pages.
+ * Use Bind on a Mat before creating it, OpenCV then allocates and releases its data through the pool.
+ * Every Mat bound to the pool must be released before the pool is destroyed.
+ */
+class BufferPool : public cv::MatAllocator
+{
+public:
+    explicit BufferPool(bool bHugePages = false, size_t maxCachedBytes = DEFAULT_MAX_CACHED_BYTES);
+    ~BufferPool() override;
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    void Bind(cv::Mat& mat);
+    BufferPoolStats Stats() const;
+    void ResetStats();
+    void Trim();
+
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step, cv::AccessFlag flags,
+                           cv::UMatUsageFlags usageFlags) const override;
+    bool allocate(cv::UMatData* data, cv::AccessFlag accessFlags, cv::UMatUsageFlags usageFlags) const override;
+    void deallocate(cv::UMatData* data) const override;
+
+    static constexpr size_t ALIGNMENT = 64;
+    static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+    static constexpr size_t DEFAULT_MAX_CACHED_BYTES = 512 * 1024 * 1024;
+
+private:
+    bool bHugePages;
+    size_t maxCachedBytes;
+
+    mutable std::mutex mutex;
+    mutable std::unordered_map<size_t, std::vector<void*>> freeBuffers;
+    mutable BufferPoolStats stats;
+
+    size_t bufferSize(size_t size) const;
+    void* acquire(size_t size) const;
+    void release(void* buffer, size_t size) const;
+};
+
+#endif // BUFFERPOOL_H
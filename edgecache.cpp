@@ -0,0 +1,206 @@
+#include "edgecache.h"
+#include "stegoarchive.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+// Edge detection masks the two low bits of every sample away, they are left out of the key
+const uint64_t SAMPLE_MASK = 0xFCFCFCFCFCFCFCFCull;
+const uint64_t HASH_MULTIPLIER_1 = 0x9E3779B97F4A7C15ull;
+const uint64_t HASH_MULTIPLIER_2 = 0xBF58476D1CE4E5B9ull;
+const uchar EDGE_VALUE = 255;
+
+uint64_t mixHash(uint64_t hash, uint64_t word)
+{
+    hash ^= word * HASH_MULTIPLIER_1;
+    hash = (hash << 31) | (hash >> 33);
+
+    return hash * HASH_MULTIPLIER_2;
+}
+
+EdgeCache::EdgeCache(const std::filesystem::path& directory, uint64_t maxBytes)
+    : directory(directory)
+    , maxBytes(maxBytes)
+{
+    std::error_code error;
+    std::filesystem::create_directories(this->directory, error);
+}
+
+/**
+ * @brief EdgeCache::Key Hash the samples of an 8-bit image as edge detection reads them, together with its size and
+ * the edge detection type. The image is read 8 bytes at a time, far faster than detecting its edges. An image LSB
+ * embedded in with edge detection keeps the key of its carrier, one PVD embedded in does not.
+ */
+uint64_t EdgeCache::Key(const cv::Mat& image, EdgeDetectionType edgeDetectionType)
+{
+    uint64_t hash = mixHash(static_cast<uint64_t>(image.rows) << 32 | static_cast<uint32_t>(image.cols),
+                            static_cast<uint64_t>(image.type()) << 8 | static_cast<uint64_t>(edgeDetectionType));
+    size_t rowBytes = image.cols * image.elemSize();
+    for (int row = 0; row < image.rows; row++)
+    {
+        const uchar* samples = image.ptr<uchar>(row);
+        size_t i = 0;
+        for (; i + sizeof(uint64_t) <= rowBytes; i += sizeof(uint64_t))
+        {
+            uint64_t word;
+            std::memcpy(&word, samples + i, sizeof(word));
+            hash = mixHash(hash, word & SAMPLE_MASK);
+        }
+
+        uint64_t tail = 0;
+        std::memcpy(&tail, samples + i, rowBytes - i);
+        hash = mixHash(hash, (tail & SAMPLE_MASK) ^ row);
+    }
+
+    // Final avalanche, so keys differing in a few bits name different files
+    hash ^= hash >> 31;
+    hash *= HASH_MULTIPLIER_1;
+
+    return hash ^ (hash >> 29);
+}
+
+std::filesystem::path EdgeCache::filePath(uint64_t key) const
+{
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << key << ".edges";
+
+    return this->directory / name.str();
+}
+
+/**
+ * @brief EdgeCache::Load Read the mask stored under key into mask, a CV_8UC1 image of rows by cols that is non zero
+ * for edge pixels like EdgeDetection::GetMagnitudes. A hit marks the mask as used most recently.
+ * @return false if there is no mask of that size under key
+ */
+bool EdgeCache::Load(uint64_t key, int rows, int cols, cv::Mat& mask)
+{
+    std::filesystem::path path = filePath(key);
+    std::ifstream file(path, std::ios_base::binary);
+    std::vector<uint8_t> header(HEADER_BYTES);
+    uint64_t numPixels = static_cast<uint64_t>(rows) * cols;
+    std::vector<uint8_t> bits((numPixels + 7) / 8);
+    bool bHit = file.read(reinterpret_cast<char*>(header.data()), header.size()) &&
+                readLittleEndian(header, 0, 4) == MAGIC && readLittleEndian(header, 4, 4) == static_cast<uint32_t>(rows) &&
+                readLittleEndian(header, 8, 4) == static_cast<uint32_t>(cols) &&
+                file.read(reinterpret_cast<char*>(bits.data()), bits.size());
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (!bHit)
+    {
+        this->stats.numMisses++;
+        return false;
+    }
+
+    mask.create(rows, cols, CV_8UC1);
+    uchar* pixels = mask.ptr<uchar>(0);
+    for (uint64_t pixel = 0; pixel < numPixels; pixel++)
+    {
+        pixels[pixel] = (bits[pixel / 8] >> (pixel % 8)) & 1 ? EDGE_VALUE : 0;
+    }
+
+    std::error_code error;
+    std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+    this->stats.numHits++;
+
+    return true;
+}
+
+/**
+ * @brief EdgeCache::Store Store mask, a continuous CV_8UC1 edge mask, under key and remove the least recently used
+ * masks while the cache is over its budget. The file is written under a temp name unique to this call and renamed,
+ * so other instances never read half of it.
+ */
+void EdgeCache::Store(uint64_t key, const cv::Mat& mask)
+{
+    if (mask.empty() || !mask.isContinuous() || mask.type() != CV_8UC1)
+    {
+        return;
+    }
+
+    std::string contents;
+    putLittleEndian(contents, MAGIC, 4);
+    putLittleEndian(contents, mask.rows, 4);
+    putLittleEndian(contents, mask.cols, 4);
+
+    uint64_t numPixels = mask.total();
+    std::vector<uint8_t> bits((numPixels + 7) / 8, 0);
+    const uchar* pixels = mask.ptr<uchar>(0);
+    for (uint64_t pixel = 0; pixel < numPixels; pixel++)
+    {
+        bits[pixel / 8] |= static_cast<uint8_t>((pixels[pixel] != 0) << (pixel % 8));
+    }
+
+    contents.append(bits.begin(), bits.end());
+
+    // Jobs with caches of their own and other processes may store the same carrier at once, every writer has a temp
+    // file of its own and the last rename wins
+    std::lock_guard<std::mutex> lock(this->mutex);
+    std::filesystem::path path = filePath(key);
+    std::filesystem::path tempPath = this->directory / (uniqueTempName(path.filename().string()) + ".tmp");
+    {
+        std::ofstream file(tempPath, std::ios_base::binary | std::ios_base::trunc);
+        if (!file.write(contents.data(), contents.size()))
+        {
+            return;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, path, error);
+    if (error)
+    {
+        std::filesystem::remove(tempPath, error);
+        return;
+    }
+
+    evict();
+}
+
+EdgeCacheStats EdgeCache::Stats() const
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->stats;
+}
+
+/**
+ * @brief EdgeCache::evict Remove the masks used least recently, by the time their files were written or last
+ * loaded, until the cache fits its budget. Must be called with the mutex held.
+ */
+void EdgeCache::evict()
+{
+    std::vector<std::pair<std::filesystem::file_time_type, std::filesystem::path>> files;
+    uint64_t totalBytes = 0;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(this->directory, error))
+    {
+        if (entry.path().extension() == ".edges")
+        {
+            totalBytes += entry.file_size(error);
+            files.emplace_back(entry.last_write_time(error), entry.path());
+        }
+    }
+
+    if (totalBytes <= this->maxBytes)
+    {
+        return;
+    }
+
+    std::sort(files.begin(), files.end());
+    for (const auto& [writeTime, path] : files)
+    {
+        if (totalBytes <= this->maxBytes)
+        {
+            break;
+        }
+
+        uint64_t fileBytes = std::filesystem::file_size(path, error);
+        if (std::filesystem::remove(path, error))
+        {
+            totalBytes -= std::min(totalBytes, fileBytes);
+            this->stats.numEvictions++;
+        }
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef EDGECACHE_H
+#define EDGECACHE_H
+
+#include "EdgeDetectionType.h"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <opencv2/core/mat.hpp>
+
+/**
+ * Counters of an EdgeCache since it was created.
+ */
+struct EdgeCacheStats
+{
+    uint64_t numHits = 0;
+    uint64_t numMisses = 0;
+    uint64_t numEvictions = 0;
+};
+
+/**
+ * On-disk cache of the edge masks of carriers that are embedded in or decoded again and again, e.g. a library of
+ * cover images. A mask is keyed by a hash of the bits edge detection reads, the six high bits of every sample. LSB
+ * with edge detection changes at most the MAX_EDGE_LSB_BITS low bits, so its stego images find the mask of their
+ * carrier. PVD rewrites pixel differences in up to 7 bits and its stego images hash differently, the masks a PVD
+ * encode stores only help when the same cover is encoded again, decoding PVD needs no edges. Masks are stored one
+ * file each, a bit per pixel, and the least recently used are removed once the files take more than the budget.
+ *
+ * Every method is thread safe, and instances in several processes may share a directory. A file removed or
+ * replaced by another instance at the wrong moment only costs a miss.
+ */
+class EdgeCache
+{
+public:
+    explicit EdgeCache(const std::filesystem::path& directory, uint64_t maxBytes = DEFAULT_MAX_BYTES);
+
+    static uint64_t Key(const cv::Mat& image, EdgeDetectionType edgeDetectionType);
+    bool Load(uint64_t key, int rows, int cols, cv::Mat& mask);
+    void Store(uint64_t key, const cv::Mat& mask);
+    EdgeCacheStats Stats() const;
+
+    static constexpr uint64_t DEFAULT_MAX_BYTES = 256 * 1024 * 1024;
+    static constexpr uint32_t MAGIC = 0x47444553;
+    static constexpr size_t HEADER_BYTES = 4 + 4 + 4;
+
+private:
+    std::filesystem::path directory;
+    uint64_t maxBytes;
+
+    mutable std::mutex mutex;
+    EdgeCacheStats stats;
+
+    std::filesystem::path filePath(uint64_t key) const;
+    void evict();
+};
+
+#endif // EDGECACHE_H
@@ -1,6 +1,9 @@
 #include "edgedetection.h"
 #include <QCoreApplication>
 #include <qdebug.h>
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
 
 const size_t CANNY_LOWER_THRESHOLD = 64;
 const size_t CANNY_UPPER_THRESHOLD = 128;
@@ -8,6 +11,11 @@ const size_t CANNY_UPPER_THRESHOLD = 128;
 const uchar WEAK_EDGE = 0;
 const uchar STRONG_EDGE = 1;
 
+const uchar TEXTURE_BLOCK = 255;
+
+static_assert(EdgeDetection::TEXTURE_BLOCK_SIZE - 1 <= EdgeDetection::SOBEL_HALO_ROWS,
+              "The halo rows of a strip must hold the rows of a texture block outside the strip");
+
 double roundAngle(double angle)
 {
     if (angle >= 0 && angle < 22.5)
@@ -38,31 +46,184 @@ double roundAngle(double angle)
     return angle;
 }
 
-EdgeDetection::EdgeDetection() {}
+EdgeDetection::EdgeDetection(BufferPool* bufferPool, EdgeCache* edgeCache)
+    : bufferPool(bufferPool)
+    , edgeCache(edgeCache)
+{
+}
+
+/**
+ * @brief EdgeDetection::bind Allocate mat from the buffer pool, if there is one.
+ */
+void EdgeDetection::bind(cv::Mat& mat)
+{
+    if (this->bufferPool != nullptr)
+    {
+        this->bufferPool->Bind(mat);
+    }
+}
 
 StegoStatus EdgeDetection::DetectEdges(cv::Mat image, EdgeDetectionType edgeDetectionType)
 {
-    StegoStatus status = StegoStatus::SUCCESS;
-    QCoreApplication::processEvents();
+    StegoStatus status = BeginDetection(image, edgeDetectionType);
+    if (status == StegoStatus::SUCCESS)
+    {
+        DetectRows(image.rows);
+    }
 
-    if (edgeDetectionType == EdgeDetectionType::Canny)
+    return status;
+}
+
+/**
+ * @brief EdgeDetection::DetectEdges Detect edges in a strip of a larger image and keep the magnitudes of rows
+ * firstRow to firstRow + numRows only. They match the magnitudes of the whole image when the strip has
+ * SOBEL_HALO_ROWS rows around them, or reaches the image border. Canny thins and links edges across the whole image,
+ * so it cannot be detected on a strip. imageRow is the row of the larger image the strip starts at, texture blocks
+ * are aligned to it.
+ */
+StegoStatus EdgeDetection::DetectEdges(cv::Mat image, EdgeDetectionType edgeDetectionType, int firstRow, int numRows,
+                                       int imageRow)
+{
+    if (edgeDetectionType != EdgeDetectionType::Sobel && edgeDetectionType != EdgeDetectionType::Texture)
     {
-        status = canny(image);
+        return StegoStatus::INVALID_HEADER;
     }
-    else if (edgeDetectionType == EdgeDetectionType::Sobel)
+
+    // Strips are never detected twice, they are kept out of the cache
+    reset(image, edgeDetectionType);
+    this->firstBlockRow = (TEXTURE_BLOCK_SIZE - imageRow % TEXTURE_BLOCK_SIZE) % TEXTURE_BLOCK_SIZE;
+    DetectRows(image.rows);
+    magnitudes = magnitudes.rowRange(firstRow, firstRow + numRows);
+
+    return StegoStatus::SUCCESS;
+}
+
+/**
+ * @brief EdgeDetection::BeginDetection Start detecting edges in image, no rows are detected until DetectRows is called.
+ * The first NumDetectedRows rows of GetMagnitudes match the magnitudes DetectEdges gives, the rows below are not final.
+ * With an edge cache the mask of an image detected before is loaded instead and every row is detected at once, an
+ * image not in the cache is detected in full here and stored. A loaded mask is 255 for edge pixels instead of their
+ * magnitude, only whether a magnitude is 0 is ever read.
+ */
+StegoStatus EdgeDetection::BeginDetection(cv::Mat image, EdgeDetectionType edgeDetectionType)
+{
+    if (edgeDetectionType == EdgeDetectionType::None)
     {
-        status = sobel(image);
+        return StegoStatus::INVALID_HEADER;
     }
-    else
+
+    if (this->edgeCache == nullptr)
     {
-        status = StegoStatus::INVALID_HEADER;
+        reset(image, edgeDetectionType);
+        return StegoStatus::SUCCESS;
     }
 
-    // namedWindow("test", cv::WINDOW_AUTOSIZE ); // Create a window for display.
-    // cv::imshow("test", magnitudes);
-    // cv::waitKey(0);
+    uint64_t key = EdgeCache::Key(image, edgeDetectionType);
+    this->image = image;
+    this->edgeDetectionType = edgeDetectionType;
+    magnitudes = cv::Mat();
+    angles = cv::Mat();
+    edgeStrengths = cv::Mat();
+    bind(magnitudes);
+    if (this->edgeCache->Load(key, image.rows, image.cols, magnitudes))
+    {
+        this->numSobelRows = image.rows;
+        this->numSuppressedRows = image.rows;
+        this->numThresholdedRows = image.rows;
+        this->numDetectedRows = image.rows;
+        return StegoStatus::SUCCESS;
+    }
 
-    return status;
+    reset(image, edgeDetectionType);
+    DetectRows(image.rows);
+    this->edgeCache->Store(key, magnitudes);
+
+    return StegoStatus::SUCCESS;
+}
+
+/**
+ * @brief EdgeDetection::reset Start detecting edges in image from the top with fresh planes.
+ */
+void EdgeDetection::reset(cv::Mat image, EdgeDetectionType edgeDetectionType)
+{
+    this->image = image;
+    this->edgeDetectionType = edgeDetectionType;
+    this->numSobelRows = 0;
+    this->numSuppressedRows = 0;
+    this->numThresholdedRows = 0;
+    this->numDetectedRows = 0;
+    this->firstBlockRow = 0;
+
+    // Fresh planes, the previous ones may still be referenced through GetMagnitudes
+    magnitudes = cv::Mat();
+    angles = cv::Mat();
+    edgeStrengths = cv::Mat();
+    bind(magnitudes);
+    bind(angles);
+    bind(edgeStrengths);
+    magnitudes.create(image.rows, image.cols, CV_8UC1);
+    magnitudes.setTo(0);
+    if (edgeDetectionType != EdgeDetectionType::Texture)
+    {
+        angles.create(image.rows, image.cols, CV_64FC1);
+        angles.setTo(0.0);
+    }
+
+    if (edgeDetectionType == EdgeDetectionType::Canny)
+    {
+        edgeStrengths.create(image.rows, image.cols, CV_8UC1);
+        edgeStrengths.setTo(0);
+    }
+}
+
+/**
+ * @brief EdgeDetection::DetectRows Detect the image given to BeginDetection from the top until at least numRows rows
+ * are detected, or all of them. The Sobel filters run on MIN_DETECTION_PIXELS or more pixels at a time, texture
+ * detection on whole rows of blocks.
+ * @return The number of rows detected from the top
+ */
+int EdgeDetection::DetectRows(int numRows)
+{
+    int nRows = this->image.rows;
+    int minRows = std::max(1, MIN_DETECTION_PIXELS / std::max(1, this->image.cols));
+    int lagRows = this->edgeDetectionType == EdgeDetectionType::Canny ? CANNY_LAG_ROWS : 0;
+    numRows = std::min(numRows, nRows);
+
+    while (this->numDetectedRows < numRows)
+    {
+        QCoreApplication::processEvents();
+
+        if (this->edgeDetectionType == EdgeDetectionType::Texture)
+        {
+            texture(std::min(nRows, std::max(this->numDetectedRows + minRows, numRows)));
+            continue;
+        }
+
+        int endRow = std::min(nRows, std::max(this->numSobelRows + minRows, numRows + lagRows));
+        sobel(this->numSobelRows, endRow);
+        this->numSobelRows = endRow;
+
+        if (this->edgeDetectionType == EdgeDetectionType::Canny)
+        {
+            canny();
+        }
+        else
+        {
+            this->numDetectedRows = this->numSobelRows;
+        }
+    }
+
+    return this->numDetectedRows;
+}
+
+int EdgeDetection::NumDetectedRows() const
+{
+    return this->numDetectedRows;
+}
+
+bool EdgeDetection::IsComplete() const
+{
+    return this->numDetectedRows >= this->image.rows;
 }
 
 cv::Mat EdgeDetection::GetMagnitudes() const
@@ -70,7 +231,11 @@ cv::Mat EdgeDetection::GetMagnitudes() const
     return magnitudes;
 }
 
-StegoStatus EdgeDetection::sobel(cv::Mat image)
+/**
+ * @brief EdgeDetection::sobel Sobel magnitudes and angles of rows firstRow to endRow. The filters run on these rows and
+ * SOBEL_HALO_ROWS rows of the image around them, and reflect at the image border like filters over the whole image.
+ */
+void EdgeDetection::sobel(int firstRow, int endRow)
 {
     cv::Mat gaussianKernel = (cv::Mat_<double>(5, 5) << 1,  4,  6,  4, 1,
                                                         4, 16, 24, 16, 4,
@@ -88,7 +253,15 @@ StegoStatus EdgeDetection::sobel(cv::Mat image)
     cv::flip(sobelXKernel, sobelXKernel, -1);
     cv::flip(sobelYKernel, sobelYKernel, -1);
 
-    cv::bitwise_and(image, 252, maskedImage);
+    cv::Mat* planes[] = {&maskedImage, &dst, &dstX, &dstY, &dstAbsX, &dstAbsY};
+    for (cv::Mat* plane : planes)
+    {
+        bind(*plane);
+    }
+
+    int windowStart = std::max(0, firstRow - SOBEL_HALO_ROWS);
+    int windowEnd = std::min(this->image.rows, endRow + SOBEL_HALO_ROWS);
+    cv::bitwise_and(this->image.rowRange(windowStart, windowEnd), 252, maskedImage);
 
     cv::filter2D(maskedImage, dst, -1, gaussianKernel, cv::Point(-1, -1), 0, cv::BORDER_REFLECT);
     cv::filter2D(dst, dstX, CV_64F, sobelXKernel, cv::Point(-1, -1), 0, cv::BORDER_REFLECT);
@@ -98,12 +271,15 @@ StegoStatus EdgeDetection::sobel(cv::Mat image)
     convertScaleAbs(dstX, dstAbsX);
     convertScaleAbs(dstY, dstAbsY);
 
-    calculatePixelMagnitudes(dstAbsX, dstAbsY);
-
-    return StegoStatus::SUCCESS;
+    calculatePixelMagnitudes(dstAbsX.rowRange(firstRow - windowStart, endRow - windowStart),
+                             dstAbsY.rowRange(firstRow - windowStart, endRow - windowStart), firstRow);
 }
 
-void EdgeDetection::calculatePixelMagnitudes(cv::Mat imageX, cv::Mat imageY)
+/**
+ * @brief EdgeDetection::calculatePixelMagnitudes Magnitudes and angles of the rows of the image starting at firstRow
+ * from their Sobel derivatives imageX and imageY.
+ */
+void EdgeDetection::calculatePixelMagnitudes(cv::Mat imageX, cv::Mat imageY, int firstRow)
 {
     int channels = imageX.channels();
     int nRows = imageX.rows;
@@ -121,14 +297,16 @@ void EdgeDetection::calculatePixelMagnitudes(cv::Mat imageX, cv::Mat imageY)
 
     double magnitude = 0;
 
-    magnitudes = cv::Mat(imageX.rows, imageX.cols, CV_64FC1, 0.0);
-    angles = cv::Mat(imageX.rows, imageX.cols, CV_64FC1, 0.0);
+    cv::Mat rowMagnitudes;
+    bind(rowMagnitudes);
+    rowMagnitudes.create(imageX.rows, imageX.cols, CV_64FC1);
+    cv::Mat rowAngles = angles.rowRange(firstRow, firstRow + imageX.rows);
     for (size_t i = 0; i < nRows; i++)
     {
         rowX = imageX.ptr<uchar>(i);
         rowY = imageY.ptr<uchar>(i);
-        rowMagnitude = magnitudes.ptr<double>(i);
-        rowAngle = angles.ptr<double>(i);
+        rowMagnitude = rowMagnitudes.ptr<double>(i);
+        rowAngle = rowAngles.ptr<double>(i);
         QCoreApplication::processEvents();
 
         for (size_t j = 0, k = 0; j < nCols; j+= 3, k++)
@@ -164,89 +342,153 @@ void EdgeDetection::calculatePixelMagnitudes(cv::Mat imageX, cv::Mat imageY)
         }
     }
 
-    convertScaleAbs(magnitudes, magnitudes);
+    cv::Mat detectedMagnitudes = magnitudes.rowRange(firstRow, firstRow + imageX.rows);
+    convertScaleAbs(rowMagnitudes, detectedMagnitudes);
 }
 
-void EdgeDetection::gradientMagnitude()
+/**
+ * @brief EdgeDetection::canny Thin, threshold and link every row the Sobel magnitudes known so far allow. Each stage
+ * reads the rows around its row as the stage before left them, like when every stage ran over the whole image, so a
+ * stage only runs on a row once the stage before has run on the row below it. Thinning also reads the Sobel
+ * magnitudes of the row below.
+ */
+void EdgeDetection::canny()
+{
+    int nRows = magnitudes.rows;
+    bool bSobelComplete = this->numSobelRows == nRows;
+    for (; this->numSuppressedRows < nRows && (this->numSuppressedRows + 1 < this->numSobelRows || bSobelComplete);
+         this->numSuppressedRows++)
+    {
+        gradientMagnitude(this->numSuppressedRows);
+    }
+
+    bool bSuppressionComplete = this->numSuppressedRows == nRows;
+    for (; this->numThresholdedRows < this->numSuppressedRows &&
+           (this->numThresholdedRows + 1 < this->numSuppressedRows || bSuppressionComplete);
+         this->numThresholdedRows++)
+    {
+        thresholding(this->numThresholdedRows);
+    }
+
+    bool bThresholdingComplete = this->numThresholdedRows == nRows;
+    for (; this->numDetectedRows < this->numThresholdedRows &&
+           (this->numDetectedRows + 1 < this->numThresholdedRows || bThresholdingComplete);
+         this->numDetectedRows++)
+    {
+        hysteresis(this->numDetectedRows);
+    }
+}
+
+void EdgeDetection::gradientMagnitude(int row)
 {
     int channels = magnitudes.channels();
     int nRows = magnitudes.rows;
     int nCols = magnitudes.cols * channels;
+    if (row < 1 || row >= nRows - 1)
+    {
+        return;
+    }
 
-    uchar* magnitudeRow;
-    double* angleRow;
+    uchar* magnitudeRow = magnitudes.ptr<uchar>(row);
+    double* angleRow = angles.ptr<double>(row);
+    uchar* rowAbove = magnitudes.ptr<uchar>(row - 1);
+    uchar* rowBelow = magnitudes.ptr<uchar>(row + 1);
 
     double magnitude;
     double angle;
-    for (size_t i = 1; i < nRows - 1; i++)
+    for (size_t j = 1; j < nCols - 1; j++)
     {
-        magnitudeRow = magnitudes.ptr<uchar>(i);
-        angleRow = angles.ptr<double>(i);
+        magnitude = magnitudeRow[j];
+        angle = angleRow[j];
 
-        for (size_t j = 1; j < nCols - 1; j++)
+        if (angle == 0)
         {
-            magnitude = magnitudeRow[j];
-            angle = angleRow[j];
-
-            if (angle == 0)
+            if (magnitude < magnitudeRow[j - 1] || magnitude < magnitudeRow[j + 1])
             {
-                if (magnitude < magnitudeRow[j - 1] || magnitude < magnitudeRow[j + 1])
-                {
-                    magnitudeRow[j] = 0;
-                }
+                magnitudeRow[j] = 0;
             }
-            else if (angle == 45)
+        }
+        else if (angle == 45)
+        {
+            if (magnitude < rowAbove[j + 1] || magnitude < rowBelow[j - 1])
             {
-                if (magnitude < magnitudes.ptr<uchar>(i - 1)[j + 1] || magnitude < magnitudes.ptr<uchar>(i + 1)[j - 1])
-                {
-                    magnitudeRow[j] = 0;
-                }
+                magnitudeRow[j] = 0;
             }
-            else if (angle == 90)
+        }
+        else if (angle == 90)
+        {
+            if (magnitude < rowAbove[j] || magnitude < rowBelow[j])
             {
-                if (magnitude < magnitudes.ptr<uchar>(i - 1)[j] || magnitude < magnitudes.ptr<uchar>(i + 1)[j])
-                {
-                    magnitudeRow[j] = 0;
-                }
+                magnitudeRow[j] = 0;
             }
-            else if (angle == 135)
+        }
+        else if (angle == 135)
+        {
+            if (magnitude < rowAbove[j - 1] || magnitude < rowBelow[j + 1])
             {
-                if (magnitude < magnitudes.ptr<uchar>(i - 1)[j - 1] || magnitude < magnitudes.ptr<uchar>(i + 1)[j + 1])
-                {
-                    magnitudeRow[j] = 0;
-                }
+                magnitudeRow[j] = 0;
             }
         }
     }
 }
 
-void EdgeDetection::thresholding()
+void EdgeDetection::thresholding(int row)
 {
-    edgeStrengths = cv::Mat(magnitudes.rows, magnitudes.cols, CV_8UC1, 0.0);
-
     int channels = magnitudes.channels();
     int nRows = magnitudes.rows;
     int nCols = magnitudes.cols * channels;
+    if (row < 1 || row >= nRows - 1)
+    {
+        return;
+    }
 
-    uchar* magnitudeRow;
-    uchar* edgeStrengthRow;
+    uchar* magnitudeRow = magnitudes.ptr<uchar>(row);
+    uchar* edgeStrengthRow = edgeStrengths.ptr<uchar>(row);
 
     double magnitude;
-    for (size_t i = 1; i < nRows - 1; i++)
+    for (size_t j = 1; j < nCols - 1; j++)
+    {
+        magnitude = magnitudeRow[j];
+        if (magnitude > CANNY_UPPER_THRESHOLD)
+        {
+            edgeStrengthRow[j] = STRONG_EDGE;
+        }
+        else if (magnitude > CANNY_LOWER_THRESHOLD)
+        {
+            edgeStrengthRow[j] = WEAK_EDGE;
+        }
+        else
+        {
+            magnitudeRow[j] = 0;
+        }
+    }
+}
+
+void EdgeDetection::hysteresis(int row)
+{
+    int channels = magnitudes.channels();
+    int nRows = magnitudes.rows;
+    int nCols = magnitudes.cols * channels;
+    if (row < 1 || row >= nRows - 1)
+    {
+        return;
+    }
+
+    uchar* magnitudeRow = magnitudes.ptr<uchar>(row);
+    uchar* edgeStrengthRow = edgeStrengths.ptr<uchar>(row);
+    uchar* rowAbove = edgeStrengths.ptr<uchar>(row - 1);
+    uchar* rowBelow = edgeStrengths.ptr<uchar>(row + 1);
+
+    for (size_t j = 1; j < nCols - 1; j++)
     {
-        magnitudeRow = magnitudes.ptr<uchar>(i);
-        edgeStrengthRow = edgeStrengths.ptr<uchar>(i);
-        for (size_t j = 1; j < nCols - 1; j++)
+        if (edgeStrengthRow[j] == WEAK_EDGE && magnitudeRow[j] != 0)
         {
-            magnitude = magnitudeRow[j];
-            if (magnitude > CANNY_UPPER_THRESHOLD)
+            if (rowAbove[j - 1] == STRONG_EDGE || rowAbove[j] == STRONG_EDGE || rowAbove[j + 1] == STRONG_EDGE
+                || edgeStrengthRow[j - 1] == STRONG_EDGE || edgeStrengthRow[j + 1] == STRONG_EDGE
+                || rowBelow[j - 1] == STRONG_EDGE || rowBelow[j] == STRONG_EDGE || rowBelow[j + 1] == STRONG_EDGE)
             {
                 edgeStrengthRow[j] = STRONG_EDGE;
             }
-            else if (magnitude > CANNY_LOWER_THRESHOLD)
-            {
-                edgeStrengthRow[j] = WEAK_EDGE;
-            }
             else
             {
                 magnitudeRow[j] = 0;
@@ -255,58 +497,83 @@ void EdgeDetection::thresholding()
     }
 }
 
-void EdgeDetection::hysteresis()
+/**
+ * @brief EdgeDetection::texture Score the rows of blocks from the last one detected until endRow is detected. Rows
+ * above the first block and below the last whole block are never embeddable.
+ */
+void EdgeDetection::texture(int endRow)
 {
-    int channels = magnitudes.channels();
     int nRows = magnitudes.rows;
-    int nCols = magnitudes.cols * channels;
+    int row = std::max(this->numDetectedRows, this->firstBlockRow);
+    for (; row < endRow && row + TEXTURE_BLOCK_SIZE <= nRows; row += TEXTURE_BLOCK_SIZE)
+    {
+        textureBlockRow(row);
+    }
 
-    uchar* magnitudeRow;
-    uchar* edgeStrengthRow;
-    uchar* rowAbove;
-    uchar* rowBelow;
+    this->numDetectedRows = row + TEXTURE_BLOCK_SIZE > nRows ? nRows : row;
+}
 
-    for (size_t i = 1; i < nRows - 1; i++)
+/**
+ * @brief EdgeDetection::textureBlockRow Mark the blocks of the TEXTURE_BLOCK_SIZE rows from row that are textured.
+ * The score of a block is the sum of the absolute differences between the upper 6 bits of every sample and its right
+ * and lower neighbour in the block, so it reads nothing the two least significant bits hold. The differences of the
+ * rows are taken in branchless loops the compiler vectorises, they are only summed by block at the end.
+ */
+void EdgeDetection::textureBlockRow(int row)
+{
+    const int channels = this->image.channels();
+    const int nSamples = this->image.cols * channels;
+    const int blockSamples = TEXTURE_BLOCK_SIZE * channels;
+    const int numBlocks = this->image.cols / TEXTURE_BLOCK_SIZE;
+
+    std::vector<int> rightScores(nSamples, 0);
+    std::vector<int> lowerScores(nSamples, 0);
+    int* rightScore = rightScores.data();
+    int* lowerScore = lowerScores.data();
+    for (int i = 0; i < TEXTURE_BLOCK_SIZE; i++)
     {
-        magnitudeRow = magnitudes.ptr<uchar>(i);
-
-        edgeStrengthRow = edgeStrengths.ptr<uchar>(i);
-        rowAbove = edgeStrengths.ptr<uchar>(i - 1);
-        rowBelow = edgeStrengths.ptr<uchar>(i + 1);
+        const uchar* samples = this->image.ptr<uchar>(row + i);
+        for (int j = 0; j < nSamples - channels; j++)
+        {
+            rightScore[j] += std::abs((samples[j] & 252) - (samples[j + channels] & 252));
+        }
 
-        for (size_t j = 1; j < nCols - 1; j++)
+        if (i + 1 < TEXTURE_BLOCK_SIZE)
         {
-            if (edgeStrengthRow[j] == WEAK_EDGE && magnitudeRow[j] != 0)
+            const uchar* samplesBelow = this->image.ptr<uchar>(row + i + 1);
+            for (int j = 0; j < nSamples; j++)
             {
-                if (rowAbove[j - 1] == STRONG_EDGE || rowAbove[j] == STRONG_EDGE || rowAbove[j + 1] == STRONG_EDGE
-                    || edgeStrengthRow[j - 1] == STRONG_EDGE || edgeStrengthRow[j + 1] == STRONG_EDGE
-                    || rowBelow[j - 1] == STRONG_EDGE || rowBelow[j] == STRONG_EDGE || rowBelow[j + 1] == STRONG_EDGE)
-                {
-                    edgeStrengthRow[j] = STRONG_EDGE;
-                }
-                else
-                {
-                    magnitudeRow[j] = 0;
-                }
+                lowerScore[j] += std::abs((samples[j] & 252) - (samplesBelow[j] & 252));
             }
         }
     }
-}
-
 
-StegoStatus EdgeDetection::canny(cv::Mat image)
-{
-    StegoStatus status = sobel(image);
-    if (status != StegoStatus::SUCCESS)
+    // The blocks are marked in the first row and the row is copied to the rest of the block row
+    const int numPairs = 2 * TEXTURE_BLOCK_SIZE * (TEXTURE_BLOCK_SIZE - 1) * channels;
+    uchar* blockRow = magnitudes.ptr<uchar>(row);
+    for (int block = 0; block < numBlocks; block++)
     {
-        return status;
-    }
+        // The right neighbours of the last column of a block belong to the next block
+        int first = block * blockSamples;
+        int blockScore = 0;
+        for (int j = first; j < first + blockSamples - channels; j++)
+        {
+            blockScore += rightScore[j];
+        }
 
-    QCoreApplication::processEvents();
+        for (int j = first; j < first + blockSamples; j++)
+        {
+            blockScore += lowerScore[j];
+        }
 
-    gradientMagnitude();
-    thresholding();
-    hysteresis();
+        if (blockScore >= numPairs * TEXTURE_THRESHOLD)
+        {
+            std::fill(blockRow + block * TEXTURE_BLOCK_SIZE, blockRow + (block + 1) * TEXTURE_BLOCK_SIZE, TEXTURE_BLOCK);
+        }
+    }
 
-    return status;
+    for (int i = 1; i < TEXTURE_BLOCK_SIZE; i++)
+    {
+        std::copy(blockRow, blockRow + magnitudes.cols, magnitudes.ptr<uchar>(row + i));
+    }
 }
@@ -3,6 +3,8 @@
 
 #include "StegoStatus.h"
 #include "EdgeDetectionType.h"
+#include "bufferpool.h"
+#include "edgecache.h"
 #include <opencv2/core/mat.hpp>
 #include <opencv2/opencv.hpp>
 
@@ -10,21 +12,56 @@
 class EdgeDetection
 {
 public:
-    EdgeDetection();
+    explicit EdgeDetection(BufferPool* bufferPool = nullptr, EdgeCache* edgeCache = nullptr);
     StegoStatus DetectEdges(cv::Mat image, EdgeDetectionType edgeDetectionType);
+    StegoStatus DetectEdges(cv::Mat image, EdgeDetectionType edgeDetectionType, int firstRow, int numRows,
+                            int imageRow = 0);
+    StegoStatus BeginDetection(cv::Mat image, EdgeDetectionType edgeDetectionType);
+    int DetectRows(int numRows);
+    int NumDetectedRows() const;
+    bool IsComplete() const;
     cv::Mat GetMagnitudes() const;
 
+    // Rows of the image a Sobel magnitude depends on above and below it, 2 for the Gaussian and 1 for the Sobel kernel
+    static constexpr int SOBEL_HALO_ROWS = 3;
+    // Rows of Sobel magnitudes below a row Canny needs to finish it, 1 each for thinning, thresholding and hysteresis
+    static constexpr int CANNY_LAG_ROWS = 3;
+    // Side of the square blocks texture detection scores, a block is embeddable as a whole or not at all
+    static constexpr int TEXTURE_BLOCK_SIZE = 4;
+    // Smallest mean difference between the upper 6 bits of neighbouring samples of a textured block
+    static constexpr int TEXTURE_THRESHOLD = 8;
+    // Fewest pixels DetectRows runs the Sobel filters on at a time, so the halo rows stay a small overhead
+    static constexpr int MIN_DETECTION_PIXELS = 1 << 16;
+
 private:
+    BufferPool* bufferPool;
+    // Masks of images detected before, a miss detects the whole image so it can be stored
+    EdgeCache* edgeCache;
+
     cv::Mat magnitudes;
     cv::Mat angles;
     cv::Mat edgeStrengths;
 
-    StegoStatus canny(cv::Mat image);
-    StegoStatus sobel(cv::Mat image);
-    void calculatePixelMagnitudes(cv::Mat imageX, cv::Mat imageY);
-    void gradientMagnitude();
-    void thresholding();
-    void hysteresis();
+    // Image detected by DetectRows and the rows of it each stage has finished, from the top
+    cv::Mat image;
+    EdgeDetectionType edgeDetectionType = EdgeDetectionType::None;
+    int numSobelRows = 0;
+    int numSuppressedRows = 0;
+    int numThresholdedRows = 0;
+    int numDetectedRows = 0;
+    // Row the first texture block starts at, blocks line up with the whole image when detecting a strip of it
+    int firstBlockRow = 0;
+
+    void bind(cv::Mat& mat);
+    void reset(cv::Mat image, EdgeDetectionType edgeDetectionType);
+    void sobel(int firstRow, int endRow);
+    void calculatePixelMagnitudes(cv::Mat imageX, cv::Mat imageY, int firstRow);
+    void canny();
+    void texture(int endRow);
+    void textureBlockRow(int row);
+    void gradientMagnitude(int row);
+    void thresholding(int row);
+    void hysteresis(int row);
 };
 
 #endif // EDGEDETECTION_H
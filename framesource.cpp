@@ -0,0 +1,333 @@
+#include "framesource.h"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <utility>
+#ifdef __linux__
+#include <fcntl.h>
+#endif
+
+using namespace cv;
+
+FrameSource::FrameSource(FrameSourceType type, BufferPool* bufferPool, size_t numBufferedFrames)
+    : type(type)
+    , bufferPool(bufferPool)
+    , numBufferedFrames(std::max<size_t>(1, numBufferedFrames))
+{
+}
+
+FrameSource::~FrameSource()
+{
+    Release();
+}
+
+/**
+ * @brief FrameSource::Open Open the video at path, reading its frame rate, frame count and frame size.
+ * @return false if the video could not be opened, or for RawPipe if ffmpeg did not deliver a first frame
+ */
+bool FrameSource::Open(const std::string& path)
+{
+    Release();
+
+    this->path = path;
+    this->video.open(path);
+    if (!this->video.isOpened())
+    {
+        return false;
+    }
+
+    this->fps = this->video.get(CAP_PROP_FPS);
+    this->frameCount = this->video.get(CAP_PROP_FRAME_COUNT);
+    this->width = static_cast<int>(this->video.get(CAP_PROP_FRAME_WIDTH));
+    this->height = static_cast<int>(this->video.get(CAP_PROP_FRAME_HEIGHT));
+    if (this->type == FrameSourceType::VideoCapture)
+    {
+        return true;
+    }
+
+    // The capture only supplied the stream properties, the frames come from the pipe
+    this->video.release();
+    if (!openPipe(path))
+    {
+        Release();
+        return false;
+    }
+
+    return true;
+}
+
+bool FrameSource::IsOpened() const
+{
+    return this->type == FrameSourceType::VideoCapture ? this->video.isOpened() : this->pipe != nullptr;
+}
+
+/**
+ * @brief FrameSource::Read Move to the next frame. frame is replaced, not written to, so it may still be in use.
+ * @return false and an empty frame after the last frame
+ */
+bool FrameSource::Read(Mat& frame)
+{
+    if (this->type == FrameSourceType::VideoCapture)
+    {
+        return this->video.read(frame);
+    }
+
+    // Hand the previous frame's buffer back to the pool before waiting for the next one
+    frame.release();
+    if (this->pipe == nullptr)
+    {
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->frameAvailable.wait(lock, [this] { return !this->frames.empty() || this->bEndOfStream; });
+    if (this->frames.empty())
+    {
+        return false;
+    }
+
+    frame = std::move(this->frames.front());
+    this->frames.pop_front();
+    this->slotAvailable.notify_one();
+
+    return true;
+}
+
+/**
+ * @brief FrameSource::Seek Move to the frame at frameIndex, the next Read returns it. VideoCapture seeks the capture,
+ * RawPipe restarts ffmpeg at the frame's timestamp, which needs the constant frame rate of the stego videos.
+ * Frames read ahead are dropped.
+ * @return false if the video has no such frame
+ */
+bool FrameSource::Seek(size_t frameIndex)
+{
+    if (this->type == FrameSourceType::VideoCapture)
+    {
+        return this->video.set(CAP_PROP_POS_FRAMES, static_cast<double>(frameIndex));
+    }
+
+    if (this->pipe == nullptr)
+    {
+        return false;
+    }
+
+    Release();
+    if (!openPipe(this->path, frameIndex))
+    {
+        Release();
+        return false;
+    }
+
+    return true;
+}
+
+FrameSource& FrameSource::operator>>(Mat& frame)
+{
+    Read(frame);
+    return *this;
+}
+
+/**
+ * @brief FrameSource::Release Close the video. Frames read so far stay valid, frames read ahead are dropped.
+ */
+void FrameSource::Release()
+{
+    this->video.release();
+    if (this->pipe != nullptr)
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->bStopping = true;
+        }
+
+        this->slotAvailable.notify_all();
+        this->reader.join();
+
+        // ffmpeg stops with a broken pipe once the read end is closed if not every frame was read
+#ifdef _WIN32
+        _pclose(this->pipe);
+#else
+        pclose(this->pipe);
+#endif
+        this->pipe = nullptr;
+    }
+
+    this->frames.clear();
+    this->bEndOfStream = false;
+    this->bStopping = false;
+}
+
+double FrameSource::FPS() const
+{
+    return this->fps;
+}
+
+/**
+ * @brief FrameSource::FrameCount Frame count the container reports, which may be an estimate.
+ */
+double FrameSource::FrameCount() const
+{
+    return this->frameCount;
+}
+
+bool FrameSource::ParseType(const std::string& name, FrameSourceType& type)
+{
+    if (name == "VideoCapture")
+    {
+        type = FrameSourceType::VideoCapture;
+    }
+    else if (name == "RawPipe")
+    {
+        type = FrameSourceType::RawPipe;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+std::string FrameSource::TypeName(FrameSourceType type)
+{
+    switch (type)
+    {
+    case FrameSourceType::VideoCapture: return "VideoCapture";
+    case FrameSourceType::RawPipe: return "RawPipe";
+    }
+
+    return "Unknown";
+}
+
+/**
+ * @brief quoteShellArgument Quote an argument for the shell popen runs, so that the shell passes it on as it is.
+ * POSIX shells expand nothing between single quotes, an embedded single quote ends the quotes, is escaped and opens
+ * them again. cmd.exe expands %VAR% even between double quotes, and '"' can not be part of a Windows file name, so
+ * arguments holding either are refused there.
+ * @return false if the argument can not be quoted
+ */
+bool quoteShellArgument(const std::string& argument, std::string& quoted)
+{
+#ifdef _WIN32
+    if (argument.find_first_of("\"%") != std::string::npos)
+    {
+        return false;
+    }
+
+    quoted = "\"" + argument + "\"";
+#else
+    quoted = "'";
+    for (char c : argument)
+    {
+        if (c == '\'')
+        {
+            quoted += "'\\''";
+        }
+        else
+        {
+            quoted += c;
+        }
+    }
+
+    quoted += "'";
+#endif
+
+    return true;
+}
+
+bool FrameSource::openPipe(const std::string& path, size_t startFrame)
+{
+    if (this->width <= 0 || this->height <= 0)
+    {
+        return false;
+    }
+
+    // The path comes from manifests and directory scans, the shell must never see it unquoted. The file: protocol
+    // keeps ffmpeg from reading a name such as "concat:a|b" as a protocol of its own
+    std::string input;
+    if (!quoteShellArgument("file:" + path, input))
+    {
+        return false;
+    }
+
+    // Every decoded frame is passed through as it is, and converted to BGR with the scaler settings OpenCV uses.
+    // Seeking starts half a frame early, so the decoder drops the frames before startFrame however the time rounds.
+    std::ostringstream command;
+    command << "ffmpeg -nostdin -loglevel error ";
+    if (startFrame > 0)
+    {
+        if (this->fps <= 0)
+        {
+            return false;
+        }
+
+        command << "-ss " << std::fixed << std::setprecision(6) << (startFrame - 0.5) / this->fps << " ";
+    }
+
+    command << "-i " << input << " -map 0:v:0 -an -sn -dn -fps_mode passthrough "
+            << "-vf scale=flags=bicubic:in_color_matrix=bt601 -pix_fmt bgr24 -f rawvideo -";
+
+#ifdef _WIN32
+    this->pipe = _popen(command.str().c_str(), "rb");
+#else
+    this->pipe = popen(command.str().c_str(), "r");
+#endif
+    if (this->pipe == nullptr)
+    {
+        return false;
+    }
+
+    // Unbuffered, so every fread is a read() of up to a whole frame straight into the frame's buffer
+    std::setvbuf(this->pipe, nullptr, _IONBF, 0);
+#ifdef __linux__
+    // A larger pipe lets ffmpeg run further ahead of the reads than the default 64 KiB
+    fcntl(fileno(this->pipe), F_SETPIPE_SZ, PIPE_BYTES);
+#endif
+
+    this->reader = std::thread(&FrameSource::readerLoop, this);
+
+    // ffmpeg missing or unable to decode the video shows as a stream without frames
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->frameAvailable.wait(lock, [this] { return !this->frames.empty() || this->bEndOfStream; });
+
+    return !this->frames.empty();
+}
+
+void FrameSource::readerLoop()
+{
+    size_t frameBytes = static_cast<size_t>(this->width) * this->height * 3;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->slotAvailable.wait(lock, [this] {
+                return this->bStopping || this->frames.size() < this->numBufferedFrames;
+            });
+
+            if (this->bStopping)
+            {
+                return;
+            }
+        }
+
+        Mat frame;
+        if (this->bufferPool != nullptr)
+        {
+            this->bufferPool->Bind(frame);
+        }
+
+        frame.create(this->height, this->width, CV_8UC3);
+        size_t bytesRead = std::fread(frame.data, 1, frameBytes, this->pipe);
+
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (bytesRead < frameBytes)
+        {
+            this->bEndOfStream = true;
+            this->frameAvailable.notify_all();
+            return;
+        }
+
+        this->frames.push_back(std::move(frame));
+        this->frameAvailable.notify_all();
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef FRAMESOURCE_H
+#define FRAMESOURCE_H
+
+#include "bufferpool.h"
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <opencv2/core/mat.hpp>
+#include <opencv2/videoio.hpp>
+
+enum class FrameSourceType {
+    VideoCapture,
+    RawPipe
+};
+
+/**
+ * Reads the frames of a video as 8-bit BGR Mats, the same frames in the same order for every type.
+ * VideoCapture decodes with whatever backend OpenCV picks, one frame per call. RawPipe runs a single ffmpeg process
+ * that writes raw BGR frames to a pipe, a reader thread fills up to numBufferedFrames frames ahead with large reads
+ * into pooled buffers, so the next frames are decoded while the caller embeds in the current one.
+ */
+class FrameSource
+{
+public:
+    explicit FrameSource(FrameSourceType type = FrameSourceType::VideoCapture, BufferPool* bufferPool = nullptr,
+                         size_t numBufferedFrames = DEFAULT_BUFFERED_FRAMES);
+    ~FrameSource();
+
+    FrameSource(const FrameSource&) = delete;
+    FrameSource& operator=(const FrameSource&) = delete;
+
+    bool Open(const std::string& path);
+    bool IsOpened() const;
+    bool Read(cv::Mat& frame);
+    bool Seek(size_t frameIndex);
+    FrameSource& operator>>(cv::Mat& frame);
+    void Release();
+
+    double FPS() const;
+    double FrameCount() const;
+
+    static bool ParseType(const std::string& name, FrameSourceType& type);
+    static std::string TypeName(FrameSourceType type);
+
+    static constexpr size_t DEFAULT_BUFFERED_FRAMES = 4;
+    static constexpr int PIPE_BYTES = 1 << 20;
+
+private:
+    FrameSourceType type;
+    BufferPool* bufferPool;
+    size_t numBufferedFrames;
+    std::string path;
+
+    cv::VideoCapture video;
+    double fps = 0;
+    double frameCount = 0;
+    int width = 0;
+    int height = 0;
+
+    FILE* pipe = nullptr;
+    std::thread reader;
+    std::mutex mutex;
+    std::condition_variable frameAvailable;
+    std::condition_variable slotAvailable;
+    std::deque<cv::Mat> frames;
+    bool bEndOfStream = false;
+    bool bStopping = false;
+
+    bool openPipe(const std::string& path, size_t startFrame = 0);
+    void readerLoop();
+};
+
+#endif // FRAMESOURCE_H
@@ -0,0 +1,500 @@
+#include "jobscheduler.h"
+#include "stego.h"
+#include "stegocapacity.h"
+#include "stegoplanner.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <mutex>
+#include <numeric>
+#include <sstream>
+
+// Cost of a decode relative to an encode in the same mode
+const double DECODE_COST_FACTOR = 0.5;
+
+/**
+ * @brief jobFrameSourceType Frame source a job names. Unknown names read with VideoCapture, the frames are the same.
+ */
+FrameSourceType jobFrameSourceType(const std::string& name)
+{
+    FrameSourceType type = FrameSourceType::VideoCapture;
+    FrameSource::ParseType(name, type);
+
+    return type;
+}
+
+/**
+ * @brief isAutoJob Whether a job leaves its algorithm or edge detection to the planner.
+ */
+bool isAutoJob(const StegoJob& job)
+{
+    return job.algo == StegoPlanner::AUTO || job.edgeDetection == StegoPlanner::AUTO;
+}
+
+/**
+ * @brief jobPlanConstraints Modes a job allows, every mode for "Auto" and the mode it names otherwise.
+ * @return false if the job names an unknown algorithm or edge detection
+ */
+bool jobPlanConstraints(const StegoJob& job, StegoPlanConstraints& constraints)
+{
+    constraints.bRequireEdgeDetection = job.bRequireEdgeDetection;
+    constraints.maxFill = job.maxFill;
+    constraints.lsbBits = job.lsbBits;
+    if (job.algo != StegoPlanner::AUTO)
+    {
+        StegoAlgo algo;
+        if (!StegoPlanner::ParseAlgo(job.algo, algo))
+        {
+            return false;
+        }
+
+        constraints.algos = {algo};
+    }
+
+    if (job.edgeDetection != StegoPlanner::AUTO)
+    {
+        EdgeDetectionType edgeDetectionType;
+        if (!StegoPlanner::ParseEdgeDetection(job.edgeDetection, edgeDetectionType))
+        {
+            return false;
+        }
+
+        constraints.edgeDetectionTypes = {edgeDetectionType};
+    }
+
+    return true;
+}
+
+/**
+ * @brief jobCostModel Cost model kept in costModelPath, the defaults if the path is empty. A missing model is
+ * calibrated and saved by the first job asking for it, the other jobs of the batch wait and load it.
+ */
+StegoCostModel jobCostModel(const std::string& costModelPath)
+{
+    static std::mutex calibrationMutex;
+
+    StegoCostModel costModel;
+    if (costModelPath.empty())
+    {
+        return costModel;
+    }
+
+    std::lock_guard<std::mutex> lock(calibrationMutex);
+    if (!costModel.Load(costModelPath))
+    {
+        costModel.Calibrate();
+        costModel.Save(costModelPath);
+    }
+
+    return costModel;
+}
+
+JobScheduler::JobScheduler(std::string outputRoot, size_t numWorkers)
+    : outputRoot(outputRoot)
+    , numWorkers(numWorkers)
+{
+    if (this->numWorkers == 0)
+    {
+        this->numWorkers = std::max(1u, std::thread::hardware_concurrency());
+    }
+}
+
+bool JobScheduler::IsVideo(const std::string& mediaPath)
+{
+    return std::filesystem::path(mediaPath).extension() == ".mkv";
+}
+
+/**
+ * @brief JobScheduler::EstimateCost Estimate the relative run time of a job from the size of its carrier.
+ * Cost is pixel count x frames x the seconds per pixel of the mode in the job's cost model, see StegoCostModel.
+ * A sharded job costs the sum of its media.
+ */
+double JobScheduler::EstimateCost(const StegoJob& job)
+{
+    if (!job.shardMediaPaths.empty())
+    {
+        StegoJob shardJob = job;
+        shardJob.shardMediaPaths.clear();
+        double cost = 0;
+        for (const std::string& mediaPath : job.shardMediaPaths)
+        {
+            shardJob.mediaPath = mediaPath;
+            cost += EstimateCost(shardJob);
+        }
+
+        return cost;
+    }
+
+    double pixels = 0;
+    double frames = 1;
+    if (IsVideo(job.mediaPath))
+    {
+        cv::VideoCapture video(job.mediaPath);
+        if (video.isOpened())
+        {
+            pixels = video.get(cv::CAP_PROP_FRAME_WIDTH) * video.get(cv::CAP_PROP_FRAME_HEIGHT);
+            frames = std::max(1.0, video.get(cv::CAP_PROP_FRAME_COUNT));
+        }
+    }
+    else
+    {
+        pixels = StegoCapacity::ReadPngPixelCount(job.mediaPath);
+    }
+
+    // Unknown dimensions, fall back to the size of the file
+    if (pixels == 0)
+    {
+        std::error_code error;
+        pixels = std::filesystem::file_size(job.mediaPath, error);
+        if (error)
+        {
+            pixels = 1;
+        }
+    }
+
+    // Decodes and jobs naming an unknown mode cost like LSB without edge detection, "Auto" encodes like the fastest
+    // mode they allow, which they get whenever it holds the file
+    StegoCostModel costModel = jobCostModel(job.costModelPath);
+    StegoPlanConstraints constraints;
+    double secondsPerPixel = std::numeric_limits<double>::max();
+    if (jobPlanConstraints(job, constraints))
+    {
+        for (StegoAlgo algo : constraints.algos)
+        {
+            for (EdgeDetectionType edgeDetectionType : constraints.edgeDetectionTypes)
+            {
+                if (!constraints.bRequireEdgeDetection || edgeDetectionType != EdgeDetectionType::None)
+                {
+                    secondsPerPixel = std::min(secondsPerPixel, costModel.SecondsPerPixel(algo, edgeDetectionType));
+                }
+            }
+        }
+    }
+
+    if (secondsPerPixel == std::numeric_limits<double>::max())
+    {
+        secondsPerPixel = costModel.SecondsPerPixel(StegoAlgo::LSB, EdgeDetectionType::None);
+    }
+
+    double cost = pixels * frames * secondsPerPixel;
+    if (job.type == StegoJobType::Decode)
+    {
+        cost *= DECODE_COST_FACTOR;
+    }
+
+    return cost;
+}
+
+/**
+ * @brief JobScheduler::planJob Replace "Auto" in the algorithm and edge detection of an encode by the fastest mode
+ * that holds its file, see StegoPlanner.
+ * @param embedSize Set to the most room any allowed mode has when none holds the file
+ * @return StegoStatus::FILE_TOO_LARGE if no allowed mode holds the file, StegoStatus::INVALID_MEDIA if the job names
+ * an unknown mode, the status of reading the media otherwise
+ */
+StegoStatus JobScheduler::planJob(StegoJob& job, uint64_t& embedSize)
+{
+    StegoPlanConstraints constraints;
+    if (!jobPlanConstraints(job, constraints))
+    {
+        return StegoStatus::INVALID_MEDIA;
+    }
+
+    std::unique_ptr<EdgeCache> edgeCache;
+    StegoPlanner planner(jobCostModel(job.costModelPath));
+    if (!job.edgeCacheDirectory.empty())
+    {
+        edgeCache = std::make_unique<EdgeCache>(job.edgeCacheDirectory, job.edgeCacheBudget);
+        planner.SetEdgeCache(edgeCache.get());
+    }
+
+    bool bShards = !job.shardMediaPaths.empty();
+    std::vector<std::string> mediaPaths = bShards ? job.shardMediaPaths : std::vector<std::string>{job.mediaPath};
+    StegoPlanOption chosen;
+    StegoStatus status = planner.PlanEncode(job.filePath, mediaPaths, bShards, job.bEncrypt, constraints, chosen);
+    if (status == StegoStatus::SUCCESS)
+    {
+        job.algo = StegoPlanner::AlgoName(chosen.algo);
+        job.edgeDetection = StegoPlanner::EdgeDetectionName(chosen.edgeDetectionType);
+    }
+    else if (status == StegoStatus::FILE_TOO_LARGE)
+    {
+        embedSize = chosen.capacity;
+    }
+
+    return status;
+}
+
+/**
+ * @brief JobScheduler::RunJob Run a single job with all of its files created under workingDirectory.
+ * An exception thrown by the job fails only that job: filesystem errors report FILE_OPEN_FAILED, OpenCV errors on
+ * an unreadable carrier INVALID_MEDIA and anything else, e.g. running out of memory, UNEXPECTED_ERROR.
+ * @param bufferPool Pool for the job's frame buffers, nullptr gives the job a pool of its own
+ */
+StegoJobResult JobScheduler::RunJob(const StegoJob& job, const std::filesystem::path& workingDirectory,
+                                    std::shared_ptr<BufferPool> bufferPool)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    StegoJobResult result;
+    try
+    {
+        return runJob(job, workingDirectory, bufferPool);
+    }
+    catch (const std::filesystem::filesystem_error&)
+    {
+        result.status = StegoStatus::FILE_OPEN_FAILED;
+    }
+    catch (const cv::Exception&)
+    {
+        result.status = StegoStatus::INVALID_MEDIA;
+    }
+    catch (const std::exception&)
+    {
+        result.status = StegoStatus::UNEXPECTED_ERROR;
+    }
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return result;
+}
+
+StegoJobResult JobScheduler::runJob(const StegoJob& job, const std::filesystem::path& workingDirectory,
+                                    std::shared_ptr<BufferPool> bufferPool)
+{
+    StegoJobResult result;
+    auto start = std::chrono::steady_clock::now();
+
+    if (job.type == StegoJobType::Encode && isAutoJob(job))
+    {
+        StegoJob plannedJob = job;
+        result.status = planJob(plannedJob, result.embedSize);
+        if (result.status == StegoStatus::SUCCESS)
+        {
+            result = runJob(plannedJob, workingDirectory, bufferPool);
+        }
+
+        result.algo = plannedJob.algo;
+        result.edgeDetection = plannedJob.edgeDetection;
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        return result;
+    }
+
+    // An update embeds a new file in a stego medium in place of its payload, with the mode in its header
+    if (job.type == StegoJobType::Encode || job.type == StegoJobType::Update)
+    {
+        Stego stego(job.filePath, job.mediaPath, job.algo, job.edgeDetection, job.bEncrypt, job.password);
+        stego.SetWorkingDirectory(workingDirectory.string());
+        stego.SetCompression(job.bCompress);
+        stego.SetStripBudget(job.stripBudget);
+        VideoCodec videoCodec = VideoCodec::FFV1;
+        if (!VideoBackend::ParseCodec(job.videoCodec, videoCodec))
+        {
+            result.status = StegoStatus::VIDEO_REENCODING_FAILED;
+        }
+
+        stego.SetVideoBackend(VideoBackend(videoCodec, job.videoThreads, job.videoSlices));
+        stego.SetFrameSource(jobFrameSourceType(job.frameSource));
+        stego.SetCheckpointInterval(job.checkpointFrames);
+        stego.SetLsbBits(job.lsbBits);
+        if (bufferPool)
+        {
+            stego.SetBufferPool(bufferPool);
+        }
+
+        if (!job.edgeCacheDirectory.empty())
+        {
+            stego.SetEdgeCache(std::make_shared<EdgeCache>(job.edgeCacheDirectory, job.edgeCacheBudget));
+        }
+
+        std::error_code error;
+        result.payloadBytes = std::filesystem::file_size(job.filePath, error);
+
+        if (result.status == StegoStatus::SUCCESS && job.bEncrypt)
+        {
+            result.status = stego.EncryptFile();
+        }
+
+        if (result.status == StegoStatus::SUCCESS && job.type == StegoJobType::Update)
+        {
+            result.status = IsVideo(job.mediaPath) ? stego.UpdateVideo() : stego.UpdateImage();
+        }
+        else if (result.status == StegoStatus::SUCCESS && !job.shardMediaPaths.empty())
+        {
+            result.status = stego.EncodeShards(job.shardMediaPaths);
+        }
+        else if (result.status == StegoStatus::SUCCESS)
+        {
+            result.status = IsVideo(job.mediaPath) ? stego.EncodeVideo() : stego.EncodeImage();
+        }
+
+        result.embedSize = stego.GetEmbedSize();
+        result.outputPath = stego.GetOutputPath();
+        result.algo = job.algo;
+        result.edgeDetection = job.edgeDetection;
+    }
+    else if (job.type == StegoJobType::Decode)
+    {
+        Stego stego(job.mediaPath, job.bEncrypt, job.password);
+        stego.SetWorkingDirectory(workingDirectory.string());
+        stego.SetFrameSource(jobFrameSourceType(job.frameSource));
+        if (bufferPool)
+        {
+            stego.SetBufferPool(bufferPool);
+        }
+
+        if (!job.edgeCacheDirectory.empty())
+        {
+            stego.SetEdgeCache(std::make_shared<EdgeCache>(job.edgeCacheDirectory, job.edgeCacheBudget));
+        }
+
+        if (!job.shardMediaPaths.empty())
+        {
+            result.status = stego.DecodeShards(job.shardMediaPaths);
+            if (result.status == StegoStatus::SUCCESS && job.bEncrypt)
+            {
+                result.status = stego.DecryptFile();
+            }
+        }
+        else if (!job.member.empty())
+        {
+            result.status = stego.ExtractMember(job.member);
+        }
+        else if (job.rangeLength > 0)
+        {
+            result.status = stego.ExtractRange(job.rangeOffset, job.rangeLength);
+        }
+        else
+        {
+            result.status = IsVideo(job.mediaPath) ? stego.DecodeVideo() : stego.DecodeImage();
+            if (result.status == StegoStatus::SUCCESS && job.bEncrypt)
+            {
+                result.status = stego.DecryptFile();
+            }
+        }
+
+        result.outputPath = stego.GetOutputPath();
+        if (result.status == StegoStatus::SUCCESS)
+        {
+            std::error_code error;
+            result.payloadBytes = std::filesystem::file_size(result.outputPath, error);
+        }
+    }
+    else if (job.type == StegoJobType::Capacity)
+    {
+        Stego stego("", job.mediaPath, job.algo, job.edgeDetection, false, "");
+        stego.SetWorkingDirectory(workingDirectory.string());
+        stego.SetLsbBits(job.lsbBits);
+        if (bufferPool)
+        {
+            stego.SetBufferPool(bufferPool);
+        }
+
+        if (!job.edgeCacheDirectory.empty())
+        {
+            stego.SetEdgeCache(std::make_shared<EdgeCache>(job.edgeCacheDirectory, job.edgeCacheBudget));
+        }
+
+        result.status = stego.CalculateCapacity();
+        result.embedSize = stego.GetEmbedSize();
+        result.algo = job.algo;
+        result.edgeDetection = job.edgeDetection;
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    result.seconds = std::chrono::duration<double>(end - start).count();
+
+    return result;
+}
+
+/**
+ * @brief JobScheduler::Run Run every job and wait for them to finish.
+ * Jobs are sorted by estimated cost and dealt out largest first, so the most expensive carriers start early
+ * and idle workers steal the small jobs left at the end of the other queues.
+ * @param results Result of each job, in the same order as jobs
+ * @return Throughput of the whole batch
+ */
+ThroughputReport JobScheduler::Run(const std::vector<StegoJob>& jobs, std::vector<StegoJobResult>& results)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    results.assign(jobs.size(), StegoJobResult());
+    std::vector<double> costs(jobs.size());
+    std::vector<size_t> order(jobs.size());
+    std::iota(order.begin(), order.end(), 0);
+
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        costs[i] = EstimateCost(jobs[i]);
+    }
+
+    std::sort(order.begin(), order.end(), [&costs](size_t a, size_t b) { return costs[a] > costs[b]; });
+
+    {
+        WorkStealingThreadPool pool(std::min(this->numWorkers, std::max<size_t>(1, jobs.size())));
+
+        // One buffer pool per worker, jobs on the same worker run one after another and recycle its buffers
+        std::vector<std::shared_ptr<BufferPool>> bufferPools;
+        for (size_t worker = 0; worker < pool.NumThreads(); worker++)
+        {
+            bufferPools.push_back(std::make_shared<BufferPool>());
+        }
+
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            size_t jobIndex = order[i];
+            std::ostringstream jobDirectoryName;
+            jobDirectoryName << "job_" << std::setw(6) << std::setfill('0') << jobIndex;
+            std::filesystem::path jobDirectory = this->outputRoot / jobDirectoryName.str();
+
+            pool.Submit([&jobs, &results, &costs, &bufferPools, jobIndex, jobDirectory]() {
+                std::error_code error;
+                std::filesystem::create_directories(jobDirectory, error);
+
+                size_t worker = WorkStealingThreadPool::CurrentWorker();
+                StegoJobResult result = RunJob(jobs[jobIndex], jobDirectory, bufferPools[worker]);
+                result.estimatedCost = costs[jobIndex];
+                result.worker = worker;
+                results[jobIndex] = result;
+            }, i);
+        }
+
+        pool.Wait();
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    ThroughputReport report;
+    report.numJobs = jobs.size();
+    report.numWorkers = std::min(this->numWorkers, std::max<size_t>(1, jobs.size()));
+    report.wallSeconds = std::chrono::duration<double>(end - start).count();
+
+    uint64_t payloadBytes = 0;
+    for (const StegoJobResult& result : results)
+    {
+        if (result.status == StegoStatus::SUCCESS)
+        {
+            report.numSucceeded++;
+            payloadBytes += result.payloadBytes;
+        }
+        else
+        {
+            report.numFailed++;
+        }
+
+        report.busySeconds += result.seconds;
+    }
+
+    if (report.wallSeconds > 0)
+    {
+        report.utilisation = report.busySeconds / (report.wallSeconds * report.numWorkers);
+        report.jobsPerSecond = report.numJobs / report.wallSeconds;
+        report.payloadBytesPerSecond = payloadBytes / report.wallSeconds;
+    }
+
+    return report;
+}
@@ -0,0 +1,115 @@
+#ifndef JOBSCHEDULER_H
+#define JOBSCHEDULER_H
+
+#include "StegoStatus.h"
+#include "bufferpool.h"
+#include "videobackend.h"
+#include "framesource.h"
+#include "edgecache.h"
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+enum class StegoJobType {
+    Encode,
+    Decode,
+    Capacity,
+    Update
+};
+
+struct StegoJob
+{
+    StegoJobType type = StegoJobType::Encode;
+    std::string filePath;
+    std::string mediaPath;
+    // "Auto" for either lets an encode pick the fastest mode that holds the file, see StegoPlanner
+    std::string algo = "LSB";
+    std::string edgeDetection = "None";
+    bool bEncrypt = false;
+    std::string password;
+    bool bCompress = false;
+    // Bytes of the carrier an image encode holds at once, 0 loads the whole carrier, see Stego::SetStripBudget
+    size_t stripBudget = 0;
+    // Lossless codec of the stego video, see VideoBackend::ParseCodec for the names
+    std::string videoCodec = "FFV1";
+    // Encoder threads of the stego video, 0 uses one per core
+    int videoThreads = 0;
+    int videoSlices = VideoBackend::DEFAULT_FFV1_SLICES;
+    // How video frames are read, see FrameSource::ParseType for the names
+    std::string frameSource = "VideoCapture";
+    // Frames between the checkpoints of a video encode, 0 disables them, see Stego::SetCheckpointInterval
+    size_t checkpointFrames = 0;
+    // Least significant bits of each sample LSB embeds in, see Stego::SetLsbBits
+    size_t lsbBits = 1;
+    // Member of an archive payload a decode extracts on its own, empty decodes the whole payload
+    std::string member;
+    // Bytes of the payload a decode extracts from rangeOffset on, 0 decodes the whole payload, see Stego::ExtractRange
+    uint64_t rangeOffset = 0;
+    uint64_t rangeLength = 0;
+    // Media the payload is split across instead of mediaPath, see Stego::EncodeShards
+    std::vector<std::string> shardMediaPaths;
+    // Directory of the edge masks shared by jobs on the same carriers, empty detects every carrier, see EdgeCache
+    std::string edgeCacheDirectory;
+    uint64_t edgeCacheBudget = EdgeCache::DEFAULT_MAX_BYTES;
+    // Constraints of an "Auto" encode, see StegoPlanConstraints
+    bool bRequireEdgeDetection = false;
+    double maxFill = 1.0;
+    // File the planner's cost model is kept in, calibrated and saved there if missing. Empty uses the defaults
+    std::string costModelPath;
+};
+
+struct StegoJobResult
+{
+    StegoStatus status = StegoStatus::SUCCESS;
+    std::string outputPath;
+    // Mode an encode or capacity job ran with, the mode planned for an "Auto" encode
+    std::string algo;
+    std::string edgeDetection;
+    uint64_t embedSize = 0;
+    uint64_t payloadBytes = 0;
+    double estimatedCost = 0;
+    double seconds = 0;
+    size_t worker = 0;
+};
+
+struct ThroughputReport
+{
+    size_t numJobs = 0;
+    size_t numSucceeded = 0;
+    size_t numFailed = 0;
+    size_t numWorkers = 0;
+    double wallSeconds = 0;
+    double busySeconds = 0;
+    double utilisation = 0;
+    double jobsPerSecond = 0;
+    double payloadBytesPerSecond = 0;
+};
+
+/**
+ * Runs batches of stego jobs concurrently on a work stealing thread pool.
+ * Every job works in its own directory under the output root so jobs never share temp or output files.
+ */
+class JobScheduler
+{
+public:
+    JobScheduler(std::string outputRoot, size_t numWorkers = 0);
+
+    ThroughputReport Run(const std::vector<StegoJob>& jobs, std::vector<StegoJobResult>& results);
+
+    static StegoJobResult RunJob(const StegoJob& job, const std::filesystem::path& workingDirectory,
+                                 std::shared_ptr<BufferPool> bufferPool = nullptr);
+    static double EstimateCost(const StegoJob& job);
+    static bool IsVideo(const std::string& mediaPath);
+
+private:
+    std::filesystem::path outputRoot;
+    size_t numWorkers;
+
+    static StegoStatus planJob(StegoJob& job, uint64_t& embedSize);
+    static StegoJobResult runJob(const StegoJob& job, const std::filesystem::path& workingDirectory,
+                                 std::shared_ptr<BufferPool> bufferPool);
+};
+
+#endif // JOBSCHEDULER_H
@@ -1,14 +1,21 @@
 #include "mainwindow.h"
 #include "./ui_mainwindow.h"
 #include "stego.h"
+#include "stegoplanner.h"
+#include <QDir>
 #include <QFileDialog>
 #include <QMessageBox>
 #include <QProgressDialog>
+#include <QStandardPaths>
 #include <QTimer>
+#include <QtConcurrent/QtConcurrent>
 #include <QtQuick/QQuickView>
 #include <QUrl>
 #include <QDesktopServices>
 
+// Costs of the modes measured after the first encode with an Auto mode, in the application data directory
+const QString COST_MODEL_FILE_NAME = "stego_cost_model.txt";
+
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
@@ -16,6 +23,13 @@ MainWindow::MainWindow(QWidget *parent)
 {
     ui->setupUi(this);
     setupClickedEvents();
+
+    bCostModelCalibrated = costModel.Load(costModelPath().toStdString());
+    connect(&calibrationWatcher, &QFutureWatcher<StegoCostModel>::finished, this, [this]() {
+        costModel = calibrationWatcher.result();
+        bCostModelCalibrated = true;
+        costModel.Save(costModelPath().toStdString());
+    });
 }
 
 MainWindow::~MainWindow()
@@ -23,6 +37,36 @@ MainWindow::~MainWindow()
     delete ui;
 }
 
+/**
+ * @brief MainWindow::costModelPath File the calibrated cost model is kept in, created with its directory as needed.
+ */
+QString MainWindow::costModelPath()
+{
+    QString directory = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    QDir().mkpath(directory);
+
+    return QDir(directory).filePath(COST_MODEL_FILE_NAME);
+}
+
+/**
+ * @brief MainWindow::calibrateCostModel Measure the cost model on a worker thread, it takes a timed encode with every
+ * mode. Plans keep using the default factors until it is done, then use the measured costs, which are saved for
+ * later runs.
+ */
+void MainWindow::calibrateCostModel()
+{
+    if (bCostModelCalibrated || calibrationWatcher.isRunning())
+    {
+        return;
+    }
+
+    calibrationWatcher.setFuture(QtConcurrent::run([]() {
+        StegoCostModel calibratedModel;
+        calibratedModel.Calibrate();
+        return calibratedModel;
+    }));
+}
+
 void MainWindow::setupClickedEvents()
 {
     connect(ui->encodeSelectFileButton, &QPushButton::clicked, this, &MainWindow::onEncodeSelectFileButtonClicked);
@@ -115,7 +159,53 @@ void MainWindow::onEncodeGoButtonClicked()
     std::string stegoAlgo = ui->encodeStegoAlgoComboBox->currentText().toStdString();
     std::string edgeDetection = ui->encodeEdgeDetectionComboBox->currentText().toStdString();
 
+    if (stegoAlgo == StegoPlanner::AUTO || edgeDetection == StegoPlanner::AUTO)
+    {
+        StegoPlanConstraints constraints;
+        StegoAlgo algo;
+        EdgeDetectionType edgeDetectionType;
+        if (StegoPlanner::ParseAlgo(stegoAlgo, algo))
+        {
+            constraints.algos = {algo};
+        }
+
+        if (StegoPlanner::ParseEdgeDetection(edgeDetection, edgeDetectionType))
+        {
+            constraints.edgeDetectionTypes = {edgeDetectionType};
+        }
+
+        calibrateCostModel();
+
+        StegoPlanOption chosen;
+        StegoStatus planStatus = StegoPlanner(costModel).PlanEncode(filePath.toStdString(), {mediaPath.toStdString()},
+                                                                    false, bEncryption, constraints, chosen);
+        if (planStatus == StegoStatus::FILE_TOO_LARGE)
+        {
+            std::ostringstream fileSizeErrorStr;
+            fileSizeErrorStr.imbue(std::locale(""));
+            fileSizeErrorStr << "File is too large to encode. Max size for current media in any mode is " << chosen.capacity << " bytes.";
+            messageBox.setText(QString::fromStdString(fileSizeErrorStr.str()));
+            messageBox.exec();
+            return;
+        }
+        else if (planStatus != StegoStatus::SUCCESS)
+        {
+            messageBox.setText("Failed to open media for encoding.");
+            messageBox.exec();
+            return;
+        }
+
+        stegoAlgo = StegoPlanner::AlgoName(chosen.algo);
+        edgeDetection = StegoPlanner::EdgeDetectionName(chosen.edgeDetectionType);
+    }
+
     Stego stego(filePath.toStdString(), mediaPath.toStdString(), stegoAlgo, edgeDetection, bEncryption, password);
+    stego.SetCompression(ui->encodeCompressionCheckbox->isChecked());
+    if (ui->encodeCheckpointCheckbox->isChecked())
+    {
+        // Closing the window during a long video encode loses nothing, encoding the same file again resumes it
+        stego.SetCheckpointInterval(DEFAULT_CHECKPOINT_FRAMES);
+    }
 
     StegoStatus status = StegoStatus::SUCCESS;
 
@@ -192,7 +282,7 @@ void MainWindow::onEncodeGoButtonClicked()
     {
         std::ostringstream fileSizeErrorStr;
         fileSizeErrorStr.imbue(std::locale(""));
-        fileSizeErrorStr << "File is too large to encode. Max size for current media and algorithms is " << stego.embedSize << " bytes.";
+        fileSizeErrorStr << "File is too large to encode. Max size for current media and algorithms is " << stego.GetEmbedSize() << " bytes.";
         messageBox.setText(QString::fromStdString(fileSizeErrorStr.str()));
         messageBox.exec();
         return;
@@ -299,6 +389,12 @@ void MainWindow::onDecodeGoButtonClicked()
         messageBox.exec();
         return;
     }
+    else if (status == StegoStatus::DECOMPRESSION_FAILED)
+    {
+        messageBox.setText("Failed to decompress file from media. The media may be damaged.");
+        messageBox.exec();
+        return;
+    }
 
     if (bEncryption)
     {
@@ -317,6 +413,12 @@ void MainWindow::onDecodeGoButtonClicked()
         messageBox.exec();
         return;
     }
+    else if (status == StegoStatus::DECOMPRESSION_FAILED)
+    {
+        messageBox.setText("Failed to decompress file after decryption. The media may be damaged.");
+        messageBox.exec();
+        return;
+    }
     else if (status == StegoStatus::SUCCESS)
     {
         messageBox.setText("File Decoded!");
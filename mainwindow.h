@@ -2,7 +2,9 @@
 #define MAINWINDOW_H
 
 #include "stegoapiclient.h"
+#include "stegoplanner.h"
 
+#include <QFutureWatcher>
 #include <QListWidgetItem>
 #include <QMainWindow>
 
@@ -35,6 +37,13 @@ private:
     Ui::MainWindow *ui;
     StegoApiClient apiClient;
 
+    // Costs the Auto modes are planned with, the default factors until a calibration on this machine has finished
+    StegoCostModel costModel;
+    bool bCostModelCalibrated = false;
+    QFutureWatcher<StegoCostModel> calibrationWatcher;
+
     void setupClickedEvents();
+    void calibrateCostModel();
+    static QString costModelPath();
 };
 #endif // MAINWINDOW_H
@@ -0,0 +1,398 @@
+#include "pngstrips.h"
+#include <algorithm>
+#include <csetjmp>
+
+// libpng reports errors by calling these and jumping back to the setjmp of the failing call, the functions calling
+// setjmp below only hold values that need no destructor. Errors are reported through StegoStatus, not printed.
+static void pngError(png_structp png, png_const_charp /*message*/)
+{
+    png_longjmp(png, 1);
+}
+
+static void pngWarning(png_structp /*png*/, png_const_charp /*message*/)
+{
+}
+
+PngStripReader::~PngStripReader()
+{
+    close();
+}
+
+/**
+ * @brief PngStripReader::Open Open path and read the png header, no rows are decoded yet.
+ * @return StegoStatus::IMAGE_NOT_FOUND if the file could not be opened, StegoStatus::INVALID_MEDIA if it is not
+ * a png or is interlaced, StegoStatus::SUCCESS otherwise
+ */
+StegoStatus PngStripReader::Open(const std::string& path)
+{
+    close();
+
+    this->file = std::fopen(path.c_str(), "rb");
+    if (this->file == nullptr)
+    {
+        return StegoStatus::IMAGE_NOT_FOUND;
+    }
+
+    this->png = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, pngError, pngWarning);
+    this->info = this->png ? png_create_info_struct(this->png) : nullptr;
+    if (this->info == nullptr || !readInfo())
+    {
+        close();
+        return StegoStatus::INVALID_MEDIA;
+    }
+
+    return StegoStatus::SUCCESS;
+}
+
+/**
+ * @brief PngStripReader::ReadRows Decode the next rows.rows rows into rows, an 8-bit BGR Mat Width() wide.
+ * @return StegoStatus::INVALID_MEDIA if the file is damaged or has fewer rows left, StegoStatus::SUCCESS otherwise
+ */
+StegoStatus PngStripReader::ReadRows(cv::Mat rows)
+{
+    if (this->png == nullptr || rows.type() != CV_8UC3 || rows.cols != this->width ||
+        this->rowsRead + rows.rows > this->height)
+    {
+        return StegoStatus::INVALID_MEDIA;
+    }
+
+    if (!readRows(rows))
+    {
+        close();
+        return StegoStatus::INVALID_MEDIA;
+    }
+
+    this->rowsRead += rows.rows;
+
+    return StegoStatus::SUCCESS;
+}
+
+int PngStripReader::Width() const
+{
+    return this->width;
+}
+
+int PngStripReader::Height() const
+{
+    return this->height;
+}
+
+int PngStripReader::RowsRead() const
+{
+    return this->rowsRead;
+}
+
+bool PngStripReader::readInfo()
+{
+    if (setjmp(png_jmpbuf(this->png)))
+    {
+        return false;
+    }
+
+    png_init_io(this->png, this->file);
+    png_read_info(this->png, this->info);
+
+    png_uint_32 imageWidth = png_get_image_width(this->png, this->info);
+    png_uint_32 imageHeight = png_get_image_height(this->png, this->info);
+    int bitDepth = png_get_bit_depth(this->png, this->info);
+    int colorType = png_get_color_type(this->png, this->info);
+    if (png_get_interlace_type(this->png, this->info) != PNG_INTERLACE_NONE || imageWidth == 0 || imageHeight == 0)
+    {
+        return false;
+    }
+
+    if (bitDepth == 16)
+    {
+        png_set_strip_16(this->png);
+    }
+
+    if (colorType == PNG_COLOR_TYPE_PALETTE)
+    {
+        png_set_palette_to_rgb(this->png);
+    }
+
+    if (colorType == PNG_COLOR_TYPE_GRAY && bitDepth < 8)
+    {
+        png_set_expand_gray_1_2_4_to_8(this->png);
+    }
+
+    if (colorType == PNG_COLOR_TYPE_GRAY || colorType == PNG_COLOR_TYPE_GRAY_ALPHA)
+    {
+        png_set_gray_to_rgb(this->png);
+    }
+
+    if (colorType & PNG_COLOR_MASK_ALPHA)
+    {
+        png_set_strip_alpha(this->png);
+    }
+
+    png_set_bgr(this->png);
+    png_read_update_info(this->png, this->info);
+
+    this->width = static_cast<int>(imageWidth);
+    this->height = static_cast<int>(imageHeight);
+    this->rowsRead = 0;
+
+    return true;
+}
+
+bool PngStripReader::readRows(cv::Mat rows)
+{
+    if (setjmp(png_jmpbuf(this->png)))
+    {
+        return false;
+    }
+
+    for (int row = 0; row < rows.rows; row++)
+    {
+        png_read_row(this->png, rows.ptr<png_byte>(row), nullptr);
+    }
+
+    return true;
+}
+
+void PngStripReader::close()
+{
+    if (this->png != nullptr)
+    {
+        png_destroy_read_struct(&this->png, this->info ? &this->info : nullptr, nullptr);
+    }
+
+    if (this->file != nullptr)
+    {
+        std::fclose(this->file);
+    }
+
+    this->png = nullptr;
+    this->info = nullptr;
+    this->file = nullptr;
+}
+
+PngStripWindow::PngStripWindow(PngStripReader& reader, int haloRows)
+    : reader(reader)
+    , haloRows(haloRows)
+{
+}
+
+/**
+ * @brief PngStripWindow::Next Move to the numRows rows below the current strip, fewer at the bottom of the image.
+ */
+StegoStatus PngStripWindow::Next(int numRows)
+{
+    return load(this->stripEnd, numRows);
+}
+
+/**
+ * @brief PngStripWindow::Grow Add the numRows rows below the current strip to it, fewer at the bottom of the image.
+ */
+StegoStatus PngStripWindow::Grow(int numRows)
+{
+    return load(this->stripStart, this->stripEnd - this->stripStart + numRows);
+}
+
+/**
+ * @brief PngStripWindow::Window The strip with the halo rows around it, a continuous Mat of its own.
+ */
+cv::Mat PngStripWindow::Window() const
+{
+    return this->window;
+}
+
+cv::Mat PngStripWindow::Strip() const
+{
+    return this->window.rowRange(StripOffset(), StripOffset() + NumStripRows());
+}
+
+/**
+ * @brief PngStripWindow::StripOffset Row of Window() the strip starts at.
+ */
+int PngStripWindow::StripOffset() const
+{
+    return this->stripStart - this->windowStart;
+}
+
+/**
+ * @brief PngStripWindow::WindowStart Row of the image Window() starts at.
+ */
+int PngStripWindow::WindowStart() const
+{
+    return this->windowStart;
+}
+
+int PngStripWindow::NumStripRows() const
+{
+    return this->stripEnd - this->stripStart;
+}
+
+/**
+ * @brief PngStripWindow::IsLast Whether the strip ends at the bottom of the image.
+ */
+bool PngStripWindow::IsLast() const
+{
+    return this->stripEnd >= this->reader.Height();
+}
+
+StegoStatus PngStripWindow::load(int start, int numRows)
+{
+    int height = this->reader.Height();
+    int end = std::min(height, start + std::max(numRows, 1));
+    if (start >= height)
+    {
+        return StegoStatus::INVALID_MEDIA;
+    }
+
+    // Rows above the new window are dropped, rows already read are kept and only the rest is decoded
+    int windowEnd = this->windowStart + this->window.rows;
+    int newWindowStart = std::max(0, start - this->haloRows);
+    int newWindowEnd = std::max(windowEnd, std::min(height, end + this->haloRows));
+
+    cv::Mat newWindow(newWindowEnd - newWindowStart, this->reader.Width(), CV_8UC3);
+    if (windowEnd > newWindowStart)
+    {
+        cv::Mat keptRows = newWindow.rowRange(0, windowEnd - newWindowStart);
+        this->window.rowRange(newWindowStart - this->windowStart, this->window.rows).copyTo(keptRows);
+    }
+
+    if (newWindowEnd > windowEnd)
+    {
+        StegoStatus status = this->reader.ReadRows(newWindow.rowRange(windowEnd - newWindowStart, newWindow.rows));
+        if (status != StegoStatus::SUCCESS)
+        {
+            return status;
+        }
+    }
+
+    this->window = newWindow;
+    this->windowStart = newWindowStart;
+    this->stripStart = start;
+    this->stripEnd = end;
+
+    return StegoStatus::SUCCESS;
+}
+
+PngStripWriter::~PngStripWriter()
+{
+    close();
+}
+
+/**
+ * @brief PngStripWriter::Open Create path and write the png header of a width x height rgb image.
+ * @return StegoStatus::FILE_OPEN_FAILED if the file could not be written, StegoStatus::SUCCESS otherwise
+ */
+StegoStatus PngStripWriter::Open(const std::string& path, int width, int height)
+{
+    close();
+
+    this->width = width;
+    this->height = height;
+    this->rowsWritten = 0;
+    this->file = std::fopen(path.c_str(), "wb");
+    if (this->file == nullptr)
+    {
+        return StegoStatus::FILE_OPEN_FAILED;
+    }
+
+    this->png = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, pngError, pngWarning);
+    this->info = this->png ? png_create_info_struct(this->png) : nullptr;
+    if (this->info == nullptr || !writeInfo())
+    {
+        close();
+        return StegoStatus::FILE_OPEN_FAILED;
+    }
+
+    return StegoStatus::SUCCESS;
+}
+
+/**
+ * @brief PngStripWriter::WriteRows Append rows, an 8-bit BGR Mat as wide as the image, below the rows written so far.
+ */
+StegoStatus PngStripWriter::WriteRows(const cv::Mat& rows)
+{
+    if (this->png == nullptr || rows.type() != CV_8UC3 || rows.cols != this->width ||
+        this->rowsWritten + rows.rows > this->height)
+    {
+        return StegoStatus::FILE_OPEN_FAILED;
+    }
+
+    if (!writeRows(rows))
+    {
+        close();
+        return StegoStatus::FILE_OPEN_FAILED;
+    }
+
+    this->rowsWritten += rows.rows;
+
+    return StegoStatus::SUCCESS;
+}
+
+/**
+ * @brief PngStripWriter::Close Finish the image, every row must have been written.
+ */
+StegoStatus PngStripWriter::Close()
+{
+    bool bComplete = this->png != nullptr && this->rowsWritten == this->height && writeEnd();
+    close();
+
+    return bComplete ? StegoStatus::SUCCESS : StegoStatus::FILE_OPEN_FAILED;
+}
+
+bool PngStripWriter::writeInfo()
+{
+    if (setjmp(png_jmpbuf(this->png)))
+    {
+        return false;
+    }
+
+    png_init_io(this->png, this->file);
+    png_set_IHDR(this->png, this->info, this->width, this->height, 8, PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE,
+                 PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    png_set_compression_level(this->png, COMPRESSION_LEVEL);
+    png_write_info(this->png, this->info);
+    png_set_bgr(this->png);
+
+    return true;
+}
+
+bool PngStripWriter::writeRows(const cv::Mat& rows)
+{
+    if (setjmp(png_jmpbuf(this->png)))
+    {
+        return false;
+    }
+
+    for (int row = 0; row < rows.rows; row++)
+    {
+        png_write_row(this->png, rows.ptr<png_byte>(row));
+    }
+
+    return true;
+}
+
+bool PngStripWriter::writeEnd()
+{
+    if (setjmp(png_jmpbuf(this->png)))
+    {
+        return false;
+    }
+
+    png_write_end(this->png, nullptr);
+
+    return true;
+}
+
+void PngStripWriter::close()
+{
+    if (this->png != nullptr)
+    {
+        png_destroy_write_struct(&this->png, this->info ? &this->info : nullptr);
+    }
+
+    if (this->file != nullptr)
+    {
+        std::fclose(this->file);
+    }
+
+    this->png = nullptr;
+    this->info = nullptr;
+    this->file = nullptr;
+}
@@ -0,0 +1,106 @@
+#ifndef PNGSTRIPS_H
+#define PNGSTRIPS_H
+
+#include "StegoStatus.h"
+#include <cstdio>
+#include <string>
+#include <png.h>
+#include <opencv2/core/mat.hpp>
+
+/**
+ * Reads a png from top to bottom a few rows at a time, converted to 8-bit BGR like imread with IMREAD_COLOR.
+ * Interlaced images are rejected by Open, their rows are only complete after every pass.
+ */
+class PngStripReader
+{
+public:
+    PngStripReader() = default;
+    ~PngStripReader();
+
+    PngStripReader(const PngStripReader&) = delete;
+    PngStripReader& operator=(const PngStripReader&) = delete;
+
+    StegoStatus Open(const std::string& path);
+    StegoStatus ReadRows(cv::Mat rows);
+
+    int Width() const;
+    int Height() const;
+    int RowsRead() const;
+
+private:
+    FILE* file = nullptr;
+    png_structp png = nullptr;
+    png_infop info = nullptr;
+    int width = 0;
+    int height = 0;
+    int rowsRead = 0;
+
+    bool readInfo();
+    bool readRows(cv::Mat rows);
+    void close();
+};
+
+/**
+ * Reads a png strip by strip, every strip with up to haloRows rows of the image above and below it. The rows are
+ * kept as they were read, so callers modify a copy of Strip() when the halo of the next strip must stay unchanged.
+ */
+class PngStripWindow
+{
+public:
+    PngStripWindow(PngStripReader& reader, int haloRows);
+
+    StegoStatus Next(int numRows);
+    StegoStatus Grow(int numRows);
+
+    cv::Mat Window() const;
+    cv::Mat Strip() const;
+    int StripOffset() const;
+    int WindowStart() const;
+    int NumStripRows() const;
+    bool IsLast() const;
+
+private:
+    PngStripReader& reader;
+    int haloRows;
+
+    cv::Mat window;
+    int windowStart = 0;
+    int stripStart = 0;
+    int stripEnd = 0;
+
+    StegoStatus load(int start, int numRows);
+};
+
+/**
+ * Writes an 8-bit BGR image as an rgb png a few rows at a time. The file is only complete after Close.
+ */
+class PngStripWriter
+{
+public:
+    PngStripWriter() = default;
+    ~PngStripWriter();
+
+    PngStripWriter(const PngStripWriter&) = delete;
+    PngStripWriter& operator=(const PngStripWriter&) = delete;
+
+    StegoStatus Open(const std::string& path, int width, int height);
+    StegoStatus WriteRows(const cv::Mat& rows);
+    StegoStatus Close();
+
+    static constexpr int COMPRESSION_LEVEL = 1;
+
+private:
+    FILE* file = nullptr;
+    png_structp png = nullptr;
+    png_infop info = nullptr;
+    int width = 0;
+    int height = 0;
+    int rowsWritten = 0;
+
+    bool writeInfo();
+    bool writeRows(const cv::Mat& rows);
+    bool writeEnd();
+    void close();
+};
+
+#endif // PNGSTRIPS_H
@@ -1,23 +1,53 @@
 #include "stego.h"
 #include "edgedetection.h"
+#include "stegocapacity.h"
+#include "stegoheader.h"
+#include "stegoarchive.h"
+#include "threadpool.h"
 #include <filesystem>
 #include <fstream>
 #include <QDebug>
 #include <cstdio>
 #include <QCoreApplication>
 #include <future>
+#include <atomic>
+#include <random>
+#include <sstream>
+#include <iterator>
+#include <algorithm>
+#include <limits>
+#include <mutex>
+#include <set>
 
 using namespace cv;
 
-const size_t NUM_HEADER_PIXELS = 10;
-const size_t LSB_BITS_PER_PIXEL = 3;
-const size_t BITS_PER_BYTE = 8;
-const size_t MAX_PVD_GREEN_EMBEDDING = 3;
-const size_t MAX_PVD_RED_EMBEDDING = 5;
-const size_t MAX_PVD_BLUE_EMBEDDING = 7;
+// Images with fewer pixels are embedded and extracted on a single thread
+const size_t PARALLEL_MIN_PIXELS = 1 << 18;
+const size_t CHUNKS_PER_THREAD = 4;
 
+// Bytes held per pixel of a streamed strip: the rows read, the copy being embedded in, and for PVD the planes and
+// embedding maps. Sobel adds the masked and blurred image, two CV_64F gradients, their absolute values, the
+// magnitudes as CV_64F and 8-bit, and the angles.
+const size_t STRIP_BYTES_PER_PIXEL = 3 + 3;
+const size_t PVD_STRIP_BYTES_PER_PIXEL = 3 + 3;
+const size_t SOBEL_STRIP_BYTES_PER_PIXEL = 3 + 3 + 2 * 3 * 8 + 2 * 3 + 8 + 1 + 8;
 
-std::string tempEncryptFilePath = "temp.encrypt";
+// Salt and key check at the start of a payload encrypted with DefaultEncryptorWithMAC, with room to spare
+const size_t ENCRYPTION_KEY_CHECK_BYTES = 64;
+
+// Slices of a sharded payload are copied to their shard files in chunks of this many bytes
+const size_t SHARD_COPY_BYTES = 64 * 1024;
+
+// Edge pixels are counted in runs of this many pixels while the cursor skips part of a payload
+const size_t LSB_SKIP_RUN_PIXELS = 4096;
+
+// Unchanged bytes of an updated payload are embedded again rather than skipped when fewer than this many lie between
+// two changed ones
+const uint64_t LSB_UPDATE_MIN_GAP_BYTES = 16;
+
+// Edges are detected this many bits past the end of the payload, for the byte LSB embeds after an empty file and the
+// pixel pairs PVD leaves unused after the file name
+const uint64_t EDGE_DETECTION_MARGIN_BITS = 64;
 
 uchar setBit(uchar number, int position)
 {
@@ -35,290 +65,2538 @@ int callSystem(std::string command)
     return result;
 }
 
-Stego::Stego(std::string filePath, std::string mediaPath, std::string algo, std::string edgeDetection,
-             bool bEncrypt, std::string password)
-    : filePath(filePath)
-    , mediaPath(mediaPath)
-    , fileNameLength(0)
-    , fileLength(0)
-    , bEncrypt(bEncrypt)
-    , password(password)
-    , currentRow(0)
-    , currentColumn(0)
-    , embedSize(0)
+/**
+ * @brief frameFileName Name of the png a video encode writes the frame with the given 1-based index to.
+ */
+std::string frameFileName(size_t frameIndex)
 {
-    if (algo == "LSB")
+    std::ostringstream frameName;
+    frameName << "frame_" << std::setw(6) << std::setfill('0') << frameIndex << ".png";
+
+    return frameName.str();
+}
+
+/**
+ * @brief The MemoryReadBuffer class Read only stream buffer over a byte array, lets payloads held in memory
+ * go through the same embedding code as files.
+ */
+class MemoryReadBuffer : public std::streambuf
+{
+public:
+    MemoryReadBuffer(const uint8_t* data, size_t size)
     {
-        this->algo = StegoAlgo::LSB;
+        char* begin = reinterpret_cast<char*>(const_cast<uint8_t*>(data));
+        setg(begin, begin, begin + size);
     }
-    else if (algo == "PVD")
+};
+
+/**
+ * @brief The VectorWriteBuffer class Stream buffer that appends everything written to it to a byte vector.
+ */
+class VectorWriteBuffer : public std::streambuf
+{
+public:
+    explicit VectorWriteBuffer(std::vector<uint8_t>& bytes)
+        : bytes(bytes)
     {
-        this->algo = StegoAlgo::PVD;
     }
 
-    if (edgeDetection == "None")
+protected:
+    int_type overflow(int_type ch) override
     {
-        this->edgeDetectionType = EdgeDetectionType::None;
+        if (!traits_type::eq_int_type(ch, traits_type::eof()))
+        {
+            bytes.push_back(static_cast<uint8_t>(ch));
+        }
+
+        return traits_type::not_eof(ch);
     }
-    else if (edgeDetection == "Canny")
+
+    std::streamsize xsputn(const char* data, std::streamsize size) override
     {
-        this->edgeDetectionType = EdgeDetectionType::Canny;
+        bytes.insert(bytes.end(), data, data + size);
+        return size;
     }
-    else if (edgeDetection == "Sobel")
+
+private:
+    std::vector<uint8_t>& bytes;
+};
+
+/**
+ * @brief chunkStarts Split [begin, end) into at most numChunks ranges of whole steps.
+ * @return Start of every range followed by end
+ */
+std::vector<size_t> chunkStarts(size_t begin, size_t end, size_t step, size_t numChunks)
+{
+    std::vector<size_t> starts;
+    size_t numSteps = end > begin ? (end - begin + step - 1) / step : 0;
+    numChunks = std::max<size_t>(1, std::min(numChunks, numSteps));
+    for (size_t chunk = 0; chunk < numChunks; chunk++)
     {
-        this->edgeDetectionType = EdgeDetectionType::Sobel;
+        starts.push_back(begin + (numSteps * chunk / numChunks) * step);
     }
 
-    this->fileName = std::filesystem::path(this->filePath).filename().string();
+    starts.push_back(std::max(begin, end));
+    return starts;
 }
 
-Stego::Stego(std::string mediaPath, bool bEncrypt, std::string password)
-    : mediaPath(mediaPath)
-    , fileNameLength(0)
-    , fileLength(0)
-    , bEncrypt(bEncrypt)
-    , password(password)
-    , fileName("")
-    , currentRow(0)
-    , currentColumn(0)
-    , embedSize(0)
+/**
+ * @brief payloadBit Bit of the payload at bitIndex, bits are taken from the least significant end of each byte.
+ */
+inline bool payloadBit(const std::vector<uchar>& data, uint64_t bitIndex)
 {
+    return (data[bitIndex / BITS_PER_BYTE] >> (bitIndex % BITS_PER_BYTE)) & 1;
 }
 
-
-Stego::~Stego() {
-    if (std::filesystem::exists(tempEncryptFilePath))
+/**
+ * @brief payloadBits numBits bits of the payload from bitIndex on in one value, the first in its least significant bit.
+ * Takes both bytes the bits may span at once, so a k-bit LSB sample is packed without a loop over its bits.
+ */
+inline uchar payloadBits(const std::vector<uchar>& data, uint64_t bitIndex, size_t numBits)
+{
+    size_t byteIndex = bitIndex / BITS_PER_BYTE;
+    unsigned int bytes = data[byteIndex];
+    if (byteIndex + 1 < data.size())
     {
-        std::remove(tempEncryptFilePath.c_str());
+        bytes |= static_cast<unsigned int>(data[byteIndex + 1]) << BITS_PER_BYTE;
     }
+
+    return static_cast<uchar>((bytes >> (bitIndex % BITS_PER_BYTE)) & ((1u << numBits) - 1));
 }
 
+/**
+ * @brief embedLsbBits Replace numBits bits of sample from bit firstBit on with the payload bits from bitIndex on.
+ */
+inline uchar embedLsbBits(uchar sample, const std::vector<uchar>& data, uint64_t bitIndex, size_t firstBit,
+                          size_t numBits)
+{
+    uchar mask = static_cast<uchar>(((1u << numBits) - 1) << firstBit);
+    return static_cast<uchar>((sample & ~mask) | (payloadBits(data, bitIndex, numBits) << firstBit));
+}
 
-StegoStatus Stego::EncodeImage()
+/**
+ * @brief decodePvdBlock Read the bits embedded in one channel of a PVD pixel pair.
+ * @tparam MaxBits Most bits the channel is allowed to carry, one of the MAX_PVD_*_EMBEDDING limits
+ * @return Number of bits in the block, 0 if the difference is above the range the channel is allowed to use
+ */
+template <size_t MaxBits>
+size_t decodePvdBlock(const uchar* pair, std::bitset<8>& differenceBinary)
 {
-    Mat image = imread(this->mediaPath, IMREAD_COLOR);
-    if (image.data == NULL)
+    uchar firstColourValue = pair[0] % 2 == 0 ? pair[0] + 1 : pair[0] - 1;
+    uchar rangeDifference = std::abs(firstColourValue - pair[1]);
+    size_t numBitsPerBlock = pvdRangeTable[rangeDifference];
+    if (numBitsPerBlock > MaxBits)
     {
-        return StegoStatus::IMAGE_NOT_FOUND;
+        return 0;
     }
 
-    StegoStatus status = StegoStatus::SUCCESS;
-
-    if (this->edgeDetectionType != EdgeDetectionType::None)
+    differenceBinary = std::bitset<8>(rangeDifference - pvdRangeLowerBounds[numBitsPerBlock]);
+    if (pair[0] % 2 != 0)
     {
-        this->edgeDetector = EdgeDetection();
-        this->edgeDetector.DetectEdges(image, this->edgeDetectionType);
+        differenceBinary[numBitsPerBlock - 1] = true;
     }
 
-    status = encodeHeader(image);
-    if (status != StegoStatus::SUCCESS)
+    return numBitsPerBlock;
+}
+
+/**
+ * Payload bits of the file name, for the sequential PVD encoder.
+ */
+class FileNameBitSource
+{
+public:
+    FileNameBitSource(const std::string& fileName)
+        : fileName(fileName)
+        , fileNameIndex(0)
+        , dataByteIndex(0)
     {
-        return status;
     }
 
-    if (this->isFileTooLarge(image))
+    bool Empty() const
     {
-        return StegoStatus::FILE_TOO_LARGE;
+        return fileNameIndex >= fileName.size();
     }
 
-    if (this->algo == StegoAlgo::LSB)
+    bool NextBit()
     {
-        status = encodeLsb(image);
+        bool bit = (fileName[fileNameIndex] >> dataByteIndex) & 1;
+        dataByteIndex++;
+        if (dataByteIndex >= BITS_PER_BYTE)
+        {
+            dataByteIndex = 0;
+            fileNameIndex++;
+        }
+
+        return bit;
     }
-    else if (this->algo == StegoAlgo::PVD)
+
+private:
+    const std::string& fileName;
+    size_t fileNameIndex;
+    size_t dataByteIndex;
+};
+
+/**
+ * Payload bits read from a stream, for the sequential PVD encoder. The current byte and bit index belong to
+ * the caller so they carry over to the next video frame.
+ */
+class StreamBitSource
+{
+public:
+    StreamBitSource(std::istream& file, std::bitset<8>& dataByte, size_t& dataByteIndex)
+        : file(file)
+        , dataByte(dataByte)
+        , dataByteIndex(dataByteIndex)
     {
-        status = encodePvd();
-        Mat mergedChannels[3] = {blueChannel, greenChannel, redChannel};
-        merge(mergedChannels, 3, image);
     }
 
-    if (status != StegoStatus::SUCCESS)
+    bool Empty() const
     {
-        return status;
+        return file.fail();
     }
 
-    std::filesystem::create_directory("stego_media");
-    std::string mediaName = std::filesystem::path(this->mediaPath).filename().string();
-    imwrite(std::filesystem::path("stego_media/" + mediaName), image);
+    bool NextBit()
+    {
+        bool bit = dataByte[dataByteIndex];
+        dataByteIndex++;
+        if (dataByteIndex >= dataByte.size())
+        {
+            dataByteIndex = 0;
+            char fileByte;
+            if (file.get(fileByte))
+            {
+                dataByte = std::bitset<8>(fileByte);
+            }
+        }
 
-    return status;
-}
+        return bit;
+    }
 
-StegoStatus Stego::EncryptFile()
+private:
+    std::istream& file;
+    std::bitset<8>& dataByte;
+    size_t& dataByteIndex;
+};
+
+/**
+ * Payload bits held in memory, for the parallel PVD encoder. Every chunk reads its own range of bits.
+ */
+class VectorBitSource
 {
-    std::ifstream file(this->filePath, std::ios_base::binary);
-    std::ofstream encryptedFile(tempEncryptFilePath, std::ios::binary);
-    if (!file.is_open() || !encryptedFile.is_open()) {
-        return StegoStatus::FILE_OPEN_FAILED;
+public:
+    VectorBitSource(const std::vector<uchar>& data, uint64_t firstBit)
+        : data(data)
+        , bitIndex(firstBit)
+        , numBits(data.size() * BITS_PER_BYTE)
+    {
     }
 
-    // Create FileSink and DefaultEncryptorWithMAC objects
-    CryptoPP::DefaultEncryptorWithMAC encryptor((CryptoPP::byte*)password.data(), password.size(), new CryptoPP::FileSink(encryptedFile));
-
-    // Create Redirector and FileSource objects
-    CryptoPP::FileSource fileSource(file, true, new CryptoPP::Redirector(encryptor));
+    bool Empty() const
+    {
+        return bitIndex >= numBits;
+    }
 
-    this->filePath = tempEncryptFilePath;
+    bool NextBit()
+    {
+        return payloadBit(data, bitIndex++);
+    }
 
-    return StegoStatus::SUCCESS;
-}
+private:
+    const std::vector<uchar>& data;
+    uint64_t bitIndex;
+    uint64_t numBits;
+};
 
-StegoStatus Stego::DecodeImage()
+/**
+ * Collects the decoded file name, for the sequential PVD decoder.
+ */
+class FileNameBitSink
 {
-    Mat image = imread(this->mediaPath, IMREAD_COLOR);
-    StegoStatus status = decodeHeader(image);
-    if (status != StegoStatus::SUCCESS)
+public:
+    FileNameBitSink(std::string& fileName, size_t fileNameLength)
+        : fileName(fileName)
+        , fileNameLength(fileNameLength)
+        , dataByteIndex(0)
     {
-        return status;
     }
 
-    if (this->edgeDetectionType != EdgeDetectionType::None)
+    bool Full() const
     {
-        this->edgeDetector = EdgeDetection();
-        this->edgeDetector.DetectEdges(image, this->edgeDetectionType);
+        return fileName.length() >= fileNameLength;
     }
 
-    if (this->algo == StegoAlgo::LSB)
-    {
-        status = decodeLsbFileName(image);
-        if (status != StegoStatus::SUCCESS)
-        {
-            return status;
-        }
-    }
-    else if (this->algo == StegoAlgo::PVD)
+    void PutBit(bool bit)
     {
-        status = decodePvdFileName(image);
-        if (status != StegoStatus::SUCCESS)
+        dataByte[dataByteIndex] = bit;
+        dataByteIndex++;
+        if (dataByteIndex >= dataByte.size())
         {
-            return status;
+            dataByteIndex = 0;
+            fileName += static_cast<uchar>(dataByte.to_ulong());
+            dataByte.reset();
         }
     }
 
-    std::filesystem::create_directory("decoded_files");
-    std::filesystem::path filePath = std::filesystem::path("decoded_files/" + this->fileName);
-    if (this->bEncrypt)
-    {
-        filePath = std::filesystem::path(tempEncryptFilePath);
-    }
-
-    std::ofstream file(filePath, std::ios_base::binary);
-    size_t bytesWritten = 0;
+private:
+    std::string& fileName;
+    size_t fileNameLength;
     std::bitset<8> dataByte;
-    size_t dataByteIndex = 0;
+    size_t dataByteIndex;
+};
 
-    if (this->algo == StegoAlgo::LSB)
+/**
+ * Writes decoded bytes to a stream, for the sequential PVD decoder. The current byte and bit index belong to
+ * the caller so they carry over to the next video frame.
+ */
+class StreamBitSink
+{
+public:
+    StreamBitSink(std::ostream& file, uint64_t& bytesWritten, std::bitset<8>& dataByte, size_t& dataByteIndex,
+                  uint64_t fileLength)
+        : file(file)
+        , bytesWritten(bytesWritten)
+        , dataByte(dataByte)
+        , dataByteIndex(dataByteIndex)
+        , fileLength(fileLength)
     {
-        status = decodeLsbFile(image, file, bytesWritten, dataByte, dataByteIndex);
     }
-    else if (this->algo == StegoAlgo::PVD)
+
+    bool Full() const
     {
-        status = decodePvdFile(image, file, bytesWritten, dataByte, dataByteIndex);
+        return bytesWritten >= fileLength;
     }
 
-    file.flush();
-    file.close();
+    void PutBit(bool bit)
+    {
+        dataByte[dataByteIndex] = bit;
+        dataByteIndex++;
+        if (dataByteIndex >= dataByte.size())
+        {
+            dataByteIndex = 0;
+            file.put(static_cast<uchar>(dataByte.to_ulong()));
+            bytesWritten++;
+            dataByte.reset();
+        }
+    }
 
-    return status;
-}
+private:
+    std::ostream& file;
+    uint64_t& bytesWritten;
+    std::bitset<8>& dataByte;
+    size_t& dataByteIndex;
+    uint64_t fileLength;
+};
 
 /**
- * @brief Stego::EncodeVideo Encode stegonographic data into video based on given algorithms.
- * @return StegoStatus::SUCCESS if encoding was succesful, error code otherwise.
+ * Writes the decoded bytes of part of a payload to a stream, for decoding a range with the sequential PVD decoder.
+ * The bits before the range are counted and dropped.
  */
-StegoStatus Stego::EncodeVideo()
+class RangeBitSink
 {
-    VideoCapture video(this->mediaPath);
-    if (!video.isOpened())
+public:
+    RangeBitSink(std::ostream& file, uint64_t numSkippedBits, uint64_t numBytes)
+        : file(file)
+        , numSkippedBits(numSkippedBits)
+        , numBytes(numBytes)
     {
-        qDebug()  << "Could not open video " << this->mediaPath;
-        return StegoStatus::VIDEO_OPEN_FAILED;
     }
 
-    // Get first video frame
-    Mat frame;
-    video >> frame;
-
-    // Find edges if edge detection enabled
-    if (this->edgeDetectionType != EdgeDetectionType::None)
+    bool Full() const
     {
-        this->edgeDetector = EdgeDetection();
-        this->edgeDetector.DetectEdges(frame, this->edgeDetectionType);
+        return bytesWritten >= numBytes;
     }
 
-    // Encode stego header into first frame of video
-    StegoStatus status = encodeHeader(frame);
-    if (status != StegoStatus::SUCCESS)
+    void PutBit(bool bit)
     {
-        return status;
+        if (numSkippedBits > 0)
+        {
+            numSkippedBits--;
+            return;
+        }
+
+        dataByte[dataByteIndex] = bit;
+        dataByteIndex++;
+        if (dataByteIndex >= dataByte.size())
+        {
+            dataByteIndex = 0;
+            file.put(static_cast<uchar>(dataByte.to_ulong()));
+            bytesWritten++;
+            dataByte.reset();
+        }
     }
 
-    std::ifstream file(this->filePath, std::ios_base::binary);
+private:
+    std::ostream& file;
+    uint64_t numSkippedBits;
+    uint64_t numBytes;
+    uint64_t bytesWritten = 0;
     std::bitset<8> dataByte;
     size_t dataByteIndex = 0;
+};
 
-    // Get first byte of file for writing
-    char fileByte;
-    file.get(fileByte);
-    dataByte = std::bitset<8>(fileByte);
-
-    // Create stego media directory, if it does not exist
-    std::filesystem::create_directory("stego_media");
-    std::filesystem::create_directory("stego_media/.temp");
+/**
+ * @brief extractPvdBlock Decode one channel of a PVD pixel pair into sink, stops as soon as sink is full.
+ */
+template <size_t MaxBits, typename BitSink>
+void extractPvdBlock(const uchar* pair, BitSink& sink)
+{
+    std::bitset<8> differenceBinary;
+    size_t numBitsPerBlock = decodePvdBlock<MaxBits>(pair, differenceBinary);
+    for (size_t i = 0; i < numBitsPerBlock && !sink.Full(); i++)
+    {
+        sink.PutBit(differenceBinary[i]);
+    }
+}
 
-    std::string mediaName = std::filesystem::path(this->mediaPath).filename().string();
-    std::string stegoMediaPath = "stego_media/" + mediaName;
-    std::ostringstream frameName;
-    size_t frameCount = 0;
-    bool bFileNameEmbedded = false;
+/**
+ * Collects the bits one chunk of a parallel decode extracts. Bytes that lie completely inside the chunk's bit
+ * range are written straight to the output, bytes shared with a neighbouring chunk are kept until all chunks
+ * are done and then merged.
+ */
+class ChunkBitWriter
+{
+public:
+    ChunkBitWriter(std::vector<uchar>& output, uint64_t firstBit, uint64_t endBit)
+        : output(output)
+        , firstBit(firstBit)
+        , endBit(endBit)
+        , currentByte(firstBit / BITS_PER_BYTE)
+        , currentValue(0)
+    {
+    }
 
-    while (!frame.empty())
+    void Put(uint64_t bitIndex, bool bit)
     {
-        QCoreApplication::processEvents();
-        frameCount++;
-        if (this->edgeDetectionType != EdgeDetectionType::None)
+        size_t byteIndex = bitIndex / BITS_PER_BYTE;
+        if (byteIndex != currentByte)
         {
-            this->edgeDetector.DetectEdges(frame, this->edgeDetectionType);
+            Flush();
+            currentByte = byteIndex;
         }
 
-        if (this->algo == StegoAlgo::LSB)
-        {
-            if (!bFileNameEmbedded)
-            {
-                status = encodeLsbFileName(frame);
-                if (status == StegoStatus::SUCCESS)
-                {
-                    bFileNameEmbedded = true;
-                }
-                else if (status != StegoStatus::OUT_OF_ROOM)
-                {
-                    return status;
-                }
-            }
+        currentValue |= static_cast<uchar>(bit) << (bitIndex % BITS_PER_BYTE);
+    }
 
+    void Flush()
+    {
+        if (currentValue == 0)
+        {
+            return;
+        }
 
-            if (bFileNameEmbedded)
-            {
-                status = encodeLsbFile(frame, file, dataByte, dataByteIndex);
-                if (status != StegoStatus::SUCCESS)
-                {
-                    return status;
-                }
-            }
+        uint64_t byteStart = currentByte * BITS_PER_BYTE;
+        if (byteStart >= firstBit && byteStart + BITS_PER_BYTE <= endBit)
+        {
+            output[currentByte] = currentValue;
         }
-        else if (this->algo == StegoAlgo::PVD)
+        else
         {
-            // Setup PVD embeddings for frame
-            if (this->edgeDetectionType == EdgeDetectionType::None)
-            {
-                getPvdSequentialSize(frame);
-            }
-            else
-            {
-                getPvdEdgeSize(frame);
-            }
+            sharedBytes.emplace_back(currentByte, currentValue);
+        }
 
-            if (!bFileNameEmbedded)
+        currentValue = 0;
+    }
+
+    void MergeSharedBytes()
+    {
+        for (const std::pair<size_t, uchar>& sharedByte : sharedBytes)
+        {
+            output[sharedByte.first] |= sharedByte.second;
+        }
+    }
+
+private:
+    std::vector<uchar>& output;
+    uint64_t firstBit;
+    uint64_t endBit;
+    size_t currentByte;
+    uchar currentValue;
+    std::vector<std::pair<size_t, uchar>> sharedBytes;
+};
+
+/**
+ * @brief exclusivePrefixSum
+ * @return Offsets where counts[i] starts when all counts are laid out one after another
+ */
+std::vector<uint64_t> exclusivePrefixSum(const std::vector<uint64_t>& counts)
+{
+    std::vector<uint64_t> offsets(counts.size() + 1, 0);
+    for (size_t i = 0; i < counts.size(); i++)
+    {
+        offsets[i + 1] = offsets[i] + counts[i];
+    }
+
+    return offsets;
+}
+
+/**
+ * Feeds the bits one chunk of a parallel PVD decode extracts to its ChunkBitWriter.
+ */
+class ChunkBitSink
+{
+public:
+    ChunkBitSink(ChunkBitWriter& writer, uint64_t firstBit, uint64_t numBits)
+        : writer(writer)
+        , bitIndex(firstBit)
+        , numBits(numBits)
+    {
+    }
+
+    bool Full() const
+    {
+        return bitIndex >= numBits;
+    }
+
+    void PutBit(bool bit)
+    {
+        writer.Put(bitIndex++, bit);
+    }
+
+private:
+    ChunkBitWriter& writer;
+    uint64_t bitIndex;
+    uint64_t numBits;
+};
+
+Stego::Stego(std::string filePath, std::string mediaPath, std::string algo, std::string edgeDetection,
+             bool bEncrypt, std::string password)
+    : filePath(filePath)
+    , sourceFilePath(filePath)
+    , mediaPath(mediaPath)
+    , bEncrypt(bEncrypt)
+    , password(password)
+{
+    setAlgorithms(algo, edgeDetection);
+    SetBufferPool(std::make_shared<BufferPool>());
+
+    // A directory given with a trailing separator is still named after the directory
+    std::filesystem::path path(this->filePath);
+    if (!path.has_filename())
+    {
+        path = path.parent_path();
+    }
+
+    this->fileName = path.filename().string();
+}
+
+Stego::Stego(std::string mediaPath, bool bEncrypt, std::string password)
+    : mediaPath(mediaPath)
+    , bEncrypt(bEncrypt)
+    , password(password)
+    , fileName("")
+{
+    SetBufferPool(std::make_shared<BufferPool>());
+}
+
+/**
+ * @brief Stego::Stego Create an instance for the in-memory EncodeImage/DecodeImage overloads, which take the
+ * media and payload as buffers instead of paths. The algorithms are only used when encoding.
+ */
+Stego::Stego(std::string algo, std::string edgeDetection, bool bEncrypt, std::string password)
+    : bEncrypt(bEncrypt)
+    , password(password)
+    , fileName("")
+{
+    setAlgorithms(algo, edgeDetection);
+    SetBufferPool(std::make_shared<BufferPool>());
+}
+
+
+Stego::~Stego() {
+    // Only remove temp files this instance created, other instances may share the working directory
+    std::error_code error;
+    for (const std::filesystem::path& tempPath : this->tempPaths)
+    {
+        std::filesystem::remove_all(tempPath, error);
+    }
+}
+
+void Stego::setAlgorithms(const std::string& algo, const std::string& edgeDetection)
+{
+    if (algo == "LSB")
+    {
+        this->algo = StegoAlgo::LSB;
+    }
+    else if (algo == "PVD")
+    {
+        this->algo = StegoAlgo::PVD;
+    }
+
+    if (edgeDetection == "None")
+    {
+        this->edgeDetectionType = EdgeDetectionType::None;
+    }
+    else if (edgeDetection == "Canny")
+    {
+        this->edgeDetectionType = EdgeDetectionType::Canny;
+    }
+    else if (edgeDetection == "Sobel")
+    {
+        this->edgeDetectionType = EdgeDetectionType::Sobel;
+    }
+    else if (edgeDetection == "Texture")
+    {
+        this->edgeDetectionType = EdgeDetectionType::Texture;
+    }
+}
+
+/**
+ * @brief Stego::SetWorkingDirectory Set the directory that stego_media/, decoded_files/ and temp files are created in.
+ * Defaults to the current directory. Must be set before EncryptFile is called.
+ */
+void Stego::SetWorkingDirectory(std::string workingDirectory)
+{
+    this->workingDirectory = workingDirectory;
+}
+
+/**
+ * @brief Stego::SetOutputDirectory Write stego media and decoded files directly to outputDirectory instead of
+ * stego_media/ and decoded_files/ under the working directory.
+ */
+void Stego::SetOutputDirectory(std::string outputDirectory)
+{
+    this->outputDirectory = outputDirectory;
+}
+
+/**
+ * @brief Stego::GetOutputPath
+ * @return Path of the stego media or decoded file written by the last operation
+ */
+std::string Stego::GetOutputPath() const
+{
+    return this->outputPath;
+}
+
+/**
+ * @brief Stego::GetEmbedSize
+ * @return Number of bytes that fit in the media, set by CalculateCapacity and when a file is too large to encode
+ */
+uint64_t Stego::GetEmbedSize() const
+{
+    return this->context.embedSize;
+}
+
+/**
+ * @brief Stego::SetBufferPool Allocate the per frame planes from bufferPool. Instances that run one after
+ * another, e.g. the jobs of one batch worker, can share a pool so their buffers are recycled across jobs.
+ * Every instance starts with a pool of its own, nullptr allocates the planes from the heap.
+ */
+void Stego::SetBufferPool(std::shared_ptr<BufferPool> bufferPool)
+{
+    // Planes from the old pool must be released while it is still alive
+    resetContext();
+    this->context.bufferPool = bufferPool;
+    this->context.edgeDetector = EdgeDetection(bufferPool.get(), this->edgeCache.get());
+}
+
+/**
+ * @brief Stego::GetBufferPoolStats Allocation counters of the buffer pool, used to check that steady state
+ * frames do not allocate.
+ */
+BufferPoolStats Stego::GetBufferPoolStats() const
+{
+    if (!this->context.bufferPool)
+    {
+        return BufferPoolStats();
+    }
+
+    return this->context.bufferPool->Stats();
+}
+
+/**
+ * @brief Stego::SetEdgeCache Load the edge masks of carriers detected before from edgeCache and store the masks
+ * detected, see EdgeCache. Decoding LSB hits the mask its encode stored, PVD only hits when a cover is encoded
+ * again. Instances can share a cache, nullptr detects every image. Disabled by default.
+ */
+void Stego::SetEdgeCache(std::shared_ptr<EdgeCache> edgeCache)
+{
+    this->edgeCache = edgeCache;
+    this->context.edgeDetector = EdgeDetection(this->context.bufferPool.get(), edgeCache.get());
+}
+
+/**
+ * @brief Stego::resetContext Start an operation from a fresh context that keeps the buffer pool.
+ */
+void Stego::resetContext()
+{
+    std::shared_ptr<BufferPool> bufferPool = this->context.bufferPool;
+    this->context = StegoContext();
+    this->context.bufferPool = bufferPool;
+    this->context.edgeDetector = EdgeDetection(bufferPool.get(), this->edgeCache.get());
+}
+
+/**
+ * @brief Stego::SetParallel Embed and extract large images on all cores, the output is the same either way.
+ * Enabled by default.
+ */
+void Stego::SetParallel(bool bParallel)
+{
+    this->bParallel = bParallel;
+}
+
+/**
+ * @brief Stego::SetCompression Deflate the payload before it is encrypted and embedded. Payloads that do not get
+ * smaller are embedded as they are. The header records which was used, decoding needs no setting. Disabled by default.
+ */
+void Stego::SetCompression(bool bCompress)
+{
+    this->bCompress = bCompress;
+}
+
+/**
+ * @brief Stego::SetStripBudget Encode png carriers a strip of rows at a time, holding about maxStripBytes of image
+ * data at once however large the carrier is. The stego image is the same as when the whole carrier is loaded.
+ * Canny edge detection and other formats load the whole carrier. 0 disables streaming, the default.
+ */
+void Stego::SetStripBudget(size_t maxStripBytes)
+{
+    this->stripBudget = maxStripBytes;
+}
+
+/**
+ * @brief Stego::SetFrameSource How EncodeVideo and DecodeVideo read the frames of the video, the frames are the same
+ * either way. VideoCapture by default, RawPipe reads through a single ffmpeg process and decodes ahead of the embedding.
+ */
+void Stego::SetFrameSource(FrameSourceType frameSourceType)
+{
+    this->frameSourceType = frameSourceType;
+}
+
+/**
+ * @brief Stego::SetCheckpointInterval Save the progress of EncodeVideo every numFrames frames under
+ * .stego_checkpoint/ in the working directory. An encode of the same payload into the same video with the same
+ * settings that was interrupted, e.g. by a crash, resumes after its last checkpoint and writes the same stego video
+ * as an uninterrupted encode. 0 disables checkpoints, the default.
+ */
+void Stego::SetCheckpointInterval(size_t numFrames)
+{
+    this->checkpointInterval = numFrames;
+}
+
+/**
+ * @brief Stego::SetLsbBits Embed LSB payloads in the lsbBits least significant bits of every sample instead of only
+ * the lowest one, so a payload takes lsbBits times fewer pixels and video frames, but changes each sample by more.
+ * Clamped to StegoCapacity::MaxLsbBits, so edge detection uses at most MAX_EDGE_LSB_BITS and PVD is unchanged. Set
+ * after the algorithms, the bit count is stored in the header, decoding needs no setting. 1 by default.
+ */
+void Stego::SetLsbBits(size_t lsbBits)
+{
+    this->lsbBits = std::clamp<size_t>(lsbBits, 1, StegoCapacity::MaxLsbBits(this->algo, this->edgeDetectionType));
+}
+
+/**
+ * @brief Stego::SetInflateLimit Largest size a compressed payload may inflate to when decoding, larger ones fail with
+ * StegoStatus::DECOMPRESSION_FAILED. 0, the default, allows INFLATE_LIMIT_RATIO times the embedded size and at least
+ * MIN_INFLATE_LIMIT_BYTES, raise it to decode payloads that compressed better than that.
+ */
+void Stego::SetInflateLimit(uint64_t maxBytes)
+{
+    this->maxInflatedBytes = maxBytes;
+}
+
+/**
+ * @brief Stego::SetVideoBackend Lossless codec EncodeVideo writes the stego video with. Decoding reads every backend
+ * and needs no setting. FFV1 by default.
+ */
+void Stego::SetVideoBackend(const VideoBackend& videoBackend)
+{
+    this->videoBackend = videoBackend;
+}
+
+/**
+ * @brief Stego::getTempEncryptFilePath Get the temp file that holds encrypted data, unique to this instance.
+ * Created under .stego_temp/ in the working directory on first use.
+ */
+std::filesystem::path Stego::getTempEncryptFilePath()
+{
+    if (this->tempEncryptFilePath.empty())
+    {
+        std::filesystem::path tempDirectory = this->workingDirectory / ".stego_temp";
+        std::filesystem::create_directories(tempDirectory);
+        this->tempEncryptFilePath = tempDirectory / (uniqueTempName("encrypt") + ".tmp");
+        this->tempPaths.push_back(this->tempEncryptFilePath);
+    }
+
+    return this->tempEncryptFilePath;
+}
+
+/**
+ * @brief Stego::getTempCompressFilePath Get the temp file that holds the deflated payload, unique to this instance.
+ */
+std::filesystem::path Stego::getTempCompressFilePath()
+{
+    if (this->tempCompressFilePath.empty())
+    {
+        std::filesystem::path tempDirectory = this->workingDirectory / ".stego_temp";
+        std::filesystem::create_directories(tempDirectory);
+        this->tempCompressFilePath = tempDirectory / (uniqueTempName("compress") + ".tmp");
+        this->tempPaths.push_back(this->tempCompressFilePath);
+    }
+
+    return this->tempCompressFilePath;
+}
+
+/**
+ * @brief Stego::getTempArchiveFilePath Get the temp file that holds a packed or decoded archive, unique to this instance.
+ */
+std::filesystem::path Stego::getTempArchiveFilePath()
+{
+    if (this->tempArchiveFilePath.empty())
+    {
+        std::filesystem::path tempDirectory = this->workingDirectory / ".stego_temp";
+        std::filesystem::create_directories(tempDirectory);
+        this->tempArchiveFilePath = tempDirectory / (uniqueTempName("archive") + ".tmp");
+        this->tempPaths.push_back(this->tempArchiveFilePath);
+    }
+
+    return this->tempArchiveFilePath;
+}
+
+/**
+ * @brief Stego::createTempDirectory Create a new directory under .stego_temp/ in the working directory,
+ * unique to this call. Removed when the instance is destroyed, if not already.
+ */
+std::filesystem::path Stego::createTempDirectory()
+{
+    std::filesystem::path tempDirectory = this->workingDirectory / ".stego_temp" / uniqueTempName("frames");
+    std::filesystem::create_directories(tempDirectory);
+    this->tempPaths.push_back(tempDirectory);
+
+    return tempDirectory;
+}
+
+/**
+ * @brief Stego::getOutputDirectory
+ * @return The output directory set with SetOutputDirectory, or defaultName under the working directory
+ */
+std::filesystem::path Stego::getOutputDirectory(const std::string& defaultName) const
+{
+    if (!this->outputDirectory.empty())
+    {
+        return this->outputDirectory;
+    }
+
+    return this->workingDirectory / defaultName;
+}
+
+
+StegoStatus Stego::EncodeImage()
+{
+    // Canny thins and links edges across the whole image, so it cannot be detected a strip at a time
+    bool bPng = std::filesystem::path(this->mediaPath).extension() == ".png";
+    if (this->stripBudget != 0 && bPng && this->edgeDetectionType != EdgeDetectionType::Canny)
+    {
+        PngStripReader reader;
+        if (reader.Open(this->mediaPath) == StegoStatus::SUCCESS)
+        {
+            return encodeImageStrips(reader);
+        }
+    }
+
+    resetContext();
+
+    Mat image = imread(this->mediaPath, IMREAD_COLOR);
+    if (image.data == NULL)
+    {
+        return StegoStatus::IMAGE_NOT_FOUND;
+    }
+
+    StegoStatus status = compressFile();
+    if (status != StegoStatus::SUCCESS)
+    {
+        return status;
+    }
+
+    context.bCompressed = this->bFileCompressed;
+    context.bArchive = this->bFileArchived;
+    status = readFileLength();
+    if (status != StegoStatus::SUCCESS)
+    {
+        return status;
+    }
+
+    std::ifstream file(this->filePath, std::ios_base::binary);
+    status = encodeImage(image, file);
+    if (status != StegoStatus::SUCCESS)
+    {
+        return status;
+    }
+
+    std::filesystem::path stegoMediaDirectory = getOutputDirectory("stego_media");
+    std::filesystem::create_directories(stegoMediaDirectory);
+    std::string mediaName = std::filesystem::path(this->mediaPath).filename().string();
+    this->outputPath = (stegoMediaDirectory / mediaName).string();
+    imwrite(this->outputPath, image);
+
+    return status;
+}
+
+/**
+ * @brief Stego::CalculateCapacity Calculate how many bytes can be embedded in the media with the selected algorithms.
+ * Every video frame is measured, see StegoCapacity. No file to embed is required.
+ * @return StegoStatus::SUCCESS if the media could be read, error code otherwise. Capacity is available from GetEmbedSize.
+ */
+StegoStatus Stego::CalculateCapacity()
+{
+    resetContext();
+
+    StegoCapacity capacity(this->algo, this->edgeDetectionType, this->lsbBits);
+    capacity.SetEdgeCache(this->edgeCache.get());
+    std::string extension = std::filesystem::path(this->mediaPath).extension().string();
+    if (extension == ".mkv")
+    {
+        CapacityTable table;
+        StegoStatus status = capacity.VideoCapacity(this->mediaPath, table);
+        if (status != StegoStatus::SUCCESS)
+        {
+            return status;
+        }
+
+        if (table.numFrames == 0)
+        {
+            return StegoStatus::IMAGE_NOT_FOUND;
+        }
+
+        context.embedSize = table.totalCapacity;
+        return StegoStatus::SUCCESS;
+    }
+
+    return capacity.ImageCapacity(this->mediaPath, context.embedSize);
+}
+
+/**
+ * @brief Stego::EncryptFile Encrypt the file to embed into a temp file, which is embedded instead. If compression
+ * is enabled the file is compressed first, encrypted data does not compress.
+ */
+StegoStatus Stego::EncryptFile()
+{
+    StegoStatus status = compressFile();
+    if (status != StegoStatus::SUCCESS)
+    {
+        return status;
+    }
+
+    std::ifstream file(this->filePath, std::ios_base::binary);
+    std::ofstream encryptedFile(getTempEncryptFilePath(), std::ios::binary);
+    if (!file.is_open() || !encryptedFile.is_open()) {
+        return StegoStatus::FILE_OPEN_FAILED;
+    }
+
+    // Create FileSink and DefaultEncryptorWithMAC objects
+    CryptoPP::DefaultEncryptorWithMAC encryptor((CryptoPP::byte*)password.data(), password.size(), new CryptoPP::FileSink(encryptedFile));
+
+    // Create Redirector and FileSource objects
+    CryptoPP::FileSource fileSource(file, true, new CryptoPP::Redirector(encryptor));
+
+    this->filePath = getTempEncryptFilePath().string();
+
+    return StegoStatus::SUCCESS;
+}
+
+StegoStatus Stego::DecodeImage()
+{
+    resetContext();
+    this->fileName = "";
+
+    Mat image = imread(this->mediaPath, IMREAD_COLOR);
+    if (image.empty())
+    {
+        return StegoStatus::IMAGE_NOT_FOUND;
+    }
+
+    StegoStatus status = decodeImageFileName(image);
+    if (status != StegoStatus::SUCCESS)
+    {
+        return status;
+    }
+
+    std::filesystem::path filePath = decodedFilePath();
+    std::ofstream file(filePath, std::ios_base::binary);
+    status = decodeImageFile(image, file);
+
+    file.flush();
+    file.close();
+
+    if (status != StegoStatus::SUCCESS)
+    {
+        return status;
+    }
+
+    return finishDecode(filePath);
+}
+
+/**
+ * @brief Stego::decodedFilePath Set the output path to where the decoded file goes, named after the decoded file name.
+ * @return The file the payload is decoded to, a temp file if the payload is encrypted, compressed or an archive
+ */
+std::filesystem::path Stego::decodedFilePath()
+{
+    std::filesystem::create_directories(getOutputDirectory("decoded_files"));
+    std::filesystem::path filePath = getOutputDirectory("decoded_files") / this->fileName;
+    this->outputPath = filePath.string();
+    if (this->bEncrypt)
+    {
+        filePath = getTempEncryptFilePath();
+    }
+    else if (context.bCompressed)
+    {
+        filePath = getTempCompressFilePath();
+    }
+    else if (context.bArchive)
+    {
+        filePath = getTempArchiveFilePath();
+    }
+
+    return filePath;
+}
+
+/**
+ * @brief Stego::finishDecode Inflate and unpack the payload decoded to filePath, see decodedFilePath.
+ * Encrypted payloads are inflated and unpacked by DecryptFile.
+ */
+StegoStatus Stego::finishDecode(const std::filesystem::path& filePath)
+{
+    StegoStatus status = StegoStatus::SUCCESS;
+    if (!this->bEncrypt && context.bCompressed)
+    {
+        std::filesystem::path inflatedPath = context.bArchive ? getTempArchiveFilePath()
+                                                              : std::filesystem::path(this->outputPath);
+        status = inflateFile(filePath, inflatedPath);
+    }
+
+    if (status == StegoStatus::SUCCESS && !this->bEncrypt && context.bArchive)
+    {
+        status = unpackArchive(getTempArchiveFilePath());
+    }
+
+    return status;
+}
+
+/**
+ * @brief Stego::EncodeImage Encode payload into an image held in memory. Nothing is read from or written to disk.
+ * @param carrier 8-bit BGR image to embed in, left unchanged
+ * @param payload Bytes to embed, compressed and encrypted first if enabled
+ * @param fileName Name stored with the payload and returned when decoding
+ * @param stegoImage Set to the image with the payload embedded
+ * @return StegoStatus::SUCCESS if encoding was succesful, error code otherwise.
+ */
+StegoStatus Stego::EncodeImage(const cv::Mat& carrier, const uint8_t* payload, size_t payloadSize,
+                               const std::string& fileName, cv::Mat& stegoImage)
+{
+    resetContext();
+
+    if (carrier.empty())
+    {
+        return StegoStatus::IMAGE_NOT_FOUND;
+    }
+
+    if (carrier.type() != CV_8UC3)
+    {
+        return StegoStatus::INVALID_MEDIA;
+    }
+
+    this->fileName = fileName;
+
+    std::string compressedPayload;
+    std::string encryptedPayload;
+    StegoStatus status = preparePayload(payload, payloadSize, compressedPayload, encryptedPayload);
+    if (status != StegoStatus::SUCCESS)
+    {
+        return status;
+    }
+
+    MemoryReadBuffer payloadBuffer(payload, payloadSize);
+    std::istream file(&payloadBuffer);
+    context.fileLength = payloadSize;
+
+    Mat image = carrier.clone();
+    status = encodeImage(image, file);
+    if (status != StegoStatus::SUCCESS)
+    {
+        return status;
+    }
+
+    stegoImage = image;
+
+    return status;
+}
+
+/**
+ * @brief Stego::preparePayload Compress and encrypt a payload held in memory as enabled. payload and payloadSize are
+ * set to the bytes to embed, held by compressedPayload or encryptedPayload once they differ from the payload.
+ */
+StegoStatus Stego::preparePayload(const uint8_t*& payload, size_t& payloadSize, std::string& compressedPayload,
+                                  std::string& encryptedPayload)
+{
+    if (this->bCompress)
+    {
+        StegoStatus status = deflateBuffer(payload, payloadSize, compressedPayload);
+        if (status != StegoStatus::SUCCESS)
+        {
+            return status;
+        }
+
+        if (compressedPayload.size() < payloadSize)
+        {
+            payload = reinterpret_cast<const uint8_t*>(compressedPayload.data());
+            payloadSize = compressedPayload.size();
+            context.bCompressed = true;
+        }
+    }
+
+    if (this->bEncrypt)
+    {
+        StegoStatus status = encryptBuffer(payload, payloadSize, encryptedPayload);
+        if (status != StegoStatus::SUCCESS)
+        {
+            return status;
+        }
+
+        payload = reinterpret_cast<const uint8_t*>(encryptedPayload.data());
+        payloadSize = encryptedPayload.size();
+    }
+
+    return StegoStatus::SUCCESS;
+}
+
+/**
+ * @brief Stego::EncodeImage Encode payload into an encoded image (e.g. the contents of a PNG file) held in memory.
+ * @param extension Format to encode the result in, must be lossless
+ * @return StegoStatus::SUCCESS if encoding was succesful, error code otherwise.
+ */
+StegoStatus Stego::EncodeImage(const std::vector<uchar>& carrier, const uint8_t* payload, size_t payloadSize,
+                               const std::string& fileName, std::vector<uchar>& stegoImage, const std::string& extension)
+{
+    Mat image = imdecode(carrier, IMREAD_COLOR);
+    Mat encodedImage;
+    StegoStatus status = EncodeImage(image, payload, payloadSize, fileName, encodedImage);
+    if (status != StegoStatus::SUCCESS)
+    {
+        return status;
+    }
+
+    if (!imencode(extension, encodedImage, stegoImage))
+    {
+        return StegoStatus::INVALID_MEDIA;
+    }
+
+    return status;
+}
+
+/**
+ * @brief Stego::DecodeImage Decode payload from an image held in memory. Nothing is read from or written to disk.
+ * A directory is embedded as an archive and a shard holds only a slice of a payload, both are decoded to disk
+ * instead, see DecodeImage(), ExtractMember and DecodeShards.
+ * @param payload Set to the embedded bytes, decrypted if encryption is enabled
+ * @param fileName Set to the name stored with the payload
+ * @return StegoStatus::PAYLOAD_IS_ARCHIVE if a directory is embedded, StegoStatus::SHARD_SET_INCOMPLETE if the image
+ * is a shard, StegoStatus::SUCCESS if decoding was succesful, error code otherwise.
+ */
+StegoStatus Stego::DecodeImage(const cv::Mat& stegoImage, std::vector<uint8_t>& payload, std::string& fileName)
+{
+    resetContext();
+    this->fileName = "";
+
+    if (stegoImage.empty())
+    {
+        return StegoStatus::IMAGE_NOT_FOUND;
+    }
+
+    if (stegoImage.type() != CV_8UC3)
+    {
+        return StegoStatus::INVALID_MEDIA;
+    }
+
+    Mat image = stegoImage;
+    StegoStatus status = decodeImageFileName(image);
+    if (status != StegoStatus::SUCCESS)
+    {
+        return status;
+    }
+
+    // The payload would be the raw index and members of the archive or the shard prefix and a slice. A shard is
+    // rejected here whatever this instance decodes, like beginUpdate does
+    if (context.bShard)
+    {
+        return StegoStatus::SHARD_SET_INCOMPLETE;
+    }
+
+    if (context.bArchive)
+    {
+        return StegoStatus::PAYLOAD_IS_ARCHIVE;
+    }
+
+    // The header length is untrusted, never reserve more than the image can hold
+    payload.clear();
+    payload.reserve(std::min<uint64_t>(context.fileLength, image.total() * image.channels()));
+    VectorWriteBuffer payloadBuffer(payload);
+    std::ostream file(&payloadBuffer);
+    status = decodeImageFile(image, file);
+    if (status != StegoStatus::SUCCESS)
+    {
+        return status;
+    }
+
+    if (this->bEncrypt)
+    {
+        status = decryptBuffer(payload);
+        if (status != StegoStatus::SUCCESS)
+        {
+            return status;
+        }
+    }
+
+    if (context.bCompressed)
+    {
+        status = inflateBuffer(payload);
+        if (status != StegoStatus::SUCCESS)
+        {
+            return status;
+        }
+    }
+
+    fileName = this->fileName;
+
+    return status;
+}
+
+/**
+ * @brief Stego::DecodeImage Decode payload from an encoded image (e.g. the contents of a PNG file) held in memory.
+ * @return StegoStatus::SUCCESS if decoding was succesful, error code otherwise.
+ */
+StegoStatus Stego::DecodeImage(const std::vector<uchar>& stegoImage, std::vector<uint8_t>& payload, std::string& fileName)
+{
+    Mat image = imdecode(stegoImage, IMREAD_COLOR);
+
+    return DecodeImage(image, payload, fileName);
+}
+
+/**
+ * @brief Stego::UpdateImage Replace the payload embedded in the stego image at the media path by the file, without
+ * the original carrier. LSB embeds every bit of the file name and the file in a sample that only depends on the
+ * carrier, so the payload embedded is read and only the bytes of the new one that differ from it are embedded again,
+ * with the header. Samples whose bits stay the same are not changed. The algorithm, edge detection and LSB bits are
+ * taken from the header. An encrypted payload differs in every byte, its update rewrites all of it.
+ * @return StegoStatus::INVALID_MEDIA if the payload was embedded with PVD or is a shard, StegoStatus::FILE_TOO_LARGE
+ * if the file does not fit, StegoStatus::SUCCESS otherwise
+ */
+StegoStatus Stego::UpdateImage()
+{
+    resetContext();
+
+    Mat image = imread(this->mediaPath, IMREAD_COLOR);
+    if (image.data == NULL)
+    {
+        return StegoStatus::IMAGE_NOT_FOUND;
+    }
+
+    StegoStatus status = compressFile();
+    if (status != StegoStatus::SUCCESS)
+    {
+        return status;
+    }
+
+    context.bCompressed = this->bFileCompressed;
+    context.bArchive = this->bFileArchived;
+    status = readFileLength();
+    if (status != StegoStatus::SUCCESS)
+    {
+        return status;
+    }
+
+    std::ifstream file(this->filePath, std::ios_base::binary);
+    status = updateImage(image, file);
+    if (status != StegoStatus::SUCCESS)
+    {
+        return status;
+    }
+
+    std::filesystem::path stegoMediaDirectory = getOutputDirectory("stego_media");
+    std::filesystem::create_directories(stegoMediaDirectory);
+    std::string mediaName = std::filesystem::path(this->mediaPath).filename().string();
+    this->outputPath = (stegoMediaDirectory / mediaName).string();
+    imwrite(this->outputPath, image);
+
+    return status;
+}
+
+/**
+ * @brief Stego::UpdateImage Replace the payload embedded in an image held in memory, see UpdateImage().
+ * @param stegoImage Image carrying a payload embedded with LSB, set to the updated image on success
+ * @return StegoStatus::SUCCESS if the update was succesful, error code otherwise.
+ */
+StegoStatus Stego::UpdateImage(cv::Mat& stegoImage, const uint8_t* payload, size_t payloadSize,
+                               const std::string& fileName)
+{
+    resetContext();
+
+    if (stegoImage.empty())
+    {
+        return StegoStatus::IMAGE_NOT_FOUND;
+    }
+
+    if (stegoImage.type() != CV_8UC3)
+    {
+        return StegoStatus::INVALID_MEDIA;
+    }
+
+    this->fileName = fileName;
+
+    std::string compressedPayload;
+    std::string encryptedPayload;
+    StegoStatus status = preparePayload(payload, payloadSize, compressedPayload, encryptedPayload);
+    if (status != StegoStatus::SUCCESS)
+    {
+        return status;
+    }
+
+    MemoryReadBuffer payloadBuffer(payload, payloadSize);
+    std::istream file(&payloadBuffer);
+    context.fileLength = payloadSize;
+
+    Mat image = stegoImage.clone();
+    status = updateImage(image, file);
+    if (status != StegoStatus::SUCCESS)
+    {
+        return status;
+    }
+
+    stegoImage = image;
+
+    return status;
+}
+
+/**
+ * @brief Stego::readFileLength Read the length of the file to embed into the context.
+ * @return StegoStatus::FILE_NOT_FOUND if the file does not exist, StegoStatus::SUCCESS otherwise.
+ */
+StegoStatus Stego::readFileLength()
+{
+    try
+    {
+        context.fileLength = std::filesystem::file_size(this->filePath);
+    } catch (std::filesystem::filesystem_error& e)
+    {
+        qDebug() << e.what();
+        return StegoStatus::FILE_NOT_FOUND;
+    }
+
+    return StegoStatus::SUCCESS;
+}
+
+/**
+ * @brief Stego::checkpointKey Identify an encode by its payload, its video and every setting that changes the stego
+ * video, so a checkpoint is only resumed by the same encode.
+ */
+std::string Stego::checkpointKey() const
+{
+    std::ostringstream key;
+    for (const std::string& path : {this->sourceFilePath, this->mediaPath})
+    {
+        std::error_code error;
+        key << std::filesystem::absolute(path, error).string() << "\n"
+            << std::filesystem::file_size(path, error) << " "
+            << std::filesystem::last_write_time(path, error).time_since_epoch().count() << "\n";
+    }
+
+    // A directory changes with any of its files
+    std::error_code error;
+    if (std::filesystem::is_directory(this->sourceFilePath, error))
+    {
+        for (const auto& [path, name] : StegoArchive::ListFiles(this->sourceFilePath))
+        {
+            key << name << " " << std::filesystem::file_size(path, error) << " "
+                << std::filesystem::last_write_time(path, error).time_since_epoch().count() << "\n";
+        }
+    }
+
+    key << this->fileName << "\n"
+        << static_cast<int>(this->algo) << " " << static_cast<int>(this->edgeDetectionType) << " " << this->bEncrypt
+        << " " << this->bCompress << " " << this->checkpointInterval << " " << this->lsbBits << "\n"
+        << this->videoBackend.EncoderArguments();
+
+    return key.str();
+}
+
+/**
+ * @brief Stego::loadCheckpoint Load the journal of an interrupted encode with the key of journal and embed the
+ * payload saved with it. Every frame is decoded, segments from the first one with a frame that is missing, damaged or
+ * not of frameSize on are dropped.
+ * @return false if there is nothing to resume and the encode starts over
+ */
+bool Stego::loadCheckpoint(const std::filesystem::path& checkpointDirectory, StegoJournal& journal,
+                           const cv::Size& frameSize)
+{
+    StegoJournal savedJournal;
+    if (savedJournal.Load(checkpointDirectory / "journal") != StegoStatus::SUCCESS || savedJournal.key != journal.key)
+    {
+        return false;
+    }
+
+    // The password is not part of the key, a payload encrypted with another password starts over
+    std::filesystem::path payloadPath = checkpointDirectory / "payload";
+    if (savedJournal.bPayloadSaved &&
+        (!std::filesystem::exists(payloadPath) || (this->bEncrypt && !checkPassword(payloadPath))))
+    {
+        return false;
+    }
+
+    size_t numSegments = 0;
+    size_t frameIndex = 1;
+    for (const StegoJournalSegment& segment : savedJournal.segments)
+    {
+        // A frame cut short by a crash before it reached the disk does not decode
+        while (frameIndex <= segment.endFrame)
+        {
+            Mat savedFrame = cv::imread((checkpointDirectory / "frames" / frameFileName(frameIndex)).string(),
+                                        cv::IMREAD_COLOR);
+            if (savedFrame.size() != frameSize)
+            {
+                break;
+            }
+
+            frameIndex++;
+        }
+
+        if (frameIndex <= segment.endFrame)
+        {
+            break;
+        }
+
+        numSegments++;
+    }
+
+    if (numSegments == 0)
+    {
+        return false;
+    }
+
+    savedJournal.segments.resize(numSegments);
+    if (savedJournal.bPayloadSaved)
+    {
+        this->filePath = payloadPath.string();
+        this->bFileCompressed = savedJournal.bCompressed;
+        this->bCompressionChecked = true;
+
+        // The saved payload of a directory is the archive it was packed to
+        std::error_code error;
+        this->bFileArchived = std::filesystem::is_directory(this->sourceFilePath, error);
+    }
+
+    journal = savedJournal;
+
+    return true;
+}
+
+/**
+ * @brief Stego::startCheckpoint Replace any checkpoint with the key of journal by an empty one. A payload that is a
+ * temp file of this instance, compressed or encrypted, is kept with the checkpoint so a resumed encode embeds the
+ * same bytes.
+ * @return StegoStatus::FILE_OPEN_FAILED if the checkpoint could not be written, StegoStatus::SUCCESS otherwise
+ */
+StegoStatus Stego::startCheckpoint(const std::filesystem::path& checkpointDirectory, StegoJournal& journal)
+{
+    std::error_code error;
+    std::filesystem::remove_all(checkpointDirectory, error);
+    std::filesystem::create_directories(checkpointDirectory / "frames", error);
+    if (error)
+    {
+        return StegoStatus::FILE_OPEN_FAILED;
+    }
+
+    journal.bCompressed = this->bFileCompressed;
+    journal.bPayloadSaved = this->filePath != this->sourceFilePath;
+    journal.segments.clear();
+    if (journal.bPayloadSaved)
+    {
+        // Linked where possible, the temp file is removed with this instance
+        std::filesystem::path payloadPath = checkpointDirectory / "payload";
+        std::filesystem::create_hard_link(this->filePath, payloadPath, error);
+        if (error)
+        {
+            error.clear();
+            std::filesystem::copy_file(this->filePath, payloadPath, error);
+        }
+
+        if (error)
+        {
+            return StegoStatus::FILE_OPEN_FAILED;
+        }
+    }
+
+    return journal.Save(checkpointDirectory / "journal");
+}
+
+/**
+ * @brief Stego::checkpointFrame Add a segment to the journal after every checkpointInterval frames written. The
+ * frames since the last segment are flushed to disk first, so the journal never lists a frame a power loss can cut
+ * short. Checkpoints are best effort, the encode goes on if the frames or the journal cannot be saved.
+ */
+void Stego::checkpointFrame(const std::filesystem::path& checkpointDirectory, StegoJournal& journal, size_t frameCount,
+                            std::istream& file, const std::bitset<8>& dataByte, size_t dataByteIndex,
+                            bool bFileNameEmbedded)
+{
+    if (this->checkpointInterval == 0 || frameCount % this->checkpointInterval != 0)
+    {
+        return;
+    }
+
+    std::filesystem::path framesDirectory = checkpointDirectory / "frames";
+    size_t firstFrame = journal.segments.empty() ? 1 : journal.segments.back().endFrame + 1;
+    for (size_t frameIndex = firstFrame; frameIndex <= frameCount; frameIndex++)
+    {
+        if (!StegoJournal::SyncFile(framesDirectory / frameFileName(frameIndex)))
+        {
+            qDebug() << "Could not save checkpoint in" << checkpointDirectory.string();
+            return;
+        }
+    }
+
+    if (!StegoJournal::SyncFile(framesDirectory))
+    {
+        qDebug() << "Could not save checkpoint in" << checkpointDirectory.string();
+        return;
+    }
+
+    StegoJournalSegment segment;
+    segment.endFrame = frameCount;
+    segment.bPayloadEnd = file.eof();
+    segment.payloadOffset = segment.bPayloadEnd ? context.fileLength : static_cast<uint64_t>(file.tellg());
+    segment.dataByte = static_cast<uint8_t>(dataByte.to_ulong());
+    segment.dataByteIndex = dataByteIndex;
+    segment.bFileNameEmbedded = bFileNameEmbedded;
+    journal.segments.push_back(segment);
+
+    if (journal.Save(checkpointDirectory / "journal") != StegoStatus::SUCCESS)
+    {
+        qDebug() << "Could not save checkpoint in" << checkpointDirectory.string();
+    }
+}
+
+/**
+ * @brief Stego::checkPassword Whether the password is the one encryptedPath was encrypted with. Only the key check
+ * at the start of the file is decrypted.
+ */
+bool Stego::checkPassword(const std::filesystem::path& encryptedPath) const
+{
+    std::ifstream file(encryptedPath, std::ios_base::binary);
+    std::vector<char> head(ENCRYPTION_KEY_CHECK_BYTES);
+    file.read(head.data(), head.size());
+
+    try {
+        CryptoPP::DefaultDecryptorWithMAC decryptor((CryptoPP::byte*)password.data(), password.size(), nullptr, true);
+        decryptor.Put(reinterpret_cast<const CryptoPP::byte*>(head.data()), file.gcount());
+    }
+    catch (const CryptoPP::Exception&) {
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Stego::packArchive Pack the files under the directory to embed into a temp archive, which is embedded
+ * instead, see StegoArchive. With compression enabled the members are deflated one by one. Only runs once.
+ * @return StegoStatus::FILE_NOT_FOUND if a file could not be read, StegoStatus::SUCCESS otherwise, also when the
+ * file to embed is no directory.
+ */
+StegoStatus Stego::packArchive()
+{
+    std::error_code error;
+    if (this->bFileArchived || !std::filesystem::is_directory(this->filePath, error))
+    {
+        return StegoStatus::SUCCESS;
+    }
+
+    StegoStatus status = StegoArchive::Pack(this->filePath, getTempArchiveFilePath(), this->bCompress);
+    if (status != StegoStatus::SUCCESS)
+    {
+        return status;
+    }
+
+    this->filePath = getTempArchiveFilePath().string();
+    this->bFileArchived = true;
+
+    return StegoStatus::SUCCESS;
+}
+
+/**
+ * @brief Stego::unpackArchive Unpack a decoded archive to a directory named after it in the output directory, only
+ * archiveMember if it is set. The output path is set to that directory, or to the member.
+ */
+StegoStatus Stego::unpackArchive(const std::filesystem::path& archivePath)
+{
+    std::filesystem::path archiveDirectory = getOutputDirectory("decoded_files") / this->fileName;
+    StegoStatus status = StegoArchive::Unpack(archivePath, archiveDirectory, this->archiveMember,
+                                              this->maxInflatedBytes);
+    if (status != StegoStatus::SUCCESS)
+    {
+        return status;
+    }
+
+    this->outputPath = (this->archiveMember.empty() ? archiveDirectory : archiveDirectory / this->archiveMember).string();
+
+    return StegoStatus::SUCCESS;
+}
+
+/**
+ * @brief Stego::compressFile Deflate the file to embed into a temp file, which is embedded instead, if compression
+ * is enabled. Only runs once per file, also when called from both EncryptFile and the encode. A directory is packed
+ * into an archive first, its members are compressed on their own and the archive is not compressed again.
+ * @return StegoStatus::FILE_NOT_FOUND if the file could not be read, StegoStatus::SUCCESS otherwise, also when the
+ * file is embedded uncompressed because it does not get smaller.
+ */
+StegoStatus Stego::compressFile()
+{
+    StegoStatus status = packArchive();
+    if (status != StegoStatus::SUCCESS)
+    {
+        return status;
+    }
+
+    if (!this->bCompress || this->bCompressionChecked || this->bFileArchived)
+    {
+        return StegoStatus::SUCCESS;
+    }
+
+    std::ifstream file(this->filePath, std::ios_base::binary);
+    if (!file.is_open())
+    {
+        return StegoStatus::FILE_NOT_FOUND;
+    }
+
+    this->bCompressionChecked = true;
+
+    // Skip the full pass for payloads that are already compressed, e.g. media files and archives
+    std::vector<char> probe(COMPRESSION_PROBE_BYTES);
+    file.read(probe.data(), probe.size());
+    probe.resize(file.gcount());
+
+    std::string compressedProbe;
+    deflateBuffer(reinterpret_cast<const uint8_t*>(probe.data()), probe.size(), compressedProbe);
+    if (compressedProbe.size() >= probe.size())
+    {
+        return StegoStatus::SUCCESS;
+    }
+
+    file.clear();
+    file.seekg(0);
+    std::ofstream compressedFile(getTempCompressFilePath(), std::ios_base::binary);
+    if (!compressedFile.is_open())
+    {
+        return StegoStatus::FILE_OPEN_FAILED;
+    }
+
+    CryptoPP::FileSource fileSource(file, true, new CryptoPP::Deflator(new CryptoPP::FileSink(compressedFile)));
+    compressedFile.close();
+
+    std::error_code error;
+    if (std::filesystem::file_size(getTempCompressFilePath(), error) < std::filesystem::file_size(this->filePath, error))
+    {
+        this->filePath = getTempCompressFilePath().string();
+        this->bFileCompressed = true;
+    }
+
+    return StegoStatus::SUCCESS;
+}
+
+/**
+ * @brief Stego::inflateFile Inflate a decoded payload into the output file, at most the inflate limit,
+ * see SetInflateLimit.
+ * @return StegoStatus::DECOMPRESSION_FAILED if the payload is not valid deflate data or inflates past the limit,
+ * StegoStatus::SUCCESS otherwise
+ */
+StegoStatus Stego::inflateFile(const std::filesystem::path& compressedPath, const std::filesystem::path& outputPath)
+{
+    std::ifstream compressedFile(compressedPath, std::ios_base::binary);
+    std::ofstream file(outputPath, std::ios_base::binary);
+    if (!compressedFile.is_open() || !file.is_open())
+    {
+        return StegoStatus::FILE_OPEN_FAILED;
+    }
+
+    uint64_t maxBytes = inflateLimit(std::filesystem::file_size(compressedPath), this->maxInflatedBytes);
+    try {
+        CryptoPP::FileSource fileSource(compressedFile, true, new CryptoPP::Inflator(
+                                            new InflateLimitFilter(maxBytes, new CryptoPP::FileSink(file))));
+    }
+    catch (const CryptoPP::Exception& e) {
+        qDebug() << "Crypto++ exception: " << e.what();
+        file.close();
+        std::filesystem::remove(outputPath);
+
+        return StegoStatus::DECOMPRESSION_FAILED;
+    }
+
+    return StegoStatus::SUCCESS;
+}
+
+/**
+ * @brief Stego::encodeImage Embed the header, file name and file into image. context.fileLength must be set.
+ */
+StegoStatus Stego::encodeImage(cv::Mat image, std::istream& file)
+{
+    if (this->edgeDetectionType != EdgeDetectionType::None)
+    {
+        context.edgeDetector = EdgeDetection(context.bufferPool.get(), this->edgeCache.get());
+        context.edgeDetector.BeginDetection(image, this->edgeDetectionType);
+    }
+
+    StegoStatus status = encodeHeader(image);
+    if (status != StegoStatus::SUCCESS)
+    {
+        return status;
+    }
+
+    if (this->isFileTooLarge(image))
+    {
+        return StegoStatus::FILE_TOO_LARGE;
+    }
+
+    if (this->algo == StegoAlgo::LSB)
+    {
+        status = encodeLsb(image, file);
+    }
+    else if (this->algo == StegoAlgo::PVD)
+    {
+        status = encodePvd(file);
+        Mat mergedChannels[3] = {context.blueChannel, context.greenChannel, context.redChannel};
+        merge(mergedChannels, 3, image);
+    }
+
+    return status;
+}
+
+/**
+ * @brief Stego::encodeImageStrips Embed the file in a png carrier read and written a strip of rows at a time. The
+ * strips run the same kernels as a whole image, with the cursor and the payload byte carried from strip to strip
+ * like between video frames. The first strip holds the header and the whole file name, it is grown until it does.
+ * Strips after the end of the payload are copied through once the capacity check of the whole image has passed.
+ */
+StegoStatus Stego::encodeImageStrips(PngStripReader& reader)
+{
+    resetContext();
+
+    StegoStatus status = compressFile();
+    if (status != StegoStatus::SUCCESS)
+    {
+        return status;
+    }
+
+    context.bCompressed = this->bFileCompressed;
+    context.bArchive = this->bFileArchived;
+    status = readFileLength();
+    if (status != StegoStatus::SUCCESS)
+    {
+        return status;
+    }
+
+    // Sequential LSB capacity only depends on the size of the image, the other modes are summed strip by strip
+    uint64_t numPayloadBytes = context.fileLength + this->fileName.size();
+    uint64_t numPixels = static_cast<uint64_t>(reader.Width()) * reader.Height();
+    size_t numHeaderPixels = StegoHeader::NumPixels(StegoHeader::CURRENT_VERSION);
+    uint64_t capacityBits = 0;
+    if (this->algo == StegoAlgo::LSB && this->edgeDetectionType == EdgeDetectionType::None)
+    {
+        uint64_t numSamples = numPixels > numHeaderPixels ? (numPixels - numHeaderPixels) * LSB_BITS_PER_PIXEL : 0;
+        capacityBits = numSamples * this->lsbBits;
+        if (numPayloadBytes > capacityBits / BITS_PER_BYTE)
+        {
+            context.embedSize = capacityBits / BITS_PER_BYTE;
+            return StegoStatus::FILE_TOO_LARGE;
+        }
+    }
+
+    std::filesystem::path stegoMediaDirectory = getOutputDirectory("stego_media");
+    std::filesystem::create_directories(stegoMediaDirectory);
+    std::string mediaName = std::filesystem::path(this->mediaPath).filename().string();
+    this->outputPath = (stegoMediaDirectory / mediaName).string();
+
+    PngStripWriter writer;
+    status = writer.Open(this->outputPath, reader.Width(), reader.Height());
+    if (status != StegoStatus::SUCCESS)
+    {
+        return status;
+    }
+
+    int haloRows = this->edgeDetectionType != EdgeDetectionType::None ? EdgeDetection::SOBEL_HALO_ROWS : 0;
+    int stripRows = getStripRows(reader.Width());
+    PngStripWindow strips(reader, haloRows);
+    std::ifstream file(this->filePath, std::ios_base::binary);
+    std::bitset<8> dataByte;
+    size_t dataByteIndex = 0;
+
+    Mat strip;
+    int numHeaderRows = static_cast<int>(numHeaderPixels / reader.Width() + 1);
+    int firstStripRows = std::max(stripRows, numHeaderRows + numHeaderRows % 2);
+    status = encodeFirstStrip(strips, firstStripRows, strip, file, dataByte, dataByteIndex, capacityBits);
+    while (status == StegoStatus::SUCCESS)
+    {
+        status = writer.WriteRows(strip);
+        if (status != StegoStatus::SUCCESS || strips.IsLast())
+        {
+            break;
+        }
+
+        status = strips.Next(stripRows);
+        if (status != StegoStatus::SUCCESS)
+        {
+            break;
+        }
+
+        // LSB still embeds the byte read last after the end of the file is reached, PVD stops there
+        bool bByteEmbedded = this->algo == StegoAlgo::PVD || dataByteIndex >= dataByte.size();
+        bool bPayloadEmbedded = file.fail() && bByteEmbedded;
+        if (bPayloadEmbedded && capacityBits / BITS_PER_BYTE >= numPayloadBytes)
+        {
+            strip = strips.Strip();
+            continue;
+        }
+
+        // The rows read are kept as they are for the halo of the next strip
+        strip = strips.Strip().clone();
+        capacityBits += encodeStrip(strips, strip, !bPayloadEmbedded, file, dataByte, dataByteIndex);
+    }
+
+    if (status == StegoStatus::SUCCESS && numPayloadBytes > capacityBits / BITS_PER_BYTE)
+    {
+        context.embedSize = capacityBits / BITS_PER_BYTE;
+        status = StegoStatus::FILE_TOO_LARGE;
+    }
+
+    if (status == StegoStatus::SUCCESS)
+    {
+        status = writer.Close();
+    }
+
+    if (status != StegoStatus::SUCCESS)
+    {
+        writer.Close();
+        std::error_code error;
+        std::filesystem::remove(this->outputPath, error);
+        this->outputPath.clear();
+    }
+
+    return status;
+}
+
+/**
+ * @brief Stego::encodeFirstStrip Read the first strip and embed the header, the file name and as much of the file
+ * as fits in it. The strip starts with stripRows rows and grows by as many until the file name fits.
+ * @param strip Set to the embedded strip
+ * @param capacityBits Increased by the capacity of the strip
+ * @return StegoStatus::FILE_TOO_LARGE if the file name does not fit in the whole image
+ */
+StegoStatus Stego::encodeFirstStrip(PngStripWindow& strips, int stripRows, cv::Mat& strip, std::istream& file,
+                                    std::bitset<8>& dataByte, size_t& dataByteIndex, uint64_t& capacityBits)
+{
+    StegoStatus status = strips.Next(stripRows);
+
+    uint64_t stripBits = 0;
+    while (status == StegoStatus::SUCCESS)
+    {
+        strip = strips.Strip().clone();
+        status = detectStripEdges(strips);
+        if (status != StegoStatus::SUCCESS)
+        {
+            return status;
+        }
+
+        status = encodeHeader(strip);
+        if (status != StegoStatus::SUCCESS)
+        {
+            return status;
+        }
+
+        stripBits = getStripCapacityBits(strip, strips.IsLast());
+
+        bool bNameFits = true;
+        if (this->algo == StegoAlgo::LSB)
+        {
+            // The file name kernel does not stop at the end of the edges, only call it when they hold the name
+            bool bEdgesHoldName = stripBits >= this->fileName.size() * BITS_PER_BYTE;
+            bNameFits = (this->edgeDetectionType == EdgeDetectionType::None || bEdgesHoldName) &&
+                        encodeLsbFileName(strip) == StegoStatus::SUCCESS;
+        }
+        else if (this->algo == StegoAlgo::PVD)
+        {
+            // The pair skipped after the name must be in the strip too, the next strip starts at its first pair
+            encodePvdFileName();
+            bNameFits = context.currentRow == 0 && (context.currentColumn < strip.total() || strips.IsLast());
+        }
+
+        if (bNameFits)
+        {
+            break;
+        }
+
+        // Same as the whole image, the capacity check comes first
+        if (strips.IsLast())
+        {
+            uint64_t capacity = (capacityBits + stripBits) / BITS_PER_BYTE;
+            if (context.fileLength + this->fileName.size() <= capacity)
+            {
+                return StegoStatus::OUT_OF_ROOM;
+            }
+
+            context.embedSize = capacity;
+            return StegoStatus::FILE_TOO_LARGE;
+        }
+
+        status = strips.Grow(stripRows);
+    }
+
+    if (status != StegoStatus::SUCCESS)
+    {
+        return status;
+    }
+
+    capacityBits += stripBits;
+
+    char fileByte = 0;
+    file.get(fileByte);
+    dataByte = std::bitset<8>(fileByte);
+    dataByteIndex = 0;
+
+    if (this->algo == StegoAlgo::LSB)
+    {
+        return encodeLsbFile(strip, file, dataByte, dataByteIndex);
+    }
+
+    status = encodePvdFile(file, dataByte, dataByteIndex);
+    Mat mergedChannels[3] = {context.blueChannel, context.greenChannel, context.redChannel};
+    merge(mergedChannels, 3, strip);
+
+    return status;
+}
+
+/**
+ * @brief Stego::encodeStrip Embed the next part of the file in a strip after the first, if bEmbed is set.
+ * @return The capacity of the strip in bits
+ */
+uint64_t Stego::encodeStrip(PngStripWindow& strips, cv::Mat strip, bool bEmbed, std::istream& file,
+                            std::bitset<8>& dataByte, size_t& dataByteIndex)
+{
+    context.currentRow = 0;
+    context.currentColumn = 0;
+    context.currentBit = 0;
+    context.numHeaderPixels = 0;
+
+    if (detectStripEdges(strips) != StegoStatus::SUCCESS)
+    {
+        return 0;
+    }
+
+    uint64_t stripBits = getStripCapacityBits(strip, strips.IsLast());
+    if (!bEmbed)
+    {
+        return stripBits;
+    }
+
+    if (this->algo == StegoAlgo::LSB)
+    {
+        encodeLsbFile(strip, file, dataByte, dataByteIndex);
+    }
+    else if (this->algo == StegoAlgo::PVD)
+    {
+        encodePvdFile(file, dataByte, dataByteIndex);
+        Mat mergedChannels[3] = {context.blueChannel, context.greenChannel, context.redChannel};
+        merge(mergedChannels, 3, strip);
+    }
+
+    return stripBits;
+}
+
+/**
+ * @brief Stego::detectStripEdges Detect the edges of the current strip on the rows read around it.
+ */
+StegoStatus Stego::detectStripEdges(const PngStripWindow& strips)
+{
+    if (this->edgeDetectionType == EdgeDetectionType::None)
+    {
+        return StegoStatus::SUCCESS;
+    }
+
+    context.edgeDetector = EdgeDetection(context.bufferPool.get(), this->edgeCache.get());
+    return context.edgeDetector.DetectEdges(strips.Window(), this->edgeDetectionType, strips.StripOffset(),
+                                            strips.NumStripRows(), strips.WindowStart());
+}
+
+/**
+ * @brief Stego::getStripCapacityBits Capacity of a strip from the cursor on, in bits so the strips of an image add up
+ * to the capacity getEncodeableSize gives for the whole image. Builds the PVD embedding maps of the strip.
+ * Sequential LSB is not measured per strip and gives 0.
+ * @param bLastStrip Whether the strip ends the image
+ */
+uint64_t Stego::getStripCapacityBits(cv::Mat strip, bool bLastStrip)
+{
+    if (this->algo == StegoAlgo::LSB && this->edgeDetectionType != EdgeDetectionType::None)
+    {
+        uint64_t numEdgePixels = StegoCapacity::LsbEdgePixels(context.edgeDetector.GetMagnitudes(),
+                                                              context.numHeaderPixels);
+        return numEdgePixels * LSB_BITS_PER_PIXEL * this->lsbBits;
+    }
+
+    if (this->algo != StegoAlgo::PVD)
+    {
+        return 0;
+    }
+
+    splitChannels(strip);
+    calculatePvdEmbeddings();
+    if (this->edgeDetectionType != EdgeDetectionType::None)
+    {
+        size_t numMaskedRows = bLastStrip ? context.blueChannel.rows - 1 : context.blueChannel.rows;
+        return maskPvdEmbeddingsToEdges(context.currentRow, context.currentColumn / 3, numMaskedRows);
+    }
+
+    return sumPvdEmbeddings();
+}
+
+/**
+ * @brief Stego::getStripRows Number of rows of a width wide carrier that fit in the strip budget, with the halo
+ * rows edge detection needs. Strips of an odd width have an even number of rows, so PVD never splits a pixel pair.
+ */
+int Stego::getStripRows(int width) const
+{
+    size_t bytesPerPixel = STRIP_BYTES_PER_PIXEL;
+    if (this->algo == StegoAlgo::PVD)
+    {
+        bytesPerPixel += PVD_STRIP_BYTES_PER_PIXEL;
+    }
+
+    size_t numHaloRows = 0;
+    if (this->edgeDetectionType != EdgeDetectionType::None)
+    {
+        bytesPerPixel += SOBEL_STRIP_BYTES_PER_PIXEL;
+        numHaloRows = 2 * EdgeDetection::SOBEL_HALO_ROWS;
+    }
+
+    size_t numRows = this->stripBudget / (static_cast<size_t>(width) * bytesPerPixel);
+    numRows = numRows > numHaloRows ? numRows - numHaloRows : 1;
+    numRows = std::min<size_t>(numRows, std::numeric_limits<int>::max() / 2);
+    if (width % 2 != 0 && numRows % 2 != 0)
+    {
+        numRows++;
+    }
+
+    return static_cast<int>(numRows);
+}
+
+/**
+ * @brief Stego::decodeImageFileName Decode the header and the file name from image.
+ */
+StegoStatus Stego::decodeImageFileName(cv::Mat image)
+{
+    StegoStatus status = decodeHeader(image);
+    if (status != StegoStatus::SUCCESS)
+    {
+        return status;
+    }
+
+    // PVD marks the pixel pairs it embedded in, only LSB needs the edges to extract
+    if (this->algo == StegoAlgo::LSB && this->edgeDetectionType != EdgeDetectionType::None)
+    {
+        context.edgeDetector = EdgeDetection(context.bufferPool.get(), this->edgeCache.get());
+        context.edgeDetector.BeginDetection(image, this->edgeDetectionType);
+        detectEdgesFor((context.fileNameLength + context.fileLength) * BITS_PER_BYTE);
+    }
+
+    if (this->algo == StegoAlgo::LSB)
+    {
+        status = decodeLsbFileName(image);
+    }
+    else if (this->algo == StegoAlgo::PVD)
+    {
+        status = decodePvdFileName(image);
+    }
+
+    context.payloadRow = context.currentRow;
+    context.payloadColumn = context.currentColumn;
+    context.payloadBit = context.currentBit;
+
+    return status;
+}
+
+/**
+ * @brief Stego::decodeImageFile Decode the file from image into file. Must be called after decodeImageFileName.
+ */
+StegoStatus Stego::decodeImageFile(cv::Mat image, std::ostream& file)
+{
+    uint64_t bytesWritten = 0;
+    std::bitset<8> dataByte;
+    size_t dataByteIndex = 0;
+
+    StegoStatus status = StegoStatus::SUCCESS;
+    if (useParallelKernels(image))
+    {
+        if (this->algo == StegoAlgo::LSB)
+        {
+            status = decodeLsbFileParallel(image, file);
+        }
+        else if (this->algo == StegoAlgo::PVD)
+        {
+            status = decodePvdFileParallel(image, file);
+        }
+    }
+    else if (this->algo == StegoAlgo::LSB)
+    {
+        status = decodeLsbFile(image, file, bytesWritten, dataByte, dataByteIndex);
+    }
+    else if (this->algo == StegoAlgo::PVD)
+    {
+        status = decodePvdFile(image, file, bytesWritten, dataByte, dataByteIndex);
+    }
+
+    return status;
+}
+
+/**
+ * @brief Stego::decodeImageRange Decode length bytes of the payload from offset on into file. Must be called after
+ * decodeImageFileName. LSB skips the bytes before offset without decoding them: the cursor moves straight to the
+ * sample holding offset, counting only the edge pixels with edge detection. PVD carries a varying number of bits
+ * per pixel pair, so the pairs before offset are still read, but nothing is written for them.
+ * @param length Bytes to decode, cut short at the end of the payload
+ * @return StegoStatus::INVALID_RANGE if offset is past the end of the payload, StegoStatus::INVALID_MEDIA if the image
+ * ends before the range, StegoStatus::SUCCESS otherwise
+ */
+StegoStatus Stego::decodeImageRange(cv::Mat image, uint64_t offset, uint64_t length, std::ostream& file)
+{
+    uint64_t payloadLength = context.fileLength;
+    if (offset > payloadLength)
+    {
+        return StegoStatus::INVALID_RANGE;
+    }
+
+    length = std::min(length, payloadLength - offset);
+    if (length == 0)
+    {
+        return StegoStatus::SUCCESS;
+    }
+
+    context.currentRow = context.payloadRow;
+    context.currentColumn = context.payloadColumn;
+    context.currentBit = context.payloadBit;
+
+    if (this->algo == StegoAlgo::PVD)
+    {
+        RangeBitSink sink(file, offset * BITS_PER_BYTE, length);
+        if (this->edgeDetectionType != EdgeDetectionType::None)
+        {
+            extractPvdPairs<true>(sink);
+        }
+        else
+        {
+            extractPvdPairs<false>(sink);
+        }
+
+        return sink.Full() ? StegoStatus::SUCCESS : StegoStatus::INVALID_MEDIA;
+    }
+
+    uint64_t numSkippedBits = offset * BITS_PER_BYTE;
+    if (!skipLsbBits(image, numSkippedBits))
+    {
+        return StegoStatus::INVALID_MEDIA;
+    }
+
+    uint64_t bytesWritten = 0;
+    std::bitset<8> dataByte;
+    size_t dataByteIndex = 0;
+    context.fileLength = length;
+    StegoStatus status = decodeLsbFile(image, file, bytesWritten, dataByte, dataByteIndex);
+    context.fileLength = payloadLength;
+
+    if (status == StegoStatus::SUCCESS && bytesWritten < length)
+    {
+        status = StegoStatus::INVALID_MEDIA;
+    }
+
+    return status;
+}
+
+/**
+ * @brief Stego::skipLsbBits Move the cursor past numBits embedded bits. The kernels skip whole samples of lsbBits bits,
+ * the bits left over move the cursor on within the sample after them.
+ * @param numBits Bits to skip, set to the bits left to skip in the next frame if the image ends before them
+ * @return false if the image ends before them
+ */
+bool Stego::skipLsbBits(cv::Mat image, uint64_t& numBits)
+{
+    uint64_t numSampleBits = context.currentBit + numBits;
+    uint64_t numSamples = numSampleBits / this->lsbBits;
+    size_t bit = numSampleBits % this->lsbBits;
+    context.currentBit = 0;
+
+    bool bEdges = this->edgeDetectionType != EdgeDetectionType::None;
+    bool bSkipped = bEdges ? skipLsbBitsKernel<true>(image, numSamples) : skipLsbBitsKernel<false>(image, numSamples);
+    if (bSkipped && bEdges && bit != 0)
+    {
+        // The bits left over are in the next edge sample, the kernel may stop on a sample between edges
+        size_t nRows = image.rows;
+        size_t nCols = image.cols * image.channels();
+        if (image.isContinuous())
+        {
+            nCols *= nRows;
+            nRows = 1;
+        }
+
+        Mat edges = context.edgeDetector.GetMagnitudes();
+        while (context.currentRow < nRows && edges.ptr<uchar>(context.currentRow)[context.currentColumn / 3] == 0)
+        {
+            context.currentColumn++;
+            if (context.currentColumn >= nCols)
+            {
+                context.currentColumn = 0;
+                context.currentRow++;
+            }
+        }
+
+        bSkipped = context.currentRow < nRows;
+    }
+
+    if (!bSkipped)
+    {
+        numBits = numSamples * this->lsbBits + bit;
+        return false;
+    }
+
+    numBits = 0;
+    context.currentBit = bit;
+
+    return true;
+}
+
+/**
+ * @brief Stego::skipLsbBitsKernel Move the cursor past numSamples samples that hold embedded bits, in the same order
+ * as decodeLsbFileKernel reads them.
+ * @param numSamples Samples to skip, set to the samples left to skip in the next frame if the image ends before them
+ * @return false if the image ends before them
+ */
+template <bool bEdges>
+bool Stego::skipLsbBitsKernel(cv::Mat image, uint64_t& numSamples)
+{
+    size_t nRows = image.rows;
+    size_t nCols = image.cols * image.channels();
+    if (image.isContinuous())
+    {
+        nCols *= nRows;
+        nRows = 1;
+    }
+
+    if constexpr (!bEdges)
+    {
+        uint64_t sample = context.currentRow * nCols + context.currentColumn + numSamples;
+        uint64_t numFrameSamples = static_cast<uint64_t>(nRows) * nCols;
+        if (sample >= numFrameSamples)
+        {
+            numSamples = sample - numFrameSamples;
+            context.currentRow = nRows;
+            context.currentColumn = 0;
+            return false;
+        }
+
+        numSamples = 0;
+        context.currentRow = sample / nCols;
+        context.currentColumn = sample % nCols;
+
+        return true;
+    }
+
+    // Every sample of an edge pixel holds bits, runs of pixels are counted at once
+    Mat edges = context.edgeDetector.GetMagnitudes();
+    size_t pixelsPerRow = nCols / 3;
+    while (context.currentRow < nRows)
+    {
+        const uchar* edgeRow = edges.ptr<uchar>(context.currentRow);
+        while (context.currentColumn % 3 != 0 && numSamples > 0)
+        {
+            numSamples -= edgeRow[context.currentColumn / 3] != 0 ? 1 : 0;
+            context.currentColumn++;
+        }
+
+        if (numSamples == 0 && context.currentColumn < nCols)
+        {
+            return true;
+        }
+
+        size_t pixel = context.currentColumn / 3;
+        while (numSamples > 0 && pixel < pixelsPerRow)
+        {
+            size_t runEnd = std::min(pixelsPerRow, pixel + LSB_SKIP_RUN_PIXELS);
+            uint64_t runSamples = 3 * static_cast<uint64_t>(countNonZero(Mat(1, static_cast<int>(runEnd - pixel),
+                                                                             CV_8UC1, const_cast<uchar*>(edgeRow + pixel))));
+            if (runSamples >= numSamples)
+            {
+                break;
+            }
+
+            numSamples -= runSamples;
+            pixel = runEnd;
+        }
+
+        for (; numSamples > 0 && pixel < pixelsPerRow; pixel++)
+        {
+            if (edgeRow[pixel] == 0)
+            {
+                continue;
+            }
+
+            if (numSamples < 3)
+            {
+                context.currentColumn = pixel * 3 + numSamples;
+                numSamples = 0;
+                return true;
+            }
+
+            numSamples -= 3;
+        }
+
+        if (numSamples == 0 && pixel < pixelsPerRow)
+        {
+            context.currentColumn = pixel * 3;
+            return true;
+        }
+
+        context.currentColumn = 0;
+        context.currentRow++;
+        if (numSamples == 0)
+        {
+            return context.currentRow < nRows;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Stego::encryptBuffer Encrypt data in memory with the password, same format as EncryptFile.
+ */
+StegoStatus Stego::encryptBuffer(const uint8_t* data, size_t size, std::string& encrypted)
+{
+    CryptoPP::DefaultEncryptorWithMAC encryptor((CryptoPP::byte*)password.data(), password.size(), new CryptoPP::StringSink(encrypted));
+    CryptoPP::ArraySource arraySource(data, size, true, new CryptoPP::Redirector(encryptor));
+
+    return StegoStatus::SUCCESS;
+}
+
+/**
+ * @brief Stego::decryptBuffer Decrypt data in memory with the password, replacing it with the plaintext.
+ */
+StegoStatus Stego::decryptBuffer(std::vector<uint8_t>& data)
+{
+    std::string decrypted;
+    try {
+        CryptoPP::DefaultDecryptorWithMAC decryptor((CryptoPP::byte*)password.data(), password.size(),
+                                             new CryptoPP::StringSink(decrypted));
+        CryptoPP::ArraySource arraySource(data.data(), data.size(), true, new CryptoPP::Redirector(decryptor));
+    }
+    catch (const CryptoPP::Exception& e) {
+        qDebug() << "Crypto++ exception: " << e.what();
+        return StegoStatus::DECRYPTION_FAILED;
+    }
+
+    data.assign(decrypted.begin(), decrypted.end());
+
+    return StegoStatus::SUCCESS;
+}
+
+/**
+ * @brief Stego::deflateBuffer Compress data in memory, same format as compressFile.
+ */
+StegoStatus Stego::deflateBuffer(const uint8_t* data, size_t size, std::string& compressed)
+{
+    CryptoPP::ArraySource arraySource(data, size, true, new CryptoPP::Deflator(new CryptoPP::StringSink(compressed)));
+
+    return StegoStatus::SUCCESS;
+}
+
+/**
+ * @brief Stego::inflateBuffer Decompress data in memory, replacing it with the original bytes. Stops with
+ * StegoStatus::DECOMPRESSION_FAILED once the data inflates past the inflate limit.
+ */
+StegoStatus Stego::inflateBuffer(std::vector<uint8_t>& data)
+{
+    std::string inflated;
+    uint64_t maxBytes = inflateLimit(data.size(), this->maxInflatedBytes);
+    try {
+        CryptoPP::ArraySource arraySource(data.data(), data.size(), true, new CryptoPP::Inflator(
+                                              new InflateLimitFilter(maxBytes, new CryptoPP::StringSink(inflated))));
+    }
+    catch (const CryptoPP::Exception& e) {
+        qDebug() << "Crypto++ exception: " << e.what();
+        return StegoStatus::DECOMPRESSION_FAILED;
+    }
+
+    data.assign(inflated.begin(), inflated.end());
+
+    return StegoStatus::SUCCESS;
+}
+
+/**
+ * @brief Stego::EncodeVideo Encode stegonographic data into video based on given algorithms.
+ * @return StegoStatus::SUCCESS if encoding was succesful, error code otherwise.
+ */
+StegoStatus Stego::EncodeVideo()
+{
+    resetContext();
+
+    FrameSource video(this->frameSourceType, context.bufferPool.get());
+    if (!video.Open(this->mediaPath))
+    {
+        qDebug()  << "Could not open video " << this->mediaPath;
+        return StegoStatus::VIDEO_OPEN_FAILED;
+    }
+
+    // Get first video frame
+    Mat frame;
+    video >> frame;
+
+    // Edges are detected frame by frame, only as far as the payload reaches
+    if (this->edgeDetectionType != EdgeDetectionType::None)
+    {
+        context.edgeDetector = EdgeDetection(context.bufferPool.get(), this->edgeCache.get());
+    }
+
+    // An interrupted run of the same encode is resumed after its last checkpoint
+    StegoJournal journal;
+    std::filesystem::path checkpointDirectory;
+    bool bResume = false;
+    if (this->checkpointInterval != 0)
+    {
+        journal.key = checkpointKey();
+        checkpointDirectory = this->workingDirectory / ".stego_checkpoint" / StegoJournal::KeyName(journal.key);
+        bResume = loadCheckpoint(checkpointDirectory, journal, frame.size());
+    }
+
+    // Encode stego header into first frame of video
+    StegoStatus status = compressFile();
+    if (status != StegoStatus::SUCCESS)
+    {
+        return status;
+    }
+
+    context.bCompressed = this->bFileCompressed;
+    context.bArchive = this->bFileArchived;
+    status = readFileLength();
+    if (status != StegoStatus::SUCCESS)
+    {
+        return status;
+    }
+
+    status = encodeHeader(frame);
+    if (status != StegoStatus::SUCCESS)
+    {
+        return status;
+    }
+
+    if (this->checkpointInterval != 0 && !bResume)
+    {
+        status = startCheckpoint(checkpointDirectory, journal);
+        if (status != StegoStatus::SUCCESS)
+        {
+            return status;
+        }
+    }
+
+    std::ifstream file(this->filePath, std::ios_base::binary);
+    std::bitset<8> dataByte;
+    size_t dataByteIndex = 0;
+
+    // Get first byte of file for writing
+    char fileByte = 0;
+    file.get(fileByte);
+    dataByte = std::bitset<8>(fileByte);
+
+    // Create stego media directory, if it does not exist
+    std::filesystem::path stegoMediaDirectory = getOutputDirectory("stego_media");
+    std::filesystem::path tempFramesDirectory = checkpointDirectory.empty() ? createTempDirectory()
+                                                                            : checkpointDirectory / "frames";
+    std::filesystem::create_directories(stegoMediaDirectory);
+
+    std::string mediaName = std::filesystem::path(this->mediaPath).filename().string();
+    std::string stegoMediaPath = (stegoMediaDirectory / mediaName).string();
+    this->outputPath = stegoMediaPath;
+    size_t frameCount = 0;
+    bool bFileNameEmbedded = false;
+    bool bPayloadEnd = false;
+
+    if (bResume)
+    {
+        // The frames up to the checkpoint are on disk, embedding carries on with the next one
+        const StegoJournalSegment& segment = journal.segments.back();
+        for (; frameCount < segment.endFrame && !frame.empty(); frameCount++)
+        {
+            video >> frame;
+        }
+
+        context.currentRow = 0;
+        context.currentColumn = 0;
+        context.currentBit = 0;
+        file.clear();
+        file.seekg(segment.payloadOffset);
+        dataByte = std::bitset<8>(segment.dataByte);
+        dataByteIndex = segment.dataByteIndex;
+        bFileNameEmbedded = segment.bFileNameEmbedded;
+        bPayloadEnd = segment.bPayloadEnd;
+        if (bPayloadEnd)
+        {
+            // Fails at the end of the payload and leaves the stream at eof, like the run that was interrupted
+            file.get(fileByte);
+        }
+    }
+
+    while (!frame.empty() && !bPayloadEnd)
+    {
+        QCoreApplication::processEvents();
+        frameCount++;
+        if (this->edgeDetectionType != EdgeDetectionType::None)
+        {
+            context.edgeDetector.BeginDetection(frame, this->edgeDetectionType);
+        }
+
+        if (this->algo == StegoAlgo::LSB)
+        {
+            if (this->edgeDetectionType != EdgeDetectionType::None)
+            {
+                detectEdgesFor(remainingPayloadBits(file, dataByteIndex, bFileNameEmbedded));
+            }
+
+            if (!bFileNameEmbedded)
+            {
+                status = encodeLsbFileName(frame);
+                if (status == StegoStatus::SUCCESS)
+                {
+                    bFileNameEmbedded = true;
+                }
+                else if (status != StegoStatus::OUT_OF_ROOM)
+                {
+                    return status;
+                }
+            }
+
+
+            if (bFileNameEmbedded)
+            {
+                status = encodeLsbFile(frame, file, dataByte, dataByteIndex);
+                if (status != StegoStatus::SUCCESS)
+                {
+                    return status;
+                }
+            }
+        }
+        else if (this->algo == StegoAlgo::PVD)
+        {
+            // Setup PVD embeddings for frame
+            if (this->edgeDetectionType == EdgeDetectionType::None)
+            {
+                getPvdSequentialSize(frame);
+            }
+            else
+            {
+                getPvdEdgeSize(frame, remainingPayloadBits(file, dataByteIndex, bFileNameEmbedded));
+            }
+
+            if (!bFileNameEmbedded)
             {
                 status = encodePvdFileName();
                 if (status == StegoStatus::SUCCESS)
@@ -331,190 +2609,723 @@ StegoStatus Stego::EncodeVideo()
                 }
             }
 
-            if (bFileNameEmbedded)
+            if (bFileNameEmbedded)
+            {
+                status = encodePvdFile(file, dataByte, dataByteIndex);
+                if (status != StegoStatus::SUCCESS)
+                {
+                    return status;
+                }
+            }
+
+            Mat mergedChannels[3] = {context.blueChannel, context.greenChannel, context.redChannel};
+            merge(mergedChannels, 3, frame);
+        }
+
+        context.currentRow = 0;
+        context.currentColumn = 0;
+        context.currentBit = 0;
+
+        cv::imwrite((tempFramesDirectory / frameFileName(frameCount)).string(), frame);
+        checkpointFrame(checkpointDirectory, journal, frameCount, file, dataByte, dataByteIndex, bFileNameEmbedded);
+        video >> frame;
+
+        if (file.eof())
+        {
+            break;
+        }
+    }
+
+    // Check if file is at end or just ran out of frames and file is too big
+    if (file.eof())
+    {
+        while (!frame.empty())
+        {
+            QCoreApplication::processEvents();
+            frameCount++;
+            cv::imwrite((tempFramesDirectory / frameFileName(frameCount)).string(), frame);
+            checkpointFrame(checkpointDirectory, journal, frameCount, file, dataByte, dataByteIndex, bFileNameEmbedded);
+            video >> frame;
+        }
+
+        if (!reencodeVideo(tempFramesDirectory, video.FPS(), stegoMediaPath))
+        {
+            // With checkpoints the frames are kept, a retry only has to encode the video
+            if (checkpointDirectory.empty())
+            {
+                std::filesystem::remove_all(tempFramesDirectory);
+            }
+
+            video.Release();
+            file.close();
+
+            return StegoStatus::VIDEO_REENCODING_FAILED;
+        }
+    }
+    else
+    {
+        context.embedSize = file.tellg();
+        status = StegoStatus::FILE_TOO_LARGE;
+    }
+
+    std::filesystem::remove_all(checkpointDirectory.empty() ? tempFramesDirectory : checkpointDirectory);
+
+    video.Release();
+    file.close();
+
+    return status;
+}
+
+/**
+ * @brief Stego::reencodeVideo Encode the numbered frames in framesDirectory into stegoMediaPath with the video backend,
+ * with the audio of the media.
+ * @return false if ffmpeg failed
+ */
+bool Stego::reencodeVideo(const std::filesystem::path& framesDirectory, double videoFPS, const std::string& stegoMediaPath)
+{
+    std::ostringstream command;
+    command << "ffmpeg -loglevel error -y -framerate " << videoFPS << " -thread_queue_size 512 -i \"" << (framesDirectory / "frame_%06d.png").string() << "\" " << "-thread_queue_size 512 -i \"" << mediaPath << "\" "
+        << "-map 0:v -map 1:a?:0 " << this->videoBackend.EncoderArguments() << " -fflags +bitexact \"" << stegoMediaPath << "\"";
+
+    std::future<int> future = std::async(std::launch::async, callSystem, command.str());
+
+    while (future.wait_for(std::chrono::milliseconds(100)) != std::future_status::ready)
+    {
+        QCoreApplication::processEvents();
+    }
+
+    return future.get() == 0;
+}
+
+/**
+ * @brief Stego::decodeVideoFileName Read the first frames of video up to the end of the file name and decode the
+ * header and file name from them. frame is left at the frame the payload starts in, frameIndex counts it.
+ * @return StegoStatus::INVALID_MEDIA if the video ends in the file name, the status of the header otherwise
+ */
+StegoStatus Stego::decodeVideoFileName(FrameSource& video, cv::Mat& frame, size_t& frameIndex)
+{
+    frameIndex = 0;
+    video >> frame;
+    StegoStatus status = decodeHeader(frame, StegoCapacity::MaxFrameCount(video.FrameCount()));
+    if (status != StegoStatus::SUCCESS)
+    {
+        return status;
+    }
+
+    while (!frame.empty())
+    {
+        // PVD marks the pixel pairs it embedded in, only LSB needs the edges to extract
+        if (this->algo == StegoAlgo::LSB && this->edgeDetectionType != EdgeDetectionType::None)
+        {
+            context.edgeDetector = EdgeDetection(context.bufferPool.get(), this->edgeCache.get());
+            context.edgeDetector.BeginDetection(frame, this->edgeDetectionType);
+            detectEdgesFor((context.fileNameLength + context.fileLength) * BITS_PER_BYTE);
+        }
+
+        if (this->algo == StegoAlgo::LSB)
+        {
+            status = decodeLsbFileName(frame);
+            if (status == StegoStatus::SUCCESS)
+            {
+                break;
+            }
+            else if (status != StegoStatus::OUT_OF_ROOM)
+            {
+                return status;
+            }
+        }
+        else if (this->algo == StegoAlgo::PVD)
+        {
+            status = decodePvdFileName(frame);
+            if (status == StegoStatus::SUCCESS)
+            {
+                break;
+            }
+            else if (status != StegoStatus::OUT_OF_ROOM)
+            {
+                return status;
+            }
+        }
+
+        context.currentColumn = 0;
+        context.currentRow = 0;
+        context.currentBit = 0;
+        video >> frame;
+        frameIndex++;
+    }
+
+    return frame.empty() ? StegoStatus::INVALID_MEDIA : StegoStatus::SUCCESS;
+}
+
+StegoStatus Stego::DecodeVideo()
+{
+    resetContext();
+    this->fileName = "";
+
+    FrameSource video(this->frameSourceType, context.bufferPool.get());
+    if (!video.Open(this->mediaPath))
+    {
+        qDebug()  << "Could not open video " << this->mediaPath;
+        return StegoStatus::VIDEO_OPEN_FAILED;
+    }
+
+    Mat frame;
+    size_t frameIndex = 0;
+    StegoStatus status = decodeVideoFileName(video, frame, frameIndex);
+    if (status != StegoStatus::SUCCESS)
+    {
+        return status;
+    }
+
+    std::filesystem::path filePath = decodedFilePath();
+    std::ofstream file(filePath, std::ios_base::binary);
+    uint64_t bytesWritten = 0;
+    std::bitset<8> dataByte;
+    size_t dataByteIndex = 0;
+
+    // The file starts in the frame the file name ends in, detection goes on where it stopped there
+    bool bNewFrame = false;
+    while (!frame.empty())
+    {
+        QCoreApplication::processEvents();
+
+        if (this->algo == StegoAlgo::LSB && this->edgeDetectionType != EdgeDetectionType::None)
+        {
+            if (bNewFrame)
             {
-                status = encodePvdFile(file, dataByte, dataByteIndex);
-                if (status != StegoStatus::SUCCESS)
-                {
-                    return status;
-                }
+                context.edgeDetector.BeginDetection(frame, this->edgeDetectionType);
             }
 
-            Mat mergedChannels[3] = {blueChannel, greenChannel, redChannel};
-            merge(mergedChannels, 3, frame);
+            detectEdgesFor((context.fileLength - bytesWritten) * BITS_PER_BYTE);
         }
 
-        currentRow = 0;
-        currentColumn = 0;
+        if (this->algo == StegoAlgo::LSB)
+        {
+            status = decodeLsbFile(frame, file, bytesWritten, dataByte, dataByteIndex);
+            if (status != StegoStatus::SUCCESS)
+            {
+                return status;
+            }
+        }
+        else if (this->algo == StegoAlgo::PVD)
+        {
+            status = decodePvdFile(frame, file, bytesWritten, dataByte, dataByteIndex);
+            if (status != StegoStatus::SUCCESS)
+            {
+                return status;
+            }
+        }
 
-        frameName.str("");
-        frameName.clear();
-        frameName << "frame_" << std::setw(6) << std::setfill('0') << frameCount << ".png";
-        cv::imwrite("stego_media/.temp/" + frameName.str(), frame);
         video >> frame;
+        bNewFrame = true;
 
-        if (file.eof())
+        if (bytesWritten >= context.fileLength)
         {
             break;
         }
     }
 
-    // Check if file is at end or just ran out of frames and file is too big
-    if (file.eof())
+    if (bytesWritten < context.fileLength)
     {
-        while (!frame.empty())
+        return StegoStatus::INVALID_MEDIA;
+    }
+
+    file.close();
+
+    return finishDecode(filePath);
+}
+
+/**
+ * @brief Stego::UpdateVideo Replace the payload embedded in the stego video at the media path by the file, like
+ * UpdateImage. The payload embedded is read first, up to its end, which gives the stream bit every frame before it
+ * ends at. Frames without a changed byte are then copied to the new video as they are, without edge detection, and
+ * the others only have their changed bytes embedded again.
+ * @return StegoStatus::INVALID_MEDIA if the payload was embedded with PVD or is a shard, StegoStatus::FILE_TOO_LARGE
+ * if the file does not fit, StegoStatus::SUCCESS otherwise
+ */
+StegoStatus Stego::UpdateVideo()
+{
+    resetContext();
+
+    FrameSource video(this->frameSourceType, context.bufferPool.get());
+    if (!video.Open(this->mediaPath))
+    {
+        qDebug()  << "Could not open video " << this->mediaPath;
+        return StegoStatus::VIDEO_OPEN_FAILED;
+    }
+
+    StegoStatus status = compressFile();
+    if (status != StegoStatus::SUCCESS)
+    {
+        return status;
+    }
+
+    context.bCompressed = this->bFileCompressed;
+    context.bArchive = this->bFileArchived;
+    status = readFileLength();
+    if (status != StegoStatus::SUCCESS)
+    {
+        return status;
+    }
+
+    Mat frame;
+    video >> frame;
+    StegoUpdate update;
+    status = beginUpdate(frame, StegoCapacity::MaxFrameCount(video.FrameCount()), update);
+    if (status != StegoStatus::SUCCESS)
+    {
+        return status;
+    }
+
+    while (!frame.empty())
+    {
+        QCoreApplication::processEvents();
+        if (this->edgeDetectionType != EdgeDetectionType::None)
         {
-            QCoreApplication::processEvents();
-            frameCount++;
-            frameName.str("");
-            frameName.clear();
-            frameName << "frame_" << std::setw(6) << std::setfill('0') << frameCount << ".png";
-            cv::imwrite("stego_media/.temp/" + frameName.str(), frame);
-            video >> frame;
+            context.edgeDetector = EdgeDetection(context.bufferPool.get(), this->edgeCache.get());
+            context.edgeDetector.BeginDetection(frame, this->edgeDetectionType);
         }
 
-        double videoFPS = video.get(CAP_PROP_FPS);
-        std::ostringstream command;
-        command << "ffmpeg -loglevel error -y -framerate " << videoFPS << " -thread_queue_size 512 -i " << "stego_media/.temp/frame_%06d.png " << "-thread_queue_size 512 -i \"" << mediaPath << "\" "
-            << "-map 0:v -map 1:a?:0 " << "-c:v ffv1 -pix_fmt bgr0 \"" << stegoMediaPath << "\"";
+        bool bStreamRead = extractUpdateStream(frame, update);
+        context.currentRow = 0;
+        context.currentColumn = 0;
+        context.currentBit = 0;
+        if (bStreamRead)
+        {
+            break;
+        }
+
+        video >> frame;
+    }
+
+    video.Release();
+
+    std::ifstream file(this->filePath, std::ios_base::binary);
+    readUpdateStream(file, update);
+
+    FrameSource stegoVideo(this->frameSourceType, context.bufferPool.get());
+    if (!stegoVideo.Open(this->mediaPath))
+    {
+        return StegoStatus::VIDEO_OPEN_FAILED;
+    }
+
+    std::filesystem::path stegoMediaDirectory = getOutputDirectory("stego_media");
+    std::filesystem::path tempFramesDirectory = createTempDirectory();
+    std::filesystem::create_directories(stegoMediaDirectory);
 
-        std::future<int> future = std::async(std::launch::async, callSystem, command.str());
+    std::string mediaName = std::filesystem::path(this->mediaPath).filename().string();
+    std::string stegoMediaPath = (stegoMediaDirectory / mediaName).string();
+    this->outputPath = stegoMediaPath;
 
-        while (future.wait_for(std::chrono::milliseconds(100)) != std::future_status::ready)
+    size_t frameCount = 0;
+    stegoVideo >> frame;
+    while (!frame.empty())
+    {
+        QCoreApplication::processEvents();
+        if (frameCount == 0)
         {
-            QCoreApplication::processEvents();
+            status = encodeHeader(frame);
+            if (status != StegoStatus::SUCCESS)
+            {
+                std::filesystem::remove_all(tempFramesDirectory);
+                return status;
+            }
         }
 
-        int status = future.get();
-        if (status != 0)
+        if (isFrameUpdated(frameCount, update))
         {
-            std::string deleteCommand = "rm -f stego_media/.temp/frame_*.png";
-            std::system(deleteCommand.c_str());
-
-            video.release();
-            file.close();
+            if (this->edgeDetectionType != EdgeDetectionType::None)
+            {
+                context.edgeDetector = EdgeDetection(context.bufferPool.get(), this->edgeCache.get());
+                context.edgeDetector.BeginDetection(frame, this->edgeDetectionType);
+            }
 
-            return StegoStatus::VIDEO_REENCODING_FAILED;
+            updateLsbFrame(frame, update);
+        }
+        else if (update.runIndex < update.runs.size())
+        {
+            update.streamBit = update.frameEndBits[frameCount];
         }
+
+        context.currentRow = 0;
+        context.currentColumn = 0;
+        context.currentBit = 0;
+
+        frameCount++;
+        cv::imwrite((tempFramesDirectory / frameFileName(frameCount)).string(), frame);
+        stegoVideo >> frame;
     }
-    else
+
+    if (update.runIndex < update.runs.size())
     {
-        embedSize = file.tellg();
         status = StegoStatus::FILE_TOO_LARGE;
     }
+    else if (!reencodeVideo(tempFramesDirectory, stegoVideo.FPS(), stegoMediaPath))
+    {
+        status = StegoStatus::VIDEO_REENCODING_FAILED;
+    }
+
+    std::filesystem::remove_all(tempFramesDirectory);
+    stegoVideo.Release();
+
+    return status;
+}
+
+/**
+ * @brief Stego::beginUpdate Read the header of the carrier of an update and take its mode over, the payload is embedded
+ * again with the same algorithm, edge detection and LSB bits, so the bits that stay the same stay where they are.
+ * The cursor is left after the header.
+ * @return StegoStatus::INVALID_MEDIA if the payload was embedded with PVD or is a shard, the status of the header
+ * otherwise
+ */
+StegoStatus Stego::beginUpdate(cv::Mat image, uint64_t numFrames, StegoUpdate& update)
+{
+    StegoHeader header;
+    StegoStatus status = header.Read(image);
+    if (status != StegoStatus::SUCCESS)
+    {
+        return status;
+    }
+
+    if (!header.FitsIn(image.total(), numFrames))
+    {
+        return StegoStatus::INVALID_HEADER;
+    }
+
+    // PVD embeds as many bits in a pixel pair as the pair allows and a shard holds a slice of a payload split by the
+    // capacity of every medium, both are encoded again instead
+    if (header.algo != StegoAlgo::LSB || header.bShard)
+    {
+        return StegoStatus::INVALID_MEDIA;
+    }
+
+    this->algo = header.algo;
+    this->edgeDetectionType = header.edgeDetectionType;
+    this->lsbBits = header.lsbBits;
+
+    // Headers of older versions take fewer pixels, the current one moves every bit after them
+    if (header.version == StegoHeader::CURRENT_VERSION)
+    {
+        update.oldStreamLength = header.fileNameLength + header.fileLength;
+    }
+
+    setCursorAfterHeader(image, header.NumPixels());
+
+    return StegoStatus::SUCCESS;
+}
+
+/**
+ * @brief Stego::extractUpdateStream Read the bytes of the old stream of the update frame holds, from the cursor on.
+ * Edge detection must have begun on frame.
+ * @return true once the whole old stream is read
+ */
+bool Stego::extractUpdateStream(cv::Mat frame, StegoUpdate& update)
+{
+    uint64_t bytesRead = update.oldStream.size();
+    if (bytesRead >= update.oldStreamLength)
+    {
+        return true;
+    }
+
+    if (this->edgeDetectionType != EdgeDetectionType::None)
+    {
+        detectEdgesFor((update.oldStreamLength - bytesRead) * BITS_PER_BYTE);
+    }
+
+    VectorWriteBuffer streamBuffer(update.oldStream);
+    std::ostream streamFile(&streamBuffer);
+    uint64_t fileLength = context.fileLength;
+    context.fileLength = update.oldStreamLength;
+    decodeLsbFile(frame, streamFile, bytesRead, update.dataByte, update.dataByteIndex);
+    context.fileLength = fileLength;
+
+    if (bytesRead >= update.oldStreamLength)
+    {
+        return true;
+    }
+
+    // The next frame goes on with the bits of the byte read last
+    update.frameEndBits.push_back(bytesRead * BITS_PER_BYTE + update.dataByteIndex % BITS_PER_BYTE);
+
+    return false;
+}
+
+/**
+ * @brief Stego::readUpdateStream Read the file name and the file into the stream of the update and find the runs of
+ * bytes that differ from the old stream. Runs less than LSB_UPDATE_MIN_GAP_BYTES apart are joined, embedding a bit
+ * again leaves its sample as it is.
+ */
+void Stego::readUpdateStream(std::istream& file, StegoUpdate& update)
+{
+    update.stream.assign(this->fileName.begin(), this->fileName.end());
+    update.stream.insert(update.stream.end(), std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+    uint64_t numOldBytes = std::min<uint64_t>(update.oldStream.size(), update.stream.size());
+    for (uint64_t position = 0; position < update.stream.size(); position++)
+    {
+        if (position < numOldBytes && update.stream[position] == update.oldStream[position])
+        {
+            continue;
+        }
+
+        if (!update.runs.empty() && position - update.runs.back().second < LSB_UPDATE_MIN_GAP_BYTES)
+        {
+            update.runs.back().second = position + 1;
+        }
+        else
+        {
+            update.runs.emplace_back(position, position + 1);
+        }
+    }
+}
+
+/**
+ * @brief Stego::isFrameUpdated Whether the frame with the given 0-based index holds a run of the update. Where the
+ * frames the old stream runs past end is known, the other frames may hold one.
+ */
+bool Stego::isFrameUpdated(size_t frameIndex, const StegoUpdate& update) const
+{
+    if (update.runIndex >= update.runs.size())
+    {
+        return false;
+    }
+
+    if (update.bInRun || frameIndex >= update.frameEndBits.size())
+    {
+        return true;
+    }
+
+    return update.frameEndBits[frameIndex] > update.runs[update.runIndex].first * BITS_PER_BYTE;
+}
+
+/**
+ * @brief Stego::updateLsbFrame Embed the runs of the update frame holds, from the cursor on. The cursor skips the
+ * bytes between the runs like decodeImageRange skips to a range. Edge detection must have begun on frame.
+ * @return true once every run is embedded, false if the frame ends before
+ */
+bool Stego::updateLsbFrame(cv::Mat frame, StegoUpdate& update)
+{
+    if (update.runIndex >= update.runs.size())
+    {
+        return true;
+    }
+
+    if (this->edgeDetectionType != EdgeDetectionType::None)
+    {
+        detectEdgesFor(update.runs.back().second * BITS_PER_BYTE - update.streamBit);
+    }
+
+    while (update.runIndex < update.runs.size())
+    {
+        const std::pair<uint64_t, uint64_t>& run = update.runs[update.runIndex];
+        if (!update.bInRun)
+        {
+            uint64_t runBit = run.first * BITS_PER_BYTE;
+            uint64_t numSkippedBits = runBit - update.streamBit;
+            bool bSkipped = skipLsbBits(frame, numSkippedBits);
+            update.streamBit = runBit - numSkippedBits;
+            if (!bSkipped)
+            {
+                return false;
+            }
+
+            update.bInRun = true;
+            update.runPosition = run.first;
+            update.dataByteIndex = BITS_PER_BYTE;
+        }
+
+        MemoryReadBuffer runBuffer(update.stream.data() + update.runPosition, run.second - update.runPosition);
+        std::istream runFile(&runBuffer);
+        encodeLsbFile(frame, runFile, update.dataByte, update.dataByteIndex);
+        update.runPosition = run.second - runBuffer.in_avail();
+        if (update.runPosition < run.second || update.dataByteIndex < BITS_PER_BYTE)
+        {
+            return false;
+        }
+
+        update.bInRun = false;
+        update.streamBit = run.second * BITS_PER_BYTE;
+        update.runIndex++;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Stego::updateImage Embed file in image in place of the payload it carries, see UpdateImage.
+ */
+StegoStatus Stego::updateImage(cv::Mat image, std::istream& file)
+{
+    StegoUpdate update;
+    StegoStatus status = beginUpdate(image, 1, update);
+    if (status != StegoStatus::SUCCESS)
+    {
+        return status;
+    }
+
+    if (this->edgeDetectionType != EdgeDetectionType::None)
+    {
+        context.edgeDetector = EdgeDetection(context.bufferPool.get(), this->edgeCache.get());
+        context.edgeDetector.BeginDetection(image, this->edgeDetectionType);
+    }
+
+    // The header length is untrusted, never reserve more than the image can hold
+    update.oldStream.reserve(std::min<uint64_t>(update.oldStreamLength, image.total() * image.channels()));
+    extractUpdateStream(image, update);
+    readUpdateStream(file, update);
+
+    status = encodeHeader(image);
+    if (status != StegoStatus::SUCCESS)
+    {
+        return status;
+    }
 
-    std::string deleteCommand = "rm -f stego_media/.temp/frame_*.png";
-    std::system(deleteCommand.c_str());
-
-    video.release();
-    file.close();
+    if (this->isFileTooLarge(image) || !updateLsbFrame(image, update))
+    {
+        return StegoStatus::FILE_TOO_LARGE;
+    }
 
-    return status;
+    return StegoStatus::SUCCESS;
 }
 
-StegoStatus Stego::DecodeVideo()
+/**
+ * @brief Stego::decodeVideoRange Decode length bytes of the payload from offset on into file. Must be called after
+ * decodeVideoFileName, frame and frameIndex are the frame the payload starts in. LSB skips the bytes before offset
+ * like decodeImageRange does. Without edge detection every frame holds the same number of bits, so the frames before
+ * the one holding offset are not decoded at all, video seeks straight past them. With edge detection and with PVD
+ * the capacity of a frame depends on its pixels, so those frames are still read, but nothing is written for them.
+ * @param length Bytes to decode, cut short at the end of the payload
+ * @return StegoStatus::INVALID_RANGE if offset is past the end of the payload, StegoStatus::INVALID_MEDIA if the video
+ * ends before the range, StegoStatus::SUCCESS otherwise
+ */
+StegoStatus Stego::decodeVideoRange(FrameSource& video, cv::Mat& frame, size_t frameIndex, uint64_t offset,
+                                    uint64_t length, std::ostream& file)
 {
-    VideoCapture video(this->mediaPath);
-    if (!video.isOpened())
+    if (offset > context.fileLength)
     {
-        qDebug()  << "Could not open video " << this->mediaPath;
-        return StegoStatus::VIDEO_OPEN_FAILED;
+        return StegoStatus::INVALID_RANGE;
     }
 
-    Mat frame;
-    video >> frame;
-    StegoStatus status = decodeHeader(frame);
-    if (status != StegoStatus::SUCCESS)
+    length = std::min(length, context.fileLength - offset);
+    if (length == 0)
     {
-        return status;
+        return StegoStatus::SUCCESS;
     }
 
-    while (!frame.empty())
+    bool bEdges = this->edgeDetectionType != EdgeDetectionType::None;
+    if (this->algo == StegoAlgo::PVD)
     {
-        if (this->edgeDetectionType != EdgeDetectionType::None)
+        // The sink drops the bits before offset and carries a partial byte on to the next frame
+        RangeBitSink sink(file, offset * BITS_PER_BYTE, length);
+        while (!frame.empty())
         {
-            this->edgeDetector = EdgeDetection();
-            this->edgeDetector.DetectEdges(frame, this->edgeDetectionType);
-        }
+            QCoreApplication::processEvents();
 
-        if (this->algo == StegoAlgo::LSB)
-        {
-            status = decodeLsbFileName(frame);
-            if (status == StegoStatus::SUCCESS)
-            {
-                break;
-            }
-            else if (status != StegoStatus::OUT_OF_ROOM)
+            splitChannels(frame);
+            if (bEdges)
             {
-                return status;
+                extractPvdPairs<true>(sink);
             }
-        }
-        else if (this->algo == StegoAlgo::PVD)
-        {
-            status = decodePvdFileName(frame);
-            if (status == StegoStatus::SUCCESS)
+            else
             {
-                break;
+                extractPvdPairs<false>(sink);
             }
-            else if (status != StegoStatus::OUT_OF_ROOM)
+
+            if (sink.Full())
             {
-                return status;
+                return StegoStatus::SUCCESS;
             }
-        }
 
-        currentColumn = 0;
-        currentRow = 0;
-        video >> frame;
-    }
+            context.currentRow = 0;
+            context.currentColumn = 0;
+            video >> frame;
+        }
 
-    std::filesystem::create_directory("decoded_files");
-    std::filesystem::path filePath = std::filesystem::path("decoded_files/" + this->fileName);
-    if (this->bEncrypt)
-    {
-        filePath = std::filesystem::path(tempEncryptFilePath);
+        return StegoStatus::INVALID_MEDIA;
     }
 
-    std::ofstream file(filePath, std::ios_base::binary);
-    size_t bytesWritten = 0;
-    std::bitset<8> dataByte;
-    size_t dataByteIndex = 0;
+    // Edge detection goes on where the file name stopped it in the first frame
+    bool bNewFrame = false;
+    uint64_t numSkippedBits = offset * BITS_PER_BYTE;
     while (!frame.empty())
     {
         QCoreApplication::processEvents();
 
-        if (this->edgeDetectionType != EdgeDetectionType::None)
+        if (bEdges)
         {
-            this->edgeDetector.DetectEdges(frame, this->edgeDetectionType);
+            if (bNewFrame)
+            {
+                context.edgeDetector.BeginDetection(frame, this->edgeDetectionType);
+                bNewFrame = false;
+            }
+
+            detectEdgesFor(numSkippedBits + length * BITS_PER_BYTE);
         }
 
-        if (this->algo == StegoAlgo::LSB)
+        if (skipLsbBits(frame, numSkippedBits))
         {
-            status = decodeLsbFile(frame, file, bytesWritten, dataByte, dataByteIndex);
-            if (status != StegoStatus::SUCCESS)
+            break;
+        }
+
+        uint64_t frameBits = static_cast<uint64_t>(frame.total()) * frame.channels() * this->lsbBits;
+        if (!bEdges && numSkippedBits >= frameBits)
+        {
+            uint64_t numSkippedFrames = numSkippedBits / frameBits;
+            if (!video.Seek(frameIndex + 1 + numSkippedFrames))
             {
-                return status;
+                return StegoStatus::INVALID_MEDIA;
             }
+
+            frameIndex += numSkippedFrames;
+            numSkippedBits %= frameBits;
         }
-        else if (this->algo == StegoAlgo::PVD)
+
+        context.currentRow = 0;
+        context.currentColumn = 0;
+        context.currentBit = 0;
+        video >> frame;
+        frameIndex++;
+        bNewFrame = true;
+    }
+
+    uint64_t payloadLength = context.fileLength;
+    uint64_t bytesWritten = 0;
+    std::bitset<8> dataByte;
+    size_t dataByteIndex = 0;
+    StegoStatus status = StegoStatus::SUCCESS;
+    context.fileLength = length;
+    while (!frame.empty())
+    {
+        if (bNewFrame)
         {
-            status = decodePvdFile(frame, file, bytesWritten, dataByte, dataByteIndex);
-            if (status != StegoStatus::SUCCESS)
+            QCoreApplication::processEvents();
+            if (bEdges)
             {
-                return status;
+                context.edgeDetector.BeginDetection(frame, this->edgeDetectionType);
             }
+
+            bNewFrame = false;
         }
 
-        video >> frame;
+        if (bEdges)
+        {
+            detectEdgesFor((length - bytesWritten) * BITS_PER_BYTE);
+        }
 
-        if (bytesWritten >= this->fileLength)
+        status = decodeLsbFile(frame, file, bytesWritten, dataByte, dataByteIndex);
+        if (status != StegoStatus::SUCCESS || bytesWritten >= length)
         {
             break;
         }
+
+        video >> frame;
+        bNewFrame = true;
     }
 
-    if (bytesWritten < this->fileLength)
+    context.fileLength = payloadLength;
+    if (status == StegoStatus::SUCCESS && bytesWritten < length)
     {
-        return StegoStatus::INVALID_MEDIA;
+        status = StegoStatus::INVALID_MEDIA;
     }
 
     return status;
@@ -522,249 +3333,708 @@ StegoStatus Stego::DecodeVideo()
 
 StegoStatus Stego::DecryptFile()
 {
-    std::ifstream file(tempEncryptFilePath, std::ios_base::binary);
-    std::ofstream decryptedFile("decoded_files/" + this->fileName, std::ios::binary);
+    std::filesystem::path decryptedFilePath = context.bArchive ? getTempArchiveFilePath()
+                                                               : getOutputDirectory("decoded_files") / this->fileName;
+    std::ifstream file(getTempEncryptFilePath(), std::ios_base::binary);
+    std::ofstream decryptedFile(decryptedFilePath, std::ios::binary);
     if (!file.is_open() || !decryptedFile.is_open()) {
         return StegoStatus::FILE_OPEN_FAILED;
     }
 
     try {
-        // Create FileSink and DefaultDecryptor objects
-        CryptoPP::DefaultDecryptorWithMAC decryptor((CryptoPP::byte*)password.data(), password.size(),
-                                             new CryptoPP::FileSink(decryptedFile));
+        // Create FileSink and DefaultDecryptor objects, compressed payloads are inflated as they are decrypted
+        CryptoPP::BufferedTransformation* fileSink = new CryptoPP::FileSink(decryptedFile);
+        if (context.bCompressed)
+        {
+            uint64_t maxBytes = inflateLimit(std::filesystem::file_size(getTempEncryptFilePath()),
+                                             this->maxInflatedBytes);
+            fileSink = new CryptoPP::Inflator(new InflateLimitFilter(maxBytes, fileSink));
+        }
+
+        CryptoPP::DefaultDecryptorWithMAC decryptor((CryptoPP::byte*)password.data(), password.size(), fileSink);
 
         // Create Redirector and FileSource objects
         CryptoPP::FileSource fileSource(file, true, new CryptoPP::Redirector(decryptor));
     }
+    catch (const CryptoPP::Inflator::Err& e) {
+        qDebug() << "Crypto++ exception: " << e.what();
+        decryptedFile.close();
+        std::filesystem::remove(decryptedFilePath);
+
+        return StegoStatus::DECOMPRESSION_FAILED;
+    }
     catch (const CryptoPP::Exception& e) {
         qDebug() << "Crypto++ exception: " << e.what();
-        std::remove(("decoded_files/" + this->fileName).c_str());
+        decryptedFile.close();
+        std::filesystem::remove(decryptedFilePath);
 
         return StegoStatus::DECRYPTION_FAILED;
     }
 
+    if (context.bArchive)
+    {
+        decryptedFile.close();
+        return unpackArchive(decryptedFilePath);
+    }
+
+    this->outputPath = decryptedFilePath.string();
+
     return StegoStatus::SUCCESS;
 }
 
 /**
- * Uses the LSB stego method to encode data in a image/video frame.
- * @brief Stego::encodeLsb
+ * @brief Stego::ExtractRange Extract length bytes of the payload from offset on, skipping the payload before them
+ * without decoding it where the embedding allows, see decodeImageRange and decodeVideoRange. The bytes are written
+ * next to where the whole payload would be decoded to, named after the file and the range. Offsets count in the
+ * embedded payload, so parts of compressed or encrypted payloads can not be extracted.
+ * @param length Bytes to extract, cut short at the end of the payload
+ * @return StegoStatus::INVALID_RANGE if offset is past the end of the payload or the payload is compressed or
+ * encrypted, StegoStatus::SUCCESS otherwise. The output path is set to the extracted bytes.
  */
-StegoStatus Stego::encodeLsb(Mat image)
+StegoStatus Stego::ExtractRange(uint64_t offset, uint64_t length)
 {
-    StegoStatus status = encodeLsbFileName(image);
+    if (this->bEncrypt)
+    {
+        return StegoStatus::INVALID_RANGE;
+    }
+
+    resetContext();
+    this->fileName = "";
+
+    bool bVideo = std::filesystem::path(this->mediaPath).extension() == ".mkv";
+    FrameSource video(this->frameSourceType, context.bufferPool.get());
+    Mat frame;
+    size_t frameIndex = 0;
+    StegoStatus status = StegoStatus::SUCCESS;
+    if (bVideo)
+    {
+        if (!video.Open(this->mediaPath))
+        {
+            qDebug() << "Could not open video " << this->mediaPath;
+            return StegoStatus::VIDEO_OPEN_FAILED;
+        }
+
+        status = decodeVideoFileName(video, frame, frameIndex);
+    }
+    else
+    {
+        frame = imread(this->mediaPath, IMREAD_COLOR);
+        status = frame.empty() ? StegoStatus::IMAGE_NOT_FOUND : decodeImageFileName(frame);
+    }
+
     if (status != StegoStatus::SUCCESS)
     {
         return status;
     }
 
-    std::ifstream file(this->filePath, std::ios_base::binary);
+    if (context.bCompressed || offset > context.fileLength)
+    {
+        return StegoStatus::INVALID_RANGE;
+    }
 
+    length = std::min(length, context.fileLength - offset);
+    std::filesystem::create_directories(getOutputDirectory("decoded_files"));
+    std::filesystem::path filePath = getOutputDirectory("decoded_files") /
+                                     (this->fileName + "." + std::to_string(offset) + "-" +
+                                      std::to_string(offset + length));
+    {
+        std::ofstream file(filePath, std::ios_base::binary | std::ios_base::trunc);
+        if (!file.is_open())
+        {
+            return StegoStatus::FILE_OPEN_FAILED;
+        }
 
-    std::bitset<8> dataByte;
-    size_t dataByteIndex = 0;
+        status = bVideo ? decodeVideoRange(video, frame, frameIndex, offset, length, file)
+                        : decodeImageRange(frame, offset, length, file);
+    }
 
-    char fileByte;
-    file.get(fileByte);
-    dataByte = std::bitset<8>(fileByte);
+    if (status == StegoStatus::SUCCESS)
+    {
+        this->outputPath = filePath.string();
+    }
+
+    return status;
+}
+
+/**
+ * @brief Stego::ExtractMember Extract a single member of an archive payload to where decoding the whole archive
+ * would put it, see StegoArchive. The index and then only the member are decoded, the payload before them is skipped
+ * like ExtractRange skips it. Encrypted archives and archives compressed as a whole are decoded in full, but only
+ * the member is written out.
+ * @param memberName Name of the member, its path under the directory that was embedded with '/' separators
+ * @return StegoStatus::ARCHIVE_MEMBER_NOT_FOUND if the payload is no archive or has no such member,
+ * StegoStatus::SUCCESS otherwise. The output path is set to the extracted member.
+ */
+StegoStatus Stego::ExtractMember(const std::string& memberName)
+{
+    if (memberName.empty())
+    {
+        return StegoStatus::ARCHIVE_MEMBER_NOT_FOUND;
+    }
+
+    this->archiveMember = memberName;
+    bool bVideo = std::filesystem::path(this->mediaPath).extension() == ".mkv";
+    StegoStatus status = StegoStatus::SUCCESS;
+    if (this->bEncrypt)
+    {
+        status = bVideo ? DecodeVideo() : DecodeImage();
+        if (status == StegoStatus::SUCCESS)
+        {
+            status = DecryptFile();
+        }
+    }
+    else
+    {
+        std::function<StegoStatus(uint64_t, uint64_t, std::ostream&)> decodeRange;
+        status = openPayloadRanges(decodeRange);
+        if (status == StegoStatus::SUCCESS && context.bCompressed)
+        {
+            // An archive deflated as a whole has no offsets to skip to
+            status = bVideo ? DecodeVideo() : DecodeImage();
+        }
+        else if (status == StegoStatus::SUCCESS)
+        {
+            status = extractArchiveMember(decodeRange);
+        }
+    }
+
+    this->archiveMember.clear();
+
+    return status;
+}
+
+/**
+ * @brief Stego::extractArchiveMember Decode the index of the archive, then only the bytes of archiveMember.
+ * @param decodeRange Decodes a range of the payload, see decodeImageRange and decodeVideoRange
+ */
+StegoStatus Stego::extractArchiveMember(const std::function<StegoStatus(uint64_t, uint64_t, std::ostream&)>& decodeRange)
+{
+    std::vector<uint8_t> index;
+    VectorWriteBuffer indexBuffer(index);
+    std::ostream indexStream(&indexBuffer);
+    StegoStatus status = decodeRange(0, StegoArchive::PREFIX_BYTES, indexStream);
+
+    uint64_t indexSize = 0;
+    if (status == StegoStatus::SUCCESS)
+    {
+        status = StegoArchive::ReadIndexSize(index, context.fileLength, indexSize);
+    }
+
+    if (status == StegoStatus::SUCCESS)
+    {
+        status = decodeRange(StegoArchive::PREFIX_BYTES, indexSize - StegoArchive::PREFIX_BYTES, indexStream);
+    }
+
+    StegoArchive archive;
+    if (status == StegoStatus::SUCCESS)
+    {
+        status = archive.ReadIndex(index, context.fileLength);
+    }
 
-    status = encodeLsbFile(image, file, dataByte, dataByteIndex);
     if (status != StegoStatus::SUCCESS)
     {
         return status;
     }
 
-    file.close();
+    const StegoArchiveMember* member = archive.Find(this->archiveMember);
+    if (member == nullptr)
+    {
+        return StegoStatus::ARCHIVE_MEMBER_NOT_FOUND;
+    }
+
+    // Deflated members are decoded to a temp file and inflated from there
+    std::filesystem::path memberPath = getOutputDirectory("decoded_files") / this->fileName / member->name;
+    bool bDeflated = (member->flags & StegoArchive::FLAG_DEFLATED) != 0;
+    std::filesystem::path filePath = bDeflated ? getTempCompressFilePath() : memberPath;
+    std::filesystem::create_directories(memberPath.parent_path());
+    {
+        std::ofstream file(filePath, std::ios_base::binary | std::ios_base::trunc);
+        if (!file.is_open())
+        {
+            return StegoStatus::FILE_OPEN_FAILED;
+        }
+
+        status = decodeRange(archive.indexSize + member->offset, member->length, file);
+    }
+
+    if (status == StegoStatus::SUCCESS && bDeflated)
+    {
+        status = inflateFile(filePath, memberPath);
+    }
+
+    if (status == StegoStatus::SUCCESS)
+    {
+        this->outputPath = memberPath.string();
+    }
 
     return status;
 }
 
-StegoStatus Stego::encodePvd()
+/**
+ * @brief Stego::openPayloadRanges Decode the header and file name of the media and set decodeRange to decode ranges
+ * of its payload, see decodeImageRange and decodeVideoRange. Every range of a video is decoded from its first frame on
+ * again, an image is read once and kept by decodeRange.
+ */
+StegoStatus Stego::openPayloadRanges(std::function<StegoStatus(uint64_t, uint64_t, std::ostream&)>& decodeRange)
 {
-    StegoStatus status = encodePvdFileName();
-    if (status != StegoStatus::SUCCESS)
+    resetContext();
+    this->fileName = "";
+
+    if (std::filesystem::path(this->mediaPath).extension() == ".mkv")
     {
+        FrameSource video(this->frameSourceType, context.bufferPool.get());
+        Mat frame;
+        size_t frameIndex = 0;
+        StegoStatus status = video.Open(this->mediaPath) ? decodeVideoFileName(video, frame, frameIndex)
+                                                         : StegoStatus::VIDEO_OPEN_FAILED;
+        video.Release();
+
+        decodeRange = [this](uint64_t offset, uint64_t length, std::ostream& file)
+        {
+            resetContext();
+            FrameSource rangeVideo(this->frameSourceType, context.bufferPool.get());
+            Mat rangeFrame;
+            size_t rangeFrameIndex = 0;
+            if (!rangeVideo.Open(this->mediaPath))
+            {
+                return StegoStatus::VIDEO_OPEN_FAILED;
+            }
+
+            StegoStatus rangeStatus = decodeVideoFileName(rangeVideo, rangeFrame, rangeFrameIndex);
+            if (rangeStatus != StegoStatus::SUCCESS)
+            {
+                return rangeStatus;
+            }
+
+            return decodeVideoRange(rangeVideo, rangeFrame, rangeFrameIndex, offset, length, file);
+        };
+
         return status;
     }
 
-    std::ifstream file(this->filePath, std::ios_base::binary);
-    std::bitset<8> dataByte;
-    size_t dataByteIndex = 0;
+    Mat image = imread(this->mediaPath, IMREAD_COLOR);
+    if (image.empty())
+    {
+        return StegoStatus::IMAGE_NOT_FOUND;
+    }
 
-    char fileByte;
-    file.get(fileByte);
-    dataByte = std::bitset<8>(fileByte);
+    decodeRange = [this, image](uint64_t offset, uint64_t length, std::ostream& file)
+    {
+        return decodeImageRange(image, offset, length, file);
+    };
 
-    status = encodePvdFile(file, dataByte, dataByteIndex);
+    return decodeImageFileName(image);
+}
+
+/**
+ * @brief Stego::EncodeShards Split the file to embed across several media and encode the shards concurrently, for
+ * payloads no single medium holds. The capacities of the media are probed first and every medium gets a slice in
+ * proportion to its capacity, see StegoShard::Split, so the encode takes about as long as its slowest shard. The file
+ * is compressed once and, when EncryptFile was called, encrypted once, the slices are cut from the embedded bytes.
+ * Every stego medium is written to the output directory under its own name, the names must differ.
+ * @param mediaPaths Images and videos to embed in, in the order the shards are numbered
+ * @return StegoStatus::FILE_TOO_LARGE if the media together can not hold the file, the embed size is set to the bytes
+ * they hold. StegoStatus::INVALID_MEDIA if two media have the same name, the first failed shard's status otherwise.
+ * The output path is set to the output directory.
+ */
+StegoStatus Stego::EncodeShards(const std::vector<std::string>& mediaPaths)
+{
+    resetContext();
+
+    if (mediaPaths.empty())
+    {
+        return StegoStatus::IMAGE_NOT_FOUND;
+    }
+
+    std::set<std::string> mediaNames;
+    for (const std::string& mediaPath : mediaPaths)
+    {
+        if (!mediaNames.insert(std::filesystem::path(mediaPath).filename().string()).second)
+        {
+            return StegoStatus::INVALID_MEDIA;
+        }
+    }
+
+    StegoStatus status = compressFile();
+    if (status != StegoStatus::SUCCESS)
+    {
+        return status;
+    }
+
+    status = readFileLength();
     if (status != StegoStatus::SUCCESS)
     {
         return status;
     }
 
-    file.close();
+    WorkStealingThreadPool pool(std::min<size_t>(mediaPaths.size(), std::thread::hardware_concurrency()));
+    std::vector<uint64_t> capacities(mediaPaths.size(), 0);
+    std::vector<StegoStatus> statuses(mediaPaths.size(), StegoStatus::SUCCESS);
+    for (size_t i = 0; i < mediaPaths.size(); i++)
+    {
+        pool.Submit([this, &mediaPaths, &capacities, &statuses, i]()
+        {
+            Stego probe(mediaPaths[i], false, "");
+            probe.algo = this->algo;
+            probe.edgeDetectionType = this->edgeDetectionType;
+            probe.lsbBits = this->lsbBits;
+            probe.SetEdgeCache(this->edgeCache);
+            statuses[i] = probe.CalculateCapacity();
+            capacities[i] = probe.GetEmbedSize();
+        }, i % pool.NumThreads());
+    }
+
+    pool.Wait();
+
+    // Every shard embeds the file name and the shard prefix before its slice
+    uint64_t shardOverhead = this->fileName.size() + StegoShard::PREFIX_BYTES;
+    uint64_t totalCapacity = 0;
+    bool bFits = true;
+    for (size_t i = 0; i < mediaPaths.size(); i++)
+    {
+        if (statuses[i] != StegoStatus::SUCCESS)
+        {
+            return statuses[i];
+        }
+
+        bFits = bFits && capacities[i] >= shardOverhead;
+        capacities[i] = capacities[i] > shardOverhead ? capacities[i] - shardOverhead : 0;
+        totalCapacity += capacities[i];
+    }
+
+    std::vector<uint64_t> sliceLengths = StegoShard::Split(context.fileLength, capacities);
+    if (!bFits || sliceLengths.empty())
+    {
+        context.embedSize = totalCapacity;
+        return StegoStatus::FILE_TOO_LARGE;
+    }
+
+    std::random_device randomDevice;
+    StegoShard shard;
+    shard.setId = (static_cast<uint64_t>(randomDevice()) << 32) | randomDevice();
+    shard.count = static_cast<uint32_t>(mediaPaths.size());
+    shard.payloadLength = context.fileLength;
+
+    std::filesystem::path shardDirectory = createTempDirectory();
+    std::filesystem::path stegoMediaDirectory = getOutputDirectory("stego_media");
+    std::filesystem::create_directories(stegoMediaDirectory);
+    for (size_t i = 0; i < mediaPaths.size(); i++)
+    {
+        pool.Submit([this, &mediaPaths, &sliceLengths, &statuses, &shardDirectory, &stegoMediaDirectory, shard, i]() mutable
+        {
+            shard.index = static_cast<uint32_t>(i);
+            statuses[i] = encodeShard(shard, sliceLengths[i], mediaPaths[i], shardDirectory, stegoMediaDirectory);
+        }, i % pool.NumThreads());
+
+        shard.offset += sliceLengths[i];
+    }
+
+    pool.Wait();
+
+    for (size_t i = 0; i < mediaPaths.size(); i++)
+    {
+        if (statuses[i] != StegoStatus::SUCCESS)
+        {
+            return statuses[i];
+        }
+    }
+
+    this->outputPath = stegoMediaDirectory.string();
 
-    return status;
+    return StegoStatus::SUCCESS;
 }
 
-StegoStatus Stego::encodeHeader(Mat image)
+/**
+ * @brief Stego::encodeShard Write the prefix of shard and its slice of sliceLength bytes to a file under
+ * shardDirectory and embed that in the medium at mediaPath, named after the file to embed. The shard's slice is read
+ * from where it starts in the file, so the shards of a set are cut concurrently.
+ */
+StegoStatus Stego::encodeShard(const StegoShard& shard, uint64_t sliceLength, const std::string& mediaPath,
+                               const std::filesystem::path& shardDirectory, const std::filesystem::path& stegoMediaDirectory)
 {
-    int channels = image.channels();
-    int nRows = image.rows;
-    int nCols = image.cols * channels;
-    if (image.isContinuous())
+    std::filesystem::path shardPath = shardDirectory / ("shard_" + std::to_string(shard.index) + ".tmp");
     {
-        nCols *= nRows;
-        nRows = 1;
+        std::ifstream file(this->filePath, std::ios_base::binary);
+        std::ofstream shardFile(shardPath, std::ios_base::binary | std::ios_base::trunc);
+        if (!file.is_open() || !shardFile.is_open())
+        {
+            return StegoStatus::FILE_OPEN_FAILED;
+        }
+
+        std::string prefix = shard.WritePrefix();
+        shardFile.write(prefix.data(), prefix.size());
+
+        file.seekg(static_cast<std::streamoff>(shard.offset));
+        std::vector<char> buffer(std::min<uint64_t>(sliceLength, SHARD_COPY_BYTES));
+        for (uint64_t remaining = sliceLength; remaining > 0;)
+        {
+            std::streamsize chunk = static_cast<std::streamsize>(std::min<uint64_t>(remaining, buffer.size()));
+            if (!file.read(buffer.data(), chunk))
+            {
+                return StegoStatus::FILE_NOT_FOUND;
+            }
+
+            shardFile.write(buffer.data(), chunk);
+            remaining -= chunk;
+        }
     }
 
-    uchar* row = image.ptr<uchar>(0);
+    // The shard embeds the name and flags of the whole file, its slice is embedded as it is
+    Stego shardStego(mediaPath, this->bEncrypt, this->password);
+    shardStego.filePath = shardPath.string();
+    shardStego.sourceFilePath = shardPath.string();
+    shardStego.fileName = this->fileName;
+    shardStego.algo = this->algo;
+    shardStego.edgeDetectionType = this->edgeDetectionType;
+    shardStego.lsbBits = this->lsbBits;
+    shardStego.bCompressionChecked = true;
+    shardStego.bFileCompressed = this->bFileCompressed;
+    shardStego.bFileArchived = this->bFileArchived;
+    shardStego.bShard = true;
+    shardStego.bParallel = false;
+    shardStego.workingDirectory = this->workingDirectory;
+    shardStego.outputDirectory = stegoMediaDirectory;
+    shardStego.stripBudget = this->stripBudget;
+    shardStego.videoBackend = this->videoBackend;
+    shardStego.frameSourceType = this->frameSourceType;
+    shardStego.SetEdgeCache(this->edgeCache);
+
+    bool bVideo = std::filesystem::path(mediaPath).extension() == ".mkv";
+    return bVideo ? shardStego.EncodeVideo() : shardStego.EncodeImage();
+}
+
+/**
+ * @brief Stego::DecodeShards Decode a payload split across media by EncodeShards. The media can be given in any order,
+ * every shard is decoded on a thread of its own and written to its offset in the decoded file, so the decode takes
+ * about as long as its slowest shard. Encrypted payloads are finished by DecryptFile, like after DecodeImage.
+ * @param mediaPaths Every medium of the set
+ * @return StegoStatus::SHARD_SET_INCOMPLETE if shards of the set are missing, StegoStatus::INVALID_MEDIA if the media
+ * hold no shards, shards of another set or a shard twice, the first failed shard's status otherwise. The output path
+ * is set to the decoded file.
+ */
+StegoStatus Stego::DecodeShards(const std::vector<std::string>& mediaPaths)
+{
+    resetContext();
+    this->fileName = "";
 
-    // Embed Algorithm in lsb of blue segment of first pixel
-    if (this->algo == StegoAlgo::LSB)
+    if (mediaPaths.empty())
     {
-        // 0
-        row[0] = clearBit(row[0], 0);
+        return StegoStatus::SHARD_SET_INCOMPLETE;
     }
-    else
+
+    StegoShardSet shardSet;
+    std::vector<StegoStatus> statuses(mediaPaths.size(), StegoStatus::SUCCESS);
+    WorkStealingThreadPool pool(std::min<size_t>(mediaPaths.size(), std::thread::hardware_concurrency()));
+    for (size_t i = 0; i < mediaPaths.size(); i++)
     {
-        // 1
-        row[0] = setBit(row[0], 0);
+        pool.Submit([this, &mediaPaths, &shardSet, &statuses, i]()
+        {
+            statuses[i] = decodeShard(mediaPaths[i], shardSet);
+        }, i % pool.NumThreads());
     }
 
-    // Embed Edge Detection in least 2 significant bits of green segment of first pixel
-    if (this->edgeDetectionType == EdgeDetectionType::None)
+    pool.Wait();
+
+    for (StegoStatus status : statuses)
     {
-        // 00
-        row[1] = clearBit(row[1], 0);
-        row[1] = clearBit(row[1], 1);
+        if (status != StegoStatus::SUCCESS)
+        {
+            return status;
+        }
     }
-    else if (this->edgeDetectionType == EdgeDetectionType::Canny)
+
+    for (bool bDecoded : shardSet.bDecoded)
     {
-        // 01
-        row[1] = setBit(row[1], 0);
-        row[1] = clearBit(row[1], 1);
+        if (!bDecoded)
+        {
+            return StegoStatus::SHARD_SET_INCOMPLETE;
+        }
     }
-    else if (this->edgeDetectionType == EdgeDetectionType::Sobel)
+
+    return finishDecode(shardSet.filePath);
+}
+
+/**
+ * @brief Stego::decodeShard Decode the shard in the medium at mediaPath and write its slice to shardSet's file. The
+ * first shard decoded takes the file name and flags of the payload and creates the file at its full length, so the
+ * slices can be written in any order.
+ */
+StegoStatus Stego::decodeShard(const std::string& mediaPath, StegoShardSet& shardSet)
+{
+    Stego shardStego(mediaPath, this->bEncrypt, this->password);
+    shardStego.bShard = true;
+    shardStego.bParallel = false;
+    shardStego.workingDirectory = this->workingDirectory;
+    shardStego.frameSourceType = this->frameSourceType;
+    shardStego.SetEdgeCache(this->edgeCache);
+
+    std::function<StegoStatus(uint64_t, uint64_t, std::ostream&)> decodeRange;
+    StegoStatus status = shardStego.openPayloadRanges(decodeRange);
+    if (status != StegoStatus::SUCCESS)
     {
-        // 11
-        row[1] = setBit(row[1], 0);
-        row[1] = setBit(row[1], 1);
+        return status;
     }
 
-    // Encryption status in least significant bit of red segment of first pixel
-    if (this->bEncrypt)
+    std::vector<uint8_t> prefixBytes;
+    VectorWriteBuffer prefixBuffer(prefixBytes);
+    std::ostream prefixStream(&prefixBuffer);
+    uint64_t shardLength = shardStego.context.fileLength;
+    status = decodeRange(0, StegoShard::PREFIX_BYTES, prefixStream);
+
+    StegoShard shard;
+    if (status == StegoStatus::SUCCESS)
     {
-        // 1
-        row[2] = setBit(row[2], 0);
+        status = shard.ReadPrefix(prefixBytes, shardLength);
     }
-    else
+
+    if (status != StegoStatus::SUCCESS)
     {
-        // 0
-        row[2] = clearBit(row[2], 0);
+        return StegoStatus::INVALID_MEDIA;
     }
 
-    // Embed File Name Length in Pixels 2-4
-    this->fileNameLength =  this->fileName.length();
-    std::bitset<18> fileNameLengthBits(fileNameLength);
-
-    size_t bitPos = 0;
-    this->currentColumn = 3;
-    for (; currentRow < nRows; currentRow++)
     {
-        row = image.ptr<uchar>(currentRow);
-        for (; currentColumn < nCols; currentColumn++)
+        std::lock_guard<std::mutex> lock(shardSet.mutex);
+        if (shardSet.bDecoded.empty())
         {
-            if (fileNameLengthBits[bitPos])
-            {
-                row[currentColumn] = setBit(row[currentColumn], 0);
-            }
-            else
-            {
-                row[currentColumn] = clearBit(row[currentColumn], 0);
-            }
+            shardSet.first = shard;
+            shardSet.bDecoded.assign(shard.count, false);
 
-            if (fileNameLengthBits[bitPos + 1])
-            {
-                row[currentColumn] = setBit(row[currentColumn], 1);
-            }
-            else
-            {
-                row[currentColumn] = clearBit(row[currentColumn], 1);
-            }
+            this->fileName = shardStego.fileName;
+            context.fileLength = shard.payloadLength;
+            context.bCompressed = shardStego.context.bCompressed;
+            context.bArchive = shardStego.context.bArchive;
+            shardSet.filePath = decodedFilePath();
 
-            bitPos += 2;
-            if (bitPos >= fileNameLengthBits.size())
+            std::ofstream file(shardSet.filePath, std::ios_base::binary | std::ios_base::trunc);
+            file.close();
+            std::error_code error;
+            std::filesystem::resize_file(shardSet.filePath, shard.payloadLength, error);
+            if (error)
             {
-                currentColumn++;
-                break;
+                return StegoStatus::FILE_OPEN_FAILED;
             }
         }
+        else if (shard.setId != shardSet.first.setId || shard.count != shardSet.first.count ||
+                 shard.payloadLength != shardSet.first.payloadLength || shardStego.fileName != this->fileName)
+        {
+            return StegoStatus::INVALID_MEDIA;
+        }
 
-        if (bitPos >= fileNameLengthBits.size())
+        if (shardSet.bDecoded[shard.index])
         {
-            break;
+            return StegoStatus::INVALID_MEDIA;
         }
 
-        currentColumn = 0;
+        shardSet.bDecoded[shard.index] = true;
     }
 
-    // Embed File Length in Pixels 5-10
-
-    try
+    std::fstream file(shardSet.filePath, std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+    if (!file.is_open())
     {
-        this->fileLength = std::filesystem::file_size(this->filePath);
-    } catch (std::filesystem::filesystem_error& e)
+        return StegoStatus::FILE_OPEN_FAILED;
+    }
+
+    file.seekp(static_cast<std::streamoff>(shard.offset));
+
+    return decodeRange(StegoShard::PREFIX_BYTES, shardLength - StegoShard::PREFIX_BYTES, file);
+}
+
+/**
+ * Uses the LSB stego method to encode data in a image/video frame.
+ * @brief Stego::encodeLsb
+ */
+StegoStatus Stego::encodeLsb(Mat image, std::istream& file)
+{
+    StegoStatus status = encodeLsbFileName(image);
+    if (status != StegoStatus::SUCCESS)
     {
-        qDebug() << e.what();
-        return StegoStatus::FILE_NOT_FOUND;
+        return status;
     }
 
-    std::bitset<36> fileLengthBits(fileLength);
-    bitPos = 0;
-    for (; currentRow < nRows; currentRow++)
+    if (useParallelKernels(image))
     {
-        row = image.ptr<uchar>(currentRow);
-        for (; currentColumn < nCols; currentColumn++)
+        std::vector<uchar> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (!data.empty())
         {
-            if (fileLengthBits[bitPos])
-            {
-                row[currentColumn] = setBit(row[currentColumn], 0);
-            }
-            else
-            {
-                row[currentColumn] = clearBit(row[currentColumn], 0);
-            }
+            return encodeLsbFileParallel(image, data);
+        }
+    }
 
-            if (fileLengthBits[bitPos + 1])
-            {
-                row[currentColumn] = setBit(row[currentColumn], 1);
-            }
-            else
-            {
-                row[currentColumn] = clearBit(row[currentColumn], 1);
-            }
+    std::bitset<8> dataByte;
+    size_t dataByteIndex = 0;
 
+    char fileByte = 0;
+    file.get(fileByte);
+    dataByte = std::bitset<8>(fileByte);
 
-            bitPos += 2;
-            if (bitPos >= fileLengthBits.size())
-            {
-                currentColumn++;
-                break;
-            }
-        }
+    return encodeLsbFile(image, file, dataByte, dataByteIndex);
+}
 
-        if (bitPos >= fileLengthBits.size())
+StegoStatus Stego::encodePvd(std::istream& file)
+{
+    StegoStatus status = encodePvdFileName();
+    if (status != StegoStatus::SUCCESS)
+    {
+        return status;
+    }
+
+    if (useParallelKernels(context.blueChannel))
+    {
+        std::vector<uchar> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (!data.empty())
         {
-            break;
+            return encodePvdFileParallel(data);
         }
+    }
+
+    std::bitset<8> dataByte;
+    size_t dataByteIndex = 0;
+
+    char fileByte = 0;
+    file.get(fileByte);
+    dataByte = std::bitset<8>(fileByte);
 
-        currentColumn = 0;
+    return encodePvdFile(file, dataByte, dataByteIndex);
+}
+
+StegoStatus Stego::encodeHeader(Mat image)
+{
+    StegoHeader header;
+    header.version = StegoHeader::CURRENT_VERSION;
+    header.algo = this->algo;
+    header.edgeDetectionType = this->edgeDetectionType;
+    header.bEncrypted = this->bEncrypt;
+    header.bCompressed = context.bCompressed;
+    header.bArchive = context.bArchive;
+    header.bShard = this->bShard;
+    header.lsbBits = static_cast<uint8_t>(this->lsbBits);
+    header.fileNameLength = this->fileName.length();
+    header.fileLength = context.fileLength;
+
+    StegoStatus status = header.Write(image);
+    if (status != StegoStatus::SUCCESS)
+    {
+        return status;
     }
 
+    context.fileNameLength = header.fileNameLength;
+    setCursorAfterHeader(image, header.NumPixels());
+
     return StegoStatus::SUCCESS;
 }
 
 StegoStatus Stego::encodeLsbFileName(cv::Mat image)
+{
+    if (this->edgeDetectionType != EdgeDetectionType::None)
+    {
+        return encodeLsbFileNameKernel<true>(image);
+    }
+
+    return encodeLsbFileNameKernel<false>(image);
+}
+
+template <bool bEdges>
+StegoStatus Stego::encodeLsbFileNameKernel(cv::Mat image)
 {
     int channels = image.channels();
     int nRows = image.rows;
@@ -778,14 +4048,14 @@ StegoStatus Stego::encodeLsbFileName(cv::Mat image)
     Mat edges;
     uchar* edgeRow;
     size_t edgeCol = 0;
-    if (edgeDetectionType != EdgeDetectionType::None)
+    if constexpr (bEdges)
     {
-        edges = edgeDetector.GetMagnitudes();
-        edgeRow = edges.ptr<uchar>(currentRow);
-        edgeCol = currentColumn / 3;
+        edges = context.edgeDetector.GetMagnitudes();
+        edgeRow = edges.ptr<uchar>(context.currentRow);
+        edgeCol = context.currentColumn / 3;
     }
 
-    uchar* imageRow = image.ptr<uchar>(currentRow);
+    uchar* imageRow = image.ptr<uchar>(context.currentRow);
 
     std::bitset<8> dataByte;
     for (size_t i = 0; i < this->fileName.size(); i++)
@@ -794,48 +4064,56 @@ StegoStatus Stego::encodeLsbFileName(cv::Mat image)
         size_t j = 0;
         while (j < dataByte.size())
         {
-            if (edgeDetectionType != EdgeDetectionType::None)
+            if constexpr (bEdges)
             {
                 // NOLINTBEGIN
                 if (edgeRow[edgeCol] == 0)
                 // NOLINTEND
                 {
-                    currentColumn++;
-                    edgeCol = currentColumn / 3;
+                    context.currentColumn++;
+                    edgeCol = context.currentColumn / 3;
                     continue;
                 }
             }
 
             if (dataByte[j])
             {
-                imageRow[currentColumn] = setBit(imageRow[currentColumn], 0);
+                imageRow[context.currentColumn] = setBit(imageRow[context.currentColumn], context.currentBit);
             }
             else
             {
-                imageRow[currentColumn] = clearBit(imageRow[currentColumn], 0);
+                imageRow[context.currentColumn] = clearBit(imageRow[context.currentColumn], context.currentBit);
             }
 
             j++;
-            currentColumn++;
-            edgeCol = currentColumn / 3;
 
-            if (currentColumn >= nCols)
+            // A sample holds lsbBits bits of the payload before the cursor moves on
+            if (++context.currentBit < this->lsbBits)
+            {
+                continue;
+            }
+
+            context.currentBit = 0;
+            context.currentColumn++;
+            edgeCol = context.currentColumn / 3;
+
+            if (context.currentColumn >= nCols)
             {
-                currentColumn = 0;
+                context.currentColumn = 0;
                 edgeCol = 0;
-                currentRow++;
-                if (currentRow >= nRows)
+                context.currentRow++;
+                if (context.currentRow >= nRows)
                 {
                     // Shouldn't happen. For debugging.
                     return StegoStatus::OUT_OF_ROOM;
                 }
                 else
                 {
-                    imageRow = image.ptr<uchar>(currentRow);
+                    imageRow = image.ptr<uchar>(context.currentRow);
 
-                    if (edgeDetectionType != EdgeDetectionType::None)
+                    if constexpr (bEdges)
                     {
-                        edgeRow = edges.ptr<uchar>(currentRow);
+                        edgeRow = edges.ptr<uchar>(context.currentRow);
                     }
                 }
             }
@@ -845,7 +4123,18 @@ StegoStatus Stego::encodeLsbFileName(cv::Mat image)
     return StegoStatus::SUCCESS;
 }
 
-StegoStatus Stego::encodeLsbFile(Mat image, std::ifstream& file, std::bitset<8>& dataByte, size_t& dataByteIndex)
+StegoStatus Stego::encodeLsbFile(Mat image, std::istream& file, std::bitset<8>& dataByte, size_t& dataByteIndex)
+{
+    if (this->edgeDetectionType != EdgeDetectionType::None)
+    {
+        return encodeLsbFileKernel<true>(image, file, dataByte, dataByteIndex);
+    }
+
+    return encodeLsbFileKernel<false>(image, file, dataByte, dataByteIndex);
+}
+
+template <bool bEdges>
+StegoStatus Stego::encodeLsbFileKernel(Mat image, std::istream& file, std::bitset<8>& dataByte, size_t& dataByteIndex)
 {
     int channels = image.channels();
     int nRows = image.rows;
@@ -859,14 +4148,14 @@ StegoStatus Stego::encodeLsbFile(Mat image, std::ifstream& file, std::bitset<8>&
     Mat edges;
     uchar* edgeRow;
     size_t edgeCol = 0;
-    if (edgeDetectionType != EdgeDetectionType::None)
+    if constexpr (bEdges)
     {
-        edges = edgeDetector.GetMagnitudes();
-        edgeRow = edges.ptr<uchar>(currentRow);
-        edgeCol = currentColumn / 3;
+        edges = context.edgeDetector.GetMagnitudes();
+        edgeRow = edges.ptr<uchar>(context.currentRow);
+        edgeCol = context.currentColumn / 3;
     }
 
-    uchar* imageRow = image.ptr<uchar>(currentRow);
+    uchar* imageRow = image.ptr<uchar>(context.currentRow);
     char fileByte;
 
     while (true)
@@ -885,24 +4174,24 @@ StegoStatus Stego::encodeLsbFile(Mat image, std::ifstream& file, std::bitset<8>&
 
         while (dataByteIndex < dataByte.size())
         {
-            if (edgeDetectionType != EdgeDetectionType::None)
+            if constexpr (bEdges)
             {
                 if (edgeRow[edgeCol] == 0)
                 {
-                    currentColumn++;
-                    edgeCol = currentColumn / 3;
-                    if (currentColumn >= nCols)
+                    context.currentColumn++;
+                    edgeCol = context.currentColumn / 3;
+                    if (context.currentColumn >= nCols)
                     {
-                        currentColumn = 0;
+                        context.currentColumn = 0;
                         edgeCol = 0;
-                        currentRow++;
-                        if (currentRow >= nRows)
+                        context.currentRow++;
+                        if (context.currentRow >= nRows)
                         {
                             break;
                         }
 
-                        imageRow = image.ptr<uchar>(currentRow);
-                        edgeRow = edges.ptr<uchar>(currentRow);
+                        imageRow = image.ptr<uchar>(context.currentRow);
+                        edgeRow = edges.ptr<uchar>(context.currentRow);
                     }
 
                     continue;
@@ -911,39 +4200,47 @@ StegoStatus Stego::encodeLsbFile(Mat image, std::ifstream& file, std::bitset<8>&
 
             if (dataByte[dataByteIndex])
             {
-                imageRow[currentColumn] = setBit(imageRow[currentColumn], 0);
+                imageRow[context.currentColumn] = setBit(imageRow[context.currentColumn], context.currentBit);
             }
             else
             {
-                imageRow[currentColumn] = clearBit(imageRow[currentColumn], 0);
+                imageRow[context.currentColumn] = clearBit(imageRow[context.currentColumn], context.currentBit);
             }
 
             dataByteIndex++;
-            currentColumn++;
-            edgeCol = currentColumn / 3;
 
-            if (currentColumn >= nCols)
+            // A sample holds lsbBits bits of the payload before the cursor moves on
+            if (++context.currentBit < this->lsbBits)
+            {
+                continue;
+            }
+
+            context.currentBit = 0;
+            context.currentColumn++;
+            edgeCol = context.currentColumn / 3;
+
+            if (context.currentColumn >= nCols)
             {
-                currentColumn = 0;
+                context.currentColumn = 0;
                 edgeCol = 0;
-                currentRow++;
-                if (currentRow >= nRows)
+                context.currentRow++;
+                if (context.currentRow >= nRows)
                 {
                     break;
                 }
                 else
                 {
-                    imageRow = image.ptr<uchar>(currentRow);
+                    imageRow = image.ptr<uchar>(context.currentRow);
 
-                    if (edgeDetectionType != EdgeDetectionType::None)
+                    if constexpr (bEdges)
                     {
-                        edgeRow = edges.ptr<uchar>(currentRow);
+                        edgeRow = edges.ptr<uchar>(context.currentRow);
                     }
                 }
             }
         }
 
-        if (currentRow >= nRows)
+        if (context.currentRow >= nRows)
         {
             break;
         }
@@ -954,338 +4251,146 @@ StegoStatus Stego::encodeLsbFile(Mat image, std::ifstream& file, std::bitset<8>&
 
 StegoStatus Stego::encodePvdFileName()
 {
-    currentColumn = currentColumn / 3;
-    int channels = this->blueChannel.channels();
-    int nRows = this->blueChannel.rows;
-    int nCols = this->blueChannel.cols * channels;
-    if (this->blueChannel.isContinuous())
+    context.currentColumn = context.currentColumn / 3;
+
+    FileNameBitSource source(this->fileName);
+    if (this->edgeDetectionType != EdgeDetectionType::None)
     {
-        nCols *= nRows;
-        nRows = 1;
+        embedPvdPairs<true>(source);
     }
-
-    uchar* blueRow;
-    uchar* greenRow;
-    uchar* redRow;
-    size_t numBitsToEmbed;
-
-    size_t fileNameIndex = 0;
-    size_t dataByteIndex = 0;
-    std::bitset<8> dataByte = std::bitset<8>(this->fileName[fileNameIndex]);
-    std::bitset<7> embeddingNumber = std::bitset<7>();
-    for (; currentRow < nRows; currentRow++)
+    else
     {
-        if (fileNameIndex >= fileName.size())
-        {
-            break;
-        }
-
-        blueRow = this->blueChannel.ptr<uchar>(currentRow);
-        greenRow = this->greenChannel.ptr<uchar>(currentRow);
-        redRow = this->redChannel.ptr<uchar>(currentRow);
-
-        for (; currentColumn < nCols; currentColumn += 2)
-        {
-            // No second pixel pair
-            if (currentColumn + 1 >= nCols)
-            {
-                break;
-            }
-
-            if (fileNameIndex >= fileName.size())
-            {
-                break;
-            }
-
-            numBitsToEmbed = blueEmbedding.at<uchar>(currentRow, currentColumn);
-            if (numBitsToEmbed)
-            {
-                for (size_t i = 0; i < numBitsToEmbed; i++)
-                {
-                    embeddingNumber[i] = dataByte[dataByteIndex];
-
-                    dataByteIndex++;
-                    if (dataByteIndex >= dataByte.size())
-                    {
-                        dataByteIndex = 0;
-                        fileNameIndex++;
-                        if (fileNameIndex >= fileName.size())
-                        {
-                            break;
-                        }
-
-                        dataByte = std::bitset<8>(this->fileName[fileNameIndex]);
-                    }
-                }
-
-                embedPvdPair(embeddingNumber, numBitsToEmbed, blueRow);
-                embeddingNumber.reset();
-            }
-            else
-            {
-                embedPvdOverhead(blueRow);
-            }
-
-
-
-            if (edgeDetectionType == EdgeDetectionType::None)
-            {
-                if (fileNameIndex >= fileName.size())
-                {
-                    break;
-                }
-
-                numBitsToEmbed = greenEmbedding.at<uchar>(currentRow, currentColumn);
-                if (numBitsToEmbed)
-                {
-                    for (size_t i = 0; i < numBitsToEmbed; i++)
-                    {
-                        embeddingNumber[i] = dataByte[dataByteIndex];
-
-                        dataByteIndex++;
-                        if (dataByteIndex >= dataByte.size())
-                        {
-                            dataByteIndex = 0;
-                            fileNameIndex++;
-                            if (fileNameIndex >= fileName.size())
-                            {
-                                break;
-                            }
-
-                            dataByte = std::bitset<8>(this->fileName[fileNameIndex]);
-                        }
-                    }
-
-                    embedPvdPair(embeddingNumber, numBitsToEmbed, greenRow);
-                    embeddingNumber.reset();
-                }
-                else
-                {
-                    embedPvdOverhead(greenRow);
-                }
-            }
-            else
-            {
-                if (numBitsToEmbed != 0 || redEmbedding.at<uchar>(currentRow, currentColumn) != 0)
-                {
-                    greenRow[currentColumn] = setBit(greenRow[currentColumn], 0);
-                }
-                else
-                {
-                    greenRow[currentColumn] = clearBit(greenRow[currentColumn], 0);
-                }
-            }
-
-            if (fileNameIndex >= fileName.size())
-            {
-                break;
-            }
-
-            numBitsToEmbed = redEmbedding.at<uchar>(currentRow, currentColumn);
-            if (numBitsToEmbed)
-            {
-                for (size_t i = 0; i < numBitsToEmbed; i++)
-                {
-                    embeddingNumber[i] = dataByte[dataByteIndex];
+        embedPvdPairs<false>(source);
+    }
 
-                    dataByteIndex++;
-                    if (dataByteIndex >= dataByte.size())
-                    {
-                        dataByteIndex = 0;
-                        fileNameIndex++;
-                        if (fileNameIndex >= fileName.size())
-                        {
-                            break;
-                        }
+    context.currentColumn += 2;
 
-                        dataByte = std::bitset<8>(this->fileName[fileNameIndex]);
-                    }
-                }
+    return StegoStatus::SUCCESS;
+}
 
-                embedPvdPair(embeddingNumber, numBitsToEmbed, redRow);
-                embeddingNumber.reset();
-            }
-            else
-            {
-                embedPvdOverhead(redRow);
-            }
-        }
+StegoStatus Stego::encodePvdFile(std::istream& file, std::bitset<8>& dataByte, size_t& dataByteIndex)
+{
+    StreamBitSource source(file, dataByte, dataByteIndex);
+    if (this->edgeDetectionType != EdgeDetectionType::None)
+    {
+        embedPvdPairs<true>(source);
+    }
+    else
+    {
+        embedPvdPairs<false>(source);
+    }
 
-        if (fileNameIndex >= fileName.size())
+    return StegoStatus::SUCCESS;
+}
+
+/**
+ * @brief Stego::embedPvdBlock Embed the next numBits bits of source in one channel of a pixel pair, or only
+ * the overhead if the channel carries no data. Bits past the end of source are zero.
+ */
+template <typename BitSource>
+void Stego::embedPvdBlock(uchar* pair, size_t numBits, BitSource& source)
+{
+    if (numBits == 0)
+    {
+        embedPvdOverhead(pair);
+        return;
+    }
+
+    std::bitset<7> embeddingNumber;
+    for (size_t i = 0; i < numBits; i++)
+    {
+        embeddingNumber[i] = source.NextBit();
+        if (source.Empty())
         {
             break;
         }
-
-        currentColumn = 0;
     }
 
-    currentColumn += 2;
-
-    return StegoStatus::SUCCESS;
+    embedPvdPair(embeddingNumber, numBits, pair);
 }
 
-StegoStatus Stego::encodePvdFile(std::ifstream& file, std::bitset<8>& dataByte, size_t& dataByteIndex)
+/**
+ * @brief Stego::embedPvdPairs Embed source in the pixel pairs from the current position until it runs out.
+ * With edge detection the green channel carries the edge flag instead of data.
+ */
+template <bool bEdges, typename BitSource>
+void Stego::embedPvdPairs(BitSource& source)
 {
-    int channels = this->blueChannel.channels();
-    int nRows = this->blueChannel.rows;
-    int nCols = this->blueChannel.cols * channels;
-    if (this->blueChannel.isContinuous())
+    int channels = context.blueChannel.channels();
+    int nRows = context.blueChannel.rows;
+    int nCols = context.blueChannel.cols * channels;
+    if (context.blueChannel.isContinuous())
     {
         nCols *= nRows;
         nRows = 1;
     }
 
-    uchar* blueRow;
-    uchar* greenRow;
-    uchar* redRow;
-    size_t numBitsToEmbed;
-
-    std::bitset<7> embeddingNumber = std::bitset<7>();
-
-    char fileByte;
-    size_t bytesWritten = 0;
-    for (; currentRow < nRows; currentRow++)
+    for (; context.currentRow < nRows; context.currentRow++)
     {
-        if (file.fail())
+        if (source.Empty())
         {
             break;
         }
 
-        blueRow = this->blueChannel.ptr<uchar>(currentRow);
-        greenRow = this->greenChannel.ptr<uchar>(currentRow);
-        redRow = this->redChannel.ptr<uchar>(currentRow);
+        uchar* blueRow = context.blueChannel.ptr<uchar>(context.currentRow);
+        uchar* greenRow = context.greenChannel.ptr<uchar>(context.currentRow);
+        uchar* redRow = context.redChannel.ptr<uchar>(context.currentRow);
+        const uchar* blueBits = context.blueEmbedding.ptr<uchar>(context.currentRow);
+        const uchar* greenBits = context.greenEmbedding.ptr<uchar>(context.currentRow);
+        const uchar* redBits = context.redEmbedding.ptr<uchar>(context.currentRow);
 
-        for (; currentColumn < nCols; currentColumn += 2)
+        for (; context.currentColumn < nCols; context.currentColumn += 2)
         {
             // No second pixel pair
-            if (currentColumn + 1 >= nCols)
+            if (context.currentColumn + 1 >= nCols)
             {
                 break;
             }
 
-            if (file.fail())
+            if (source.Empty())
             {
                 break;
             }
 
-            numBitsToEmbed = blueEmbedding.at<uchar>(currentRow, currentColumn);
-            if (numBitsToEmbed)
-            {
-                for (size_t i = 0; i < numBitsToEmbed; i++)
-                {
-                    embeddingNumber[i] = dataByte[dataByteIndex];
-
-                    dataByteIndex++;
-                    if (dataByteIndex >= dataByte.size())
-                    {
-                        dataByteIndex = 0;
-                        file.get(fileByte);
-                        if (file.fail())
-                        {
-                            break;
-                        }
-
-
-                        dataByte = std::bitset<8>(fileByte);
-                    }
-                }
-
-                embedPvdPair(embeddingNumber, numBitsToEmbed, blueRow);
-                embeddingNumber.reset();
-            }
-            else
-            {
-                embedPvdOverhead(blueRow);
-            }
+            size_t column = context.currentColumn;
+            embedPvdBlock(blueRow + column, blueBits[column], source);
 
-            if (edgeDetectionType == EdgeDetectionType::None)
+            if constexpr (bEdges)
             {
-                if (file.fail())
-                {
-                    break;
-                }
-
-                numBitsToEmbed = greenEmbedding.at<uchar>(currentRow, currentColumn);
-                if (numBitsToEmbed)
+                if (blueBits[column] != 0 || redBits[column] != 0)
                 {
-                    for (size_t i = 0; i < numBitsToEmbed; i++)
-                    {
-                        embeddingNumber[i] = dataByte[dataByteIndex];
-                        dataByteIndex++;
-
-                        if (dataByteIndex >= dataByte.size())
-                        {
-                            dataByteIndex = 0;
-                            file.get(fileByte);
-                            if (file.fail())
-                            {
-                                break;
-                            }
-
-                            dataByte = std::bitset<8>(fileByte);
-                        }
-                    }
-
-                    embedPvdPair(embeddingNumber, numBitsToEmbed, greenRow);
-                    embeddingNumber.reset();
+                    greenRow[column] = setBit(greenRow[column], 0);
                 }
                 else
                 {
-                    embedPvdOverhead(greenRow);
+                    greenRow[column] = clearBit(greenRow[column], 0);
                 }
             }
             else
             {
-                if (numBitsToEmbed != 0 || redEmbedding.at<uchar>(currentRow, currentColumn) != 0)
+                if (source.Empty())
                 {
-                    greenRow[currentColumn] = setBit(greenRow[currentColumn], 0);
-                }
-                else
-                {
-                    greenRow[currentColumn] = clearBit(greenRow[currentColumn], 0);
+                    break;
                 }
+
+                embedPvdBlock(greenRow + column, greenBits[column], source);
             }
 
-            if (file.fail())
+            if (source.Empty())
             {
                 break;
             }
 
-            numBitsToEmbed = redEmbedding.at<uchar>(currentRow, currentColumn);
-            if (numBitsToEmbed)
-            {
-                for (size_t i = 0; i < numBitsToEmbed; i++)
-                {
-                    embeddingNumber[i] = dataByte[dataByteIndex];
-
-                    dataByteIndex++;
-                    if (dataByteIndex >= dataByte.size())
-                    {
-
-                        dataByteIndex = 0;
-                        file.get(fileByte);
-                        if (file.fail())
-                        {
-                            break;
-                        }
-
-                        dataByte = std::bitset<8>(fileByte);
-                    }
-                }
+            embedPvdBlock(redRow + column, redBits[column], source);
+        }
 
-                embedPvdPair(embeddingNumber, numBitsToEmbed, redRow);
-                embeddingNumber.reset();
-            }
-            else
-            {
-                embedPvdOverhead(redRow);
-            }
+        if (source.Empty())
+        {
+            break;
         }
 
-        currentColumn = 0;
+        context.currentColumn = 0;
     }
-
-    return StegoStatus::SUCCESS;
 }
 
 /**
@@ -1293,61 +4398,65 @@ StegoStatus Stego::encodePvdFile(std::ifstream& file, std::bitset<8>& dataByte,
  * @param image to calculate size for
  * @return The number of bits that can be embedded in the image with sequential lsb
  */
-uint32_t Stego::getLsbSequentialSize(Mat image)
+uint64_t Stego::getLsbSequentialSize(Mat image)
 {
-    uint32_t numPixels = image.total();
-    uint32_t numPixelsMinusHeader = numPixels - NUM_HEADER_PIXELS;
-
-    return (numPixelsMinusHeader * LSB_BITS_PER_PIXEL) / BITS_PER_BYTE;
+    return StegoCapacity::LsbSequentialCapacity(image.total(), context.numHeaderPixels, this->lsbBits);
 }
 
 /**
  * @brief Stego::getLsbEdgeSize
- * @return The number of bits that can be embedded in the image with lsb in edges
+ * @param numBitsNeeded Edges are detected until this many bits fit
+ * @return The number of bytes that can be embedded in the detected rows with lsb in edges
  */
-uint32_t Stego::getLsbEdgeSize()
+uint64_t Stego::getLsbEdgeSize(uint64_t numBitsNeeded)
 {
-    uint32_t numPixels = cv::countNonZero(edgeDetector.GetMagnitudes());
-    return (numPixels * LSB_BITS_PER_PIXEL) / BITS_PER_BYTE;
+    return detectEdgesFor(numBitsNeeded) / BITS_PER_BYTE;
 }
 
-uint32_t Stego::getPvdSequentialSize(Mat image)
+uint64_t Stego::getPvdSequentialSize(Mat image)
 {
-    Mat channels[3];
-    split(image, channels);
-
-    this->blueChannel = channels[0];
-    this->greenChannel = channels[1];
-    this->redChannel = channels[2];
+    splitChannels(image);
 
     calculatePvdEmbeddings();
 
-    return (sum(this->blueEmbedding)[0] +
-            sum(this->greenEmbedding)[0] +
-            sum(this->redEmbedding)[0]) / BITS_PER_BYTE;
+    return sumPvdEmbeddings() / BITS_PER_BYTE;
 }
 
-uint32_t Stego::getPvdEdgeSize(cv::Mat image)
+uint64_t Stego::getPvdEdgeSize(cv::Mat image, uint64_t numBitsNeeded)
 {
-    Mat channels[3];
-    split(image, channels);
-
-    this->blueChannel = channels[0];
-    this->greenChannel = channels[1];
-    this->redChannel = channels[2];
+    splitChannels(image);
 
     calculatePvdEmbeddings();
 
-    const Mat magnitudes = edgeDetector.GetMagnitudes();
+    return detectEdgesFor(numBitsNeeded) / BITS_PER_BYTE;
+}
+
+/**
+ * @brief Stego::sumPvdEmbeddings
+ * @return The number of bits the embedding maps of the context hold
+ */
+uint64_t Stego::sumPvdEmbeddings()
+{
+    return sum(context.blueEmbedding)[0] + sum(context.greenEmbedding)[0] + sum(context.redEmbedding)[0];
+}
+
+/**
+ * @brief Stego::maskPvdEmbeddingsToEdges Clear the embedding maps of the context outside edge pixel pairs, and the
+ * green map everywhere, from firstColumn of firstRow up to endRow. The last row of an image is not masked, strips of
+ * an image only leave it out in the strip ending the image.
+ * @return The number of bits embedded in the masked pairs
+ */
+uint64_t Stego::maskPvdEmbeddingsToEdges(size_t firstRow, size_t firstColumn, size_t endRow)
+{
+    const Mat magnitudes = context.edgeDetector.GetMagnitudes();
     int numChannels = magnitudes.channels();
-    int nRows = magnitudes.rows;
     int nCols = magnitudes.cols * numChannels;
 
     const uchar* magnitudeRow;
-    size_t channelColumn = currentColumn / 3;
-    size_t channelRow = currentRow;
-    uint32_t total = 0;
-    for (;  channelRow < nRows - 1; channelRow++)
+    size_t channelColumn = firstColumn;
+    size_t channelRow = firstRow;
+    uint64_t total = 0;
+    for (;  channelRow < endRow; channelRow++)
     {
         magnitudeRow = magnitudes.ptr<const uchar>(channelRow);
 
@@ -1360,29 +4469,36 @@ uint32_t Stego::getPvdEdgeSize(cv::Mat image)
 
             if (magnitudeRow[channelColumn] != 0 && magnitudeRow[channelColumn + 1] != 0)
             {
-                total += blueEmbedding.at<uchar>(channelRow, channelColumn);
-                greenEmbedding.at<uchar>(channelRow, channelColumn) = 0;
-                total += redEmbedding.at<uchar>(channelRow, channelColumn);
+                total += context.blueEmbedding.at<uchar>(channelRow, channelColumn);
+                context.greenEmbedding.at<uchar>(channelRow, channelColumn) = 0;
+                total += context.redEmbedding.at<uchar>(channelRow, channelColumn);
             }
             else
             {
-                blueEmbedding.at<uchar>(channelRow, channelColumn) = 0;
-                greenEmbedding.at<uchar>(channelRow, channelColumn) = 0;
-                redEmbedding.at<uchar>(channelRow, channelColumn) = 0;
+                context.blueEmbedding.at<uchar>(channelRow, channelColumn) = 0;
+                context.greenEmbedding.at<uchar>(channelRow, channelColumn) = 0;
+                context.redEmbedding.at<uchar>(channelRow, channelColumn) = 0;
             }
         }
 
         channelColumn = 0;
     }
 
-    return total / BITS_PER_BYTE;
+    return total;
 }
 
-bool Stego::isFileTooLarge(Mat image, uint32_t numFrames)
+/**
+ * @brief Stego::getEncodeableSize
+ * @param image to calculate size for, edge detection must have begun on it if edge detection is enabled
+ * @param numBytesNeeded Edges are only detected until this many bytes fit, the size is of the detected rows then
+ * @return The number of bytes that can be embedded in the image with the selected algorithms
+ */
+uint64_t Stego::getEncodeableSize(Mat image, uint64_t numBytesNeeded)
 {
-    uint32_t fileSizeBytes = std::filesystem::file_size(this->filePath);
-    uint32_t fileNameBytes = this->fileName.size();
-    uint32_t imageNumEncodeableBytes = 0;
+    uint64_t numBitsNeeded = numBytesNeeded > std::numeric_limits<uint64_t>::max() / BITS_PER_BYTE ?
+                                 std::numeric_limits<uint64_t>::max() : numBytesNeeded * BITS_PER_BYTE;
+
+    uint64_t imageNumEncodeableBytes = 0;
     if (this->algo == StegoAlgo::LSB && this->edgeDetectionType == EdgeDetectionType::None)
     {
         imageNumEncodeableBytes = getLsbSequentialSize(image);
@@ -1393,34 +4509,151 @@ bool Stego::isFileTooLarge(Mat image, uint32_t numFrames)
     }
     else if (this->algo == StegoAlgo::LSB && this->edgeDetectionType != EdgeDetectionType::None)
     {
-        imageNumEncodeableBytes = getLsbEdgeSize();
+        imageNumEncodeableBytes = getLsbEdgeSize(numBitsNeeded);
     }
     else if (this->algo == StegoAlgo::PVD && this->edgeDetectionType != EdgeDetectionType::None)
     {
-        imageNumEncodeableBytes = getPvdEdgeSize(image);
+        imageNumEncodeableBytes = getPvdEdgeSize(image, numBitsNeeded);
     }
 
+    return imageNumEncodeableBytes;
+}
+
+bool Stego::isFileTooLarge(Mat image, uint64_t numFrames)
+{
+    uint64_t fileSizeBytes = context.fileLength;
+    uint64_t fileNameBytes = this->fileName.size();
+    uint64_t numBytesPerFrame = (fileSizeBytes + fileNameBytes + numFrames - 1) / numFrames;
+    uint64_t imageNumEncodeableBytes = getEncodeableSize(image, numBytesPerFrame);
+
     bool fileTooLarge = fileSizeBytes + fileNameBytes > (imageNumEncodeableBytes * numFrames);
     if (fileTooLarge)
     {
-        embedSize = imageNumEncodeableBytes * numFrames;
+        context.embedSize = imageNumEncodeableBytes * numFrames;
     }
 
     return fileTooLarge;
 }
 
+/**
+ * @brief Stego::detectEdgesFor Detect edges of the image edge detection has begun on until the rows from the cursor on
+ * hold numBits bits and EDGE_DETECTION_MARGIN_BITS more, or the whole image is detected. The kernels never reach the
+ * rows below, so the payload alone sets how much of a large image is detected. For PVD the embedding maps must be
+ * calculated, the detected rows are masked to edges as they come in.
+ * @return The number of bits the detected rows hold from the cursor on
+ */
+uint64_t Stego::detectEdgesFor(uint64_t numBits)
+{
+    EdgeDetection& edgeDetector = context.edgeDetector;
+    const Mat magnitudes = edgeDetector.GetMagnitudes();
+    if (magnitudes.empty())
+    {
+        return 0;
+    }
+
+    uint64_t numBitsWanted = numBits > std::numeric_limits<uint64_t>::max() - EDGE_DETECTION_MARGIN_BITS ?
+                                 std::numeric_limits<uint64_t>::max() : numBits + EDGE_DETECTION_MARGIN_BITS;
+
+    // PVD leaves the last row of the image unmasked and does not count it, like getPvdEdgeSize always has
+    bool bPvd = this->algo == StegoAlgo::PVD;
+    size_t numCountedRows = bPvd ? magnitudes.rows - 1 : magnitudes.rows;
+    size_t startPixel = context.currentRow * magnitudes.cols + context.currentColumn / 3;
+    size_t row = bPvd ? context.currentRow : startPixel / magnitudes.cols;
+    size_t column = bPvd ? context.currentColumn / 3 : startPixel % magnitudes.cols;
+
+    uint64_t numBitsDetected = 0;
+    while (true)
+    {
+        size_t endRow = std::min(static_cast<size_t>(edgeDetector.NumDetectedRows()), numCountedRows);
+        if (endRow > row)
+        {
+            if (bPvd)
+            {
+                numBitsDetected += maskPvdEmbeddingsToEdges(row, column, endRow);
+            }
+            else
+            {
+                numBitsDetected += StegoCapacity::LsbEdgePixels(magnitudes.rowRange(row, endRow), column) *
+                                   LSB_BITS_PER_PIXEL * this->lsbBits;
+            }
+
+            row = endRow;
+            column = 0;
+        }
+
+        if (numBitsDetected >= numBitsWanted || edgeDetector.IsComplete())
+        {
+            return numBitsDetected;
+        }
+
+        edgeDetector.DetectRows(edgeDetector.NumDetectedRows() + 1);
+    }
+}
+
+/**
+ * @brief Stego::remainingPayloadBits Bits of the file name and the file left to embed, while embedding file with
+ * dataByteIndex bits of the byte read last embedded.
+ */
+uint64_t Stego::remainingPayloadBits(std::istream& file, size_t dataByteIndex, bool bFileNameEmbedded)
+{
+    uint64_t numBits = BITS_PER_BYTE - std::min(dataByteIndex, BITS_PER_BYTE);
+    std::streamoff position = file.tellg();
+    if (position >= 0 && static_cast<uint64_t>(position) < context.fileLength)
+    {
+        numBits += (context.fileLength - position) * BITS_PER_BYTE;
+    }
+
+    if (!bFileNameEmbedded)
+    {
+        numBits += this->fileName.size() * BITS_PER_BYTE;
+    }
+
+    return numBits;
+}
+
+/**
+ * @brief Stego::splitChannels Split image into the blue, green and red planes of the context. The planes are
+ * allocated from the buffer pool, so a new frame reuses the planes of the previous one.
+ */
+void Stego::splitChannels(cv::Mat image)
+{
+    Mat colours[3];
+    for (Mat& colour : colours)
+    {
+        if (context.bufferPool)
+        {
+            context.bufferPool->Bind(colour);
+        }
+    }
+
+    split(image, colours);
+
+    context.blueChannel = colours[0];
+    context.greenChannel = colours[1];
+    context.redChannel = colours[2];
+}
+
 void Stego::calculatePvdEmbeddings()
 {
-    this->blueEmbedding = Mat(this->blueChannel.rows, this->blueChannel.cols, CV_8UC1);
-    this->greenEmbedding = Mat(this->greenChannel.rows, this->greenChannel.cols, CV_8UC1);
-    this->redEmbedding = Mat(this->redChannel.rows, this->redChannel.cols, CV_8UC1);
+    // Only the first value of each pair is set below, zero the rest so the maps can be summed
+    Mat* embeddings[3] = {&context.blueEmbedding, &context.greenEmbedding, &context.redEmbedding};
+    for (Mat* embedding : embeddings)
+    {
+        if (context.bufferPool)
+        {
+            context.bufferPool->Bind(*embedding);
+        }
+
+        embedding->create(context.blueChannel.rows, context.blueChannel.cols, CV_8UC1);
+        embedding->setTo(Scalar(0));
+    }
 
-    size_t channelColumn = currentColumn / 3;
-    size_t channelRow = currentRow;
-    int channels = this->blueChannel.channels();
-    int nRows = this->blueChannel.rows;
-    int nCols = this->blueChannel.cols * channels;
-    if (this->blueChannel.isContinuous())
+    size_t channelColumn = context.currentColumn / 3;
+    size_t channelRow = context.currentRow;
+    int channels = context.blueChannel.channels();
+    int nRows = context.blueChannel.rows;
+    int nCols = context.blueChannel.cols * channels;
+    if (context.blueChannel.isContinuous())
     {
         nCols *= nRows;
         nRows = 1;
@@ -1434,9 +4667,9 @@ void Stego::calculatePvdEmbeddings()
 
     for (; channelRow < nRows; channelRow++)
     {
-        blueRow = this->blueChannel.ptr<uchar>(channelRow);
-        greenRow = this->greenChannel.ptr<uchar>(channelRow);
-        redRow = this->redChannel.ptr<uchar>(channelRow);
+        blueRow = context.blueChannel.ptr<uchar>(channelRow);
+        greenRow = context.greenChannel.ptr<uchar>(channelRow);
+        redRow = context.redChannel.ptr<uchar>(channelRow);
 
         for (; channelColumn < nCols; channelColumn += 2)
         {
@@ -1453,7 +4686,7 @@ void Stego::calculatePvdEmbeddings()
                 numBitsToEmbed = 0;
             }
 
-            blueEmbedding.at<uchar>(channelRow, channelColumn) = numBitsToEmbed;
+            context.blueEmbedding.at<uchar>(channelRow, channelColumn) = numBitsToEmbed;
 
             difference = std::abs(greenRow[channelColumn] - greenRow[channelColumn + 1]);
             numBitsToEmbed = pvdRangeTable[difference];
@@ -1462,7 +4695,7 @@ void Stego::calculatePvdEmbeddings()
                 numBitsToEmbed = 0;
             }
 
-            greenEmbedding.at<uchar>(channelRow, channelColumn) = numBitsToEmbed;
+            context.greenEmbedding.at<uchar>(channelRow, channelColumn) = numBitsToEmbed;
 
             difference = std::abs(redRow[channelColumn] - redRow[channelColumn + 1]);
             numBitsToEmbed = pvdRangeTable[difference];
@@ -1470,21 +4703,21 @@ void Stego::calculatePvdEmbeddings()
             {
                 numBitsToEmbed = 0;
             }
-            redEmbedding.at<uchar>(channelRow, channelColumn) = numBitsToEmbed;
+            context.redEmbedding.at<uchar>(channelRow, channelColumn) = numBitsToEmbed;
         }
 
         channelColumn = 0;
     }
 }
 
-void Stego::embedPvdPair(std::bitset<7> embeddingNumber, size_t numBits, uchar *row)
+void Stego::embedPvdPair(std::bitset<7> embeddingNumber, size_t numBits, uchar* pair)
 {
-    int difference = std::abs(row[currentColumn] - row[currentColumn + 1]);
+    int difference = std::abs(pair[0] - pair[1]);
     int newDifference = embeddingNumber.to_ulong() + pvdRangeLowerBounds[numBits];
     double embed = std::abs(newDifference - difference);
 
-    int firstValue = row[currentColumn];
-    int secondValue = row[currentColumn + 1];
+    int firstValue = pair[0];
+    int secondValue = pair[1];
 
     int newFirstValue = 0;
     int newSecondValue = 0;
@@ -1513,8 +4746,8 @@ void Stego::embedPvdPair(std::bitset<7> embeddingNumber, size_t numBits, uchar *
 
             if ((newFirstValue >= 0 && newFirstValue <= 255) && (newSecondValue >= 0 && newSecondValue <= 255))
             {
-                row[currentColumn] = newFirstValue;
-                row[currentColumn + 1] = newSecondValue;
+                pair[0] = newFirstValue;
+                pair[1] = newSecondValue;
             }
         }
 
@@ -1612,14 +4845,14 @@ void Stego::embedPvdPair(std::bitset<7> embeddingNumber, size_t numBits, uchar *
         }
     }
 
-    row[currentColumn] = newFirstValue;
-    row[currentColumn + 1] = newSecondValue;
+    pair[0] = newFirstValue;
+    pair[1] = newSecondValue;
 }
 
-void Stego::embedPvdOverhead(uchar *row)
+void Stego::embedPvdOverhead(uchar* pair)
 {
-    uchar newFirstValue = row[currentColumn];
-    uchar newSecondValue = row[currentColumn + 1];
+    uchar newFirstValue = pair[0];
+    uchar newSecondValue = pair[1];
 
     bool firstValueLsbZero = newFirstValue % 2 == 0;
     bool secondValueLsbZero = newSecondValue % 2 == 0;
@@ -1654,8 +4887,8 @@ void Stego::embedPvdOverhead(uchar *row)
         newFirstValue--;
     }
 
-    row[currentColumn] = newFirstValue;
-    row[currentColumn + 1] = newSecondValue;
+    pair[0] = newFirstValue;
+    pair[1] = newSecondValue;
 }
 
 std::pair<int, int> Stego::calculateNewPvdPixelPairs(int firstValue, int secondValue, int difference, int newDifference, double embed)
@@ -1687,126 +4920,96 @@ std::pair<int, int> Stego::calculateNewPvdPixelPairs(int firstValue, int secondV
     return std::make_pair(newFirstValue, newSecondValue);
 }
 
-StegoStatus Stego::decodeHeader(Mat image)
+/**
+ * @brief Stego::decodeHeader Read the header from image and check that the payload it describes fits in the media,
+ * so media without a payload is rejected before edge detection and extraction.
+ * @param numFrames Number of frames of the media, 0 if unknown
+ * @return StegoStatus::INVALID_HEADER if image has no valid header, StegoStatus::SUCCESS if it has
+ */
+StegoStatus Stego::decodeHeader(Mat image, uint64_t numFrames)
 {
-    int channels = image.channels();
-    int nRows = image.rows;
-    int nCols = image.cols * channels;
-    if (image.isContinuous())
-    {
-        nCols *= nRows;
-        nRows = 1;
-    }
-
-    uchar* row = image.ptr<uchar>(0);
-
-    // Get algorithm from lsb of blue segment of first pixel
-    std::bitset<8> intensity(row[0]);
-    if (intensity[0])
-    {
-        // 1
-        this->algo = StegoAlgo::PVD;
-    }
-    else
+    StegoHeader header;
+    StegoStatus status = header.Read(image);
+    if (status != StegoStatus::SUCCESS)
     {
-        // 0
-        this->algo = StegoAlgo::LSB;
+        return status;
     }
 
-    // Get Edge Detection from least 2 significant bits of green segment of first pixel
-    intensity = std::bitset<8>(row[1]);
-    if (intensity[0] == true && intensity[1] == true)
-    {
-        this->edgeDetectionType = EdgeDetectionType::Sobel;
-    }
-    else if (intensity[0] == true && intensity[1] == false)
-    {
-        this->edgeDetectionType = EdgeDetectionType::Canny;
-    }
-    else if (intensity[0] == false && intensity[1] == false)
-    {
-        this->edgeDetectionType = EdgeDetectionType::None;
-    }
-    else
+    if (!header.FitsIn(image.total(), numFrames))
     {
         return StegoStatus::INVALID_HEADER;
     }
 
-    // Validate encryption status from least significant bit of red segment of first pixel
-    intensity = std::bitset<8>(row[2]);
-    if (intensity[0] == false && this->bEncrypt)
+    this->algo = header.algo;
+    this->edgeDetectionType = header.edgeDetectionType;
+    this->lsbBits = header.lsbBits;
+
+    // Validate the encryption status against the password
+    if (!header.bEncrypted && this->bEncrypt)
     {
         return StegoStatus::DATA_NOT_ENCRYPTED;
     }
 
-    if (intensity[0] == true && password == "")
+    if (header.bEncrypted && password == "")
     {
         return StegoStatus::DECRYPTION_FAILED;
     }
 
-    std::bitset<18> fileNameLengthBits;
-    size_t bitPos = 0;
-    currentColumn = 3;
-    for (; currentRow < nRows; currentRow++)
-    {
-        row = image.ptr<uchar>(currentRow);
-        for (; currentColumn < nCols; currentColumn++)
-        {
-            intensity = std::bitset<8>(row[currentColumn]);
-            fileNameLengthBits[bitPos] = intensity[0];
-            fileNameLengthBits[bitPos + 1] = intensity[1];
+    context.fileNameLength = header.fileNameLength;
+    context.fileLength = header.fileLength;
+    context.bCompressed = header.bCompressed;
+    context.bArchive = header.bArchive;
+    context.bShard = header.bShard;
+    setCursorAfterHeader(image, header.NumPixels());
 
-            bitPos += 2;
-            if (bitPos >= fileNameLengthBits.size())
-            {
-                currentColumn++;
-                break;
-            }
-        }
+    // A shard is only decoded with the rest of its set, see DecodeShards
+    if (header.bShard && !this->bShard)
+    {
+        return StegoStatus::SHARD_SET_INCOMPLETE;
+    }
 
-        if (bitPos >= fileNameLengthBits.size())
-        {
-            break;
-        }
+    if (!header.bShard && this->bShard)
+    {
+        return StegoStatus::INVALID_MEDIA;
+    }
 
-        currentColumn = 0;
+    // Only archives have members, nothing else is extracted
+    if (!this->archiveMember.empty() && !context.bArchive)
+    {
+        return StegoStatus::ARCHIVE_MEMBER_NOT_FOUND;
     }
 
-    this->fileNameLength = fileNameLengthBits.to_ulong();
+    return StegoStatus::SUCCESS;
+}
 
-    std::bitset<36> fileLengthBits;
-    bitPos = 0;
-    for (; currentRow < nRows; currentRow++)
+/**
+ * @brief Stego::setCursorAfterHeader Move the embedding cursor to the first sample after a header of numPixels pixels.
+ */
+void Stego::setCursorAfterHeader(cv::Mat image, size_t numPixels)
+{
+    size_t nCols = image.cols * image.channels();
+    if (image.isContinuous())
     {
-        row = image.ptr<uchar>(currentRow);
-        for (; currentColumn < nCols; currentColumn++)
-        {
-            intensity = std::bitset<8>(row[currentColumn]);
-            fileLengthBits[bitPos] = intensity[0];
-            fileLengthBits[bitPos + 1] = intensity[1];
-
-            bitPos += 2;
-            if (bitPos >= fileLengthBits.size())
-            {
-                currentColumn++;
-                break;
-            }
-        }
+        nCols *= image.rows;
+    }
 
-        if (bitPos >= fileLengthBits.size())
-        {
-            break;
-        }
+    context.numHeaderPixels = numPixels;
+    context.currentRow = (numPixels * 3) / nCols;
+    context.currentColumn = (numPixels * 3) % nCols;
+}
 
-        currentRow = 0;
+StegoStatus Stego::decodeLsbFileName(cv::Mat image)
+{
+    if (this->edgeDetectionType != EdgeDetectionType::None)
+    {
+        return decodeLsbFileNameKernel<true>(image);
     }
 
-    this->fileLength = fileLengthBits.to_ulong();
-
-    return StegoStatus::SUCCESS;
+    return decodeLsbFileNameKernel<false>(image);
 }
 
-StegoStatus Stego::decodeLsbFileName(cv::Mat image)
+template <bool bEdges>
+StegoStatus Stego::decodeLsbFileNameKernel(cv::Mat image)
 {
     int channels = image.channels();
     int nRows = image.rows;
@@ -1817,7 +5020,7 @@ StegoStatus Stego::decodeLsbFileName(cv::Mat image)
         nRows = 1;
     }
 
-    uchar* row = image.ptr<uchar>(currentRow);
+    uchar* row = image.ptr<uchar>(context.currentRow);
 
     std::bitset<8> dataByte;
     std::bitset<8> intensity;
@@ -1825,54 +5028,61 @@ StegoStatus Stego::decodeLsbFileName(cv::Mat image)
     Mat edges;
     uchar* edgeRow;
     size_t edgeCol = 0;
-    if (edgeDetectionType != EdgeDetectionType::None)
+    if constexpr (bEdges)
     {
-        edges = edgeDetector.GetMagnitudes();
-        edgeRow = edges.ptr<uchar>(currentRow);
-        edgeCol = currentColumn / 3;
+        edges = context.edgeDetector.GetMagnitudes();
+        edgeRow = edges.ptr<uchar>(context.currentRow);
+        edgeCol = context.currentColumn / 3;
     }
 
     this->fileName = "";
 
-    for (size_t i = 0; i < this->fileNameLength; i++)
+    for (size_t i = 0; i < context.fileNameLength; i++)
     {
         dataByte.reset();
         size_t j = 0;
         while (j < dataByte.size())
         {
-            if (edgeDetectionType != EdgeDetectionType::None)
+            if constexpr (bEdges)
             {
                 if (edgeRow[edgeCol] == 0)
                 {
-                    currentColumn++;
-                    edgeCol = currentColumn / 3;
+                    context.currentColumn++;
+                    edgeCol = context.currentColumn / 3;
                     continue;
                 }
             }
 
-            intensity = std::bitset<8>(row[currentColumn]);
-            dataByte[j] = intensity[0];
-
-            currentColumn++;
-            edgeCol = currentColumn / 3;
+            intensity = std::bitset<8>(row[context.currentColumn]);
+            dataByte[j] = intensity[context.currentBit];
             j++;
 
-            if (currentColumn >= nCols)
+            // A sample holds lsbBits bits of the payload before the cursor moves on
+            if (++context.currentBit < this->lsbBits)
+            {
+                continue;
+            }
+
+            context.currentBit = 0;
+            context.currentColumn++;
+            edgeCol = context.currentColumn / 3;
+
+            if (context.currentColumn >= nCols)
             {
-                currentColumn = 0;
+                context.currentColumn = 0;
                 edgeCol = 0;
-                currentRow++;
+                context.currentRow++;
 
-                if (currentRow >= nRows)
+                if (context.currentRow >= nRows)
                 {
                     // Shouldn't happen. For debugging.
                     return StegoStatus::OUT_OF_ROOM;
                 }
 
-                row = image.ptr<uchar>(currentRow);
-                if (edgeDetectionType != EdgeDetectionType::None)
+                row = image.ptr<uchar>(context.currentRow);
+                if constexpr (bEdges)
                 {
-                    edgeRow = edges.ptr<uchar>(currentRow);
+                    edgeRow = edges.ptr<uchar>(context.currentRow);
                 }
             }
         }
@@ -1883,7 +5093,18 @@ StegoStatus Stego::decodeLsbFileName(cv::Mat image)
     return StegoStatus::SUCCESS;
 }
 
-StegoStatus Stego::decodeLsbFile(Mat image, std::ofstream& file, size_t& bytesWritten, std::bitset<8>& dataByte, size_t& dataByteIndex)
+StegoStatus Stego::decodeLsbFile(Mat image, std::ostream& file, uint64_t& bytesWritten, std::bitset<8>& dataByte, size_t& dataByteIndex)
+{
+    if (this->edgeDetectionType != EdgeDetectionType::None)
+    {
+        return decodeLsbFileKernel<true>(image, file, bytesWritten, dataByte, dataByteIndex);
+    }
+
+    return decodeLsbFileKernel<false>(image, file, bytesWritten, dataByte, dataByteIndex);
+}
+
+template <bool bEdges>
+StegoStatus Stego::decodeLsbFileKernel(Mat image, std::ostream& file, uint64_t& bytesWritten, std::bitset<8>& dataByte, size_t& dataByteIndex)
 {
     int channels = image.channels();
     int nRows = image.rows;
@@ -1894,21 +5115,21 @@ StegoStatus Stego::decodeLsbFile(Mat image, std::ofstream& file, size_t& bytesWr
         nRows = 1;
     }
 
-    uchar* row = image.ptr<uchar>(currentRow);
+    uchar* row = image.ptr<uchar>(context.currentRow);
 
     std::bitset<8> intensity;
 
     Mat edges;
     uchar* edgeRow;
     size_t edgeCol = 0;
-    if (edgeDetectionType != EdgeDetectionType::None)
+    if constexpr (bEdges)
     {
-        edges = edgeDetector.GetMagnitudes();
-        edgeRow = edges.ptr<uchar>(currentRow);
-        edgeCol = currentColumn / 3;
+        edges = context.edgeDetector.GetMagnitudes();
+        edgeRow = edges.ptr<uchar>(context.currentRow);
+        edgeCol = context.currentColumn / 3;
     }
 
-    while (bytesWritten < fileLength)
+    while (bytesWritten < context.fileLength)
     {
         if (dataByteIndex >= dataByte.size())
         {
@@ -1918,54 +5139,61 @@ StegoStatus Stego::decodeLsbFile(Mat image, std::ofstream& file, size_t& bytesWr
 
         while (dataByteIndex < dataByte.size())
         {
-            if (edgeDetectionType != EdgeDetectionType::None)
+            if constexpr (bEdges)
             {
                 if (edgeRow[edgeCol] == 0)
                 {
-                    currentColumn++;
-                    edgeCol = currentColumn / 3;
-                    if (currentColumn >= nCols)
+                    context.currentColumn++;
+                    edgeCol = context.currentColumn / 3;
+                    if (context.currentColumn >= nCols)
                     {
-                        currentColumn = 0;
+                        context.currentColumn = 0;
                         edgeCol = 0;
-                        currentRow++;
-                        if (currentRow >= nRows)
+                        context.currentRow++;
+                        if (context.currentRow >= nRows)
                         {
                             break;
                         }
 
-                        edgeRow = edges.ptr<uchar>(currentRow);
-                        row = image.ptr<uchar>(currentRow);
+                        edgeRow = edges.ptr<uchar>(context.currentRow);
+                        row = image.ptr<uchar>(context.currentRow);
                     }
 
                     continue;
                 }
             }
 
-            intensity = std::bitset<8>(row[currentColumn]);
-            dataByte[dataByteIndex] = intensity[0];
-
-            currentColumn++;
-            edgeCol = currentColumn / 3;
+            intensity = std::bitset<8>(row[context.currentColumn]);
+            dataByte[dataByteIndex] = intensity[context.currentBit];
             dataByteIndex++;
 
-            if (currentColumn >= nCols)
+            // A sample holds lsbBits bits of the payload before the cursor moves on
+            if (++context.currentBit < this->lsbBits)
+            {
+                continue;
+            }
+
+            context.currentBit = 0;
+            context.currentColumn++;
+            edgeCol = context.currentColumn / 3;
+
+            if (context.currentColumn >= nCols)
             {
-                currentColumn = 0;
+                context.currentColumn = 0;
                 edgeCol = 0;
-                currentRow++;
-                if (currentRow >= nRows)
+                context.currentRow++;
+                if (context.currentRow >= nRows)
                 {
                     break;
                 }
 
-                if (edgeDetectionType != EdgeDetectionType::None)
+                if constexpr (bEdges)
                 {
 
-                    edgeRow = edges.ptr<uchar>(currentRow);
+                    edgeRow = edges.ptr<uchar>(context.currentRow);
                 }
 
-                row = image.ptr<uchar>(currentRow);
+                row = image.ptr<uchar>(context.currentRow);
             }
         }
 
@@ -1977,457 +5205,569 @@ StegoStatus Stego::decodeLsbFile(Mat image, std::ofstream& file, size_t& bytesWr
 
         file.put(static_cast<uchar>(dataByte.to_ulong()));
         bytesWritten++;
-        if (bytesWritten >= this->fileLength || currentRow >= nRows)
+        if (bytesWritten >= context.fileLength || context.currentRow >= nRows)
         {
             break;
         }
     }
 
-    currentColumn = 0;
-    currentRow = 0;
+    context.currentColumn = 0;
+    context.currentRow = 0;
+    context.currentBit = 0;
+
+    return StegoStatus::SUCCESS;
+}
+
+StegoStatus Stego::decodePvdFileName(cv::Mat image)
+{
+    context.currentColumn /= 3;
+    splitChannels(image);
+
+    this->fileName = "";
+
+    FileNameBitSink sink(this->fileName, context.fileNameLength);
+    if (this->edgeDetectionType != EdgeDetectionType::None)
+    {
+        extractPvdPairs<true>(sink);
+    }
+    else
+    {
+        extractPvdPairs<false>(sink);
+    }
+
+    context.currentColumn += 2;
+    return StegoStatus::SUCCESS;
+}
+
+StegoStatus Stego::decodePvdFile(cv::Mat image, std::ostream& file, uint64_t& bytesWritten, std::bitset<8>& dataByte, size_t& dataByteIndex)
+{
+    splitChannels(image);
+
+    StreamBitSink sink(file, bytesWritten, dataByte, dataByteIndex, context.fileLength);
+    if (this->edgeDetectionType != EdgeDetectionType::None)
+    {
+        extractPvdPairs<true>(sink);
+    }
+    else
+    {
+        extractPvdPairs<false>(sink);
+    }
+
+    context.currentRow = 0;
+    context.currentColumn = 0;
 
     return StegoStatus::SUCCESS;
 }
 
-StegoStatus Stego::decodePvdFileName(cv::Mat image)
+/**
+ * @brief Stego::extractPvdPairs Decode the pixel pairs from the current position into sink until it is full.
+ * With edge detection only pairs whose green value is odd carry data, and green carries none itself.
+ */
+template <bool bEdges, typename BitSink>
+void Stego::extractPvdPairs(BitSink& sink)
 {
-    currentColumn /= 3;
-    Mat colours[3];
-    split(image, colours);
-
-    this->blueChannel = colours[0];
-    this->greenChannel = colours[1];
-    this->redChannel = colours[2];
-
-    int channels = blueChannel.channels();
-    int nRows = blueChannel.rows;
-    int nCols = blueChannel.cols * channels;
-    if (blueChannel.isContinuous())
+    int channels = context.blueChannel.channels();
+    int nRows = context.blueChannel.rows;
+    int nCols = context.blueChannel.cols * channels;
+    if (context.blueChannel.isContinuous())
     {
         nCols *= nRows;
         nRows = 1;
     }
 
-    uchar* blueRow;
-    uchar* greenRow;
-    uchar* redRow;
-
-    std::bitset<8> dataByte;
-    size_t dataByteIndex = 0;
-    uchar firstColourValue;
-    uchar secondColourValue;
-    uchar rangeDifference;
-    std::bitset<8> differenceBinary;
-    size_t lowerBound;
-    size_t numBitsPerBlock;
-
-    this->fileName = "";
-
-    for (; currentRow < nRows; currentRow++)
+    for (; context.currentRow < nRows; context.currentRow++)
     {
-        if (fileName.length() >= fileNameLength)
+        if (sink.Full())
         {
             break;
         }
 
-        blueRow = this->blueChannel.ptr<uchar>(currentRow);
-        greenRow = this->greenChannel.ptr<uchar>(currentRow);
-        redRow = this->redChannel.ptr<uchar>(currentRow);
+        const uchar* blueRow = context.blueChannel.ptr<uchar>(context.currentRow);
+        const uchar* greenRow = context.greenChannel.ptr<uchar>(context.currentRow);
+        const uchar* redRow = context.redChannel.ptr<uchar>(context.currentRow);
 
-        for (; currentColumn < nCols; currentColumn+= 2)
+        for (; context.currentColumn < nCols; context.currentColumn += 2)
         {
-            if (currentColumn + 1 >= nCols)
+            if (context.currentColumn + 1 >= nCols)
             {
                 break;
             }
 
-            if (fileName.length() >= fileNameLength)
+            if (sink.Full())
             {
                 break;
             }
 
-            if (edgeDetectionType != EdgeDetectionType::None)
+            size_t column = context.currentColumn;
+            if constexpr (bEdges)
             {
-                if (greenRow[currentColumn] % 2 == 0)
+                if (greenRow[column] % 2 == 0)
                 {
                     continue;
                 }
             }
 
-            firstColourValue = blueRow[currentColumn];
-            secondColourValue = blueRow[currentColumn + 1];
-
-            if (firstColourValue % 2 == 0)
+            extractPvdBlock<MAX_PVD_BLUE_EMBEDDING>(blueRow + column, sink);
+            if (sink.Full())
             {
-                firstColourValue++;
+                break;
             }
-            else
+
+            if constexpr (!bEdges)
             {
-                firstColourValue--;
+                extractPvdBlock<MAX_PVD_GREEN_EMBEDDING>(greenRow + column, sink);
+                if (sink.Full())
+                {
+                    break;
+                }
             }
 
-            rangeDifference = std::abs(firstColourValue - secondColourValue);
-            numBitsPerBlock = pvdRangeTable[rangeDifference];
-            if (numBitsPerBlock <= MAX_PVD_BLUE_EMBEDDING)
-            {
-                lowerBound = pvdRangeLowerBounds[numBitsPerBlock];
-                rangeDifference = rangeDifference - lowerBound;
+            extractPvdBlock<MAX_PVD_RED_EMBEDDING>(redRow + column, sink);
+        }
 
-                differenceBinary = std::bitset<8>(rangeDifference);
+        if (sink.Full())
+        {
+            break;
+        }
+    }
+}
 
-                if (blueRow[currentColumn] % 2 != 0)
-                {
-                    differenceBinary[numBitsPerBlock - 1] = true;
-                }
+/**
+ * @brief Stego::useParallelKernels
+ * @return True if the payload of image should be embedded or extracted with the parallel kernels
+ */
+bool Stego::useParallelKernels(const cv::Mat& image) const
+{
+    return this->bParallel && image.isContinuous() && image.total() >= PARALLEL_MIN_PIXELS;
+}
 
-                for (size_t i = 0; i < numBitsPerBlock; i++)
-                {
-                    dataByte[dataByteIndex] = differenceBinary[i];
+/**
+ * @brief Stego::encodeLsbFileParallel Parallel version of encodeLsbFile for a whole payload held in memory.
+ * The samples after the file name are split into chunks, the number of usable samples in every chunk is
+ * counted and a prefix sum gives each chunk its payload bit offset, so every chunk can then be embedded on its
+ * own. The result is identical to encodeLsbFile.
+ */
+StegoStatus Stego::encodeLsbFileParallel(cv::Mat image, const std::vector<uchar>& data)
+{
+    if (this->edgeDetectionType != EdgeDetectionType::None)
+    {
+        return encodeLsbFileParallelKernel<true>(image, data);
+    }
 
-                    dataByteIndex++;
-                    if (dataByteIndex >= dataByte.size())
-                    {
-                        dataByteIndex = 0;
-                        this->fileName += static_cast<uchar>(dataByte.to_ulong());
-                        dataByte.reset();
+    return encodeLsbFileParallelKernel<false>(image, data);
+}
 
-                        if (fileName.length() >= fileNameLength)
-                        {
-                            break;
-                        }
-                    }
-                }
-            }
+template <bool bEdges>
+StegoStatus Stego::encodeLsbFileParallelKernel(cv::Mat image, const std::vector<uchar>& data)
+{
+    uchar* samples = image.ptr<uchar>(0);
+    size_t numSamples = image.total() * image.channels();
+    size_t startSample = context.currentRow * image.cols * image.channels() + context.currentColumn;
+    uint64_t numBits = data.size() * BITS_PER_BYTE;
+
+    // The file name may end inside a sample, its bits left take the start of the file
+    uint64_t firstBit = 0;
+    if (context.currentBit != 0)
+    {
+        firstBit = std::min<uint64_t>(this->lsbBits - context.currentBit, numBits);
+        samples[startSample] = embedLsbBits(samples[startSample], data, 0, context.currentBit, firstBit);
+        startSample++;
+    }
 
-            if (fileName.length() >= fileNameLength)
-            {
-                break;
-            }
+    Mat edges;
+    const uchar* edgePixels = nullptr;
+    if constexpr (bEdges)
+    {
+        edges = context.edgeDetector.GetMagnitudes();
+        edgePixels = edges.ptr<uchar>(0);
 
-            if (edgeDetectionType == EdgeDetectionType::None)
-            {
-                firstColourValue = greenRow[currentColumn];
-                secondColourValue = greenRow[currentColumn + 1];
+        // Rows below the ones detectEdgesFor reached are not final, the payload ends inside the detected rows
+        size_t numDetectedSamples = static_cast<size_t>(context.edgeDetector.NumDetectedRows()) * image.cols *
+                                    image.channels();
+        numSamples = std::max(startSample, std::min(numSamples, numDetectedSamples));
+    }
 
-                if (firstColourValue % 2 == 0)
-                {
-                    firstColourValue++;
-                }
-                else
+    std::vector<size_t> starts = chunkStarts(startSample, numSamples, 1, cv::getNumThreads() * CHUNKS_PER_THREAD);
+    size_t numChunks = starts.size() - 1;
+
+    std::vector<uint64_t> counts(numChunks, 0);
+    cv::parallel_for_(Range(0, numChunks), [&](const Range& range) {
+        for (int chunk = range.start; chunk < range.end; chunk++)
+        {
+            uint64_t count = starts[chunk + 1] - starts[chunk];
+            if constexpr (bEdges)
+            {
+                count = 0;
+                for (size_t sample = starts[chunk]; sample < starts[chunk + 1]; sample++)
                 {
-                    firstColourValue--;
+                    count += edgePixels[sample / 3] != 0;
                 }
+            }
 
-                rangeDifference = std::abs(firstColourValue - secondColourValue);
-                numBitsPerBlock = pvdRangeTable[rangeDifference];
-                if (numBitsPerBlock <= MAX_PVD_GREEN_EMBEDDING)
-                {
-                    lowerBound = pvdRangeLowerBounds[numBitsPerBlock];
-                    rangeDifference = rangeDifference - lowerBound;
+            counts[chunk] = count * this->lsbBits;
+        }
+    });
 
-                    differenceBinary = std::bitset<8>(rangeDifference);
+    std::vector<uint64_t> offsets = exclusivePrefixSum(counts);
 
-                    if (greenRow[currentColumn] % 2 != 0)
+    // The last sample only has the bits the payload reaches changed, as in encodeLsbFile
+    cv::parallel_for_(Range(0, numChunks), [&](const Range& range) {
+        for (int chunk = range.start; chunk < range.end; chunk++)
+        {
+            uint64_t bitIndex = firstBit + offsets[chunk];
+            for (size_t sample = starts[chunk]; sample < starts[chunk + 1] && bitIndex < numBits; sample++)
+            {
+                if constexpr (bEdges)
+                {
+                    if (edgePixels[sample / 3] == 0)
                     {
-                        differenceBinary[numBitsPerBlock - 1] = true;
+                        continue;
                     }
+                }
 
-                    for (size_t i = 0; i < numBitsPerBlock; i++)
-                    {
-                        dataByte[dataByteIndex] = differenceBinary[i];
+                size_t numSampleBits = std::min<uint64_t>(this->lsbBits, numBits - bitIndex);
+                samples[sample] = embedLsbBits(samples[sample], data, bitIndex, 0, numSampleBits);
+                bitIndex += numSampleBits;
+            }
+        }
+    });
 
-                        dataByteIndex++;
-                        if (dataByteIndex >= dataByte.size())
-                        {
-                            dataByteIndex = 0;
-                            this->fileName += static_cast<uchar>(dataByte.to_ulong());
-                            dataByte.reset();
-
-                            if (fileName.length() >= fileNameLength)
-                            {
-                                break;
-                            }
-                        }
-                    }
-                }
+    return StegoStatus::SUCCESS;
+}
+
+/**
+ * @brief Stego::encodePvdFileParallel Parallel version of encodePvdFile for a whole payload held in memory.
+ * The pixel pairs after the file name are split into chunks and a prefix sum over the embedding maps gives
+ * each chunk its payload bit offset. A block is only embedded while payload bits remain, exactly as in
+ * encodePvdFile, so the result is identical. With edge detection the maps of rows detectEdgesFor has not reached are
+ * not masked yet and their counts are too high, which is harmless because the payload ends inside the masked rows and
+ * no bit is embedded past them.
+ */
+StegoStatus Stego::encodePvdFileParallel(const std::vector<uchar>& data)
+{
+    if (this->edgeDetectionType != EdgeDetectionType::None)
+    {
+        return encodePvdFileParallelKernel<true>(data);
+    }
+
+    return encodePvdFileParallelKernel<false>(data);
+}
 
-                if (fileName.length() >= fileNameLength)
+template <bool bEdges>
+StegoStatus Stego::encodePvdFileParallelKernel(const std::vector<uchar>& data)
+{
+    uchar* blueValues = context.blueChannel.ptr<uchar>(0);
+    uchar* greenValues = context.greenChannel.ptr<uchar>(0);
+    uchar* redValues = context.redChannel.ptr<uchar>(0);
+    const uchar* blueBits = context.blueEmbedding.ptr<uchar>(0);
+    const uchar* greenBits = context.greenEmbedding.ptr<uchar>(0);
+    const uchar* redBits = context.redEmbedding.ptr<uchar>(0);
+
+    size_t numValues = context.blueChannel.total();
+    size_t startPair = context.currentRow * context.blueChannel.cols + context.currentColumn;
+    size_t endPair = numValues > startPair ? startPair + ((numValues - startPair) / 2) * 2 : startPair;
+
+    std::vector<size_t> starts = chunkStarts(startPair, endPair, 2, cv::getNumThreads() * CHUNKS_PER_THREAD);
+    size_t numChunks = starts.size() - 1;
+
+    std::vector<uint64_t> counts(numChunks, 0);
+    cv::parallel_for_(Range(0, numChunks), [&](const Range& range) {
+        for (int chunk = range.start; chunk < range.end; chunk++)
+        {
+            uint64_t count = 0;
+            for (size_t pair = starts[chunk]; pair < starts[chunk + 1]; pair += 2)
+            {
+                count += blueBits[pair] + redBits[pair];
+                if constexpr (!bEdges)
                 {
-                    break;
+                    count += greenBits[pair];
                 }
             }
 
-            firstColourValue = redRow[currentColumn];
-            secondColourValue = redRow[currentColumn + 1];
+            counts[chunk] = count;
+        }
+    });
 
-            if (firstColourValue % 2 == 0)
-            {
-                firstColourValue++;
-            }
-            else
-            {
-                firstColourValue--;
-            }
+    std::vector<uint64_t> offsets = exclusivePrefixSum(counts);
 
-            rangeDifference = std::abs(firstColourValue - secondColourValue);
-            numBitsPerBlock = pvdRangeTable[rangeDifference];
-            if (numBitsPerBlock <= MAX_PVD_RED_EMBEDDING)
+    cv::parallel_for_(Range(0, numChunks), [&](const Range& range) {
+        for (int chunk = range.start; chunk < range.end; chunk++)
+        {
+            VectorBitSource source(data, offsets[chunk]);
+            for (size_t pair = starts[chunk]; pair < starts[chunk + 1] && !source.Empty(); pair += 2)
             {
-                lowerBound = pvdRangeLowerBounds[numBitsPerBlock];
-                rangeDifference = rangeDifference - lowerBound;
-
-                differenceBinary = std::bitset<8>(rangeDifference);
+                embedPvdBlock(blueValues + pair, blueBits[pair], source);
 
-                if (redRow[currentColumn] % 2 != 0)
+                if constexpr (bEdges)
                 {
-                    differenceBinary[numBitsPerBlock - 1] = true;
+                    if (blueBits[pair] != 0 || redBits[pair] != 0)
+                    {
+                        greenValues[pair] = setBit(greenValues[pair], 0);
+                    }
+                    else
+                    {
+                        greenValues[pair] = clearBit(greenValues[pair], 0);
+                    }
                 }
-
-                for (size_t i = 0; i < numBitsPerBlock; i++)
+                else
                 {
-                    dataByte[dataByteIndex] = differenceBinary[i];
-
-                    dataByteIndex++;
-                    if (dataByteIndex >= dataByte.size())
+                    if (source.Empty())
                     {
-                        dataByteIndex = 0;
-                        this->fileName += static_cast<uchar>(dataByte.to_ulong());
-                        dataByte.reset();
-
-                        if (fileName.length() >= fileNameLength)
-                        {
-                            break;
-                        }
+                        break;
                     }
+
+                    embedPvdBlock(greenValues + pair, greenBits[pair], source);
                 }
-            }
-        }
 
-        if (fileName.length() >= fileNameLength)
-        {
-            break;
+                if (source.Empty())
+                {
+                    break;
+                }
+
+                embedPvdBlock(redValues + pair, redBits[pair], source);
+            }
         }
-    }
+    });
 
-    currentColumn += 2;
     return StegoStatus::SUCCESS;
 }
 
-StegoStatus Stego::decodePvdFile(cv::Mat image, std::ofstream& file, size_t& bytesWritten, std::bitset<8>& dataByte, size_t& dataByteIndex)
+/**
+ * @brief Stego::decodeLsbFileParallel Parallel version of decodeLsbFile, writes the whole file once every
+ * chunk has been extracted.
+ */
+StegoStatus Stego::decodeLsbFileParallel(cv::Mat image, std::ostream& file)
 {
-    Mat colours[3];
-    split(image, colours);
-
-    this->blueChannel = colours[0];
-    this->greenChannel = colours[1];
-    this->redChannel = colours[2];
-
-    int channels = blueChannel.channels();
-    int nRows = blueChannel.rows;
-    int nCols = blueChannel.cols * channels;
-    if (blueChannel.isContinuous())
+    if (this->edgeDetectionType != EdgeDetectionType::None)
     {
-        nCols *= nRows;
-        nRows = 1;
+        return decodeLsbFileParallelKernel<true>(image, file);
     }
 
-    uchar* blueRow;
-    uchar* greenRow;
-    uchar* redRow;
-
-    uchar firstColourValue;
-    uchar secondColourValue;
-    uchar rangeDifference;
-    std::bitset<8> differenceBinary;
-    size_t lowerBound;
-    size_t numBitsPerBlock;
+    return decodeLsbFileParallelKernel<false>(image, file);
+}
 
-    for (; currentRow < nRows; currentRow++)
+template <bool bEdges>
+StegoStatus Stego::decodeLsbFileParallelKernel(cv::Mat image, std::ostream& file)
+{
+    const uchar* samples = image.ptr<uchar>(0);
+    size_t numSamples = image.total() * image.channels();
+    size_t startSample = context.currentRow * image.cols * image.channels() + context.currentColumn;
+
+    // The file name may end inside a sample, its bits left hold the start of the file
+    uint64_t firstBit = 0;
+    uchar firstBits = 0;
+    if (context.currentBit != 0)
     {
-        if (bytesWritten >= fileLength)
-        {
-            break;
-        }
+        firstBit = this->lsbBits - context.currentBit;
+        firstBits = static_cast<uchar>(samples[startSample] >> context.currentBit);
+        startSample++;
+    }
 
-        blueRow = this->blueChannel.ptr<uchar>(currentRow);
-        greenRow = this->greenChannel.ptr<uchar>(currentRow);
-        redRow = this->redChannel.ptr<uchar>(currentRow);
+    Mat edges;
+    const uchar* edgePixels = nullptr;
+    if constexpr (bEdges)
+    {
+        edges = context.edgeDetector.GetMagnitudes();
+        edgePixels = edges.ptr<uchar>(0);
 
-        for (; currentColumn < nCols; currentColumn += 2)
-        {
-            if (currentColumn + 1 >= nCols)
-            {
-                break;
-            }
+        // Rows below the ones detectEdgesFor reached are not final, the payload ends inside the detected rows
+        size_t numDetectedSamples = static_cast<size_t>(context.edgeDetector.NumDetectedRows()) * image.cols *
+                                    image.channels();
+        numSamples = std::max(startSample, std::min(numSamples, numDetectedSamples));
+    }
 
-            if (bytesWritten >= fileLength)
-            {
-                break;
-            }
+    std::vector<size_t> starts = chunkStarts(startSample, numSamples, 1, cv::getNumThreads() * CHUNKS_PER_THREAD);
+    size_t numChunks = starts.size() - 1;
 
-            if (edgeDetectionType != EdgeDetectionType::None)
+    std::vector<uint64_t> counts(numChunks, 0);
+    cv::parallel_for_(Range(0, numChunks), [&](const Range& range) {
+        for (int chunk = range.start; chunk < range.end; chunk++)
+        {
+            uint64_t count = starts[chunk + 1] - starts[chunk];
+            if constexpr (bEdges)
             {
-                if (greenRow[currentColumn] % 2 == 0)
+                count = 0;
+                for (size_t sample = starts[chunk]; sample < starts[chunk + 1]; sample++)
                 {
-                    continue;
+                    count += edgePixels[sample / 3] != 0;
                 }
             }
 
-            firstColourValue = blueRow[currentColumn];
-            secondColourValue = blueRow[currentColumn + 1];
+            counts[chunk] = count * this->lsbBits;
+        }
+    });
 
-            if (firstColourValue % 2 == 0)
-            {
-                firstColourValue++;
-            }
-            else
-            {
-                firstColourValue--;
-            }
+    // Only whole bytes are written, as in decodeLsbFile
+    std::vector<uint64_t> offsets = exclusivePrefixSum(counts);
+    for (uint64_t& offset : offsets)
+    {
+        offset += firstBit;
+    }
 
-            rangeDifference = std::abs(firstColourValue - secondColourValue);
-            numBitsPerBlock = pvdRangeTable[rangeDifference];
-            if (numBitsPerBlock <= MAX_PVD_BLUE_EMBEDDING)
-            {
-                lowerBound = pvdRangeLowerBounds[numBitsPerBlock];
-                rangeDifference = rangeDifference - lowerBound;
+    uint64_t numBytes = std::min<uint64_t>(context.fileLength, offsets.back() / BITS_PER_BYTE);
+    uint64_t numBits = numBytes * BITS_PER_BYTE;
+    std::vector<uchar> data(numBytes, 0);
+
+    ChunkBitWriter firstWriter(data, 0, std::min(firstBit, numBits));
+    for (uint64_t bitIndex = 0; bitIndex < std::min(firstBit, numBits); bitIndex++)
+    {
+        firstWriter.Put(bitIndex, (firstBits >> bitIndex) & 1);
+    }
 
-                differenceBinary = std::bitset<8>(rangeDifference);
+    firstWriter.Flush();
 
-                if (blueRow[currentColumn] % 2 != 0)
-                {
-                    differenceBinary[numBitsPerBlock - 1] = true;
-                }
+    std::vector<ChunkBitWriter> writers;
+    for (size_t chunk = 0; chunk < numChunks; chunk++)
+    {
+        writers.emplace_back(data, offsets[chunk], std::min(offsets[chunk + 1], numBits));
+    }
 
-                for (size_t i = 0; i < numBitsPerBlock; i++)
+    cv::parallel_for_(Range(0, numChunks), [&](const Range& range) {
+        for (int chunk = range.start; chunk < range.end; chunk++)
+        {
+            uint64_t bitIndex = offsets[chunk];
+            for (size_t sample = starts[chunk]; sample < starts[chunk + 1] && bitIndex < numBits; sample++)
+            {
+                if constexpr (bEdges)
                 {
-                    dataByte[dataByteIndex] = differenceBinary[i];
-
-                    dataByteIndex++;
-                    if (dataByteIndex >= dataByte.size())
+                    if (edgePixels[sample / 3] == 0)
                     {
-                        dataByteIndex = 0;
-                        file.put(static_cast<uchar>(dataByte.to_ulong()));
-                        bytesWritten++;
-                        dataByte.reset();
-
-                        if (bytesWritten >= fileLength)
-                        {
-                            break;
-                        }
+                        continue;
                     }
                 }
-            }
 
-            if (bytesWritten >= fileLength)
-            {
-                break;
+                for (size_t bit = 0; bit < this->lsbBits && bitIndex < numBits; bit++, bitIndex++)
+                {
+                    writers[chunk].Put(bitIndex, (samples[sample] >> bit) & 1);
+                }
             }
 
-            if (edgeDetectionType == EdgeDetectionType::None)
-            {
-                firstColourValue = greenRow[currentColumn];
-                secondColourValue = greenRow[currentColumn + 1];
+            writers[chunk].Flush();
+        }
+    });
 
-                if (firstColourValue % 2 == 0)
-                {
-                    firstColourValue++;
-                }
-                else
-                {
-                    firstColourValue--;
-                }
+    firstWriter.MergeSharedBytes();
+    for (ChunkBitWriter& writer : writers)
+    {
+        writer.MergeSharedBytes();
+    }
 
-                rangeDifference = std::abs(firstColourValue - secondColourValue);
-                numBitsPerBlock = pvdRangeTable[rangeDifference];
-                if (numBitsPerBlock <= MAX_PVD_GREEN_EMBEDDING)
-                {
-                    lowerBound = pvdRangeLowerBounds[numBitsPerBlock];
-                    rangeDifference = rangeDifference - lowerBound;
+    file.write(reinterpret_cast<const char*>(data.data()), data.size());
 
-                    differenceBinary = std::bitset<8>(rangeDifference);
+    context.currentColumn = 0;
+    context.currentRow = 0;
+    context.currentBit = 0;
 
-                    if (greenRow[currentColumn] % 2 != 0)
-                    {
-                        differenceBinary[numBitsPerBlock - 1] = true;
-                    }
+    return StegoStatus::SUCCESS;
+}
 
-                    for (size_t i = 0; i < numBitsPerBlock; i++)
-                    {
-                        dataByte[dataByteIndex] = differenceBinary[i];
+/**
+ * @brief Stego::decodePvdFileParallel Parallel version of decodePvdFile, writes the whole file once every
+ * chunk has been extracted.
+ */
+StegoStatus Stego::decodePvdFileParallel(cv::Mat image, std::ostream& file)
+{
+    if (this->edgeDetectionType != EdgeDetectionType::None)
+    {
+        return decodePvdFileParallelKernel<true>(image, file);
+    }
 
-                        dataByteIndex++;
-                        if (dataByteIndex >= dataByte.size())
-                        {
-                            dataByteIndex = 0;
-                            file.put(static_cast<uchar>(dataByte.to_ulong()));
-                            dataByte.reset();
-                            bytesWritten++;
-
-                            if (bytesWritten >= fileLength)
-                            {
-                                break;
-                            }
-                        }
+    return decodePvdFileParallelKernel<false>(image, file);
+}
+
+template <bool bEdges>
+StegoStatus Stego::decodePvdFileParallelKernel(cv::Mat image, std::ostream& file)
+{
+    splitChannels(image);
+
+    const uchar* blueValues = context.blueChannel.ptr<uchar>(0);
+    const uchar* greenValues = context.greenChannel.ptr<uchar>(0);
+    const uchar* redValues = context.redChannel.ptr<uchar>(0);
+
+    size_t numValues = context.blueChannel.total();
+    size_t startPair = context.currentRow * context.blueChannel.cols + context.currentColumn;
+    size_t endPair = numValues > startPair ? startPair + ((numValues - startPair) / 2) * 2 : startPair;
+
+    std::vector<size_t> starts = chunkStarts(startPair, endPair, 2, cv::getNumThreads() * CHUNKS_PER_THREAD);
+    size_t numChunks = starts.size() - 1;
+
+    std::vector<uint64_t> counts(numChunks, 0);
+    cv::parallel_for_(Range(0, numChunks), [&](const Range& range) {
+        std::bitset<8> differenceBinary;
+        for (int chunk = range.start; chunk < range.end; chunk++)
+        {
+            uint64_t count = 0;
+            for (size_t pair = starts[chunk]; pair < starts[chunk + 1]; pair += 2)
+            {
+                if constexpr (bEdges)
+                {
+                    if (greenValues[pair] % 2 == 0)
+                    {
+                        continue;
                     }
                 }
 
-                if (bytesWritten >= fileLength)
+                count += decodePvdBlock<MAX_PVD_BLUE_EMBEDDING>(blueValues + pair, differenceBinary);
+                if constexpr (!bEdges)
                 {
-                    break;
+                    count += decodePvdBlock<MAX_PVD_GREEN_EMBEDDING>(greenValues + pair, differenceBinary);
                 }
-            }
 
-            firstColourValue = redRow[currentColumn];
-            secondColourValue = redRow[currentColumn + 1];
-
-            if (firstColourValue % 2 == 0)
-            {
-                firstColourValue++;
-            }
-            else
-            {
-                firstColourValue--;
+                count += decodePvdBlock<MAX_PVD_RED_EMBEDDING>(redValues + pair, differenceBinary);
             }
 
-            rangeDifference = std::abs(firstColourValue - secondColourValue);
-            numBitsPerBlock = pvdRangeTable[rangeDifference];
-            if (numBitsPerBlock <= MAX_PVD_RED_EMBEDDING)
-            {
-                lowerBound = pvdRangeLowerBounds[numBitsPerBlock];
-                rangeDifference = rangeDifference - lowerBound;
+            counts[chunk] = count;
+        }
+    });
 
-                differenceBinary = std::bitset<8>(rangeDifference);
+    // Only whole bytes are written, as in decodePvdFile
+    std::vector<uint64_t> offsets = exclusivePrefixSum(counts);
+    uint64_t numBytes = std::min<uint64_t>(context.fileLength, offsets.back() / BITS_PER_BYTE);
+    uint64_t numBits = numBytes * BITS_PER_BYTE;
+    std::vector<uchar> data(numBytes, 0);
 
-                if (redRow[currentColumn] % 2 != 0)
-                {
-                    differenceBinary[numBitsPerBlock - 1] = true;
-                }
+    std::vector<ChunkBitWriter> writers;
+    for (size_t chunk = 0; chunk < numChunks; chunk++)
+    {
+        writers.emplace_back(data, offsets[chunk], std::min(offsets[chunk + 1], numBits));
+    }
 
-                for (size_t i = 0; i < numBitsPerBlock; i++)
+    cv::parallel_for_(Range(0, numChunks), [&](const Range& range) {
+        for (int chunk = range.start; chunk < range.end; chunk++)
+        {
+            ChunkBitSink sink(writers[chunk], offsets[chunk], numBits);
+            for (size_t pair = starts[chunk]; pair < starts[chunk + 1] && !sink.Full(); pair += 2)
+            {
+                if constexpr (bEdges)
                 {
-                    dataByte[dataByteIndex] = differenceBinary[i];
-                    dataByteIndex++;
-
-                    if (dataByteIndex >= dataByte.size())
+                    if (greenValues[pair] % 2 == 0)
                     {
-                        dataByteIndex = 0;
-                        file.put(static_cast<uchar>(dataByte.to_ulong()));
-                        bytesWritten++;
-                        dataByte.reset();
-
-                        if (bytesWritten >= fileLength)
-                        {
-                            break;
-                        }
+                        continue;
                     }
                 }
+
+                extractPvdBlock<MAX_PVD_BLUE_EMBEDDING>(blueValues + pair, sink);
+                if constexpr (!bEdges)
+                {
+                    extractPvdBlock<MAX_PVD_GREEN_EMBEDDING>(greenValues + pair, sink);
+                }
+
+                extractPvdBlock<MAX_PVD_RED_EMBEDDING>(redValues + pair, sink);
             }
+
+            writers[chunk].Flush();
         }
+    });
+
+    for (ChunkBitWriter& writer : writers)
+    {
+        writer.MergeSharedBytes();
     }
 
-    currentRow = 0;
-    currentColumn = 0;
+    file.write(reinterpret_cast<const char*>(data.data()), data.size());
+
+    context.currentRow = 0;
+    context.currentColumn = 0;
 
     return StegoStatus::SUCCESS;
 }
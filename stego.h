@@ -2,134 +2,243 @@
 #define STEGO_H
 
 #include <string>
+#include <filesystem>
 #include <opencv4/opencv2/opencv_modules.hpp>
 #include <cstdint>
 #include <bitset>
+#include <functional>
+#include <vector>
 #include <opencv4/opencv2/opencv.hpp>
 #include "StegoAlgo.h"
 #include "EdgeDetectionType.h"
 #include "StegoStatus.h"
 #include "edgedetection.h"
+#include "stegocontext.h"
+#include "bufferpool.h"
+#include "stegoconstants.h"
+#include "pngstrips.h"
+#include "videobackend.h"
+#include "framesource.h"
+#include "stegojournal.h"
+#include "stegoarchive.h"
+#include "stegoshard.h"
 #include <cryptopp/cryptlib.h>
 #include <cryptopp/default.h>
 #include <cryptopp/files.h>
 #include <cryptopp/filters.h>
 #include <cryptopp/hex.h>
+#include <cryptopp/zdeflate.h>
+#include <cryptopp/zinflate.h>
 
 class Stego
 {
 public:
     Stego(std::string filePath, std::string mediaPath, std::string algo, std::string edgeDetection, bool bEncrypt, std::string password);
     Stego(std::string mediaPath, bool bEncrypt, std::string password);
+    Stego(std::string algo, std::string edgeDetection, bool bEncrypt, std::string password);
     ~Stego();
 
     StegoStatus EncodeImage();
     StegoStatus DecodeImage();
 
+    StegoStatus EncodeImage(const cv::Mat& carrier, const uint8_t* payload, size_t payloadSize,
+                            const std::string& fileName, cv::Mat& stegoImage);
+    StegoStatus EncodeImage(const std::vector<uchar>& carrier, const uint8_t* payload, size_t payloadSize,
+                            const std::string& fileName, std::vector<uchar>& stegoImage, const std::string& extension = ".png");
+    StegoStatus DecodeImage(const cv::Mat& stegoImage, std::vector<uint8_t>& payload, std::string& fileName);
+    StegoStatus DecodeImage(const std::vector<uchar>& stegoImage, std::vector<uint8_t>& payload, std::string& fileName);
+
     StegoStatus EncodeVideo();
     StegoStatus DecodeVideo();
 
+    StegoStatus ExtractRange(uint64_t offset, uint64_t length);
+    StegoStatus ExtractMember(const std::string& memberName);
+
+    StegoStatus UpdateImage();
+    StegoStatus UpdateImage(cv::Mat& stegoImage, const uint8_t* payload, size_t payloadSize, const std::string& fileName);
+    StegoStatus UpdateVideo();
+
+    StegoStatus EncodeShards(const std::vector<std::string>& mediaPaths);
+    StegoStatus DecodeShards(const std::vector<std::string>& mediaPaths);
+
     StegoStatus EncryptFile();
     StegoStatus DecryptFile();
 
-    uint64_t embedSize;
+    StegoStatus CalculateCapacity();
+
+    void SetWorkingDirectory(std::string workingDirectory);
+    void SetOutputDirectory(std::string outputDirectory);
+    std::string GetOutputPath() const;
+    uint64_t GetEmbedSize() const;
+    void SetParallel(bool bParallel);
+    void SetCompression(bool bCompress);
+    void SetStripBudget(size_t maxStripBytes);
+    void SetVideoBackend(const VideoBackend& videoBackend);
+    void SetFrameSource(FrameSourceType frameSourceType);
+    void SetCheckpointInterval(size_t numFrames);
+    void SetLsbBits(size_t lsbBits);
+    void SetInflateLimit(uint64_t maxBytes);
+    void SetBufferPool(std::shared_ptr<BufferPool> bufferPool);
+    void SetEdgeCache(std::shared_ptr<EdgeCache> edgeCache);
+    BufferPoolStats GetBufferPoolStats() const;
 
 private:
-    static constexpr std::array<size_t, 256> pvdRangeTable = [] {
-        std::array<size_t, 256> result {};
-        for (size_t i = 0; i < 8; ++ i)
-        {
-            result[i] = 2;
-        }
-
-        for (size_t i = 8; i < 16; ++ i)
-        {
-            result[i] = 3;
-        }
-
-        for (size_t i = 16; i < 32; ++ i)
-        {
-            result[i] = 4;
-        }
-
-        for (size_t i = 32; i < 64; ++ i)
-        {
-            result[i] = 5;
-        }
-
-        for (size_t i = 64; i < 128; ++ i)
-        {
-            result[i] = 6;
-        }
-
-        for (size_t i = 128; i < 256; ++ i)
-        {
-            result[i] = 7;
-        }
-
-        return result;
-    }();
-
-    static constexpr std::array<size_t, 8> pvdRangeLowerBounds = [] {
-        std::array<size_t, 8> result {};
-        result[2] = 0;
-        result[3] = 8;
-        result[4] = 16;
-        result[5] = 32;
-        result[6] = 64;
-        result[7] = 128;
-
-        return result;
-    }();
-
-
     std::string filePath;
+    // The file as given, filePath points to the temp file embedded instead once the payload is compressed or encrypted
+    std::string sourceFilePath;
     std::string fileName;
     std::string mediaPath;
 
-    StegoAlgo algo;
-    EdgeDetectionType edgeDetectionType;
+    std::filesystem::path workingDirectory;
+    std::filesystem::path outputDirectory;
+    std::filesystem::path tempEncryptFilePath;
+    std::filesystem::path tempCompressFilePath;
+    std::filesystem::path tempArchiveFilePath;
+    std::vector<std::filesystem::path> tempPaths;
+    std::string outputPath;
 
-    size_t currentRow;
-    size_t currentColumn;
+    StegoAlgo algo = StegoAlgo::LSB;
+    EdgeDetectionType edgeDetectionType = EdgeDetectionType::None;
+
+    // Least significant bits of each sample LSB embeds in, taken from the header when decoding
+    size_t lsbBits = 1;
 
-    uint16_t fileNameLength;
-    uint32_t fileLength;
     bool bEncrypt;
     std::string password;
-
-    cv::Mat greenChannel;
-    cv::Mat blueChannel;
-    cv::Mat redChannel;
-
-    cv::Mat greenEmbedding;
-    cv::Mat blueEmbedding;
-    cv::Mat redEmbedding;
-
-    EdgeDetection edgeDetector;
-
-    StegoStatus encodeLsb(cv::Mat image);
-    StegoStatus encodePvd();
+    bool bParallel = true;
+
+    // bFileCompressed is set once filePath holds the deflated payload
+    bool bCompress = false;
+    bool bCompressionChecked = false;
+    bool bFileCompressed = false;
+
+    // Bytes a compressed payload may inflate to, 0 derives the limit from the embedded size, see SetInflateLimit
+    uint64_t maxInflatedBytes = 0;
+
+    // bFileArchived is set once filePath holds the archive a directory was packed to. archiveMember is the only
+    // member unpacked while ExtractMember decodes a whole archive.
+    bool bFileArchived = false;
+    std::string archiveMember;
+
+    // Set on the instances EncodeShards and DecodeShards run for every medium of a shard set
+    bool bShard = false;
+
+    // Bytes of carrier rows EncodeImage holds at once, 0 loads the whole carrier
+    size_t stripBudget = 0;
+
+    VideoBackend videoBackend;
+    FrameSourceType frameSourceType = FrameSourceType::VideoCapture;
+
+    // Frames between the checkpoints of EncodeVideo, 0 disables checkpoints
+    size_t checkpointInterval = 0;
+
+    std::shared_ptr<EdgeCache> edgeCache;
+
+    StegoContext context;
+
+    void setAlgorithms(const std::string& algo, const std::string& edgeDetection);
+    void resetContext();
+    std::filesystem::path getTempEncryptFilePath();
+    std::filesystem::path getTempCompressFilePath();
+    std::filesystem::path getTempArchiveFilePath();
+    std::filesystem::path createTempDirectory();
+    std::filesystem::path getOutputDirectory(const std::string& defaultName) const;
+
+    StegoStatus readFileLength();
+    std::string checkpointKey() const;
+    bool loadCheckpoint(const std::filesystem::path& checkpointDirectory, StegoJournal& journal,
+                        const cv::Size& frameSize);
+    StegoStatus startCheckpoint(const std::filesystem::path& checkpointDirectory, StegoJournal& journal);
+    void checkpointFrame(const std::filesystem::path& checkpointDirectory, StegoJournal& journal, size_t frameCount,
+                         std::istream& file, const std::bitset<8>& dataByte, size_t dataByteIndex, bool bFileNameEmbedded);
+    bool checkPassword(const std::filesystem::path& encryptedPath) const;
+    StegoStatus packArchive();
+    StegoStatus unpackArchive(const std::filesystem::path& archivePath);
+    StegoStatus extractArchiveMember(const std::function<StegoStatus(uint64_t, uint64_t, std::ostream&)>& decodeRange);
+    StegoStatus openPayloadRanges(std::function<StegoStatus(uint64_t, uint64_t, std::ostream&)>& decodeRange);
+    std::filesystem::path decodedFilePath();
+    StegoStatus finishDecode(const std::filesystem::path& filePath);
+    StegoStatus encodeShard(const StegoShard& shard, uint64_t sliceLength, const std::string& mediaPath,
+                            const std::filesystem::path& shardDirectory, const std::filesystem::path& stegoMediaDirectory);
+    StegoStatus decodeShard(const std::string& mediaPath, StegoShardSet& shardSet);
+    StegoStatus compressFile();
+    StegoStatus inflateFile(const std::filesystem::path& compressedPath, const std::filesystem::path& outputPath);
+    StegoStatus deflateBuffer(const uint8_t* data, size_t size, std::string& compressed);
+    StegoStatus inflateBuffer(std::vector<uint8_t>& data);
+    StegoStatus preparePayload(const uint8_t*& payload, size_t& payloadSize, std::string& compressedPayload,
+                               std::string& encryptedPayload);
+    bool reencodeVideo(const std::filesystem::path& framesDirectory, double videoFPS, const std::string& stegoMediaPath);
+    StegoStatus encodeImage(cv::Mat image, std::istream& file);
+    StegoStatus encodeImageStrips(PngStripReader& reader);
+    StegoStatus encodeFirstStrip(PngStripWindow& strips, int stripRows, cv::Mat& strip, std::istream& file,
+                                 std::bitset<8>& dataByte, size_t& dataByteIndex, uint64_t& capacityBits);
+    uint64_t encodeStrip(PngStripWindow& strips, cv::Mat strip, bool bEmbed, std::istream& file,
+                         std::bitset<8>& dataByte, size_t& dataByteIndex);
+    StegoStatus detectStripEdges(const PngStripWindow& strips);
+    uint64_t getStripCapacityBits(cv::Mat strip, bool bLastStrip);
+    int getStripRows(int width) const;
+    StegoStatus encryptBuffer(const uint8_t* data, size_t size, std::string& encrypted);
+    StegoStatus decryptBuffer(std::vector<uint8_t>& data);
+    StegoStatus encodeLsb(cv::Mat image, std::istream& file);
+    StegoStatus encodePvd(std::istream& file);
     StegoStatus encodeHeader(cv::Mat image);
     StegoStatus encodeLsbFileName(cv::Mat image);
     StegoStatus encodePvdFileName();
-    StegoStatus encodeLsbFile(cv::Mat image, std::ifstream& file, std::bitset<8>& dataByte, size_t& dataByteIndex);
-    StegoStatus encodePvdFile(std::ifstream& file, std::bitset<8>& dataByte, size_t& dataByteIndex);
-    uint32_t getLsbSequentialSize(cv::Mat image);
-    uint32_t getLsbEdgeSize();
-    uint32_t getPvdSequentialSize(cv::Mat image);
-    uint32_t getPvdEdgeSize(cv::Mat image);
-    bool isFileTooLarge(cv::Mat image, uint32_t numFrames = 1);
+    StegoStatus encodeLsbFile(cv::Mat image, std::istream& file, std::bitset<8>& dataByte, size_t& dataByteIndex);
+    StegoStatus encodePvdFile(std::istream& file, std::bitset<8>& dataByte, size_t& dataByteIndex);
+    template <bool bEdges> StegoStatus encodeLsbFileNameKernel(cv::Mat image);
+    template <bool bEdges> StegoStatus encodeLsbFileKernel(cv::Mat image, std::istream& file, std::bitset<8>& dataByte, size_t& dataByteIndex);
+    template <bool bEdges, typename BitSource> void embedPvdPairs(BitSource& source);
+    template <typename BitSource> static void embedPvdBlock(uchar* pair, size_t numBits, BitSource& source);
+    uint64_t getLsbSequentialSize(cv::Mat image);
+    uint64_t getLsbEdgeSize(uint64_t numBitsNeeded);
+    uint64_t getPvdSequentialSize(cv::Mat image);
+    uint64_t getPvdEdgeSize(cv::Mat image, uint64_t numBitsNeeded);
+    uint64_t sumPvdEmbeddings();
+    uint64_t maskPvdEmbeddingsToEdges(size_t firstRow, size_t firstColumn, size_t endRow);
+    uint64_t getEncodeableSize(cv::Mat image, uint64_t numBytesNeeded);
+    bool isFileTooLarge(cv::Mat image, uint64_t numFrames = 1);
+    uint64_t detectEdgesFor(uint64_t numBits);
+    uint64_t remainingPayloadBits(std::istream& file, size_t dataByteIndex, bool bFileNameEmbedded);
+    void splitChannels(cv::Mat image);
     void calculatePvdEmbeddings();
-    void embedPvdPair(std::bitset<7> embeddingNumber, size_t numBits, uchar* row);
-    void embedPvdOverhead(uchar* row);
-    std::pair<int, int> calculateNewPvdPixelPairs(int firstValue, int secondValue, int difference, int newDifference, double embed);
-
-    StegoStatus decodeHeader(cv::Mat image);
+    static void embedPvdPair(std::bitset<7> embeddingNumber, size_t numBits, uchar* pair);
+    static void embedPvdOverhead(uchar* pair);
+    static std::pair<int, int> calculateNewPvdPixelPairs(int firstValue, int secondValue, int difference, int newDifference, double embed);
+
+    StegoStatus decodeHeader(cv::Mat image, uint64_t numFrames = 1);
+    void setCursorAfterHeader(cv::Mat image, size_t numPixels);
+    StegoStatus decodeImageFileName(cv::Mat image);
+    StegoStatus decodeImageFile(cv::Mat image, std::ostream& file);
+    StegoStatus decodeImageRange(cv::Mat image, uint64_t offset, uint64_t length, std::ostream& file);
+    StegoStatus decodeVideoFileName(FrameSource& video, cv::Mat& frame, size_t& frameIndex);
+    StegoStatus decodeVideoRange(FrameSource& video, cv::Mat& frame, size_t frameIndex, uint64_t offset,
+                                 uint64_t length, std::ostream& file);
+    StegoStatus beginUpdate(cv::Mat image, uint64_t numFrames, StegoUpdate& update);
+    bool extractUpdateStream(cv::Mat frame, StegoUpdate& update);
+    void readUpdateStream(std::istream& file, StegoUpdate& update);
+    bool isFrameUpdated(size_t frameIndex, const StegoUpdate& update) const;
+    bool updateLsbFrame(cv::Mat frame, StegoUpdate& update);
+    StegoStatus updateImage(cv::Mat image, std::istream& file);
+    bool skipLsbBits(cv::Mat image, uint64_t& numBits);
+    template <bool bEdges> bool skipLsbBitsKernel(cv::Mat image, uint64_t& numSamples);
     StegoStatus decodeLsbFileName(cv::Mat image);
-    StegoStatus decodeLsbFile(cv::Mat image, std::ofstream& file, size_t& bytesWritten, std::bitset<8>& dataByte, size_t& dataByteIndex);
+    StegoStatus decodeLsbFile(cv::Mat image, std::ostream& file, uint64_t& bytesWritten, std::bitset<8>& dataByte, size_t& dataByteIndex);
     StegoStatus decodePvdFileName(cv::Mat image);
-    StegoStatus decodePvdFile(cv::Mat image, std::ofstream& file, size_t& bytesWritten, std::bitset<8>& dataByte, size_t& dataByteIndex);
+    StegoStatus decodePvdFile(cv::Mat image, std::ostream& file, uint64_t& bytesWritten, std::bitset<8>& dataByte, size_t& dataByteIndex);
+    template <bool bEdges> StegoStatus decodeLsbFileNameKernel(cv::Mat image);
+    template <bool bEdges> StegoStatus decodeLsbFileKernel(cv::Mat image, std::ostream& file, uint64_t& bytesWritten, std::bitset<8>& dataByte, size_t& dataByteIndex);
+    template <bool bEdges, typename BitSink> void extractPvdPairs(BitSink& sink);
+
+    bool useParallelKernels(const cv::Mat& image) const;
+    StegoStatus encodeLsbFileParallel(cv::Mat image, const std::vector<uchar>& data);
+    StegoStatus encodePvdFileParallel(const std::vector<uchar>& data);
+    StegoStatus decodeLsbFileParallel(cv::Mat image, std::ostream& file);
+    StegoStatus decodePvdFileParallel(cv::Mat image, std::ostream& file);
+    template <bool bEdges> StegoStatus encodeLsbFileParallelKernel(cv::Mat image, const std::vector<uchar>& data);
+    template <bool bEdges> StegoStatus encodePvdFileParallelKernel(const std::vector<uchar>& data);
+    template <bool bEdges> StegoStatus decodeLsbFileParallelKernel(cv::Mat image, std::ostream& file);
+    template <bool bEdges> StegoStatus decodePvdFileParallelKernel(cv::Mat image, std::ostream& file);
 };
 
 #endif // STEGO_H
@@ -0,0 +1,447 @@
+#include "stegoarchive.h"
+#include "stegoconstants.h"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <QDebug>
+#include <cryptopp/files.h>
+#include <cryptopp/filters.h>
+#include <cryptopp/zdeflate.h>
+#include <cryptopp/zinflate.h>
+
+const size_t ARCHIVE_COPY_BYTES = 64 * 1024;
+const size_t MAX_MEMBER_NAME_LENGTH = 0xFFFF;
+
+/**
+ * @brief uniqueTempName Build a temp file name that is unique across Stego and EdgeCache instances, threads and
+ * processes sharing a directory.
+ */
+std::string uniqueTempName(const std::string& prefix)
+{
+    static const unsigned int processToken = std::random_device()();
+    static std::atomic<uint64_t> tempCounter(0);
+
+    std::ostringstream name;
+    name << prefix << "_" << std::hex << processToken << "_" << std::dec << tempCounter++;
+    return name.str();
+}
+
+void putLittleEndian(std::string& bytes, uint64_t value, size_t numBytes)
+{
+    for (size_t i = 0; i < numBytes; i++)
+    {
+        bytes.push_back(static_cast<char>(value >> (i * 8)));
+    }
+}
+
+uint64_t readLittleEndian(const std::vector<uint8_t>& bytes, size_t position, size_t numBytes)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < numBytes; i++)
+    {
+        value |= static_cast<uint64_t>(bytes[position + i]) << (i * 8);
+    }
+
+    return value;
+}
+
+uint64_t inflateLimit(uint64_t compressedBytes, uint64_t maxInflatedBytes)
+{
+    if (maxInflatedBytes != 0)
+    {
+        return maxInflatedBytes;
+    }
+
+    uint64_t ratioBytes = compressedBytes > std::numeric_limits<uint64_t>::max() / INFLATE_LIMIT_RATIO
+                              ? std::numeric_limits<uint64_t>::max()
+                              : compressedBytes * INFLATE_LIMIT_RATIO;
+
+    return std::max(ratioBytes, MIN_INFLATE_LIMIT_BYTES);
+}
+
+InflateLimitFilter::InflateLimitFilter(uint64_t maxBytes, CryptoPP::BufferedTransformation* attachment)
+    : maxBytes(maxBytes)
+{
+    Detach(attachment);
+}
+
+size_t InflateLimitFilter::Put2(const CryptoPP::byte* inString, size_t length, int messageEnd, bool blocking)
+{
+    inflatedBytes += length;
+    if (inflatedBytes > maxBytes)
+    {
+        throw CryptoPP::Inflator::Err(CryptoPP::Exception::INVALID_DATA_FORMAT,
+                                      "Inflator: payload inflates past the limit");
+    }
+
+    return Output(0, inString, length, messageEnd, blocking);
+}
+
+/**
+ * @brief copyBytes Copy numBytes from the current position of source into sink.
+ * @return false if source ends first
+ */
+bool copyBytes(std::istream& source, CryptoPP::BufferedTransformation& sink, uint64_t numBytes)
+{
+    std::vector<char> buffer(ARCHIVE_COPY_BYTES);
+    while (numBytes > 0)
+    {
+        std::streamsize chunk = static_cast<std::streamsize>(std::min<uint64_t>(numBytes, buffer.size()));
+        if (!source.read(buffer.data(), chunk))
+        {
+            return false;
+        }
+
+        sink.Put(reinterpret_cast<const CryptoPP::byte*>(buffer.data()), chunk);
+        numBytes -= chunk;
+    }
+
+    return true;
+}
+
+/**
+ * @brief StegoArchive::ReadIndexSize Read the size of the prefix and index from the first PREFIX_BYTES of a payload.
+ * @return StegoStatus::INVALID_HEADER if the payload of payloadLength bytes is no archive, StegoStatus::SUCCESS otherwise
+ */
+StegoStatus StegoArchive::ReadIndexSize(const std::vector<uint8_t>& prefix, uint64_t payloadLength,
+                                        uint64_t& indexSize)
+{
+    if (prefix.size() < PREFIX_BYTES || readLittleEndian(prefix, 0, 4) != MAGIC)
+    {
+        return StegoStatus::INVALID_HEADER;
+    }
+
+    uint64_t numMembers = readLittleEndian(prefix, 4, 4);
+    indexSize = readLittleEndian(prefix, 8, 8);
+    if (indexSize < PREFIX_BYTES || indexSize > payloadLength ||
+        (indexSize - PREFIX_BYTES) / MEMBER_FIXED_BYTES < numMembers)
+    {
+        return StegoStatus::INVALID_HEADER;
+    }
+
+    return StegoStatus::SUCCESS;
+}
+
+/**
+ * @brief StegoArchive::ReadIndex Read the members from index, the first indexSize bytes of the payload. Every member
+ * must lie inside the payload of payloadLength bytes and have a name that stays inside the directory it is unpacked to.
+ * @return StegoStatus::INVALID_HEADER if the index is damaged, StegoStatus::SUCCESS otherwise
+ */
+StegoStatus StegoArchive::ReadIndex(const std::vector<uint8_t>& index, uint64_t payloadLength)
+{
+    this->members.clear();
+    StegoStatus status = ReadIndexSize(index, payloadLength, this->indexSize);
+    if (status != StegoStatus::SUCCESS || index.size() < this->indexSize)
+    {
+        return StegoStatus::INVALID_HEADER;
+    }
+
+    uint64_t dataLength = payloadLength - this->indexSize;
+    size_t numMembers = static_cast<size_t>(readLittleEndian(index, 4, 4));
+    size_t position = PREFIX_BYTES;
+    for (size_t i = 0; i < numMembers; i++)
+    {
+        if (position + MEMBER_FIXED_BYTES > this->indexSize)
+        {
+            return StegoStatus::INVALID_HEADER;
+        }
+
+        StegoArchiveMember member;
+        size_t nameLength = static_cast<size_t>(readLittleEndian(index, position, 2));
+        position += 2;
+        if (position + nameLength + MEMBER_FIXED_BYTES - 2 > this->indexSize)
+        {
+            return StegoStatus::INVALID_HEADER;
+        }
+
+        member.name.assign(index.begin() + position, index.begin() + position + nameLength);
+        position += nameLength;
+        member.offset = readLittleEndian(index, position, 8);
+        member.length = readLittleEndian(index, position + 8, 8);
+        member.flags = index[position + 16];
+        position += 17;
+
+        if (!IsSafeName(member.name) || member.offset > dataLength || member.length > dataLength - member.offset)
+        {
+            return StegoStatus::INVALID_HEADER;
+        }
+
+        this->members.push_back(member);
+    }
+
+    return position == this->indexSize ? StegoStatus::SUCCESS : StegoStatus::INVALID_HEADER;
+}
+
+/**
+ * @brief StegoArchive::Find
+ * @return The member called name, nullptr if there is none
+ */
+const StegoArchiveMember* StegoArchive::Find(const std::string& name) const
+{
+    for (const StegoArchiveMember& member : this->members)
+    {
+        if (member.name == name)
+        {
+            return &member;
+        }
+    }
+
+    return nullptr;
+}
+
+/**
+ * @brief StegoArchive::ListFiles Every regular file under directory with its member name, sorted by name so the
+ * same directory always packs to the same archive.
+ */
+std::vector<std::pair<std::filesystem::path, std::string>> StegoArchive::ListFiles(const std::filesystem::path& directory)
+{
+    std::vector<std::pair<std::filesystem::path, std::string>> files;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(directory, error))
+    {
+        if (entry.is_regular_file(error))
+        {
+            files.emplace_back(entry.path(), entry.path().lexically_relative(directory).generic_string());
+        }
+    }
+
+    std::sort(files.begin(), files.end(), [](const auto& first, const auto& second)
+    {
+        return first.second < second.second;
+    });
+
+    return files;
+}
+
+/**
+ * @brief StegoArchive::Pack Write every file under directory to an archive at archivePath. With bCompress members
+ * are deflated one by one, members that do not get smaller are stored as they are.
+ * @return StegoStatus::FILE_NOT_FOUND if a file could not be read, StegoStatus::FILE_OPEN_FAILED if the archive
+ * could not be written, StegoStatus::SUCCESS otherwise
+ */
+StegoStatus StegoArchive::Pack(const std::filesystem::path& directory, const std::filesystem::path& archivePath,
+                               bool bCompress)
+{
+    // The index in front needs the stored lengths, so the data is written to a file of its own first
+    std::filesystem::path dataPath = archivePath;
+    dataPath += ".data";
+    std::fstream data(dataPath, std::ios_base::in | std::ios_base::out | std::ios_base::trunc | std::ios_base::binary);
+    if (!data.is_open())
+    {
+        return StegoStatus::FILE_OPEN_FAILED;
+    }
+
+    std::vector<StegoArchiveMember> members;
+    uint64_t dataLength = 0;
+    for (const auto& [path, name] : ListFiles(directory))
+    {
+        std::ifstream file(path, std::ios_base::binary);
+        std::error_code error;
+        uint64_t fileLength = std::filesystem::file_size(path, error);
+        if (!file.is_open() || error || name.size() > MAX_MEMBER_NAME_LENGTH)
+        {
+            data.close();
+            std::filesystem::remove(dataPath, error);
+            return StegoStatus::FILE_NOT_FOUND;
+        }
+
+        StegoArchiveMember member;
+        member.name = name;
+        member.offset = dataLength;
+
+        // Same probe as for whole payloads, members that are already compressed are stored without a full pass
+        if (bCompress)
+        {
+            std::string probe(std::min<uint64_t>(fileLength, COMPRESSION_PROBE_BYTES), '\0');
+            file.read(probe.data(), probe.size());
+
+            std::string compressedProbe;
+            CryptoPP::ArraySource probeSource(reinterpret_cast<const CryptoPP::byte*>(probe.data()), probe.size(), true,
+                                              new CryptoPP::Deflator(new CryptoPP::StringSink(compressedProbe)));
+            file.clear();
+            file.seekg(0);
+            if (compressedProbe.size() < probe.size())
+            {
+                CryptoPP::FileSource fileSource(file, true, new CryptoPP::Deflator(new CryptoPP::FileSink(data)));
+                member.length = static_cast<uint64_t>(data.tellp()) - member.offset;
+                member.flags = FLAG_DEFLATED;
+            }
+        }
+
+        if (member.flags != FLAG_DEFLATED || member.length >= fileLength)
+        {
+            file.clear();
+            file.seekg(0);
+            data.seekp(member.offset);
+            CryptoPP::FileSink sink(data);
+            if (!copyBytes(file, sink, fileLength))
+            {
+                data.close();
+                std::filesystem::remove(dataPath, error);
+                return StegoStatus::FILE_NOT_FOUND;
+            }
+
+            member.length = fileLength;
+            member.flags = 0;
+        }
+
+        dataLength = member.offset + member.length;
+        members.push_back(member);
+    }
+
+    std::string index;
+    for (const StegoArchiveMember& member : members)
+    {
+        putLittleEndian(index, member.name.size(), 2);
+        index += member.name;
+        putLittleEndian(index, member.offset, 8);
+        putLittleEndian(index, member.length, 8);
+        putLittleEndian(index, member.flags, 1);
+    }
+
+    std::string prefix;
+    putLittleEndian(prefix, MAGIC, 4);
+    putLittleEndian(prefix, members.size(), 4);
+    putLittleEndian(prefix, PREFIX_BYTES + index.size(), 8);
+
+    // A member stored after a longer failed deflate leaves bytes past dataLength, only dataLength bytes are copied
+    std::ofstream archive(archivePath, std::ios_base::binary | std::ios_base::trunc);
+    archive << prefix << index;
+    data.flush();
+    data.seekg(0);
+    CryptoPP::FileSink archiveSink(archive);
+    bool bCopied = copyBytes(data, archiveSink, dataLength);
+    archive.flush();
+    data.close();
+
+    std::error_code error;
+    std::filesystem::remove(dataPath, error);
+
+    return bCopied && archive ? StegoStatus::SUCCESS : StegoStatus::FILE_OPEN_FAILED;
+}
+
+/**
+ * @brief StegoArchive::Unpack Extract the members of the archive at archivePath under outputDirectory.
+ * @param memberName Only extract the member of that name, every member if empty
+ * @param maxInflatedBytes Largest size a deflated member may inflate to, see inflateLimit
+ * @return StegoStatus::INVALID_HEADER if it is no valid archive, StegoStatus::ARCHIVE_MEMBER_NOT_FOUND if there is
+ * no member memberName, StegoStatus::SUCCESS otherwise
+ */
+StegoStatus StegoArchive::Unpack(const std::filesystem::path& archivePath, const std::filesystem::path& outputDirectory,
+                                 const std::string& memberName, uint64_t maxInflatedBytes)
+{
+    std::ifstream archiveFile(archivePath, std::ios_base::binary);
+    std::error_code error;
+    uint64_t payloadLength = std::filesystem::file_size(archivePath, error);
+    if (!archiveFile.is_open() || error)
+    {
+        return StegoStatus::FILE_OPEN_FAILED;
+    }
+
+    std::vector<uint8_t> index(PREFIX_BYTES);
+    archiveFile.read(reinterpret_cast<char*>(index.data()), index.size());
+    uint64_t indexSize = 0;
+    if (!archiveFile || ReadIndexSize(index, payloadLength, indexSize) != StegoStatus::SUCCESS)
+    {
+        return StegoStatus::INVALID_HEADER;
+    }
+
+    index.resize(indexSize);
+    archiveFile.read(reinterpret_cast<char*>(index.data()) + PREFIX_BYTES, indexSize - PREFIX_BYTES);
+    StegoArchive archive;
+    if (!archiveFile || archive.ReadIndex(index, payloadLength) != StegoStatus::SUCCESS)
+    {
+        return StegoStatus::INVALID_HEADER;
+    }
+
+    std::filesystem::create_directories(outputDirectory, error);
+    bool bFound = memberName.empty();
+    for (const StegoArchiveMember& member : archive.members)
+    {
+        if (!memberName.empty() && member.name != memberName)
+        {
+            continue;
+        }
+
+        bFound = true;
+        archiveFile.seekg(archive.indexSize + member.offset);
+        StegoStatus status = ExtractMember(archiveFile, member, outputDirectory / member.name, maxInflatedBytes);
+        if (status != StegoStatus::SUCCESS)
+        {
+            return status;
+        }
+    }
+
+    return bFound ? StegoStatus::SUCCESS : StegoStatus::ARCHIVE_MEMBER_NOT_FOUND;
+}
+
+/**
+ * @brief StegoArchive::ExtractMember Write member to outputPath, inflating it if it is deflated, to at most
+ * inflateLimit(member.length, maxInflatedBytes) bytes. data must be at the first byte of the member.
+ * @return StegoStatus::DECOMPRESSION_FAILED if a deflated member is damaged or inflates past the limit,
+ * StegoStatus::SUCCESS otherwise
+ */
+StegoStatus StegoArchive::ExtractMember(std::istream& data, const StegoArchiveMember& member,
+                                        const std::filesystem::path& outputPath, uint64_t maxInflatedBytes)
+{
+    std::error_code error;
+    std::filesystem::create_directories(outputPath.parent_path(), error);
+    std::ofstream file(outputPath, std::ios_base::binary | std::ios_base::trunc);
+    if (!file.is_open())
+    {
+        return StegoStatus::FILE_OPEN_FAILED;
+    }
+
+    std::unique_ptr<CryptoPP::BufferedTransformation> sink(new CryptoPP::FileSink(file));
+    if (member.flags & FLAG_DEFLATED)
+    {
+        sink.reset(new CryptoPP::Inflator(new InflateLimitFilter(inflateLimit(member.length, maxInflatedBytes),
+                                                                 sink.release())));
+    }
+
+    try {
+        if (!copyBytes(data, *sink, member.length))
+        {
+            file.close();
+            std::filesystem::remove(outputPath, error);
+            return StegoStatus::INVALID_MEDIA;
+        }
+
+        sink->MessageEnd();
+    }
+    catch (const CryptoPP::Exception& e) {
+        qDebug() << "Crypto++ exception: " << e.what();
+        file.close();
+        std::filesystem::remove(outputPath, error);
+
+        return StegoStatus::DECOMPRESSION_FAILED;
+    }
+
+    return StegoStatus::SUCCESS;
+}
+
+/**
+ * @brief StegoArchive::IsSafeName Whether name is a relative path that stays inside the directory it is unpacked to.
+ */
+bool StegoArchive::IsSafeName(const std::string& name)
+{
+    std::filesystem::path path(name);
+    if (name.empty() || name.find('\\') != std::string::npos || path.has_root_path())
+    {
+        return false;
+    }
+
+    for (const std::filesystem::path& component : path)
+    {
+        if (component == ".." || component == "." || component.empty())
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,91 @@
+#ifndef STEGOARCHIVE_H
+#define STEGOARCHIVE_H
+
+#include "StegoStatus.h"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <istream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <cryptopp/filters.h>
+
+// Temp file names unique across instances, threads and processes, for the working directory and the edge cache
+std::string uniqueTempName(const std::string& prefix);
+
+// Little endian fields of the archive index, the shard prefix and the edge cache files
+void putLittleEndian(std::string& bytes, uint64_t value, size_t numBytes);
+uint64_t readLittleEndian(const std::vector<uint8_t>& bytes, size_t position, size_t numBytes);
+
+// Bytes a payload deflated to compressedBytes may inflate to, maxInflatedBytes unless it is 0, see
+// Stego::SetInflateLimit
+uint64_t inflateLimit(uint64_t compressedBytes, uint64_t maxInflatedBytes);
+
+/**
+ * Passes inflated bytes on to the sink attached and throws once more than maxBytes went through, so a small deflate
+ * bomb in a crafted carrier can not fill memory or the disk. The exception is an Inflator::Err, callers report it as
+ * StegoStatus::DECOMPRESSION_FAILED like any damaged deflate data.
+ */
+class InflateLimitFilter : public CryptoPP::Bufferless<CryptoPP::Filter>
+{
+public:
+    InflateLimitFilter(uint64_t maxBytes, CryptoPP::BufferedTransformation* attachment);
+
+    size_t Put2(const CryptoPP::byte* inString, size_t length, int messageEnd, bool blocking) override;
+
+private:
+    uint64_t maxBytes;
+    uint64_t inflatedBytes = 0;
+};
+
+/**
+ * A file of an archive. offset counts from the end of the index, length is the number of bytes stored, which are
+ * deflated if FLAG_DEFLATED is set.
+ */
+struct StegoArchiveMember
+{
+    std::string name;
+    uint64_t offset = 0;
+    uint64_t length = 0;
+    uint8_t flags = 0;
+};
+
+/**
+ * Payload holding every file under a directory, embedded when the file to embed is a directory and marked by the
+ * archive flag of the stego header. A compact index at the start of the payload lists the members, so a decoder
+ * can read the index, then skip straight to the bytes of a single member, see Stego::ExtractMember.
+ *
+ * The index starts with a prefix of PREFIX_BYTES: the magic tag, the number of members and the size of the prefix
+ * and index together, little endian in 4, 4 and 8 bytes. Every member then takes a 2-byte name length, the name as
+ * a relative path with '/' separators, its 8-byte offset, its 8-byte length and a byte of flags. The data of the
+ * members follows in index order. Members are compressed one by one, the archive itself never is, so their
+ * offsets stay valid.
+ */
+class StegoArchive
+{
+public:
+    static constexpr uint32_t MAGIC = 0x43524153;
+    static constexpr size_t PREFIX_BYTES = 16;
+    static constexpr size_t MEMBER_FIXED_BYTES = 2 + 8 + 8 + 1;
+    static constexpr uint8_t FLAG_DEFLATED = 1;
+
+    std::vector<StegoArchiveMember> members;
+    // Bytes of the prefix and index, the data of the members starts there
+    uint64_t indexSize = 0;
+
+    StegoStatus ReadIndex(const std::vector<uint8_t>& index, uint64_t payloadLength);
+    const StegoArchiveMember* Find(const std::string& name) const;
+
+    static StegoStatus ReadIndexSize(const std::vector<uint8_t>& prefix, uint64_t payloadLength, uint64_t& indexSize);
+    static std::vector<std::pair<std::filesystem::path, std::string>> ListFiles(const std::filesystem::path& directory);
+    static StegoStatus Pack(const std::filesystem::path& directory, const std::filesystem::path& archivePath,
+                            bool bCompress);
+    static StegoStatus Unpack(const std::filesystem::path& archivePath, const std::filesystem::path& outputDirectory,
+                              const std::string& memberName = "", uint64_t maxInflatedBytes = 0);
+    static StegoStatus ExtractMember(std::istream& data, const StegoArchiveMember& member,
+                                     const std::filesystem::path& outputPath, uint64_t maxInflatedBytes = 0);
+    static bool IsSafeName(const std::string& name);
+};
+
+#endif // STEGOARCHIVE_H
@@ -0,0 +1,387 @@
+#include "stegocapacity.h"
+#include "stegoconstants.h"
+#include "edgedetection.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <fstream>
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+
+/**
+ * @brief pvdChannelBits Number of bits PVD embeds in one channel of a pixel pair, 0 if the difference is
+ * above the range the channel is allowed to use.
+ */
+inline size_t pvdChannelBits(uchar firstValue, uchar secondValue, size_t maxBits)
+{
+    size_t numBits = pvdRangeTable[std::abs(firstValue - secondValue)];
+    return numBits > maxBits ? 0 : numBits;
+}
+
+/**
+ * @brief StegoCapacity::StegoCapacity
+ * @param lsbBits Least significant bits of each sample LSB embeds in, see Stego::SetLsbBits
+ */
+StegoCapacity::StegoCapacity(StegoAlgo algo, EdgeDetectionType edgeDetectionType, size_t lsbBits)
+    : algo(algo)
+    , edgeDetectionType(edgeDetectionType)
+    , lsbBits(lsbBits)
+{
+}
+
+/**
+ * @brief StegoCapacity::SetEdgeCache Take the edge masks of frames from edgeCache, see EdgeCache. nullptr detects
+ * every frame.
+ */
+void StegoCapacity::SetEdgeCache(EdgeCache* edgeCache)
+{
+    this->edgeCache = edgeCache;
+}
+
+/**
+ * @brief StegoCapacity::LsbSequentialCapacity Exact LSB capacity, only depends on the image dimensions.
+ */
+uint64_t StegoCapacity::LsbSequentialCapacity(uint64_t numPixels, size_t startPixel, size_t lsbBits)
+{
+    if (numPixels <= startPixel)
+    {
+        return 0;
+    }
+
+    return ((numPixels - startPixel) * LSB_BITS_PER_PIXEL * lsbBits) / BITS_PER_BYTE;
+}
+
+/**
+ * @brief StegoCapacity::LsbEdgeCapacity LSB capacity when only edge pixels are used.
+ * @param magnitudes Edge mask from EdgeDetection::GetMagnitudes, non zero for edge pixels
+ */
+uint64_t StegoCapacity::LsbEdgeCapacity(const cv::Mat& magnitudes, size_t startPixel, size_t lsbBits)
+{
+    return (LsbEdgePixels(magnitudes, startPixel) * LSB_BITS_PER_PIXEL * lsbBits) / BITS_PER_BYTE;
+}
+
+/**
+ * @brief StegoCapacity::LsbEdgePixels Number of edge pixels from startPixel on, each carries LSB_BITS_PER_PIXEL bits.
+ */
+uint64_t StegoCapacity::LsbEdgePixels(const cv::Mat& magnitudes, size_t startPixel)
+{
+    uint64_t numPixels = 0;
+    size_t pixel = 0;
+    for (int row = 0; row < magnitudes.rows; row++)
+    {
+        const uchar* magnitudeRow = magnitudes.ptr<uchar>(row);
+        for (int col = 0; col < magnitudes.cols; col++, pixel++)
+        {
+            if (pixel >= startPixel && magnitudeRow[col] != 0)
+            {
+                numPixels++;
+            }
+        }
+    }
+
+    return numPixels;
+}
+
+/**
+ * @brief StegoCapacity::PvdSequentialCapacity Exact PVD capacity from a single pass over the pixel pairs,
+ * without splitting the image or allocating embedding maps.
+ * @param image 8-bit BGR image
+ */
+uint64_t StegoCapacity::PvdSequentialCapacity(const cv::Mat& image, size_t startPixel)
+{
+    // The encoder pairs pixels over the whole image as one row
+    Mat continuousImage = image.isContinuous() ? image : image.clone();
+    const uchar* pixels = continuousImage.ptr<uchar>(0);
+    size_t numPixels = continuousImage.total();
+
+    uint64_t numBits = 0;
+    for (size_t pixel = startPixel; pixel + 1 < numPixels; pixel += 2)
+    {
+        const uchar* first = pixels + pixel * 3;
+        const uchar* second = first + 3;
+
+        numBits += pvdChannelBits(first[0], second[0], MAX_PVD_BLUE_EMBEDDING);
+        numBits += pvdChannelBits(first[1], second[1], MAX_PVD_GREEN_EMBEDDING);
+        numBits += pvdChannelBits(first[2], second[2], MAX_PVD_RED_EMBEDDING);
+    }
+
+    return numBits / BITS_PER_BYTE;
+}
+
+/**
+ * @brief StegoCapacity::PvdEdgeCapacity PVD capacity when only pairs of edge pixels are used.
+ * Green carries the edge flag, so only blue and red hold data. Pairs in the last row and column are not used.
+ * @param image 8-bit BGR image
+ * @param magnitudes Edge mask from EdgeDetection::GetMagnitudes, non zero for edge pixels
+ */
+uint64_t StegoCapacity::PvdEdgeCapacity(const cv::Mat& image, const cv::Mat& magnitudes, size_t startPixel)
+{
+    Mat continuousImage = image.isContinuous() ? image : image.clone();
+    const uchar* pixels = continuousImage.ptr<uchar>(0);
+    size_t numPixels = continuousImage.total();
+    size_t numCols = magnitudes.cols;
+
+    uint64_t numBits = 0;
+    size_t col = startPixel;
+    for (int row = 0; row < magnitudes.rows - 1; row++)
+    {
+        const uchar* magnitudeRow = magnitudes.ptr<uchar>(row);
+        for (; col + 1 < numCols; col += 2)
+        {
+            if (magnitudeRow[col] == 0 || magnitudeRow[col + 1] == 0)
+            {
+                continue;
+            }
+
+            // Pairs are formed over the flattened image, so odd pixels only start a pair in odd width images
+            size_t pixel = row * numCols + col;
+            if (pixel < startPixel || (pixel - startPixel) % 2 != 0 || pixel + 1 >= numPixels)
+            {
+                continue;
+            }
+
+            const uchar* first = pixels + pixel * 3;
+            const uchar* second = first + 3;
+
+            numBits += pvdChannelBits(first[0], second[0], MAX_PVD_BLUE_EMBEDDING);
+            numBits += pvdChannelBits(first[2], second[2], MAX_PVD_RED_EMBEDDING);
+        }
+
+        col = 0;
+    }
+
+    return numBits / BITS_PER_BYTE;
+}
+
+/**
+ * @brief StegoCapacity::MaxCapacity Upper bound of the capacity of any image with numPixels pixels, for every
+ * edge detection type. Only depends on the dimensions, so it is known before the pixels are looked at.
+ */
+uint64_t StegoCapacity::MaxCapacity(StegoAlgo algo, uint64_t numPixels, size_t startPixel, size_t lsbBits)
+{
+    if (algo == StegoAlgo::LSB)
+    {
+        return LsbSequentialCapacity(numPixels, startPixel, lsbBits);
+    }
+
+    if (numPixels <= startPixel)
+    {
+        return 0;
+    }
+
+    uint64_t numPairs = (numPixels - startPixel) / 2;
+    return numPairs * (MAX_PVD_BLUE_EMBEDDING + MAX_PVD_GREEN_EMBEDDING + MAX_PVD_RED_EMBEDDING) / BITS_PER_BYTE;
+}
+
+/**
+ * @brief StegoCapacity::MaxLsbBits Most least significant bits of a sample a mode embeds in. Edge detection ignores
+ * only the two lowest bits, and PVD has no bit count, it always takes 1.
+ */
+size_t StegoCapacity::MaxLsbBits(StegoAlgo algo, EdgeDetectionType edgeDetectionType)
+{
+    if (algo == StegoAlgo::PVD)
+    {
+        return 1;
+    }
+
+    return edgeDetectionType != EdgeDetectionType::None ? MAX_EDGE_LSB_BITS : MAX_LSB_BITS;
+}
+
+/**
+ * @brief StegoCapacity::MaxFrameCount Upper bound of the number of frames of a video from CAP_PROP_FRAME_COUNT.
+ * Some containers only estimate the frame count from the duration, so a margin is added.
+ * @return 0 if the video does not report a frame count
+ */
+uint64_t StegoCapacity::MaxFrameCount(double reportedFrameCount)
+{
+    return reportedFrameCount >= 1 ? static_cast<uint64_t>(reportedFrameCount * 1.1) + 1 : 0;
+}
+
+/**
+ * @brief StegoCapacity::ReadPngPixelCount Read the width and height from the IHDR chunk without decoding the image.
+ * @return Number of pixels in the image, 0 if the file is not a png
+ */
+uint64_t StegoCapacity::ReadPngPixelCount(const std::string& path)
+{
+    std::ifstream file(path, std::ios_base::binary);
+    unsigned char header[24];
+    if (!file.read(reinterpret_cast<char*>(header), sizeof(header)))
+    {
+        return 0;
+    }
+
+    const unsigned char pngSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    if (!std::equal(pngSignature, pngSignature + 8, header))
+    {
+        return 0;
+    }
+
+    uint64_t width = 0;
+    uint64_t height = 0;
+    for (size_t i = 0; i < 4; i++)
+    {
+        width = (width << 8) | header[16 + i];
+        height = (height << 8) | header[20 + i];
+    }
+
+    return width * height;
+}
+
+/**
+ * @brief StegoCapacity::FrameCapacity Capacity of a single image or video frame, runs edge detection if enabled.
+ * @param startPixel First pixel available for data, NUM_HEADER_PIXELS for the first frame and 0 for the rest
+ */
+uint64_t StegoCapacity::FrameCapacity(const cv::Mat& frame, size_t startPixel) const
+{
+    if (this->edgeDetectionType == EdgeDetectionType::None)
+    {
+        if (this->algo == StegoAlgo::LSB)
+        {
+            return LsbSequentialCapacity(frame.total(), startPixel, this->lsbBits);
+        }
+
+        return PvdSequentialCapacity(frame, startPixel);
+    }
+
+    EdgeDetection edgeDetector(nullptr, this->edgeCache);
+    edgeDetector.DetectEdges(frame, this->edgeDetectionType);
+    Mat magnitudes = edgeDetector.GetMagnitudes();
+
+    if (this->algo == StegoAlgo::LSB)
+    {
+        return LsbEdgeCapacity(magnitudes, startPixel, this->lsbBits);
+    }
+
+    return PvdEdgeCapacity(frame, magnitudes, startPixel);
+}
+
+/**
+ * @brief StegoCapacity::ImageCapacity Capacity of an image file. LSB without edge detection only reads the
+ * png header, every other mode decodes the image once.
+ * @return StegoStatus::IMAGE_NOT_FOUND if the image could not be read, StegoStatus::SUCCESS otherwise
+ */
+StegoStatus StegoCapacity::ImageCapacity(const std::string& mediaPath, uint64_t& capacity) const
+{
+    if (this->algo == StegoAlgo::LSB && this->edgeDetectionType == EdgeDetectionType::None)
+    {
+        uint64_t numPixels = ReadPngPixelCount(mediaPath);
+        if (numPixels != 0)
+        {
+            capacity = LsbSequentialCapacity(numPixels, NUM_HEADER_PIXELS, this->lsbBits);
+            return StegoStatus::SUCCESS;
+        }
+    }
+
+    Mat image = imread(mediaPath, IMREAD_COLOR);
+    if (image.empty())
+    {
+        return StegoStatus::IMAGE_NOT_FOUND;
+    }
+
+    capacity = FrameCapacity(image, NUM_HEADER_PIXELS);
+
+    return StegoStatus::SUCCESS;
+}
+
+/**
+ * @brief StegoCapacity::VideoCapacity Per frame capacity of a video. LSB without edge detection is computed
+ * from the stream dimensions, every other mode decodes the probed frames and measures them in parallel.
+ * @param sampleStride Probe every sampleStride-th frame, 1 measures every frame and gives the exact capacity
+ * @param numWorkers Number of threads measuring frames, 0 uses one per core
+ * @return StegoStatus::VIDEO_OPEN_FAILED if the video could not be opened, StegoStatus::SUCCESS otherwise
+ */
+StegoStatus StegoCapacity::VideoCapacity(const std::string& mediaPath, CapacityTable& table, size_t sampleStride,
+                                         size_t numWorkers) const
+{
+    VideoCapture video(mediaPath);
+    if (!video.isOpened())
+    {
+        return StegoStatus::VIDEO_OPEN_FAILED;
+    }
+
+    table = CapacityTable();
+    sampleStride = std::max<size_t>(sampleStride, 1);
+
+    if (this->algo == StegoAlgo::LSB && this->edgeDetectionType == EdgeDetectionType::None)
+    {
+        uint64_t numPixels = static_cast<uint64_t>(video.get(CAP_PROP_FRAME_WIDTH)) *
+                             static_cast<uint64_t>(video.get(CAP_PROP_FRAME_HEIGHT));
+        double numFrames = video.get(CAP_PROP_FRAME_COUNT);
+        if (numPixels != 0 && numFrames >= 1)
+        {
+            table.numFrames = static_cast<size_t>(numFrames);
+            for (size_t frameIndex = 0; frameIndex < table.numFrames; frameIndex++)
+            {
+                size_t startPixel = frameIndex == 0 ? NUM_HEADER_PIXELS : 0;
+                table.frameIndices.push_back(frameIndex);
+                table.frameCapacities.push_back(LsbSequentialCapacity(numPixels, startPixel, this->lsbBits));
+                table.totalCapacity += table.frameCapacities.back();
+            }
+
+            return StegoStatus::SUCCESS;
+        }
+    }
+
+    WorkStealingThreadPool threadPool(numWorkers);
+
+    // Frames are decoded in order on this thread and measured in batches, so only a batch is held in memory
+    const size_t batchSize = threadPool.NumThreads() * 2;
+    std::vector<Mat> batch;
+    std::vector<size_t> batchIndices;
+    size_t frameIndex = 0;
+    bool bEndOfVideo = false;
+    while (!bEndOfVideo)
+    {
+        batch.clear();
+        batchIndices.clear();
+        while (batch.size() < batchSize)
+        {
+            if (frameIndex % sampleStride != 0)
+            {
+                if (!video.grab())
+                {
+                    bEndOfVideo = true;
+                    break;
+                }
+
+                frameIndex++;
+                continue;
+            }
+
+            Mat frame;
+            if (!video.read(frame) || frame.empty())
+            {
+                bEndOfVideo = true;
+                break;
+            }
+
+            batch.push_back(frame);
+            batchIndices.push_back(frameIndex);
+            frameIndex++;
+        }
+
+        std::vector<uint64_t> batchCapacities(batch.size(), 0);
+        for (size_t i = 0; i < batch.size(); i++)
+        {
+            threadPool.Submit([this, &batch, &batchIndices, &batchCapacities, i]() {
+                size_t startPixel = batchIndices[i] == 0 ? NUM_HEADER_PIXELS : 0;
+                batchCapacities[i] = FrameCapacity(batch[i], startPixel);
+            }, i % threadPool.NumThreads());
+        }
+
+        threadPool.Wait();
+
+        table.frameIndices.insert(table.frameIndices.end(), batchIndices.begin(), batchIndices.end());
+        table.frameCapacities.insert(table.frameCapacities.end(), batchCapacities.begin(), batchCapacities.end());
+    }
+
+    table.numFrames = frameIndex;
+    table.bSampled = sampleStride > 1;
+    for (size_t i = 0; i < table.frameIndices.size(); i++)
+    {
+        size_t nextIndex = i + 1 < table.frameIndices.size() ? table.frameIndices[i + 1] : table.numFrames;
+        table.totalCapacity += table.frameCapacities[i] * (nextIndex - table.frameIndices[i]);
+    }
+
+    return StegoStatus::SUCCESS;
+}
@@ -0,0 +1,58 @@
+#ifndef STEGOCAPACITY_H
+#define STEGOCAPACITY_H
+
+#include "StegoAlgo.h"
+#include "EdgeDetectionType.h"
+#include "StegoStatus.h"
+#include "edgecache.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <opencv2/core/mat.hpp>
+
+/**
+ * Capacity of every probed frame of a video. When frames are sampled, every probed frame stands in for the
+ * frames up to the next probed frame.
+ */
+struct CapacityTable
+{
+    std::vector<size_t> frameIndices;
+    std::vector<uint64_t> frameCapacities;
+    size_t numFrames = 0;
+    uint64_t totalCapacity = 0;
+    bool bSampled = false;
+};
+
+/**
+ * Answers "will it fit?" without a payload file and without building the embedding maps the encoder uses.
+ * All capacities are in bytes and count only the pixels after the stego header.
+ */
+class StegoCapacity
+{
+public:
+    StegoCapacity(StegoAlgo algo, EdgeDetectionType edgeDetectionType, size_t lsbBits = 1);
+    void SetEdgeCache(EdgeCache* edgeCache);
+
+    StegoStatus ImageCapacity(const std::string& mediaPath, uint64_t& capacity) const;
+    StegoStatus VideoCapacity(const std::string& mediaPath, CapacityTable& table, size_t sampleStride = 1,
+                              size_t numWorkers = 0) const;
+    uint64_t FrameCapacity(const cv::Mat& frame, size_t startPixel) const;
+
+    static uint64_t LsbSequentialCapacity(uint64_t numPixels, size_t startPixel, size_t lsbBits = 1);
+    static uint64_t LsbEdgeCapacity(const cv::Mat& magnitudes, size_t startPixel, size_t lsbBits = 1);
+    static uint64_t LsbEdgePixels(const cv::Mat& magnitudes, size_t startPixel);
+    static uint64_t PvdSequentialCapacity(const cv::Mat& image, size_t startPixel);
+    static uint64_t PvdEdgeCapacity(const cv::Mat& image, const cv::Mat& magnitudes, size_t startPixel);
+    static uint64_t MaxCapacity(StegoAlgo algo, uint64_t numPixels, size_t startPixel, size_t lsbBits = 1);
+    static uint64_t MaxFrameCount(double reportedFrameCount);
+    static size_t MaxLsbBits(StegoAlgo algo, EdgeDetectionType edgeDetectionType);
+    static uint64_t ReadPngPixelCount(const std::string& path);
+
+private:
+    StegoAlgo algo;
+    EdgeDetectionType edgeDetectionType;
+    size_t lsbBits;
+    EdgeCache* edgeCache = nullptr;
+};
+
+#endif // STEGOCAPACITY_H
@@ -0,0 +1,638 @@
+#include "jobscheduler.h"
+#include "stegoconstants.h"
+#include "stegoplanner.h"
+#include "stegoscanner.h"
+#include <nlohmann/json.hpp>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+using namespace nlohmann;
+
+const size_t BYTES_PER_MIB = 1024 * 1024;
+
+std::string stegoStatusName(StegoStatus status)
+{
+    switch (status)
+    {
+    case StegoStatus::SUCCESS: return "SUCCESS";
+    case StegoStatus::IMAGE_NOT_FOUND: return "IMAGE_NOT_FOUND";
+    case StegoStatus::FILE_NOT_FOUND: return "FILE_NOT_FOUND";
+    case StegoStatus::FILE_TOO_LARGE: return "FILE_TOO_LARGE";
+    case StegoStatus::OUT_OF_ROOM: return "OUT_OF_ROOM";
+    case StegoStatus::INVALID_HEADER: return "INVALID_HEADER";
+    case StegoStatus::DATA_NOT_ENCRYPTED: return "DATA_NOT_ENCRYPTED";
+    case StegoStatus::FILE_OPEN_FAILED: return "FILE_OPEN_FAILED";
+    case StegoStatus::VIDEO_OPEN_FAILED: return "VIDEO_OPEN_FAILED";
+    case StegoStatus::DECRYPTION_FAILED: return "DECRYPTION_FAILED";
+    case StegoStatus::INVALID_MEDIA: return "INVALID_MEDIA";
+    case StegoStatus::VIDEO_REENCODING_FAILED: return "VIDEO_REENCODING_FAILED";
+    case StegoStatus::DECOMPRESSION_FAILED: return "DECOMPRESSION_FAILED";
+    case StegoStatus::ARCHIVE_MEMBER_NOT_FOUND: return "ARCHIVE_MEMBER_NOT_FOUND";
+    case StegoStatus::INVALID_RANGE: return "INVALID_RANGE";
+    case StegoStatus::SHARD_SET_INCOMPLETE: return "SHARD_SET_INCOMPLETE";
+    case StegoStatus::UNEXPECTED_ERROR: return "UNEXPECTED_ERROR";
+    case StegoStatus::PAYLOAD_IS_ARCHIVE: return "PAYLOAD_IS_ARCHIVE";
+    }
+
+    return "UNKNOWN";
+}
+
+void printUsage()
+{
+    std::cerr << "Usage:\n"
+              << "  stego-cli encode --file <path> --media <path> [--algo LSB|PVD|Auto] [--edge None|Sobel|Canny|Texture|Auto]\n"
+              << "                    [--password <password>] [--require-edges yes|no] [--max-fill <fraction>] [--cost-model <path>]\n"
+              << "                    [--compress yes|no] [--strip-budget <MiB>] [--codec FFV1|x264rgb|UTVideo|Raw]\n"
+              << "                    [--codec-threads <n>] [--codec-slices <n>] [--frame-source VideoCapture|RawPipe]\n"
+              << "                    [--checkpoint <frames>] [--edge-cache <directory> [--edge-cache-budget <MiB>]]\n"
+              << "                    [--lsb-bits <1-4>]\n"
+              << "  stego-cli encode --file <path> --shard <path> [--shard <path> ...] [options of encode]\n"
+              << "  stego-cli decode --media <path> [--password <password>] [--frame-source VideoCapture|RawPipe]\n"
+              << "                    [--member <name>] [--offset <bytes> --length <bytes>] [--edge-cache <directory>]\n"
+              << "  stego-cli decode --shard <path> [--shard <path> ...] [--password <password>]\n"
+              << "  stego-cli update --file <path> --media <stego media> [--password <password>] [--compress yes|no]\n"
+              << "                    [--codec FFV1|x264rgb|UTVideo|Raw] [--frame-source VideoCapture|RawPipe]\n"
+              << "                    [--edge-cache <directory>]\n"
+              << "  stego-cli capacity --media <path> [--algo LSB|PVD] [--edge None|Sobel|Canny|Texture]\n"
+              << "                    [--lsb-bits <1-4>] [--edge-cache <directory>]\n"
+              << "  stego-cli batch --manifest <jobs.json> [--workers <n>] [--output <directory>]\n"
+              << "  stego-cli scan --media <file or directory> [--workers <n>]\n"
+              << "\n"
+              << "Options for every command:\n"
+              << "  --summary <path>   Write the JSON summary to a file instead of stdout\n"
+              << "\n"
+              << "The batch manifest is a JSON array of jobs, e.g.\n"
+              << "  [{\"operation\": \"encode\", \"file\": \"a.pdf\", \"media\": \"a.png\", \"algo\": \"PVD\", \"edgeDetection\": \"Sobel\"}]\n"
+              << "Every batch job writes its files to its own job_<index> directory under --output.\n"
+              << "--compress yes (\"compress\": true in a manifest) deflates the payload before embedding, payloads that\n"
+              << "do not get smaller are embedded as they are.\n"
+              << "--strip-budget (\"stripBudgetMiB\" in a manifest) encodes png images a strip of rows at a time in\n"
+              << "about that much memory, for images too large to load. Canny edge detection loads the whole image.\n"
+              << "--codec (\"videoCodec\" in a manifest) picks the lossless codec of stego videos, FFV1 by default.\n"
+              << "--codec-threads (\"videoThreads\") sets its encoder threads, 0 for one per core, and --codec-slices\n"
+              << "(\"videoSlices\") the slices per FFV1 frame, rounded down to 4, 6, 9, 12, 16, 24 or 30.\n"
+              << "--frame-source RawPipe (\"frameSource\" in a manifest) reads video frames from a single ffmpeg process\n"
+              << "and decodes ahead of the embedding, for large lossless videos. The frames are the same either way.\n"
+              << "--checkpoint (\"checkpointFrames\" in a manifest) saves the progress of a video encode every that many\n"
+              << "frames, running the same encode again after it was interrupted resumes from the last checkpoint.\n"
+              << "A directory given as --file is embedded as an archive of every file under it, decoding unpacks it to\n"
+              << "a directory of the same name. --member <name> (\"member\" in a manifest) extracts only that file of the\n"
+              << "archive, named by its path under the directory with '/' separators.\n"
+              << "--offset and --length (\"offset\" and \"length\" in a manifest) extract only that many bytes of the\n"
+              << "payload from the offset on, skipping the frames before them where the embedding allows. Compressed\n"
+              << "and encrypted payloads can only be decoded whole.\n"
+              << "--shard <path> (\"shards\" in a manifest, an array of paths) replaces --media with several images\n"
+              << "or videos, the file is split across them by their capacity and the shards are encoded in parallel.\n"
+              << "Decoding takes the same media in any order and needs every one of them.\n"
+              << "--edge Texture embeds only in 4x4 blocks whose pixels differ enough from their neighbours, much\n"
+              << "faster than Sobel or Canny, and like Sobel it streams with --strip-budget.\n"
+              << "--lsb-bits (\"lsbBits\" in a manifest) embeds LSB payloads in that many of the lowest bits of every\n"
+              << "sample, 1 by default, so a payload changes fewer pixels and frames but each by more. With edge\n"
+              << "detection at most 2 bits are used, PVD ignores it. Decoding reads it from the media.\n"
+              << "update embeds the file in a medium encoded with LSB in place of the payload it carries, with the\n"
+              << "algorithm, edge detection and LSB bits of the medium. Only the bytes that differ from the payload are\n"
+              << "embedded again, and only the video frames holding them are embedded in.\n"
+              << "--edge-cache (\"edgeCache\" in a manifest) stores the edge masks of every carrier\n"
+              << "and frame in the directory, so encoding in or decoding the same carriers again skips edge detection.\n"
+              << "The least recently used masks are removed beyond --edge-cache-budget (\"edgeCacheMiB\"), 256 MiB by\n"
+              << "default.\n"
+              << "--algo Auto and --edge Auto (\"Auto\" in a manifest) encode with the fastest mode whose capacity holds\n"
+              << "the file, from the carrier size and a per pixel cost of every mode. --require-edges yes (\"requireEdges\")\n"
+              << "only picks Sobel, Canny or Texture and --max-fill (\"maxFill\") the modes the file fills at most that fraction of.\n"
+              << "--cost-model (\"costModel\") keeps the costs measured on this machine in a file, the first encode\n"
+              << "calibrates them when it is missing. The summary reports the mode every job ran with.\n"
+              << "scan reads only the header of every png and mkv file under the directory and reports the settings\n"
+              << "of the files carrying a payload, nothing is extracted.\n";
+}
+
+/**
+ * @brief parseNumber Parse the value of a numeric option. The whole value has to be a number between minValue and
+ * maxValue, negative numbers are rejected for unsigned options instead of wrapping around.
+ * @return False when the value is not a number or out of range, result is left unchanged
+ */
+template <typename T>
+bool parseNumber(const std::string& value, T minValue, T maxValue, T& result)
+{
+    T number;
+    size_t end = 0;
+    try
+    {
+        if constexpr (std::is_floating_point_v<T>)
+        {
+            number = static_cast<T>(std::stod(value, &end));
+        }
+        else if constexpr (std::is_signed_v<T>)
+        {
+            long long parsed = std::stoll(value, &end);
+            if (parsed < static_cast<long long>(std::numeric_limits<T>::min()) ||
+                parsed > static_cast<long long>(std::numeric_limits<T>::max()))
+            {
+                return false;
+            }
+
+            number = static_cast<T>(parsed);
+        }
+        else
+        {
+            if (value.find('-') != std::string::npos)
+            {
+                return false;
+            }
+
+            unsigned long long parsed = std::stoull(value, &end);
+            if (parsed > std::numeric_limits<T>::max())
+            {
+                return false;
+            }
+
+            number = static_cast<T>(parsed);
+        }
+    }
+    catch (const std::exception&)
+    {
+        return false;
+    }
+
+    // Written so that NaN is out of range as well
+    if (end != value.size() || !(number >= minValue && number <= maxValue))
+    {
+        return false;
+    }
+
+    result = number;
+
+    return true;
+}
+
+bool parseJobType(const std::string& operation, StegoJobType& type)
+{
+    if (operation == "encode")
+    {
+        type = StegoJobType::Encode;
+    }
+    else if (operation == "decode")
+    {
+        type = StegoJobType::Decode;
+    }
+    else if (operation == "capacity")
+    {
+        type = StegoJobType::Capacity;
+    }
+    else if (operation == "update")
+    {
+        type = StegoJobType::Update;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+std::string jobTypeName(StegoJobType type)
+{
+    switch (type)
+    {
+    case StegoJobType::Encode: return "encode";
+    case StegoJobType::Decode: return "decode";
+    case StegoJobType::Capacity: return "capacity";
+    case StegoJobType::Update: return "update";
+    }
+
+    return "unknown";
+}
+
+/**
+ * @brief isValidMode Whether a job names a known algorithm and edge detection, "Auto" only being known to encodes,
+ * and a number of LSB bits up to MAX_LSB_BITS. Modes that use fewer bits clamp it, see Stego::SetLsbBits. Decodes and
+ * updates take the mode from the media.
+ */
+bool isValidMode(const StegoJob& job)
+{
+    StegoAlgo algo;
+    EdgeDetectionType edgeDetectionType;
+    bool bAuto = job.type == StegoJobType::Encode;
+    bool bAlgo = StegoPlanner::ParseAlgo(job.algo, algo) || (bAuto && job.algo == StegoPlanner::AUTO);
+    bool bEdgeDetection = StegoPlanner::ParseEdgeDetection(job.edgeDetection, edgeDetectionType) ||
+                          (bAuto && job.edgeDetection == StegoPlanner::AUTO);
+    bool bLsbBits = job.lsbBits >= 1 && job.lsbBits <= MAX_LSB_BITS;
+
+    return job.type == StegoJobType::Decode || job.type == StegoJobType::Update ||
+           (bAlgo && bEdgeDetection && bLsbBits && job.maxFill > 0 && job.maxFill <= 1);
+}
+
+void writeSummary(const json& summary, const std::string& summaryPath)
+{
+    if (summaryPath.empty())
+    {
+        std::cout << summary.dump(4) << std::endl;
+    }
+    else
+    {
+        std::ofstream summaryFile(summaryPath);
+        summaryFile << summary.dump(4) << std::endl;
+    }
+}
+
+int runScan(const std::string& path, size_t numWorkers, const std::string& summaryPath)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::vector<ScanResult> results;
+    if (StegoScanner(numWorkers).Scan(path, results) != StegoStatus::SUCCESS)
+    {
+        std::cerr << "Could not open " << path << "\n";
+        return 2;
+    }
+
+    double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    json files = json::array();
+    size_t numCarriers = 0;
+    for (const ScanResult& result : results)
+    {
+        json file;
+        file["media"] = result.mediaPath;
+        file["status"] = stegoStatusName(result.status);
+        if (result.status == StegoStatus::SUCCESS)
+        {
+            numCarriers++;
+            file["headerVersion"] = result.header.version;
+            file["algo"] = StegoPlanner::AlgoName(result.header.algo);
+            file["edgeDetection"] = StegoPlanner::EdgeDetectionName(result.header.edgeDetectionType);
+            file["encrypted"] = result.header.bEncrypted;
+            file["compressed"] = result.header.bCompressed;
+            file["archive"] = result.header.bArchive;
+            file["shard"] = result.header.bShard;
+            file["fileNameLength"] = result.header.fileNameLength;
+            file["fileLength"] = result.header.fileLength;
+        }
+
+        files.push_back(file);
+    }
+
+    json summary;
+    summary["workers"] = numWorkers;
+    summary["wallSeconds"] = wallSeconds;
+    summary["filesPerSecond"] = wallSeconds > 0 ? results.size() / wallSeconds : 0.0;
+    summary["scanned"] = results.size();
+    summary["carriers"] = numCarriers;
+    summary["files"] = files;
+    writeSummary(summary, summaryPath);
+
+    return 0;
+}
+
+bool parseManifest(const std::string& manifestPath, std::vector<StegoJob>& jobs)
+{
+    std::ifstream manifestFile(manifestPath);
+    if (!manifestFile.is_open())
+    {
+        std::cerr << "Could not open manifest " << manifestPath << "\n";
+        return false;
+    }
+
+    try
+    {
+        json manifest = json::parse(manifestFile);
+        if (manifest.is_object())
+        {
+            manifest = manifest["jobs"];
+        }
+
+        for (const json& entry : manifest)
+        {
+            StegoJob job;
+            std::string operation = entry.value("operation", "encode");
+            if (!parseJobType(operation, job.type))
+            {
+                std::cerr << "Unknown operation " << operation << " in manifest " << manifestPath << "\n";
+                return false;
+            }
+
+            job.filePath = entry.value("file", "");
+            job.mediaPath = entry.value("media", "");
+            job.algo = entry.value("algo", "LSB");
+            job.edgeDetection = entry.value("edgeDetection", "None");
+            job.password = entry.value("password", "");
+            job.bEncrypt = !job.password.empty();
+            job.bCompress = entry.value("compress", false);
+            job.stripBudget = entry.value("stripBudgetMiB", size_t(0)) * BYTES_PER_MIB;
+            job.videoCodec = entry.value("videoCodec", "FFV1");
+            job.videoThreads = entry.value("videoThreads", 0);
+            job.videoSlices = entry.value("videoSlices", VideoBackend::DEFAULT_FFV1_SLICES);
+            job.frameSource = entry.value("frameSource", "VideoCapture");
+            job.checkpointFrames = entry.value("checkpointFrames", size_t(0));
+            job.lsbBits = entry.value("lsbBits", size_t(1));
+            job.member = entry.value("member", "");
+            job.rangeOffset = entry.value("offset", uint64_t(0));
+            job.rangeLength = entry.value("length", uint64_t(0));
+            job.shardMediaPaths = entry.value("shards", std::vector<std::string>());
+            job.edgeCacheDirectory = entry.value("edgeCache", "");
+            job.edgeCacheBudget = entry.value("edgeCacheMiB", EdgeCache::DEFAULT_MAX_BYTES / BYTES_PER_MIB) * BYTES_PER_MIB;
+            job.bRequireEdgeDetection = entry.value("requireEdges", false);
+            job.maxFill = entry.value("maxFill", 1.0);
+            job.costModelPath = entry.value("costModel", "");
+            VideoCodec videoCodec;
+            if (!VideoBackend::ParseCodec(job.videoCodec, videoCodec))
+            {
+                std::cerr << "Unknown video codec " << job.videoCodec << " in manifest " << manifestPath << "\n";
+                return false;
+            }
+
+            FrameSourceType frameSourceType;
+            if (!FrameSource::ParseType(job.frameSource, frameSourceType))
+            {
+                std::cerr << "Unknown frame source " << job.frameSource << " in manifest " << manifestPath << "\n";
+                return false;
+            }
+
+            if (!isValidMode(job))
+            {
+                std::cerr << "Invalid algo " << job.algo << " or edge detection " << job.edgeDetection << " in manifest "
+                          << manifestPath << "\n";
+                return false;
+            }
+
+            jobs.push_back(job);
+        }
+    }
+    catch (const json::exception& e)
+    {
+        std::cerr << "Invalid manifest " << manifestPath << ": " << e.what() << "\n";
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        printUsage();
+        return 2;
+    }
+
+    std::string command = argv[1];
+    StegoJob job;
+    std::string manifestPath;
+    std::string summaryPath;
+    std::string outputRoot = "stego_batch";
+    size_t numWorkers = std::max(1u, std::thread::hardware_concurrency());
+
+    for (int i = 2; i < argc; i++)
+    {
+        std::string option = argv[i];
+        if (i + 1 >= argc)
+        {
+            std::cerr << "Missing value for " << option << "\n";
+            printUsage();
+            return 2;
+        }
+
+        std::string value = argv[++i];
+        bool bValidValue = true;
+        if (option == "--file")
+        {
+            job.filePath = value;
+        }
+        else if (option == "--media")
+        {
+            job.mediaPath = value;
+        }
+        else if (option == "--algo")
+        {
+            job.algo = value;
+        }
+        else if (option == "--edge")
+        {
+            job.edgeDetection = value;
+        }
+        else if (option == "--password")
+        {
+            job.password = value;
+            job.bEncrypt = !value.empty();
+        }
+        else if (option == "--compress")
+        {
+            job.bCompress = value == "yes";
+        }
+        else if (option == "--strip-budget")
+        {
+            size_t stripBudgetMiB = 0;
+            bValidValue = parseNumber<size_t>(value, 0, std::numeric_limits<size_t>::max() / BYTES_PER_MIB,
+                                              stripBudgetMiB);
+            job.stripBudget = stripBudgetMiB * BYTES_PER_MIB;
+        }
+        else if (option == "--codec")
+        {
+            VideoCodec videoCodec;
+            if (!VideoBackend::ParseCodec(value, videoCodec))
+            {
+                std::cerr << "Unknown video codec " << value << "\n";
+                printUsage();
+                return 2;
+            }
+
+            job.videoCodec = value;
+        }
+        else if (option == "--codec-threads")
+        {
+            bValidValue = parseNumber(value, 0, std::numeric_limits<int>::max(), job.videoThreads);
+        }
+        else if (option == "--codec-slices")
+        {
+            bValidValue = parseNumber(value, 0, std::numeric_limits<int>::max(), job.videoSlices);
+        }
+        else if (option == "--frame-source")
+        {
+            FrameSourceType frameSourceType;
+            if (!FrameSource::ParseType(value, frameSourceType))
+            {
+                std::cerr << "Unknown frame source " << value << "\n";
+                printUsage();
+                return 2;
+            }
+
+            job.frameSource = value;
+        }
+        else if (option == "--checkpoint")
+        {
+            bValidValue = parseNumber<size_t>(value, 0, std::numeric_limits<size_t>::max(), job.checkpointFrames);
+        }
+        else if (option == "--lsb-bits")
+        {
+            bValidValue = parseNumber<size_t>(value, 1, MAX_LSB_BITS, job.lsbBits);
+        }
+        else if (option == "--member")
+        {
+            job.member = value;
+        }
+        else if (option == "--offset")
+        {
+            bValidValue = parseNumber<uint64_t>(value, 0, std::numeric_limits<uint64_t>::max(), job.rangeOffset);
+        }
+        else if (option == "--length")
+        {
+            bValidValue = parseNumber<uint64_t>(value, 0, std::numeric_limits<uint64_t>::max(), job.rangeLength);
+        }
+        else if (option == "--edge-cache")
+        {
+            job.edgeCacheDirectory = value;
+        }
+        else if (option == "--edge-cache-budget")
+        {
+            uint64_t edgeCacheBudgetMiB = 0;
+            bValidValue = parseNumber<uint64_t>(value, 0, std::numeric_limits<uint64_t>::max() / BYTES_PER_MIB,
+                                                edgeCacheBudgetMiB);
+            job.edgeCacheBudget = edgeCacheBudgetMiB * BYTES_PER_MIB;
+        }
+        else if (option == "--require-edges")
+        {
+            job.bRequireEdgeDetection = value == "yes";
+        }
+        else if (option == "--max-fill")
+        {
+            // The smallest positive double as the lower bound keeps 0 out, the payload has to fit somewhere
+            bValidValue = parseNumber(value, std::numeric_limits<double>::min(), 1.0, job.maxFill);
+        }
+        else if (option == "--cost-model")
+        {
+            job.costModelPath = value;
+        }
+        else if (option == "--shard")
+        {
+            job.shardMediaPaths.push_back(value);
+        }
+        else if (option == "--manifest")
+        {
+            manifestPath = value;
+        }
+        else if (option == "--workers")
+        {
+            bValidValue = parseNumber<size_t>(value, 1, std::numeric_limits<size_t>::max(), numWorkers);
+        }
+        else if (option == "--summary")
+        {
+            summaryPath = value;
+        }
+        else if (option == "--output")
+        {
+            outputRoot = value;
+        }
+        else
+        {
+            std::cerr << "Unknown option " << option << "\n";
+            printUsage();
+            return 2;
+        }
+
+        if (!bValidValue)
+        {
+            std::cerr << "Invalid value for " << option << "\n";
+            printUsage();
+            return 2;
+        }
+    }
+
+    if (command == "scan")
+    {
+        if (job.mediaPath.empty())
+        {
+            printUsage();
+            return 2;
+        }
+
+        return runScan(job.mediaPath, numWorkers, summaryPath);
+    }
+
+    std::vector<StegoJob> jobs;
+    std::vector<StegoJobResult> results;
+    ThroughputReport report;
+    if (command == "batch")
+    {
+        if (manifestPath.empty() || !parseManifest(manifestPath, jobs))
+        {
+            printUsage();
+            return 2;
+        }
+
+        JobScheduler scheduler(outputRoot, numWorkers);
+        report = scheduler.Run(jobs, results);
+    }
+    else if (parseJobType(command, job.type))
+    {
+        bool bShardJob = job.type == StegoJobType::Encode || job.type == StegoJobType::Decode;
+        bool bMedia = !job.mediaPath.empty() || (!job.shardMediaPaths.empty() && bShardJob);
+        bool bNeedsFile = job.type == StegoJobType::Encode || job.type == StegoJobType::Update;
+        if (!bMedia || (bNeedsFile && job.filePath.empty()) || !isValidMode(job))
+        {
+            printUsage();
+            return 2;
+        }
+
+        // Single jobs keep the GUI's layout and write to stego_media/ and decoded_files/ in the current directory
+        jobs.push_back(job);
+        results.push_back(JobScheduler::RunJob(job, ""));
+
+        report.numJobs = 1;
+        report.numWorkers = 1;
+        report.numSucceeded = results[0].status == StegoStatus::SUCCESS ? 1 : 0;
+        report.numFailed = 1 - report.numSucceeded;
+        report.wallSeconds = results[0].seconds;
+        report.busySeconds = results[0].seconds;
+    }
+    else
+    {
+        printUsage();
+        return 2;
+    }
+
+    json summary;
+    json jobSummaries = json::array();
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        json jobSummary;
+        jobSummary["index"] = i;
+        jobSummary["operation"] = jobTypeName(jobs[i].type);
+        jobSummary["media"] = jobs[i].mediaPath;
+        jobSummary["file"] = jobs[i].filePath;
+        jobSummary["status"] = stegoStatusName(results[i].status);
+        jobSummary["output"] = results[i].outputPath;
+        jobSummary["seconds"] = results[i].seconds;
+        jobSummary["worker"] = results[i].worker;
+        jobSummary["estimatedCost"] = results[i].estimatedCost;
+        if (!results[i].algo.empty())
+        {
+            jobSummary["algo"] = results[i].algo;
+            jobSummary["edgeDetection"] = results[i].edgeDetection;
+        }
+
+        if (jobs[i].type == StegoJobType::Capacity || results[i].status == StegoStatus::FILE_TOO_LARGE)
+        {
+            jobSummary["embedSize"] = results[i].embedSize;
+        }
+
+        jobSummaries.push_back(jobSummary);
+    }
+
+    summary["workers"] = report.numWorkers;
+    summary["wallSeconds"] = report.wallSeconds;
+    summary["busySeconds"] = report.busySeconds;
+    summary["utilisation"] = report.utilisation;
+    summary["jobsPerSecond"] = report.jobsPerSecond;
+    summary["payloadBytesPerSecond"] = report.payloadBytesPerSecond;
+    summary["succeeded"] = report.numSucceeded;
+    summary["failed"] = report.numFailed;
+    summary["jobs"] = jobSummaries;
+    writeSummary(summary, summaryPath);
+
+    return report.numFailed == 0 ? 0 : 1;
+}
@@ -0,0 +1,80 @@
+#ifndef STEGOCONSTANTS_H
+#define STEGOCONSTANTS_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Pixels taken by the header the encoder writes, see StegoHeader
+const size_t NUM_HEADER_PIXELS = 26;
+const size_t LSB_BITS_PER_PIXEL = 3;
+// Least significant bits of a sample LSB may embed in, see Stego::SetLsbBits
+const size_t MAX_LSB_BITS = 4;
+// Edges are detected on the upper six bits of the samples, only the two below stay free to embed in with edge detection
+const size_t MAX_EDGE_LSB_BITS = 2;
+const size_t BITS_PER_BYTE = 8;
+const size_t MAX_PVD_GREEN_EMBEDDING = 3;
+const size_t MAX_PVD_RED_EMBEDDING = 5;
+const size_t MAX_PVD_BLUE_EMBEDDING = 7;
+
+// The start of a payload is deflated first, payloads it does not shrink are embedded without compressing the rest
+const size_t COMPRESSION_PROBE_BYTES = 64 * 1024;
+
+// A compressed payload may inflate to this many times its embedded size and at least MIN_INFLATE_LIMIT_BYTES when
+// decoding, see Stego::SetInflateLimit
+const uint64_t INFLATE_LIMIT_RATIO = 256;
+const uint64_t MIN_INFLATE_LIMIT_BYTES = 256 * 1024 * 1024;
+
+// Frames between the checkpoints of a video encode where checkpoints are on by default, see Stego::SetCheckpointInterval
+const size_t DEFAULT_CHECKPOINT_FRAMES = 100;
+
+// Number of bits a PVD pixel pair can hold, indexed by the difference between the two values
+inline constexpr std::array<size_t, 256> pvdRangeTable = [] {
+    std::array<size_t, 256> result {};
+    for (size_t i = 0; i < 8; ++ i)
+    {
+        result[i] = 2;
+    }
+
+    for (size_t i = 8; i < 16; ++ i)
+    {
+        result[i] = 3;
+    }
+
+    for (size_t i = 16; i < 32; ++ i)
+    {
+        result[i] = 4;
+    }
+
+    for (size_t i = 32; i < 64; ++ i)
+    {
+        result[i] = 5;
+    }
+
+    for (size_t i = 64; i < 128; ++ i)
+    {
+        result[i] = 6;
+    }
+
+    for (size_t i = 128; i < 256; ++ i)
+    {
+        result[i] = 7;
+    }
+
+    return result;
+}();
+
+// Smallest difference of the range that holds the given number of bits
+inline constexpr std::array<size_t, 8> pvdRangeLowerBounds = [] {
+    std::array<size_t, 8> result {};
+    result[2] = 0;
+    result[3] = 8;
+    result[4] = 16;
+    result[5] = 32;
+    result[6] = 64;
+    result[7] = 128;
+
+    return result;
+}();
+
+#endif // STEGOCONSTANTS_H
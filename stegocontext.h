@@ -0,0 +1,78 @@
+#ifndef STEGOCONTEXT_H
+#define STEGOCONTEXT_H
+
+#include "bufferpool.h"
+#include "edgedetection.h"
+#include <bitset>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <opencv2/core/mat.hpp>
+
+/**
+ * State of a single encode or decode operation: the decoded header, the embedding cursor and the scratch
+ * planes used while embedding. Every public Stego operation starts from a fresh context, only the buffer pool
+ * the planes are allocated from is kept.
+ */
+struct StegoContext
+{
+    // Declared first so it outlives the planes allocated from it
+    std::shared_ptr<BufferPool> bufferPool;
+
+    size_t currentRow = 0;
+    size_t currentColumn = 0;
+    // Bit of the sample at the cursor LSB embeds in next, below the number of LSB bits per sample
+    size_t currentBit = 0;
+
+    size_t numHeaderPixels = 0;
+    uint32_t fileNameLength = 0;
+    uint64_t fileLength = 0;
+    bool bCompressed = false;
+    bool bArchive = false;
+    bool bShard = false;
+    uint64_t embedSize = 0;
+
+    // Cursor at the first byte of the payload after the file name, for decoding parts of it
+    size_t payloadRow = 0;
+    size_t payloadColumn = 0;
+    size_t payloadBit = 0;
+
+    cv::Mat greenChannel;
+    cv::Mat blueChannel;
+    cv::Mat redChannel;
+
+    cv::Mat greenEmbedding;
+    cv::Mat blueEmbedding;
+    cv::Mat redEmbedding;
+
+    EdgeDetection edgeDetector;
+};
+
+/**
+ * State of an update of a payload embedded with LSB, carried from frame to frame like the cursor. The stream is the
+ * file name followed by the file, as the kernels embed them one after the other.
+ */
+struct StegoUpdate
+{
+    // Stream embedded before the update, empty when the new header moves its bits
+    std::vector<uint8_t> oldStream;
+    uint64_t oldStreamLength = 0;
+    std::vector<uint8_t> stream;
+
+    // Stream bit every frame the old stream runs past ends at
+    std::vector<uint64_t> frameEndBits;
+
+    // Byte ranges of the stream that differ from the old stream, in order, and the range embedded next
+    std::vector<std::pair<uint64_t, uint64_t>> runs;
+    size_t runIndex = 0;
+
+    // Stream bit at the cursor between runs, and the next byte of the run being embedded
+    uint64_t streamBit = 0;
+    bool bInRun = false;
+    uint64_t runPosition = 0;
+    std::bitset<8> dataByte;
+    size_t dataByteIndex = 0;
+};
+
+#endif // STEGOCONTEXT_H
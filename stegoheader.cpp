@@ -0,0 +1,363 @@
+#include "stegoheader.h"
+#include "stegoconstants.h"
+#include "stegocapacity.h"
+#include <cryptopp/crc.h>
+
+static_assert(StegoHeader::NumPixels(StegoHeader::CURRENT_VERSION) == NUM_HEADER_PIXELS,
+              "NUM_HEADER_PIXELS must match the header the encoder writes");
+
+// Codes of the edge detection type in the two least significant bits of the green value of the first pixel
+const uint8_t EDGE_CODE_NONE = 0b00;
+const uint8_t EDGE_CODE_CANNY = 0b01;
+const uint8_t EDGE_CODE_SOBEL = 0b11;
+const uint8_t EXTENDED_HEADER_CODE = 0b10;
+// Only in the edge code of the extension, where the extended header code is free
+const uint8_t EDGE_CODE_TEXTURE = 0b10;
+
+const size_t FILE_NAME_LENGTH_SAMPLE = 3;
+const size_t NUM_FILE_NAME_LENGTH_BITS = 18;
+const size_t FILE_LENGTH_SAMPLE = 12;
+const size_t EXTENSION_SAMPLE = StegoHeader::NUM_PIXELS_V1 * 3;
+const size_t NUM_VERSION_BITS = 4;
+const size_t NUM_EDGE_CODE_BITS = 2;
+const size_t NUM_UPPER_LENGTH_BITS = 64 - StegoHeader::NUM_LENGTH_BITS_V1;
+const size_t COMPRESSED_FLAG_BIT = NUM_VERSION_BITS + NUM_EDGE_CODE_BITS + NUM_UPPER_LENGTH_BITS;
+const size_t NUM_EXTENSION_BITS_V2 = StegoHeader::NUM_EXTENSION_PIXELS_V2 * 3 * 2;
+
+// Version 3 keeps the version 2 fields, the archive flag follows the compressed flag
+const size_t ARCHIVE_FLAG_BIT = COMPRESSED_FLAG_BIT + 1;
+const size_t MAGIC_SAMPLE = EXTENSION_SAMPLE + NUM_EXTENSION_BITS_V2 / 2;
+const size_t NUM_MAGIC_BITS = 16;
+const size_t CHECKSUM_SAMPLE = MAGIC_SAMPLE + NUM_MAGIC_BITS / 2;
+const size_t NUM_CHECKSUM_BITS = 32;
+static_assert(NUM_EXTENSION_BITS_V2 + NUM_MAGIC_BITS + NUM_CHECKSUM_BITS <= StegoHeader::NUM_EXTENSION_PIXELS_V3 * 3 * 2,
+              "Version 3 fields must fit the extension pixels");
+static_assert(ARCHIVE_FLAG_BIT < NUM_EXTENSION_BITS_V2, "The archive flag must fit the version 2 extension bits");
+
+// Version 4 keeps the version 3 fields and appends a field of flags
+const size_t FLAGS_SAMPLE = CHECKSUM_SAMPLE + NUM_CHECKSUM_BITS / 2;
+const size_t NUM_FLAG_BITS = (StegoHeader::NUM_EXTENSION_PIXELS_V4 - StegoHeader::NUM_EXTENSION_PIXELS_V3) * 3 * 2;
+const uint64_t SHARD_FLAG = 1;
+// Number of least significant bits LSB embeds in per sample, stored minus one
+const size_t LSB_BITS_FLAG_SHIFT = 1;
+const size_t NUM_LSB_BITS_FLAG_BITS = 2;
+const uint64_t LSB_BITS_FLAGS = ((uint64_t(1) << NUM_LSB_BITS_FLAG_BITS) - 1) << LSB_BITS_FLAG_SHIFT;
+static_assert((uint64_t(1) << NUM_LSB_BITS_FLAG_BITS) == MAX_LSB_BITS, "Every LSB bit count must have a code");
+static_assert(FLAGS_SAMPLE == StegoHeader::NumPixels(StegoHeader::VERSION_3) * 3,
+              "Version 4 flags must follow the version 3 fields");
+
+/**
+ * @brief The HeaderSamples class Colour samples of an image in embedding order, the rows of a continuous
+ * image are walked as one row.
+ */
+class HeaderSamples
+{
+public:
+    explicit HeaderSamples(cv::Mat image)
+        : image(image)
+    {
+        numCols = image.cols * image.channels();
+        numRows = image.rows;
+        if (image.isContinuous())
+        {
+            numCols *= numRows;
+            numRows = 1;
+        }
+    }
+
+    size_t Size() const
+    {
+        return numRows * numCols;
+    }
+
+    uchar& operator[](size_t sample)
+    {
+        return image.ptr<uchar>(sample / numCols)[sample % numCols];
+    }
+
+    /**
+     * @brief HeaderSamples::WriteBits Store numBits of value, two bits in the least significant bits of every sample.
+     */
+    void WriteBits(size_t firstSample, uint64_t value, size_t numBits)
+    {
+        for (size_t bit = 0; bit < numBits; bit += 2)
+        {
+            uchar& sample = (*this)[firstSample + bit / 2];
+            sample = static_cast<uchar>((sample & ~0b11) | ((value >> bit) & 0b11));
+        }
+    }
+
+    uint64_t ReadBits(size_t firstSample, size_t numBits)
+    {
+        uint64_t value = 0;
+        for (size_t bit = 0; bit < numBits; bit += 2)
+        {
+            value |= static_cast<uint64_t>((*this)[firstSample + bit / 2] & 0b11) << bit;
+        }
+
+        return value;
+    }
+
+private:
+    cv::Mat image;
+    size_t numRows;
+    size_t numCols;
+};
+
+uint8_t edgeCode(EdgeDetectionType edgeDetectionType)
+{
+    if (edgeDetectionType == EdgeDetectionType::Canny)
+    {
+        return EDGE_CODE_CANNY;
+    }
+
+    if (edgeDetectionType == EdgeDetectionType::Sobel)
+    {
+        return EDGE_CODE_SOBEL;
+    }
+
+    if (edgeDetectionType == EdgeDetectionType::Texture)
+    {
+        return EDGE_CODE_TEXTURE;
+    }
+
+    return EDGE_CODE_NONE;
+}
+
+bool edgeDetectionFromCode(uint8_t code, EdgeDetectionType& edgeDetectionType)
+{
+    if (code == EDGE_CODE_NONE)
+    {
+        edgeDetectionType = EdgeDetectionType::None;
+    }
+    else if (code == EDGE_CODE_CANNY)
+    {
+        edgeDetectionType = EdgeDetectionType::Canny;
+    }
+    else if (code == EDGE_CODE_SOBEL)
+    {
+        edgeDetectionType = EdgeDetectionType::Sobel;
+    }
+    else if (code == EDGE_CODE_TEXTURE)
+    {
+        edgeDetectionType = EdgeDetectionType::Texture;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief StegoHeader::NumPixels Number of pixels the header takes, data starts after them.
+ */
+size_t StegoHeader::NumPixels() const
+{
+    return NumPixels(this->version);
+}
+
+/**
+ * @brief StegoHeader::checksum CRC32 of every header field, stored in version 3 and 4 headers.
+ */
+uint32_t StegoHeader::checksum() const
+{
+    CryptoPP::byte fields[16];
+    fields[0] = this->version;
+    fields[1] = this->algo == StegoAlgo::PVD ? 1 : 0;
+    fields[2] = edgeCode(this->edgeDetectionType);
+    fields[3] = static_cast<CryptoPP::byte>((this->bEncrypted ? 1 : 0) | (this->bCompressed ? 2 : 0) |
+                                            (this->bArchive ? 4 : 0) | (this->bShard ? 8 : 0) |
+                                            ((this->lsbBits - 1) << 4));
+    for (size_t i = 0; i < 4; i++)
+    {
+        fields[4 + i] = static_cast<CryptoPP::byte>(this->fileNameLength >> (i * 8));
+    }
+
+    for (size_t i = 0; i < 8; i++)
+    {
+        fields[8 + i] = static_cast<CryptoPP::byte>(this->fileLength >> (i * 8));
+    }
+
+    CryptoPP::byte digest[CryptoPP::CRC32::DIGESTSIZE];
+    CryptoPP::CRC32().CalculateDigest(digest, fields, sizeof(fields));
+
+    uint32_t crc = 0;
+    for (size_t i = 0; i < CryptoPP::CRC32::DIGESTSIZE; i++)
+    {
+        crc |= static_cast<uint32_t>(digest[i]) << (i * 8);
+    }
+
+    return crc;
+}
+
+/**
+ * @brief StegoHeader::Write Embed the header in the first pixels of image. Only the bits the header uses are changed.
+ * @return StegoStatus::OUT_OF_ROOM if the image is smaller than the header, StegoStatus::INVALID_HEADER for texture
+ * edge detection in a version 1 header, which has no code for it, or for more than one LSB bit per sample in a header
+ * older than version 4 or outside 1 to MAX_LSB_BITS, StegoStatus::SUCCESS otherwise
+ */
+StegoStatus StegoHeader::Write(cv::Mat image) const
+{
+    HeaderSamples samples(image);
+    if (samples.Size() < NumPixels() * 3)
+    {
+        return StegoStatus::OUT_OF_ROOM;
+    }
+
+    if (this->version == VERSION_1 && this->edgeDetectionType == EdgeDetectionType::Texture)
+    {
+        return StegoStatus::INVALID_HEADER;
+    }
+
+    if (this->lsbBits < 1 || this->lsbBits > MAX_LSB_BITS || (this->version < VERSION_4 && this->lsbBits != 1))
+    {
+        return StegoStatus::INVALID_HEADER;
+    }
+
+    // Algorithm in the least significant bit of blue, encryption in the least significant bit of red
+    samples[0] = static_cast<uchar>((samples[0] & ~1) | (this->algo == StegoAlgo::PVD ? 1 : 0));
+    samples[2] = static_cast<uchar>((samples[2] & ~1) | (this->bEncrypted ? 1 : 0));
+
+    uint8_t greenCode = this->version == VERSION_1 ? edgeCode(this->edgeDetectionType) : EXTENDED_HEADER_CODE;
+    samples.WriteBits(1, greenCode, 2);
+
+    samples.WriteBits(FILE_NAME_LENGTH_SAMPLE, this->fileNameLength, NUM_FILE_NAME_LENGTH_BITS);
+    samples.WriteBits(FILE_LENGTH_SAMPLE, this->fileLength, NUM_LENGTH_BITS_V1);
+
+    if (this->version != VERSION_1)
+    {
+        uint64_t extension = this->version;
+        extension |= static_cast<uint64_t>(edgeCode(this->edgeDetectionType)) << NUM_VERSION_BITS;
+        extension |= (this->fileLength >> NUM_LENGTH_BITS_V1) << (NUM_VERSION_BITS + NUM_EDGE_CODE_BITS);
+        extension |= static_cast<uint64_t>(this->bCompressed) << COMPRESSED_FLAG_BIT;
+        extension |= static_cast<uint64_t>(this->bArchive && this->version >= VERSION_3) << ARCHIVE_FLAG_BIT;
+        samples.WriteBits(EXTENSION_SAMPLE, extension, NUM_EXTENSION_BITS_V2);
+    }
+
+    if (this->version >= VERSION_3)
+    {
+        samples.WriteBits(MAGIC_SAMPLE, MAGIC, NUM_MAGIC_BITS);
+        samples.WriteBits(CHECKSUM_SAMPLE, checksum(), NUM_CHECKSUM_BITS);
+    }
+
+    if (this->version == VERSION_4)
+    {
+        uint64_t flags = this->bShard ? SHARD_FLAG : 0;
+        flags |= static_cast<uint64_t>(this->lsbBits - 1) << LSB_BITS_FLAG_SHIFT;
+        samples.WriteBits(FLAGS_SAMPLE, flags, NUM_FLAG_BITS);
+    }
+
+    return StegoStatus::SUCCESS;
+}
+
+/**
+ * @brief StegoHeader::Read Read the header from the first pixels of image. Media without a payload is rejected
+ * by the magic tag and checksum of version 3 headers, or by the file name length of older headers.
+ * @return StegoStatus::INVALID_HEADER if there is no valid header or it is from a newer version,
+ * StegoStatus::SUCCESS otherwise
+ */
+StegoStatus StegoHeader::Read(cv::Mat image)
+{
+    HeaderSamples samples(image);
+    if (samples.Size() < NUM_PIXELS_V1 * 3)
+    {
+        return StegoStatus::INVALID_HEADER;
+    }
+
+    this->algo = (samples[0] & 1) ? StegoAlgo::PVD : StegoAlgo::LSB;
+    this->bEncrypted = (samples[2] & 1) != 0;
+    this->fileNameLength = static_cast<uint32_t>(samples.ReadBits(FILE_NAME_LENGTH_SAMPLE, NUM_FILE_NAME_LENGTH_BITS));
+    this->fileLength = samples.ReadBits(FILE_LENGTH_SAMPLE, NUM_LENGTH_BITS_V1);
+
+    uint8_t greenCode = static_cast<uint8_t>(samples.ReadBits(1, 2));
+    if (greenCode != EXTENDED_HEADER_CODE)
+    {
+        this->version = VERSION_1;
+        this->bCompressed = false;
+        this->bArchive = false;
+        this->bShard = false;
+        this->lsbBits = 1;
+        return edgeDetectionFromCode(greenCode, this->edgeDetectionType) &&
+                       this->fileNameLength <= MAX_LEGACY_FILE_NAME_LENGTH
+                   ? StegoStatus::SUCCESS
+                   : StegoStatus::INVALID_HEADER;
+    }
+
+    if (samples.Size() < NumPixels(VERSION_2) * 3)
+    {
+        return StegoStatus::INVALID_HEADER;
+    }
+
+    uint64_t extension = samples.ReadBits(EXTENSION_SAMPLE, NUM_EXTENSION_BITS_V2);
+    this->version = static_cast<uint8_t>(extension & ((1 << NUM_VERSION_BITS) - 1));
+    this->bShard = false;
+    this->lsbBits = 1;
+    if (this->version == VERSION_3 || this->version == VERSION_4)
+    {
+        if (samples.Size() < NumPixels(this->version) * 3 || samples.ReadBits(MAGIC_SAMPLE, NUM_MAGIC_BITS) != MAGIC)
+        {
+            return StegoStatus::INVALID_HEADER;
+        }
+    }
+    else if (this->version != VERSION_2 || this->fileNameLength > MAX_LEGACY_FILE_NAME_LENGTH)
+    {
+        return StegoStatus::INVALID_HEADER;
+    }
+
+    uint8_t code = static_cast<uint8_t>((extension >> NUM_VERSION_BITS) & ((1 << NUM_EDGE_CODE_BITS) - 1));
+    if (!edgeDetectionFromCode(code, this->edgeDetectionType))
+    {
+        return StegoStatus::INVALID_HEADER;
+    }
+
+    uint64_t upperLengthBits = (extension >> (NUM_VERSION_BITS + NUM_EDGE_CODE_BITS)) &
+                               ((uint64_t(1) << NUM_UPPER_LENGTH_BITS) - 1);
+    this->fileLength |= upperLengthBits << NUM_LENGTH_BITS_V1;
+    this->bCompressed = ((extension >> COMPRESSED_FLAG_BIT) & 1) != 0;
+    this->bArchive = this->version >= VERSION_3 && ((extension >> ARCHIVE_FLAG_BIT) & 1) != 0;
+
+    // Flags this build does not know are from a newer encoder
+    if (this->version == VERSION_4)
+    {
+        uint64_t flags = samples.ReadBits(FLAGS_SAMPLE, NUM_FLAG_BITS);
+        if ((flags & ~(SHARD_FLAG | LSB_BITS_FLAGS)) != 0)
+        {
+            return StegoStatus::INVALID_HEADER;
+        }
+
+        this->bShard = (flags & SHARD_FLAG) != 0;
+        this->lsbBits = static_cast<uint8_t>(((flags & LSB_BITS_FLAGS) >> LSB_BITS_FLAG_SHIFT) + 1);
+
+        if (this->lsbBits > StegoCapacity::MaxLsbBits(this->algo, this->edgeDetectionType))
+        {
+            return StegoStatus::INVALID_HEADER;
+        }
+    }
+
+    if (this->version >= VERSION_3 && samples.ReadBits(CHECKSUM_SAMPLE, NUM_CHECKSUM_BITS) != checksum())
+    {
+        return StegoStatus::INVALID_HEADER;
+    }
+
+    return StegoStatus::SUCCESS;
+}
+
+/**
+ * @brief StegoHeader::FitsIn Whether the payload could fit in media of numFrames frames of numPixels pixels.
+ * Only an upper bound of the capacity is used, so a header failing it cannot have been written by the encoder.
+ * @param numFrames Number of frames of the media, 0 if unknown, which accepts any payload
+ */
+bool StegoHeader::FitsIn(uint64_t numPixels, uint64_t numFrames) const
+{
+    if (numFrames == 0)
+    {
+        return true;
+    }
+
+    uint64_t maxPayloadSize = StegoCapacity::MaxCapacity(this->algo, numPixels, NumPixels(), this->lsbBits) +
+                              StegoCapacity::MaxCapacity(this->algo, numPixels, 0, this->lsbBits) * (numFrames - 1);
+
+    return this->fileLength + this->fileNameLength <= maxPayloadSize;
+}
@@ -0,0 +1,72 @@
+#ifndef STEGOHEADER_H
+#define STEGOHEADER_H
+
+#include "StegoAlgo.h"
+#include "EdgeDetectionType.h"
+#include "StegoStatus.h"
+#include <cstddef>
+#include <cstdint>
+#include <opencv2/core/mat.hpp>
+
+/**
+ * Header stored in the least significant bits of the first pixels of an image or of the first video frame.
+ *
+ * Version 1 takes NUM_PIXELS_V1 pixels and holds payload lengths up to 36 bits. Later versions are marked by the
+ * green code of the first pixel that version 1 never writes, so older builds reject them instead of misreading
+ * them, and append pixels holding the version number, the edge detection type, the upper bits of a 64-bit length
+ * and the payload flags. Version 3 adds a magic tag and a CRC32 of the header fields, so media without a payload
+ * is rejected after reading its first pixels. Versions 1 and 2 are still read, but only when the file name length
+ * is one a file system allows. The archive flag of version 3 takes the bit after the compressed flag that earlier
+ * builds left unused, it is covered by the checksum, so they reject archives instead of extracting them as a single
+ * file. Version 4, the only version the encoder writes, appends two pixels of further flags, the shard flag, the number
+ * of LSB bits per sample and bits reserved as zero, since version 3 has no bit left.
+ */
+struct StegoHeader
+{
+    static constexpr uint8_t VERSION_1 = 1;
+    static constexpr uint8_t VERSION_2 = 2;
+    static constexpr uint8_t VERSION_3 = 3;
+    static constexpr uint8_t VERSION_4 = 4;
+    static constexpr uint8_t CURRENT_VERSION = VERSION_4;
+
+    static constexpr size_t NUM_PIXELS_V1 = 10;
+    static constexpr size_t NUM_LENGTH_BITS_V1 = 36;
+    static constexpr size_t NUM_EXTENSION_PIXELS_V2 = 6;
+    static constexpr size_t NUM_EXTENSION_PIXELS_V3 = 14;
+    static constexpr size_t NUM_EXTENSION_PIXELS_V4 = 16;
+    static constexpr uint16_t MAGIC = 0x5354;
+    static constexpr uint32_t MAX_LEGACY_FILE_NAME_LENGTH = 255;
+
+    uint8_t version = CURRENT_VERSION;
+    StegoAlgo algo = StegoAlgo::LSB;
+    EdgeDetectionType edgeDetectionType = EdgeDetectionType::None;
+    bool bEncrypted = false;
+    bool bCompressed = false;
+    // The payload is a StegoArchive, version 3 on
+    bool bArchive = false;
+    // The payload is one shard of a payload split across several media, see StegoShard, version 4 only
+    bool bShard = false;
+    // Least significant bits of each sample LSB embeds in, 1 to MAX_LSB_BITS, version 4 only
+    uint8_t lsbBits = 1;
+    uint32_t fileNameLength = 0;
+    uint64_t fileLength = 0;
+
+    static constexpr size_t NumPixels(uint8_t version)
+    {
+        return version == VERSION_1   ? NUM_PIXELS_V1
+               : version == VERSION_2 ? NUM_PIXELS_V1 + NUM_EXTENSION_PIXELS_V2
+               : version == VERSION_3 ? NUM_PIXELS_V1 + NUM_EXTENSION_PIXELS_V3
+                                      : NUM_PIXELS_V1 + NUM_EXTENSION_PIXELS_V4;
+    }
+
+    size_t NumPixels() const;
+
+    StegoStatus Write(cv::Mat image) const;
+    StegoStatus Read(cv::Mat image);
+    bool FitsIn(uint64_t numPixels, uint64_t numFrames) const;
+
+private:
+    uint32_t checksum() const;
+};
+
+#endif // STEGOHEADER_H
@@ -0,0 +1,180 @@
+#include "stegojournal.h"
+#include <cryptopp/crc.h>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+const char* JOURNAL_MAGIC = "stego-journal";
+
+// The key holds paths, it is stored hex encoded so any character survives the line based format
+std::string hexEncode(const std::string& text)
+{
+    std::ostringstream hex;
+    for (unsigned char character : text)
+    {
+        hex << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(character);
+    }
+
+    return hex.str();
+}
+
+/**
+ * @brief StegoJournal::Save Write the journal to path, replacing the previous one only once it is complete.
+ * @return StegoStatus::FILE_OPEN_FAILED if it could not be written, StegoStatus::SUCCESS otherwise
+ */
+StegoStatus StegoJournal::Save(const std::filesystem::path& path) const
+{
+    std::filesystem::path tempPath = path;
+    tempPath += ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios_base::trunc);
+        file << JOURNAL_MAGIC << " " << VERSION << "\n"
+             << "key " << hexEncode(this->key) << "\n"
+             << "compressed " << this->bCompressed << "\n"
+             << "payloadSaved " << this->bPayloadSaved << "\n";
+
+        for (const StegoJournalSegment& segment : this->segments)
+        {
+            file << "segment " << segment.endFrame << " " << segment.payloadOffset << " "
+                 << static_cast<int>(segment.dataByte) << " " << segment.dataByteIndex << " "
+                 << segment.bFileNameEmbedded << " " << segment.bPayloadEnd << "\n";
+        }
+
+        file.flush();
+        if (!file)
+        {
+            return StegoStatus::FILE_OPEN_FAILED;
+        }
+    }
+
+    // The new journal is on disk before it replaces the old one, and the rename before Save returns
+    if (!SyncFile(tempPath))
+    {
+        return StegoStatus::FILE_OPEN_FAILED;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, path, error);
+    if (error || !SyncFile(path.parent_path()))
+    {
+        return StegoStatus::FILE_OPEN_FAILED;
+    }
+
+    return StegoStatus::SUCCESS;
+}
+
+/**
+ * @brief StegoJournal::Load Read a journal written by Save.
+ * @return StegoStatus::FILE_NOT_FOUND if there is none, StegoStatus::INVALID_HEADER if it is damaged or of
+ * another version, StegoStatus::SUCCESS otherwise
+ */
+StegoStatus StegoJournal::Load(const std::filesystem::path& path)
+{
+    std::ifstream file(path);
+    if (!file.is_open())
+    {
+        return StegoStatus::FILE_NOT_FOUND;
+    }
+
+    std::string magic;
+    uint32_t version = 0;
+    std::string field;
+    std::string hexKey;
+    file >> magic >> version >> field >> hexKey;
+    if (!file || magic != JOURNAL_MAGIC || version != VERSION || field != "key" || hexKey.size() % 2 != 0 ||
+        hexKey.find_first_not_of("0123456789abcdef") != std::string::npos)
+    {
+        return StegoStatus::INVALID_HEADER;
+    }
+
+    this->key.clear();
+    for (size_t i = 0; i < hexKey.size(); i += 2)
+    {
+        this->key.push_back(static_cast<char>(std::stoi(hexKey.substr(i, 2), nullptr, 16)));
+    }
+
+    file >> field >> this->bCompressed;
+    if (!file || field != "compressed")
+    {
+        return StegoStatus::INVALID_HEADER;
+    }
+
+    file >> field >> this->bPayloadSaved;
+    if (!file || field != "payloadSaved")
+    {
+        return StegoStatus::INVALID_HEADER;
+    }
+
+    this->segments.clear();
+    while (file >> field)
+    {
+        StegoJournalSegment segment;
+        int dataByte = 0;
+        file >> segment.endFrame >> segment.payloadOffset >> dataByte >> segment.dataByteIndex
+             >> segment.bFileNameEmbedded >> segment.bPayloadEnd;
+        if (!file || field != "segment" || dataByte < 0 || dataByte > 255)
+        {
+            return StegoStatus::INVALID_HEADER;
+        }
+
+        segment.dataByte = static_cast<uint8_t>(dataByte);
+        this->segments.push_back(segment);
+    }
+
+    return StegoStatus::SUCCESS;
+}
+
+/**
+ * @brief StegoJournal::KeyName Short name for the checkpoint of key, the CRC32 of the key in hex.
+ */
+std::string StegoJournal::KeyName(const std::string& key)
+{
+    CryptoPP::CRC32 crc;
+    CryptoPP::byte digest[CryptoPP::CRC32::DIGESTSIZE];
+    crc.CalculateDigest(digest, reinterpret_cast<const CryptoPP::byte*>(key.data()), key.size());
+
+    return hexEncode(std::string(reinterpret_cast<const char*>(digest), sizeof(digest)));
+}
+
+/**
+ * @brief StegoJournal::SyncFile Flush a file, or the entries of a directory, from the OS cache to the disk, so they
+ * survive a power loss. Directories are not flushed on Windows, where a rename is already durable.
+ * @return false if path could not be opened or flushed
+ */
+bool StegoJournal::SyncFile(const std::filesystem::path& path)
+{
+#ifdef _WIN32
+    std::error_code error;
+    if (std::filesystem::is_directory(path, error))
+    {
+        return true;
+    }
+
+    int descriptor = _wopen(path.c_str(), _O_RDWR | _O_BINARY);
+    if (descriptor < 0)
+    {
+        return false;
+    }
+
+    bool bSynced = _commit(descriptor) == 0;
+    _close(descriptor);
+#else
+    int descriptor = open(path.c_str(), O_RDONLY);
+    if (descriptor < 0)
+    {
+        return false;
+    }
+
+    bool bSynced = fsync(descriptor) == 0;
+    close(descriptor);
+#endif
+
+    return bSynced;
+}
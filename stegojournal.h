@@ -0,0 +1,50 @@
+#ifndef STEGOJOURNAL_H
+#define STEGOJOURNAL_H
+
+#include "StegoStatus.h"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+/**
+ * State of a video encode after the last frame of a segment, enough to carry on with the next frame.
+ * Frames frame_000001.png to the segment's endFrame are on disk, the payload has been read up to payloadOffset
+ * and the first dataByteIndex bits of dataByte, the byte read last, are embedded.
+ */
+struct StegoJournalSegment
+{
+    size_t endFrame = 0;
+    uint64_t payloadOffset = 0;
+    uint8_t dataByte = 0;
+    size_t dataByteIndex = 0;
+    bool bFileNameEmbedded = false;
+    // The whole payload is embedded, the frames left are copied as they are
+    bool bPayloadEnd = false;
+};
+
+/**
+ * Checkpoint of a long video encode, see Stego::SetCheckpointInterval. key identifies the inputs and settings
+ * of the encode, a journal with another key is never resumed. The journal is replaced by renaming a complete
+ * new one over it, so a crash while saving leaves the previous journal. It is flushed to disk before and after the
+ * rename, the frames it lists must be flushed with SyncFile before it is saved.
+ */
+struct StegoJournal
+{
+    static constexpr uint32_t VERSION = 1;
+
+    std::string key;
+    bool bCompressed = false;
+    // The embedded payload was a temp file, e.g. encrypted with a random salt, and is kept next to the journal
+    bool bPayloadSaved = false;
+    std::vector<StegoJournalSegment> segments;
+
+    StegoStatus Save(const std::filesystem::path& path) const;
+    StegoStatus Load(const std::filesystem::path& path);
+
+    static std::string KeyName(const std::string& key);
+    static bool SyncFile(const std::filesystem::path& path);
+};
+
+#endif // STEGOJOURNAL_H
@@ -0,0 +1,467 @@
+#include "stegoplanner.h"
+#include "stego.h"
+#include "stegoarchive.h"
+#include "stegocapacity.h"
+#include "stegoconstants.h"
+#include "stegoshard.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <opencv2/opencv.hpp>
+
+// Seconds per pixel of LSB without edge detection, the other modes are scaled from it by their relative cost
+const double DEFAULT_SECONDS_PER_PIXEL = 5e-9;
+const double DEFAULT_RELATIVE_COSTS[StegoCostModel::NUM_ALGOS][StegoCostModel::NUM_EDGE_DETECTION_TYPES] = {
+    {1.0, 4.0, 6.0, 1.5},
+    {2.0, 8.0, 12.0, 3.0}
+};
+
+// Square tiles of the calibration carrier, their borders are the edges Sobel and Canny find
+const int CALIBRATION_TILE = 16;
+
+const uint64_t UNBOUNDED_CAPACITY = std::numeric_limits<uint64_t>::max();
+
+const StegoAlgo ALGOS[] = {StegoAlgo::LSB, StegoAlgo::PVD};
+const EdgeDetectionType EDGE_DETECTION_TYPES[] = {EdgeDetectionType::None, EdgeDetectionType::Sobel,
+                                                  EdgeDetectionType::Canny, EdgeDetectionType::Texture};
+
+StegoCostModel::StegoCostModel()
+{
+    for (StegoAlgo algo : ALGOS)
+    {
+        for (EdgeDetectionType edgeDetectionType : EDGE_DETECTION_TYPES)
+        {
+            SetSecondsPerPixel(algo, edgeDetectionType, DEFAULT_SECONDS_PER_PIXEL *
+                               DEFAULT_RELATIVE_COSTS[static_cast<size_t>(algo)][static_cast<size_t>(edgeDetectionType)]);
+        }
+    }
+}
+
+double StegoCostModel::SecondsPerPixel(StegoAlgo algo, EdgeDetectionType edgeDetectionType) const
+{
+    return this->secondsPerPixel[static_cast<size_t>(algo)][static_cast<size_t>(edgeDetectionType)];
+}
+
+void StegoCostModel::SetSecondsPerPixel(StegoAlgo algo, EdgeDetectionType edgeDetectionType, double seconds)
+{
+    this->secondsPerPixel[static_cast<size_t>(algo)][static_cast<size_t>(edgeDetectionType)] = seconds;
+}
+
+/**
+ * @brief StegoCostModel::EstimateSeconds Estimated run time of an encode into numPixels pixels, the pixels of every
+ * frame for a video.
+ */
+double StegoCostModel::EstimateSeconds(StegoAlgo algo, EdgeDetectionType edgeDetectionType, uint64_t numPixels) const
+{
+    return SecondsPerPixel(algo, edgeDetectionType) * static_cast<double>(numPixels);
+}
+
+/**
+ * @brief StegoCostModel::Calibrate Time an in-memory encode in every mode on a synthetic carrier of rows by cols,
+ * tiles of noise whose borders are edges, with a random payload filling half of the capacity of the mode. The
+ * fastest of CALIBRATION_RUNS runs is kept, so a busy moment does not skew the model.
+ */
+void StegoCostModel::Calibrate(int rows, int cols)
+{
+    std::mt19937 generator(1);
+    cv::Mat carrier(rows, cols, CV_8UC3);
+    for (int row = 0; row < rows; row++)
+    {
+        uchar* samples = carrier.ptr<uchar>(row);
+        for (int col = 0; col < cols; col++)
+        {
+            bool bLightTile = (row / CALIBRATION_TILE + col / CALIBRATION_TILE) % 2 != 0;
+            for (int channel = 0; channel < 3; channel++)
+            {
+                samples[col * 3 + channel] = static_cast<uchar>((bLightTile ? 160 : 64) + generator() % 32);
+            }
+        }
+    }
+
+    for (StegoAlgo algo : ALGOS)
+    {
+        for (EdgeDetectionType edgeDetectionType : EDGE_DETECTION_TYPES)
+        {
+            StegoCapacity capacity(algo, edgeDetectionType);
+            std::vector<uint8_t> payload(capacity.FrameCapacity(carrier, NUM_HEADER_PIXELS) / 2);
+            for (uint8_t& byte : payload)
+            {
+                byte = static_cast<uint8_t>(generator());
+            }
+
+            Stego stego(StegoPlanner::AlgoName(algo), StegoPlanner::EdgeDetectionName(edgeDetectionType), false, "");
+            double fastestSeconds = std::numeric_limits<double>::max();
+            for (int run = 0; run < CALIBRATION_RUNS; run++)
+            {
+                cv::Mat stegoImage;
+                auto start = std::chrono::steady_clock::now();
+                StegoStatus status = stego.EncodeImage(carrier, payload.data(), payload.size(), "calibration",
+                                                       stegoImage);
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                if (status == StegoStatus::SUCCESS)
+                {
+                    fastestSeconds = std::min(fastestSeconds, seconds);
+                }
+            }
+
+            // A mode that failed to encode keeps its default
+            if (fastestSeconds != std::numeric_limits<double>::max())
+            {
+                SetSecondsPerPixel(algo, edgeDetectionType, fastestSeconds / carrier.total());
+            }
+        }
+    }
+}
+
+/**
+ * @brief StegoCostModel::Load Read a model written by Save.
+ * @return false if the file can not be read or lacks a mode, the model is left as it was
+ */
+bool StegoCostModel::Load(const std::filesystem::path& path)
+{
+    std::ifstream file(path);
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    StegoCostModel model = *this;
+    bool bRead[NUM_ALGOS][NUM_EDGE_DETECTION_TYPES] = {};
+    std::string algoName;
+    std::string edgeDetectionName;
+    double seconds;
+    while (file >> algoName >> edgeDetectionName >> seconds)
+    {
+        StegoAlgo algo;
+        EdgeDetectionType edgeDetectionType;
+        if (!StegoPlanner::ParseAlgo(algoName, algo) ||
+            !StegoPlanner::ParseEdgeDetection(edgeDetectionName, edgeDetectionType) || !(seconds > 0))
+        {
+            return false;
+        }
+
+        model.SetSecondsPerPixel(algo, edgeDetectionType, seconds);
+        bRead[static_cast<size_t>(algo)][static_cast<size_t>(edgeDetectionType)] = true;
+    }
+
+    for (StegoAlgo algo : ALGOS)
+    {
+        for (EdgeDetectionType edgeDetectionType : EDGE_DETECTION_TYPES)
+        {
+            if (!bRead[static_cast<size_t>(algo)][static_cast<size_t>(edgeDetectionType)])
+            {
+                return false;
+            }
+        }
+    }
+
+    *this = model;
+
+    return true;
+}
+
+/**
+ * @brief StegoCostModel::Save Write the model as a line of algorithm, edge detection and seconds per pixel for every
+ * mode. The file is written under a temp name and renamed, so other processes never load half of it.
+ */
+bool StegoCostModel::Save(const std::filesystem::path& path) const
+{
+    std::filesystem::path tempPath = path;
+    tempPath += ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios_base::trunc);
+        file.precision(std::numeric_limits<double>::max_digits10);
+        for (StegoAlgo algo : ALGOS)
+        {
+            for (EdgeDetectionType edgeDetectionType : EDGE_DETECTION_TYPES)
+            {
+                file << StegoPlanner::AlgoName(algo) << " " << StegoPlanner::EdgeDetectionName(edgeDetectionType) << " "
+                     << SecondsPerPixel(algo, edgeDetectionType) << "\n";
+            }
+        }
+
+        if (!file.flush())
+        {
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, path, error);
+    if (error)
+    {
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+
+    return true;
+}
+
+StegoPlanner::StegoPlanner(const StegoCostModel& costModel)
+    : costModel(costModel)
+{
+}
+
+/**
+ * @brief StegoPlanner::SetEdgeCache Take the edge masks of the carriers from edgeCache while measuring capacities,
+ * see EdgeCache. Encoding with the same cache then skips edge detection too.
+ */
+void StegoPlanner::SetEdgeCache(EdgeCache* edgeCache)
+{
+    this->edgeCache = edgeCache;
+}
+
+/**
+ * @brief StegoPlanner::Plan Estimate every mode the constraints allow for a payload embedded in mediaPaths and find
+ * the fastest one that holds it. A mode is only measured when the upper bound of its capacity could hold the payload.
+ * @param payloadBytes Bytes of the file as embedded, see PayloadBytes
+ * @param mediumOverheadBytes Bytes every medium embeds besides its part of the file, the file name and for shards
+ * the shard prefix
+ * @param options Set to the modes allowed, fastest first. The first option with bFits set is the plan.
+ * @return StegoStatus::FILE_TOO_LARGE if no allowed mode holds the payload, StegoStatus::IMAGE_NOT_FOUND or
+ * StegoStatus::VIDEO_OPEN_FAILED if a medium can not be read, StegoStatus::SUCCESS otherwise
+ */
+StegoStatus StegoPlanner::Plan(const std::vector<std::string>& mediaPaths, uint64_t payloadBytes,
+                               uint64_t mediumOverheadBytes, const StegoPlanConstraints& constraints,
+                               std::vector<StegoPlanOption>& options) const
+{
+    options.clear();
+
+    // Only the dimensions are read here, the pixels are left for the modes that get measured
+    std::vector<uint64_t> framePixels;
+    std::vector<uint64_t> frameCounts;
+    uint64_t totalPixels = 0;
+    for (const std::string& mediaPath : mediaPaths)
+    {
+        uint64_t numPixels = 0;
+        uint64_t numFrames = 1;
+        if (std::filesystem::path(mediaPath).extension() == ".mkv")
+        {
+            cv::VideoCapture video(mediaPath);
+            if (!video.isOpened())
+            {
+                return StegoStatus::VIDEO_OPEN_FAILED;
+            }
+
+            numPixels = static_cast<uint64_t>(video.get(cv::CAP_PROP_FRAME_WIDTH)) *
+                        static_cast<uint64_t>(video.get(cv::CAP_PROP_FRAME_HEIGHT));
+            numFrames = StegoCapacity::MaxFrameCount(video.get(cv::CAP_PROP_FRAME_COUNT));
+        }
+        else
+        {
+            numPixels = StegoCapacity::ReadPngPixelCount(mediaPath);
+            if (numPixels == 0)
+            {
+                cv::Mat image = cv::imread(mediaPath, cv::IMREAD_COLOR);
+                if (image.empty())
+                {
+                    return StegoStatus::IMAGE_NOT_FOUND;
+                }
+
+                numPixels = image.total();
+            }
+        }
+
+        // A video without a frame count is estimated as a single frame and its capacity is not bounded
+        framePixels.push_back(numPixels);
+        frameCounts.push_back(numFrames);
+        totalPixels += numPixels * std::max<uint64_t>(numFrames, 1);
+    }
+
+    for (StegoAlgo algo : constraints.algos)
+    {
+        for (EdgeDetectionType edgeDetectionType : constraints.edgeDetectionTypes)
+        {
+            if (constraints.bRequireEdgeDetection && edgeDetectionType == EdgeDetectionType::None)
+            {
+                continue;
+            }
+
+            StegoPlanOption option;
+            option.algo = algo;
+            option.edgeDetectionType = edgeDetectionType;
+            option.estimatedSeconds = this->costModel.EstimateSeconds(algo, edgeDetectionType, totalPixels);
+            size_t lsbBits = std::min(constraints.lsbBits, StegoCapacity::MaxLsbBits(algo, edgeDetectionType));
+            for (size_t i = 0; i < mediaPaths.size() && option.capacity != UNBOUNDED_CAPACITY; i++)
+            {
+                option.capacity = frameCounts[i] == 0 ? UNBOUNDED_CAPACITY : option.capacity +
+                    StegoCapacity::MaxCapacity(algo, framePixels[i], NUM_HEADER_PIXELS, lsbBits) +
+                    (frameCounts[i] - 1) * StegoCapacity::MaxCapacity(algo, framePixels[i], 0, lsbBits);
+            }
+
+            options.push_back(option);
+        }
+    }
+
+    std::stable_sort(options.begin(), options.end(), [](const StegoPlanOption& a, const StegoPlanOption& b)
+    {
+        return a.estimatedSeconds < b.estimatedSeconds;
+    });
+
+    uint64_t requiredBytes = payloadBytes + mediaPaths.size() * mediumOverheadBytes;
+    for (StegoPlanOption& option : options)
+    {
+        if (option.capacity * constraints.maxFill < requiredBytes)
+        {
+            continue;
+        }
+
+        size_t lsbBits = std::min(constraints.lsbBits, StegoCapacity::MaxLsbBits(option.algo, option.edgeDetectionType));
+        StegoCapacity capacity(option.algo, option.edgeDetectionType, lsbBits);
+        capacity.SetEdgeCache(this->edgeCache);
+        option.capacity = 0;
+        bool bEveryMediumFits = true;
+        for (const std::string& mediaPath : mediaPaths)
+        {
+            uint64_t mediumCapacity = 0;
+            StegoStatus status = StegoStatus::SUCCESS;
+            if (std::filesystem::path(mediaPath).extension() == ".mkv")
+            {
+                CapacityTable table;
+                status = capacity.VideoCapacity(mediaPath, table);
+                mediumCapacity = table.totalCapacity;
+            }
+            else
+            {
+                status = capacity.ImageCapacity(mediaPath, mediumCapacity);
+            }
+
+            if (status != StegoStatus::SUCCESS)
+            {
+                return status;
+            }
+
+            bEveryMediumFits = bEveryMediumFits && mediumCapacity >= mediumOverheadBytes;
+            option.capacity += mediumCapacity;
+        }
+
+        option.bMeasured = true;
+        option.bFits = bEveryMediumFits && option.capacity * constraints.maxFill >= requiredBytes;
+        if (option.bFits)
+        {
+            return StegoStatus::SUCCESS;
+        }
+    }
+
+    return StegoStatus::FILE_TOO_LARGE;
+}
+
+/**
+ * @brief StegoPlanner::PlanEncode Plan the encode of the file at filePath into mediaPaths, a single medium unless
+ * bShards is set, see Stego::EncodeShards. The payload is planned as if it were not compressed.
+ * @param chosen Set to the fastest mode that holds the payload. When none does, to the mode with the most room,
+ * measured modes before the upper bounds of the modes ruled out from their dimensions
+ * @return See Plan
+ */
+StegoStatus StegoPlanner::PlanEncode(const std::string& filePath, const std::vector<std::string>& mediaPaths,
+                                     bool bShards, bool bEncrypt, const StegoPlanConstraints& constraints,
+                                     StegoPlanOption& chosen) const
+{
+    // Named like Stego names the file, a directory given with a trailing separator by the directory
+    std::filesystem::path path(filePath);
+    if (!path.has_filename())
+    {
+        path = path.parent_path();
+    }
+
+    uint64_t mediumOverheadBytes = path.filename().string().size() + (bShards ? StegoShard::PREFIX_BYTES : 0);
+    std::vector<StegoPlanOption> options;
+    StegoStatus status = Plan(mediaPaths, PayloadBytes(filePath, bEncrypt), mediumOverheadBytes, constraints,
+                              options);
+    if (options.empty())
+    {
+        return status;
+    }
+
+    auto fittingOption = std::find_if(options.begin(), options.end(),
+                                      [](const StegoPlanOption& option) { return option.bFits; });
+    if (fittingOption != options.end())
+    {
+        chosen = *fittingOption;
+    }
+    else
+    {
+        chosen = *std::max_element(options.begin(), options.end(), [](const StegoPlanOption& a, const StegoPlanOption& b)
+        {
+            return std::make_pair(a.bMeasured, a.capacity) < std::make_pair(b.bMeasured, b.capacity);
+        });
+    }
+
+    return status;
+}
+
+/**
+ * @brief StegoPlanner::PayloadBytes Bytes embedded for the file at filePath before compression: its size, or the
+ * size of the archive of a directory, plus the encryption overhead when bEncrypt is set.
+ */
+uint64_t StegoPlanner::PayloadBytes(const std::string& filePath, bool bEncrypt)
+{
+    std::error_code error;
+    uint64_t numBytes = 0;
+    if (std::filesystem::is_directory(filePath, error))
+    {
+        numBytes = StegoArchive::PREFIX_BYTES;
+        for (const auto& [memberPath, name] : StegoArchive::ListFiles(filePath))
+        {
+            numBytes += StegoArchive::MEMBER_FIXED_BYTES + name.size() + std::filesystem::file_size(memberPath, error);
+        }
+    }
+    else
+    {
+        numBytes = std::filesystem::file_size(filePath, error);
+        if (error)
+        {
+            numBytes = 0;
+        }
+    }
+
+    return numBytes + (bEncrypt ? ENCRYPTION_OVERHEAD_BYTES : 0);
+}
+
+bool StegoPlanner::ParseAlgo(const std::string& name, StegoAlgo& algo)
+{
+    for (StegoAlgo candidate : ALGOS)
+    {
+        if (name == AlgoName(candidate))
+        {
+            algo = candidate;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool StegoPlanner::ParseEdgeDetection(const std::string& name, EdgeDetectionType& edgeDetectionType)
+{
+    for (EdgeDetectionType candidate : EDGE_DETECTION_TYPES)
+    {
+        if (name == EdgeDetectionName(candidate))
+        {
+            edgeDetectionType = candidate;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+std::string StegoPlanner::AlgoName(StegoAlgo algo)
+{
+    return algo == StegoAlgo::PVD ? "PVD" : "LSB";
+}
+
+std::string StegoPlanner::EdgeDetectionName(EdgeDetectionType edgeDetectionType)
+{
+    switch (edgeDetectionType)
+    {
+    case EdgeDetectionType::None: return "None";
+    case EdgeDetectionType::Sobel: return "Sobel";
+    case EdgeDetectionType::Canny: return "Canny";
+    case EdgeDetectionType::Texture: return "Texture";
+    }
+
+    return "unknown";
+}
@@ -0,0 +1,104 @@
+#ifndef STEGOPLANNER_H
+#define STEGOPLANNER_H
+
+#include "StegoAlgo.h"
+#include "EdgeDetectionType.h"
+#include "StegoStatus.h"
+#include "edgecache.h"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+/**
+ * Run time of an encode per carrier pixel for every algorithm and edge detection mode. The defaults are the
+ * relative costs the job scheduler has always used, Calibrate replaces them with times measured on this machine
+ * and Save/Load keep the measurement, so it is only taken once.
+ */
+class StegoCostModel
+{
+public:
+    StegoCostModel();
+
+    double SecondsPerPixel(StegoAlgo algo, EdgeDetectionType edgeDetectionType) const;
+    void SetSecondsPerPixel(StegoAlgo algo, EdgeDetectionType edgeDetectionType, double seconds);
+    double EstimateSeconds(StegoAlgo algo, EdgeDetectionType edgeDetectionType, uint64_t numPixels) const;
+
+    void Calibrate(int rows = CALIBRATION_ROWS, int cols = CALIBRATION_COLS);
+    bool Load(const std::filesystem::path& path);
+    bool Save(const std::filesystem::path& path) const;
+
+    static constexpr size_t NUM_ALGOS = 2;
+    static constexpr size_t NUM_EDGE_DETECTION_TYPES = 4;
+    static constexpr int CALIBRATION_ROWS = 512;
+    static constexpr int CALIBRATION_COLS = 512;
+    static constexpr int CALIBRATION_RUNS = 3;
+
+private:
+    double secondsPerPixel[NUM_ALGOS][NUM_EDGE_DETECTION_TYPES];
+};
+
+/**
+ * Modes a plan may pick from and how much of their capacity the payload may take. Sobel, Canny and Texture only embed
+ * in edge pixels or textured blocks, where changes are hardest to see, and filling less of the capacity changes fewer
+ * pixels.
+ */
+struct StegoPlanConstraints
+{
+    std::vector<StegoAlgo> algos = {StegoAlgo::LSB, StegoAlgo::PVD};
+    std::vector<EdgeDetectionType> edgeDetectionTypes = {EdgeDetectionType::None, EdgeDetectionType::Sobel,
+                                                         EdgeDetectionType::Canny, EdgeDetectionType::Texture};
+    bool bRequireEdgeDetection = false;
+    // Largest fraction of the capacity of a mode the payload may fill
+    double maxFill = 1.0;
+    // Least significant bits per sample the LSB modes embed in, as far as StegoCapacity::MaxLsbBits allows
+    size_t lsbBits = 1;
+};
+
+/**
+ * One mode considered by a plan. Capacities are only measured until the fastest mode that fits is found, the modes
+ * left are given the upper bound their dimensions allow and bMeasured is false.
+ */
+struct StegoPlanOption
+{
+    StegoAlgo algo = StegoAlgo::LSB;
+    EdgeDetectionType edgeDetectionType = EdgeDetectionType::None;
+    double estimatedSeconds = 0;
+    uint64_t capacity = 0;
+    bool bMeasured = false;
+    bool bFits = false;
+};
+
+/**
+ * Picks the fastest algorithm and edge detection mode whose capacity holds a payload, for the "Auto" algorithm and
+ * edge detection names. Modes are tried in order of their estimated run time from the cost model and the carrier
+ * size, so usually only the capacity of the mode chosen is measured.
+ */
+class StegoPlanner
+{
+public:
+    explicit StegoPlanner(const StegoCostModel& costModel = StegoCostModel());
+    void SetEdgeCache(EdgeCache* edgeCache);
+
+    StegoStatus Plan(const std::vector<std::string>& mediaPaths, uint64_t payloadBytes, uint64_t mediumOverheadBytes,
+                     const StegoPlanConstraints& constraints, std::vector<StegoPlanOption>& options) const;
+    StegoStatus PlanEncode(const std::string& filePath, const std::vector<std::string>& mediaPaths, bool bShards,
+                           bool bEncrypt, const StegoPlanConstraints& constraints, StegoPlanOption& chosen) const;
+
+    static uint64_t PayloadBytes(const std::string& filePath, bool bEncrypt);
+    static bool ParseAlgo(const std::string& name, StegoAlgo& algo);
+    static bool ParseEdgeDetection(const std::string& name, EdgeDetectionType& edgeDetectionType);
+    static std::string AlgoName(StegoAlgo algo);
+    static std::string EdgeDetectionName(EdgeDetectionType edgeDetectionType);
+
+    static constexpr const char* AUTO = "Auto";
+    // Salt, key check, padding and MAC added by EncryptFile, rounded up
+    static constexpr uint64_t ENCRYPTION_OVERHEAD_BYTES = 128;
+
+private:
+    StegoCostModel costModel;
+    EdgeCache* edgeCache = nullptr;
+};
+
+#endif // STEGOPLANNER_H
@@ -0,0 +1,160 @@
+#include "stegoscanner.h"
+#include "stegocapacity.h"
+#include "threadpool.h"
+#include "pngstrips.h"
+#include <algorithm>
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+
+StegoScanner::StegoScanner(size_t numWorkers)
+    : numWorkers(numWorkers)
+{
+}
+
+/**
+ * @brief StegoScanner::ReadPngRows Decode only the rows of a png holding its first numPixels pixels. The rest of
+ * the file is not read.
+ * @param rows Set to the decoded rows as 8-bit BGR
+ * @param totalPixels Set to the number of pixels of the whole image
+ * @return StegoStatus::IMAGE_NOT_FOUND if the file could not be opened, StegoStatus::INVALID_MEDIA if it could not
+ * be decoded row by row, StegoStatus::SUCCESS otherwise
+ */
+StegoStatus StegoScanner::ReadPngRows(const std::string& path, size_t numPixels, cv::Mat& rows, uint64_t& totalPixels)
+{
+    PngStripReader reader;
+    StegoStatus status = reader.Open(path);
+    if (status != StegoStatus::SUCCESS)
+    {
+        return status;
+    }
+
+    size_t width = static_cast<size_t>(reader.Width());
+    size_t numRows = std::min<size_t>((std::max<size_t>(numPixels, 1) + width - 1) / width, reader.Height());
+    rows.create(static_cast<int>(numRows), reader.Width(), CV_8UC3);
+    totalPixels = static_cast<uint64_t>(width) * reader.Height();
+
+    return reader.ReadRows(rows);
+}
+
+/**
+ * @brief StegoScanner::IsMediaFile Whether path has the extension of media the tool embeds in.
+ */
+bool StegoScanner::IsMediaFile(const std::filesystem::path& path)
+{
+    std::string extension = path.extension().string();
+    return extension == ".png" || extension == ".mkv";
+}
+
+/**
+ * @brief StegoScanner::ScanFile Read the header of a png image or of the first frame of an mkv video.
+ * @return Result with StegoStatus::SUCCESS if the media carries a payload, StegoStatus::INVALID_HEADER if it does not
+ * and the error code of reading the media otherwise
+ */
+ScanResult StegoScanner::ScanFile(const std::string& mediaPath)
+{
+    ScanResult result;
+    result.mediaPath = mediaPath;
+
+    Mat pixels;
+    uint64_t numPixels = 0;
+    uint64_t numFrames = 1;
+    std::string extension = std::filesystem::path(mediaPath).extension().string();
+    if (extension == ".png")
+    {
+        size_t numHeaderPixels = StegoHeader::NumPixels(StegoHeader::CURRENT_VERSION);
+        result.status = ReadPngRows(mediaPath, numHeaderPixels, pixels, numPixels);
+        if (result.status == StegoStatus::INVALID_MEDIA)
+        {
+            pixels = imread(mediaPath, IMREAD_COLOR);
+            numPixels = pixels.total();
+            result.status = pixels.empty() ? StegoStatus::INVALID_MEDIA : StegoStatus::SUCCESS;
+        }
+    }
+    else if (extension == ".mkv")
+    {
+        VideoCapture video(mediaPath);
+        if (!video.isOpened())
+        {
+            result.status = StegoStatus::VIDEO_OPEN_FAILED;
+            return result;
+        }
+
+        numFrames = StegoCapacity::MaxFrameCount(video.get(CAP_PROP_FRAME_COUNT));
+        video >> pixels;
+        numPixels = pixels.total();
+        result.status = pixels.empty() ? StegoStatus::INVALID_MEDIA : StegoStatus::SUCCESS;
+    }
+    else
+    {
+        result.status = StegoStatus::INVALID_MEDIA;
+    }
+
+    if (result.status != StegoStatus::SUCCESS)
+    {
+        return result;
+    }
+
+    result.status = result.header.Read(pixels);
+    if (result.status == StegoStatus::SUCCESS && !result.header.FitsIn(numPixels, numFrames))
+    {
+        result.status = StegoStatus::INVALID_HEADER;
+    }
+
+    return result;
+}
+
+/**
+ * @brief StegoScanner::Scan Scan a media file, or every png and mkv file under a directory on the worker pool.
+ * @param results Set to one result per media file, sorted by path
+ * @return StegoStatus::FILE_NOT_FOUND if path is neither a file nor a directory, StegoStatus::SUCCESS otherwise
+ */
+StegoStatus StegoScanner::Scan(const std::string& path, std::vector<ScanResult>& results) const
+{
+    results.clear();
+
+    std::error_code error;
+    if (std::filesystem::is_regular_file(path, error))
+    {
+        results.push_back(ScanFile(path));
+        return StegoStatus::SUCCESS;
+    }
+
+    if (!std::filesystem::is_directory(path, error))
+    {
+        return StegoStatus::FILE_NOT_FOUND;
+    }
+
+    std::vector<std::string> mediaPaths;
+    auto options = std::filesystem::directory_options::skip_permission_denied;
+    for (auto entry = std::filesystem::recursive_directory_iterator(path, options, error);
+         !error && entry != std::filesystem::recursive_directory_iterator(); entry.increment(error))
+    {
+        std::error_code entryError;
+        if (entry->is_regular_file(entryError) && IsMediaFile(entry->path()))
+        {
+            mediaPaths.push_back(entry->path().string());
+        }
+    }
+
+    std::sort(mediaPaths.begin(), mediaPaths.end());
+    results.resize(mediaPaths.size());
+
+    // Most files are rejected in microseconds, so files are handed to the workers in groups
+    WorkStealingThreadPool threadPool(this->numWorkers);
+    size_t numTasks = (mediaPaths.size() + FILES_PER_TASK - 1) / FILES_PER_TASK;
+    for (size_t task = 0; task < numTasks; task++)
+    {
+        threadPool.Submit([&mediaPaths, &results, task]() {
+            size_t last = std::min(mediaPaths.size(), (task + 1) * FILES_PER_TASK);
+            for (size_t i = task * FILES_PER_TASK; i < last; i++)
+            {
+                results[i] = ScanFile(mediaPaths[i]);
+            }
+        }, task % threadPool.NumThreads());
+    }
+
+    threadPool.Wait();
+
+    return StegoStatus::SUCCESS;
+}
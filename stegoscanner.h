@@ -0,0 +1,43 @@
+#ifndef STEGOSCANNER_H
+#define STEGOSCANNER_H
+
+#include "StegoStatus.h"
+#include "stegoheader.h"
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <opencv2/core/mat.hpp>
+
+/**
+ * Result of scanning one media file. The header is only valid when status is StegoStatus::SUCCESS.
+ */
+struct ScanResult
+{
+    std::string mediaPath;
+    StegoStatus status = StegoStatus::INVALID_HEADER;
+    StegoHeader header;
+};
+
+/**
+ * Finds the media carrying a payload and reads the settings it was embedded with, without extracting anything.
+ * Png images are only decoded up to the rows holding the header and videos only up to the first frame.
+ */
+class StegoScanner
+{
+public:
+    explicit StegoScanner(size_t numWorkers = 0);
+
+    StegoStatus Scan(const std::string& path, std::vector<ScanResult>& results) const;
+
+    static ScanResult ScanFile(const std::string& mediaPath);
+    static bool IsMediaFile(const std::filesystem::path& path);
+    static StegoStatus ReadPngRows(const std::string& path, size_t numPixels, cv::Mat& rows, uint64_t& totalPixels);
+
+    static constexpr size_t FILES_PER_TASK = 32;
+
+private:
+    size_t numWorkers;
+};
+
+#endif // STEGOSCANNER_H
@@ -0,0 +1,90 @@
+#include "stegoshard.h"
+#include "stegoarchive.h"
+#include <algorithm>
+
+/**
+ * @brief StegoShard::WritePrefix
+ * @return The PREFIX_BYTES the payload of the shard starts with
+ */
+std::string StegoShard::WritePrefix() const
+{
+    std::string prefix;
+    putLittleEndian(prefix, MAGIC, 4);
+    putLittleEndian(prefix, this->setId, 8);
+    putLittleEndian(prefix, this->index, 4);
+    putLittleEndian(prefix, this->count, 4);
+    putLittleEndian(prefix, this->offset, 8);
+    putLittleEndian(prefix, this->payloadLength, 8);
+
+    return prefix;
+}
+
+/**
+ * @brief StegoShard::ReadPrefix Read the prefix of a shard payload of shardLength bytes. Its slice must lie inside
+ * the payload of the set.
+ * @return StegoStatus::INVALID_HEADER if the payload is no shard, StegoStatus::SUCCESS otherwise
+ */
+StegoStatus StegoShard::ReadPrefix(const std::vector<uint8_t>& prefix, uint64_t shardLength)
+{
+    if (prefix.size() < PREFIX_BYTES || shardLength < PREFIX_BYTES || readLittleEndian(prefix, 0, 4) != MAGIC)
+    {
+        return StegoStatus::INVALID_HEADER;
+    }
+
+    this->setId = readLittleEndian(prefix, 4, 8);
+    this->index = static_cast<uint32_t>(readLittleEndian(prefix, 12, 4));
+    this->count = static_cast<uint32_t>(readLittleEndian(prefix, 16, 4));
+    this->offset = readLittleEndian(prefix, 20, 8);
+    this->payloadLength = readLittleEndian(prefix, 28, 8);
+
+    uint64_t sliceLength = shardLength - PREFIX_BYTES;
+    if (this->index >= this->count || this->offset > this->payloadLength ||
+        sliceLength > this->payloadLength - this->offset)
+    {
+        return StegoStatus::INVALID_HEADER;
+    }
+
+    return StegoStatus::SUCCESS;
+}
+
+/**
+ * @brief StegoShard::Split Plan the slices of a payload of payloadLength bytes across media that hold capacities
+ * bytes of slice each. Every medium gets a share of the payload in proportion to its capacity, so the shards take
+ * about as long to encode as their media allow.
+ * @return The length of every slice in the order of capacities, empty if the payload does not fit
+ */
+std::vector<uint64_t> StegoShard::Split(uint64_t payloadLength, const std::vector<uint64_t>& capacities)
+{
+    uint64_t totalCapacity = 0;
+    for (uint64_t capacity : capacities)
+    {
+        totalCapacity += capacity;
+    }
+
+    if (capacities.empty() || payloadLength > totalCapacity)
+    {
+        return {};
+    }
+
+    // Slices end at the payload's share of the capacity so far, rounding never pushes one past its medium
+    std::vector<uint64_t> lengths;
+    uint64_t capacitySoFar = 0;
+    uint64_t end = 0;
+    for (uint64_t capacity : capacities)
+    {
+        capacitySoFar += capacity;
+        uint64_t nextEnd = static_cast<uint64_t>(static_cast<long double>(payloadLength) * capacitySoFar / totalCapacity);
+        uint64_t remainingCapacity = totalCapacity - capacitySoFar;
+        if (capacitySoFar == totalCapacity || nextEnd > payloadLength)
+        {
+            nextEnd = payloadLength;
+        }
+
+        nextEnd = std::max(nextEnd, payloadLength > remainingCapacity ? payloadLength - remainingCapacity : 0);
+        nextEnd = std::max(std::min(nextEnd, end + capacity), end);
+        lengths.push_back(nextEnd - end);
+        end = nextEnd;
+    }
+
+    return lengths;
+}
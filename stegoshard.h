@@ -0,0 +1,49 @@
+#ifndef STEGOSHARD_H
+#define STEGOSHARD_H
+
+#include "StegoStatus.h"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * One shard of a payload split across several media, see Stego::EncodeShards. The shard flag of the stego header
+ * marks media holding a shard, its payload starts with a prefix of PREFIX_BYTES followed by the bytes of the slice.
+ *
+ * The prefix holds the magic tag, the id shared by the shards of a set, the index of the shard, the number of shards,
+ * the offset of the slice in the payload and the length of the whole payload, little endian in 4, 8, 4, 4, 8 and
+ * 8 bytes. The slice is the rest of the shard payload, so a set can be reassembled in any order.
+ */
+struct StegoShard
+{
+    static constexpr uint32_t MAGIC = 0x44524853;
+    static constexpr size_t PREFIX_BYTES = 4 + 8 + 4 + 4 + 8 + 8;
+
+    uint64_t setId = 0;
+    uint32_t index = 0;
+    uint32_t count = 0;
+    uint64_t offset = 0;
+    uint64_t payloadLength = 0;
+
+    std::string WritePrefix() const;
+    StegoStatus ReadPrefix(const std::vector<uint8_t>& prefix, uint64_t shardLength);
+
+    static std::vector<uint64_t> Split(uint64_t payloadLength, const std::vector<uint64_t>& capacities);
+};
+
+/**
+ * Shards of a set decoded so far, shared by the threads of Stego::DecodeShards. The first shard decoded sets what
+ * the others must match and creates the file the slices are written to.
+ */
+struct StegoShardSet
+{
+    std::mutex mutex;
+    StegoShard first;
+    std::vector<bool> bDecoded;
+    std::filesystem::path filePath;
+};
+
+#endif // STEGOSHARD_H
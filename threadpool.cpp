@@ -0,0 +1,159 @@
+#include "threadpool.h"
+#include <algorithm>
+
+thread_local size_t currentWorker = 0;
+
+WorkStealingThreadPool::WorkStealingThreadPool(size_t numThreads)
+    : queuedTasks(0)
+    , unfinishedTasks(0)
+    , bStopping(false)
+{
+    if (numThreads == 0)
+    {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (size_t i = 0; i < numThreads; i++)
+    {
+        queues.push_back(std::make_unique<WorkerQueue>());
+    }
+
+    for (size_t i = 0; i < numThreads; i++)
+    {
+        threads.emplace_back(&WorkStealingThreadPool::workerLoop, this, i);
+    }
+}
+
+WorkStealingThreadPool::~WorkStealingThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        bStopping = true;
+    }
+
+    workAvailable.notify_all();
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+/**
+ * @brief WorkStealingThreadPool::Submit Queue a task on the given worker's queue. Other workers may steal it.
+ */
+void WorkStealingThreadPool::Submit(std::function<void()> task, size_t worker)
+{
+    // Count the task before publishing it, a worker may pop it and decrement queuedTasks as soon as it is queued
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        queuedTasks++;
+        unfinishedTasks++;
+    }
+
+    WorkerQueue& queue = *queues[worker % queues.size()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+
+    workAvailable.notify_one();
+}
+
+/**
+ * @brief WorkStealingThreadPool::Wait Block until every submitted task has finished.
+ */
+void WorkStealingThreadPool::Wait()
+{
+    std::unique_lock<std::mutex> lock(stateMutex);
+    allTasksDone.wait(lock, [this] { return unfinishedTasks == 0; });
+}
+
+size_t WorkStealingThreadPool::NumThreads() const
+{
+    return threads.size();
+}
+
+/**
+ * @brief WorkStealingThreadPool::CurrentWorker
+ * @return Index of the worker running the calling task
+ */
+size_t WorkStealingThreadPool::CurrentWorker()
+{
+    return currentWorker;
+}
+
+bool WorkStealingThreadPool::popTask(size_t worker, std::function<void()>& task)
+{
+    WorkerQueue& queue = *queues[worker];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty())
+    {
+        return false;
+    }
+
+    task = std::move(queue.tasks.front());
+    queue.tasks.pop_front();
+
+    return true;
+}
+
+bool WorkStealingThreadPool::stealTask(size_t thief, std::function<void()>& task)
+{
+    for (size_t i = 1; i < queues.size(); i++)
+    {
+        WorkerQueue& queue = *queues[(thief + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty())
+        {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void WorkStealingThreadPool::workerLoop(size_t worker)
+{
+    currentWorker = worker;
+
+    while (true)
+    {
+        std::function<void()> task;
+        if (popTask(worker, task) || stealTask(worker, task))
+        {
+            {
+                std::lock_guard<std::mutex> lock(stateMutex);
+                queuedTasks--;
+            }
+
+            // An exception must not end the worker or leave the task counted, Wait() would never return.
+            // Tasks report their own failures, see JobScheduler::RunJob
+            try
+            {
+                task();
+            }
+            catch (...)
+            {
+            }
+
+            std::lock_guard<std::mutex> lock(stateMutex);
+            unfinishedTasks--;
+            if (unfinishedTasks == 0)
+            {
+                allTasksDone.notify_all();
+            }
+
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(stateMutex);
+        workAvailable.wait(lock, [this] { return bStopping || queuedTasks > 0; });
+        if (bStopping && queuedTasks == 0)
+        {
+            return;
+        }
+    }
+}
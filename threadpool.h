@@ -0,0 +1,50 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Fixed size thread pool where every worker owns a task queue. Workers take tasks from the front of their
+ * own queue and, once it is empty, steal from the back of the other workers' queues.
+ */
+class WorkStealingThreadPool
+{
+public:
+    explicit WorkStealingThreadPool(size_t numThreads = 0);
+    ~WorkStealingThreadPool();
+
+    void Submit(std::function<void()> task, size_t worker);
+    void Wait();
+
+    size_t NumThreads() const;
+    static size_t CurrentWorker();
+
+private:
+    struct WorkerQueue
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> threads;
+
+    std::mutex stateMutex;
+    std::condition_variable workAvailable;
+    std::condition_variable allTasksDone;
+    size_t queuedTasks;
+    size_t unfinishedTasks;
+    bool bStopping;
+
+    bool popTask(size_t worker, std::function<void()>& task);
+    bool stealTask(size_t thief, std::function<void()>& task);
+    void workerLoop(size_t worker);
+};
+
+#endif // THREADPOOL_H
@@ -0,0 +1,125 @@
+#include "videobackend.h"
+#include <array>
+#include <cstdlib>
+#include <sstream>
+
+// Slice counts the FFV1 encoder accepts for frames larger than CIF, a grid of v x h slices with v <= h < 2v
+const std::array<int, 7> FFV1_SLICE_COUNTS = { 4, 6, 9, 12, 16, 24, 30 };
+
+VideoBackend::VideoBackend(VideoCodec codec, int numThreads, int numSlices)
+    : codec(codec)
+    , numThreads(numThreads < 0 ? 0 : numThreads)
+    , numSlices(FFV1_SLICE_COUNTS.front())
+{
+    for (int sliceCount : FFV1_SLICE_COUNTS)
+    {
+        if (sliceCount <= numSlices)
+        {
+            this->numSlices = sliceCount;
+        }
+    }
+}
+
+VideoCodec VideoBackend::Codec() const
+{
+    return this->codec;
+}
+
+/**
+ * @brief VideoBackend::NumThreads Encoder threads, 0 lets ffmpeg pick one per core.
+ */
+int VideoBackend::NumThreads() const
+{
+    return this->numThreads;
+}
+
+/**
+ * @brief VideoBackend::NumSlices FFV1 slices per frame, the requested count rounded down to one the encoder accepts.
+ * Slices are coded independently, more of them encode and decode on more threads at a small cost in size.
+ */
+int VideoBackend::NumSlices() const
+{
+    return this->numSlices;
+}
+
+/**
+ * @brief VideoBackend::EncoderArguments ffmpeg output options that encode the video stream with this backend.
+ */
+std::string VideoBackend::EncoderArguments() const
+{
+    std::ostringstream arguments;
+    switch (this->codec)
+    {
+    case VideoCodec::FFV1:
+        // Every frame a keyframe, so decoders can seek and decode slices of a frame in parallel
+        arguments << "-c:v ffv1 -level 3 -g 1 -slices " << this->numSlices << " -slicecrc 1 -pix_fmt bgr0";
+        break;
+    case VideoCodec::X264RGB:
+        // The quantizer alone makes x264 lossless, the preset only trades encode speed against size
+        arguments << "-c:v libx264rgb -qp 0 -preset veryfast -pix_fmt bgr24";
+        break;
+    case VideoCodec::UTVideo:
+        arguments << "-c:v utvideo -pred median -pix_fmt gbrp";
+        break;
+    case VideoCodec::Raw:
+        // Matroska has no native raw RGB, the frames are stored in VfW compatibility mode
+        arguments << "-c:v rawvideo -pix_fmt bgr24 -allow_raw_vfw 1";
+        break;
+    }
+
+    arguments << " -threads " << this->numThreads;
+
+    return arguments.str();
+}
+
+/**
+ * @brief VideoBackend::IsEncoderAvailable Whether the ffmpeg on the path was built with this backend's encoder.
+ * Encodes a single blank frame and throws it away.
+ */
+bool VideoBackend::IsEncoderAvailable() const
+{
+    std::ostringstream command;
+    command << "ffmpeg -loglevel quiet -y -f lavfi -i color=c=black:s=640x360:d=0.04 " << EncoderArguments()
+            << " -f null -";
+
+    return std::system(command.str().c_str()) == 0;
+}
+
+bool VideoBackend::ParseCodec(const std::string& name, VideoCodec& codec)
+{
+    if (name == "FFV1")
+    {
+        codec = VideoCodec::FFV1;
+    }
+    else if (name == "x264rgb")
+    {
+        codec = VideoCodec::X264RGB;
+    }
+    else if (name == "UTVideo")
+    {
+        codec = VideoCodec::UTVideo;
+    }
+    else if (name == "Raw")
+    {
+        codec = VideoCodec::Raw;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+std::string VideoBackend::CodecName(VideoCodec codec)
+{
+    switch (codec)
+    {
+    case VideoCodec::FFV1: return "FFV1";
+    case VideoCodec::X264RGB: return "x264rgb";
+    case VideoCodec::UTVideo: return "UTVideo";
+    case VideoCodec::Raw: return "Raw";
+    }
+
+    return "Unknown";
+}
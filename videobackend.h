@@ -0,0 +1,35 @@
+#ifndef VIDEOBACKEND_H
+#define VIDEOBACKEND_H
+
+#include "VideoCodec.h"
+#include <string>
+
+/**
+ * Lossless codec EncodeVideo writes the stego frames with. Every codec decodes back to exactly the BGR frames that
+ * were embedded into, so the choice only trades encode and decode speed against file size. The container is the
+ * carrier's, normally MKV.
+ */
+class VideoBackend
+{
+public:
+    VideoBackend(VideoCodec codec = VideoCodec::FFV1, int numThreads = 0, int numSlices = DEFAULT_FFV1_SLICES);
+
+    VideoCodec Codec() const;
+    int NumThreads() const;
+    int NumSlices() const;
+
+    std::string EncoderArguments() const;
+    bool IsEncoderAvailable() const;
+
+    static bool ParseCodec(const std::string& name, VideoCodec& codec);
+    static std::string CodecName(VideoCodec codec);
+
+    static constexpr int DEFAULT_FFV1_SLICES = 16;
+
+private:
+    VideoCodec codec;
+    int numThreads;
+    int numSlices;
+};
+
+#endif // VIDEOBACKEND_H